@@ -68,19 +68,19 @@ static void ParseComposeStringFile(FILE *fp);
 static int get_lang_region(char *, size_t);
 static int TransFileName(char *, const char *, size_t);
 
-static DefTree *g_tree;
+static uim_x_compose_table *g_table;
+/* while parsing the Compose file */
+static uim_x_compose_builder *g_builder;
 
 Compose *
 im_uim_compose_new()
 {
-    DefTree *top = g_tree;
     Compose *p;
 
     p = malloc(sizeof(Compose));
     if (p) {
-	p->m_composed = NULL;
-	p->m_top = top;
-	p->m_context = top;
+	p->m_table = g_table;
+	p->m_state = 0;
     }
 
     return p;
@@ -90,40 +90,34 @@ static int
 handleKey(unsigned int xkeysym, unsigned int xkeystate, int is_push,
 		     IMUIMContext *uic)
 {
-    DefTree *p;
-    DefTree *m_top = uic->compose->m_top;
-    DefTree *m_context = uic->compose->m_context;
+    const uim_x_compose_entry *p;
+    uim_x_compose_table *m_table = uic->compose->m_table;
+    unsigned int m_state = uic->compose->m_state;
 
-    if ((is_push == 0)  || m_top == NULL)
+    if ((is_push == 0)  || m_table == NULL)
 	return 0;
 
     if (IsModifierKey(xkeysym))
 	return 0;
 
-    for (p = m_context; p ; p = p->next) {
-	if (((xkeystate & p->modifier_mask) == p->modifier) &&
-		(xkeysym == p->keysym)) {
-	    break;
-	}
-    }
+    p = uim_x_compose_table_lookup(m_table, m_state, xkeysym, xkeystate);
 
     if (p) { /* Matched */
-	if (p->succession) { /* Intermediate */
-	    uic->compose->m_context = p->succession;
+	if (p->next_state) { /* Intermediate */
+	    uic->compose->m_state = p->next_state;
 	    return 1;
 	} else { /* Terminate (reached to leaf) */
-	    uic->compose->m_composed = p;
 	    /* commit string here */
-	    im_uim_commit_string(uic, uic->compose->m_composed->utf8);
+	    im_uim_commit_string(uic, uim_x_compose_table_utf8(m_table, p));
 	    /* initialize internal state for next key sequence */
-	    uic->compose->m_context = m_top;
+	    uic->compose->m_state = 0;
 	    return 1;
 	}
     } else { /* Unmatched */
-	if (m_context == m_top)
+	if (m_state == 0)
 	    return 0;
 	/* Error (Sequence Unmatch occurred) */
-	uic->compose->m_context = m_top;
+	uic->compose->m_state = 0;
 	return 1;
     }
 }
@@ -131,8 +125,7 @@ handleKey(unsigned int xkeysym, unsigned int xkeystate, int is_push,
 void
 im_uim_compose_reset(Compose *compose)
 {
-    compose->m_context = compose->m_top;
-    compose->m_composed = NULL;
+    compose->m_state = 0;
 }
 
 static int
@@ -464,8 +457,6 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
     unsigned modifier;
     unsigned tmp;
     KeySym keysym = NoSymbol;
-    DefTree **top = &g_tree;
-    DefTree *p = NULL;
     Bool exclam, tilde;
     KeySym rhs_keysym = 0;
     char *rhs_string_mb;
@@ -473,15 +464,8 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
     int lastch = 0;
     char local_mb_buf[MB_LEN_MAX + 1];
     char *rhs_string_utf8;
-
-    struct DefBuffer {
-	unsigned modifier_mask;
-	unsigned modifier;
-	KeySym keysym;
-    };
-
-    struct DefBuffer buf[SEQUENCE_MAX];
-    int i, n;
+    uim_x_compose_key buf[SEQUENCE_MAX];
+    int n;
     const char *encoding;
     g_get_charset(&encoding);
 
@@ -507,6 +491,7 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
 	    infp = fopen(filename, "r");
 	    if (infp == NULL)
 		goto error;
+	    uim_x_compose_builder_add_source(g_builder, filename);
 	    ParseComposeStringFile(infp);
 	    fclose(infp);
 	    return 0;
@@ -628,39 +613,9 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
 	g_free(result);
     }
 
-    for (i = 0; i < n; i++) {
-	for (p = *top; p; p = p->next) {
-	    if (buf[i].keysym == p->keysym &&
-		buf[i].modifier == p->modifier &&
-		buf[i].modifier_mask == p->modifier_mask) {
-		break;
-	    }
-	}
-	if (p) {
-	    top = &p->succession;
-	} else {
-	    if ((p = (DefTree*)malloc(sizeof(DefTree))) == NULL) {
-		free(rhs_string_mb);
-		goto error;
-	    }
-	    p->keysym = buf[i].keysym;
-	    p->modifier = buf[i].modifier;
-	    p->modifier_mask = buf[i].modifier_mask;
-	    p->succession = NULL;
-	    p->next = *top;
-	    p->mb = NULL;
-	    p->utf8 = NULL;
-	    p->ks = NoSymbol;
-	    *top = p;
-	    top = &p->succession;
-	}
-    }
-
-    free(p->mb);
-    p->mb = rhs_string_mb;
-    free(p->utf8);
-    p->utf8 = rhs_string_utf8;
-    p->ks = rhs_keysym;
+    free(rhs_string_mb);
+    n = uim_x_compose_builder_add(g_builder, buf, n, rhs_string_utf8);
+    free(rhs_string_utf8);
     return n;
 error:
     while (token != ENDOFLINE && token != ENDOFFILE) {
@@ -711,6 +666,7 @@ void im_uim_create_compose_tree()
     FILE *fp = NULL;
     char name[MAXPATHLEN];
     char lang_region[BUFSIZ];
+    char locale[BUFSIZ];
     const char *encoding;
     char *compose_env;
     int ret;
@@ -746,30 +702,28 @@ void im_uim_create_compose_tree()
 	fclose(fp);
 	return;
     }
+    snprintf(locale, sizeof(locale), "%s.%s", lang_region, encoding);
 
-    ParseComposeStringFile(fp);
-    fclose(fp);
-}
-
-static void
-FreeComposeTree(DefTree *top)
-{
-    if (!top)
+    /* use the table compiled by another process if it is up to date */
+    g_table = uim_x_compose_table_load(name, locale);
+    if (g_table) {
+	fclose(fp);
 	return;
+    }
 
-    if (top->succession)
-	FreeComposeTree(top->succession);
-    if (top->next)
-	FreeComposeTree(top->next);
-    free(top->mb);
-    free(top->utf8);
-    free(top);
+    g_builder = uim_x_compose_builder_new();
+    uim_x_compose_builder_add_source(g_builder, name);
+    ParseComposeStringFile(fp);
+    fclose(fp);
+    g_table = uim_x_compose_builder_finish(g_builder, name, locale);
+    g_builder = NULL;
 }
 
 void
 im_uim_release_compose_tree()
 {
-    FreeComposeTree(g_tree);
+    uim_x_compose_table_free(g_table);
+    g_table = NULL;
 }
 
 static int
@@ -35,23 +35,12 @@
 
 #include <X11/X.h>
 
-typedef struct _DefTree {
-    struct _DefTree *next;		/* another Key definition */
-    struct _DefTree *succession;	/* successive Key Sequence */
-					/* Key definitions */
-    unsigned modifier_mask;
-    unsigned modifier;
-    KeySym keysym;			/* leaf only */
-    char *mb;
-    char *utf8;				/* make from mb */
-    KeySym ks;
-} DefTree;
+#include "uim/uim-x-util.h"
 
 typedef struct _Compose
 {
-    DefTree *m_top;
-    DefTree *m_context;
-    DefTree *m_composed;
+    uim_x_compose_table *m_table;
+    unsigned int m_state;
 } Compose;
 
 void im_uim_create_compose_tree(void);
@@ -88,7 +88,14 @@ struct preedit_segment {
 };
 
 static int im_uim_fd = -1;
+/* the helper messages handled in parse_helper_str() */
+static const char *const helper_subscription[] = {
+  "im_change", "prop_update_custom", "custom_reload_notify",
+  "prop_list_get", "prop_activate", "im_list_get", "commit_string",
+  "focus_in", NULL
+};
 static unsigned int read_tag;
+static unsigned int server_read_tag;
 #if IM_UIM_USE_SNOOPER
 static guint snooper_id;
 static gboolean snooper_installed = FALSE;
@@ -678,24 +685,13 @@ update_cb(void *ptr)
 }
 
 static void
-update_prop_list_cb(void *ptr, const char *str)
+update_caret_state_indicator(IMUIMContext *uic, const char *str)
 {
-  IMUIMContext *uic = (IMUIMContext *)ptr;
-  GString *prop_list;
   uim_bool show_state;
   char *show_state_with;
   uim_bool show_state_mode;
   uim_bool show_state_mode_on;
 
-  if (uic != focused_context || disable_focused_context)
-    return;
-
-  prop_list = g_string_new("");
-  g_string_printf(prop_list, "prop_list_update\ncharset=UTF-8\n%s", str);
-
-  uim_helper_send_message(im_uim_fd, prop_list->str);
-  g_string_free(prop_list, TRUE);
-
   show_state = uim_scm_symbol_value_bool("bridge-show-input-state?");
   show_state_with = uim_scm_c_symbol(uim_scm_symbol_value("bridge-show-with?"));
   show_state_mode = (strcmp(show_state_with, "mode") == 0);
@@ -727,6 +723,43 @@ update_prop_list_cb(void *ptr, const char *str)
   free(show_state_with);
 }
 
+static void
+update_prop_list_cb(void *ptr, const char *str)
+{
+  IMUIMContext *uic = (IMUIMContext *)ptr;
+  GString *prop_list;
+
+  if (uic != focused_context || disable_focused_context)
+    return;
+
+  prop_list = g_string_new("");
+  g_string_printf(prop_list, "prop_list_update\ncharset=UTF-8\n%s", str);
+
+  uim_helper_send_message(im_uim_fd, prop_list->str);
+  g_string_free(prop_list, TRUE);
+
+  update_caret_state_indicator(uic, str);
+}
+
+static void
+update_prop_state_cb(void *ptr, const char *str)
+{
+  IMUIMContext *uic = (IMUIMContext *)ptr;
+  GString *prop_state;
+
+  if (uic != focused_context || disable_focused_context)
+    return;
+
+  prop_state = g_string_new("");
+  g_string_printf(prop_state, "prop_state_update\ncharset=UTF-8\n%s", str);
+
+  uim_helper_send_message(im_uim_fd, prop_state->str);
+  g_string_free(prop_state, TRUE);
+
+  /* the state string has the same branch lines as prop_list */
+  update_caret_state_indicator(uic, str);
+}
+
 #if IM_UIM_USE_NEW_PAGE_HANDLING
 static GSList *
 get_page_candidates(IMUIMContext *uic,
@@ -828,12 +861,30 @@ cand_activate_timeout(gpointer data)
   return FALSE;
 }
 
+static gboolean
+cand_activate_io_cb(GIOChannel *channel, GIOCondition c, gpointer data)
+{
+  IMUIMContext *uic = (IMUIMContext *)data;
+
+  g_object_set_data(G_OBJECT(uic->cwin), "watch-tag", GUINT_TO_POINTER(0));
+  cand_activate_timeout(data);
+  return FALSE;
+}
+
+/* removes both the timer and the fd watch */
 static void
 cand_delay_timer_remove(UIMCandWinGtk *cwin)
 {
   guint tag = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(cwin), "timeout-tag"));
-  if (tag > 0)
+  if (tag > 0) {
     g_source_remove(tag);
+    g_object_set_data(G_OBJECT(cwin), "timeout-tag", GUINT_TO_POINTER(0));
+  }
+  tag = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(cwin), "watch-tag"));
+  if (tag > 0) {
+    g_source_remove(tag);
+    g_object_set_data(G_OBJECT(cwin), "watch-tag", GUINT_TO_POINTER(0));
+  }
 }
 
 static void
@@ -851,6 +902,23 @@ cand_activate_with_delay_cb(void *ptr, int delay)
     cand_activate_timeout(ptr);
   }
 }
+
+static void
+cand_activate_on_fd_cb(void *ptr, int fd)
+{
+  IMUIMContext *uic = (IMUIMContext *)ptr;
+  GIOChannel *channel;
+  guint tag;
+
+  cand_delay_timer_remove(uic->cwin);
+  if (fd >= 0) {
+    channel = g_io_channel_unix_new(fd);
+    tag = g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+			 cand_activate_io_cb, (gpointer)uic);
+    g_io_channel_unref(channel);
+    g_object_set_data(G_OBJECT(uic->cwin), "watch-tag", GUINT_TO_POINTER(tag));
+  }
+}
 #endif /* IM_UIM_USE_DELAY */
 
 static void
@@ -1282,10 +1350,38 @@ helper_read_cb(GIOChannel *channel, GIOCondition c, gpointer p)
   return TRUE;
 }
 
+/* uim-server related */
+
+static gboolean
+server_read_cb(GIOChannel *channel, GIOCondition c, gpointer p)
+{
+  uim_server_read_proc();
+  return TRUE;
+}
+
+static void
+server_watch_cb(int fd)
+{
+  GIOChannel *channel;
+
+  if (server_read_tag) {
+    g_source_remove(server_read_tag);
+    server_read_tag = 0;
+  }
+  if (fd < 0)
+    return;
+
+  channel = g_io_channel_unix_new(fd);
+  server_read_tag = g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+				   server_read_cb, NULL);
+  g_io_channel_unref(channel);
+}
+
 static void
 check_helper_connection()
 {
   if (im_uim_fd < 0) {
+    uim_helper_client_subscribe(helper_subscription);
     im_uim_fd = uim_helper_init_client_fd(helper_disconnect_cb);
     if (im_uim_fd >= 0) {
       GIOChannel *channel;
@@ -1417,6 +1513,8 @@ im_uim_focus_in(GtkIMContext *ic)
 #endif
 
   check_helper_connection();
+  /* send focus_in and the property updates in one write */
+  uim_helper_client_begin_batch();
   uim_helper_client_focus_in(uic->uc);
   uim_prop_list_update(uic->uc);
 
@@ -1429,6 +1527,7 @@ im_uim_focus_in(GtkIMContext *ic)
     gtk_widget_show(GTK_WIDGET(uic->cwin));
 
   uim_focus_in_context(uic->uc);
+  uim_helper_client_end_batch();
 }
 
 static void
@@ -1616,7 +1715,7 @@ im_uim_finalize(GObject *obj)
     uic->preedit_window = NULL;
   }
 
-  uim_release_context(uic->uc);
+  uim_recycle_context(uic->uc);
 
   g_signal_handlers_disconnect_by_func(uic->slave, (gpointer)(uintptr_t)commit_cb, uic);
   g_object_unref(uic->slave);
@@ -1672,10 +1771,10 @@ im_module_create(const gchar *context_id)
     return NULL;
 
   im_name = uim_get_default_im_name(setlocale(LC_CTYPE, NULL));
-  uic->uc = uim_create_context(uic, "UTF-8",
-			       NULL, im_name,
-			       uim_iconv,
-			       im_uim_commit_string);
+  uic->uc = uim_acquire_context(uic, "UTF-8",
+				NULL, im_name,
+				uim_iconv,
+				im_uim_commit_string);
   if (uic->uc == NULL) {
     parent_class->finalize(obj);
     return NULL;
@@ -1685,6 +1784,7 @@ im_module_create(const gchar *context_id)
 
   uim_set_preedit_cb(uic->uc, clear_cb, pushback_cb, update_cb);
   uim_set_prop_list_update_cb(uic->uc, update_prop_list_cb);
+  uim_set_prop_state_update_cb(uic->uc, update_prop_state_cb);
   uim_set_candidate_selector_cb(uic->uc, cand_activate_cb, cand_select_cb,
 				cand_shift_page_cb, cand_deactivate_cb);
   uim_set_configuration_changed_cb(uic->uc, configuration_changed_cb);
@@ -1694,9 +1794,10 @@ im_module_create(const gchar *context_id)
   uim_set_text_acquisition_cb(uic->uc, acquire_text_cb, delete_text_cb);
 #if IM_UIM_USE_DELAY
   uim_set_delay_candidate_selector_cb(uic->uc, cand_activate_with_delay_cb);
+  uim_set_delay_candidate_selector_fd_cb(uic->uc, cand_activate_on_fd_cb);
 #endif
 
-  uim_prop_list_update(uic->uc);
+  /* the property list is sent to the helper on the first focus-in */
 
 #ifdef GDK_WINDOWING_X11
   uic->compose = im_uim_compose_new();
@@ -1797,6 +1898,7 @@ im_module_init(GTypeModule *type_module)
   type_im_uim = g_type_module_register_type(type_module, GTK_TYPE_IM_CONTEXT,
 					    "GtkIMContextUIM", &class_info, 0);
   uim_cand_win_gtk_register_type(type_module);
+  uim_set_server_watch_cb(server_watch_cb);
 
 #if IM_UIM_USE_SNOOPER
   /* Using snooper is not recommended! */
@@ -1815,6 +1917,8 @@ im_module_exit(void)
 {
   if (im_uim_fd != -1)
     uim_helper_close_client_fd(im_uim_fd);
+  uim_set_server_watch_cb(NULL);
+  server_watch_cb(-1);
 
 #if IM_UIM_USE_SNOOPER
   gtk_key_snooper_remove(snooper_id);
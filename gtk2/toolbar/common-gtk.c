@@ -767,6 +767,30 @@ convert_charset(const gchar *charset, const gchar *str)
 		   NULL); /* GError **error */
 }
 
+static void
+set_toplevel_visibility(GtkWidget *widget, gboolean is_hidden)
+{
+  GtkWidget *toplevel;
+
+  toplevel = gtk_widget_get_toplevel(widget);
+#if GTK_CHECK_VERSION(2, 18, 0)
+  if (gtk_widget_get_visible(toplevel) == is_hidden) {
+#else
+  if (GTK_WIDGET_VISIBLE(toplevel) == is_hidden) {
+#endif
+    if (is_hidden) {
+      gtk_widget_hide(toplevel);
+    } else {
+      gint x = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(toplevel),
+                                                 "position_x"));
+      gint y = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(toplevel),
+                                                 "position_y"));
+      gtk_window_move(GTK_WINDOW(toplevel), x, y);
+      gtk_widget_show(toplevel);
+    }
+  }
+}
+
 static void
 helper_toolbar_prop_list_update(GtkWidget *widget, gchar **lines)
 {
@@ -780,7 +804,6 @@ helper_toolbar_prop_list_update(GtkWidget *widget, gchar **lines)
   GtkSizeGroup *sg;
   char *display_time;
   gboolean is_hidden;
-  GtkWidget *toplevel;
 
   if (prop_menu_showing)
     return;
@@ -843,24 +866,8 @@ helper_toolbar_prop_list_update(GtkWidget *widget, gchar **lines)
       g_strfreev(cols);
     }
   }
-  toplevel = gtk_widget_get_toplevel(widget);
   is_hidden = (is_hidden && strcmp(display_time, "always"));
-#if GTK_CHECK_VERSION(2, 18, 0)
-  if (gtk_widget_get_visible(toplevel) == is_hidden) {
-#else
-  if (GTK_WIDGET_VISIBLE(toplevel) == is_hidden) {
-#endif
-    if (is_hidden) {
-      gtk_widget_hide(toplevel);
-    } else {
-      gint x = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(toplevel),
-                                                 "position_x"));
-      gint y = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(toplevel),
-                                                 "position_y"));
-      gtk_window_move(GTK_WINDOW(toplevel), x, y);
-      gtk_widget_show(toplevel);
-    }
-  }
+  set_toplevel_visibility(widget, is_hidden);
 
   /* create tool buttons */
   /* FIXME! command menu and buttons should be customizable. */
@@ -907,6 +914,115 @@ helper_toolbar_prop_list_update(GtkWidget *widget, gchar **lines)
   g_free(charset);
 }
 
+static void
+prop_button_set_indication(GtkWidget *button, const gchar *icon_name,
+			   const gchar *label, const gchar *tip_text)
+{
+  GtkWidget *child;
+
+  child = gtk_bin_get_child(GTK_BIN(button));
+  if (child)
+    gtk_container_remove(GTK_CONTAINER(button), child);
+
+  if (register_icon(icon_name))
+    child = gtk_image_new_from_stock(icon_name, GTK_ICON_SIZE_MENU);
+  else
+    child = gtk_label_new(label);
+  gtk_container_add(GTK_CONTAINER(button), child);
+  gtk_widget_show(child);
+
+  gtk_widget_set_tooltip_text(button, tip_text);
+}
+
+/* returns FALSE if action_id is not in the menu of the button */
+static gboolean
+prop_button_set_active(GtkWidget *button, const gchar *action_id)
+{
+  GList *action_list, *state_list;
+  gboolean found = FALSE;
+
+  action_list = g_object_get_data(G_OBJECT(button), "prop_action");
+  state_list = g_object_get_data(G_OBJECT(button), "prop_state");
+
+  for (; action_list && state_list;
+       action_list = action_list->next, state_list = state_list->next) {
+    gboolean active = !strcmp(action_id, action_list->data);
+
+    g_free(state_list->data);
+    state_list->data = g_strdup(active ? "*" : "");
+    found = found || active;
+  }
+
+  return found || !strcmp(action_id, "");
+}
+
+/*
+ * prop_state_update only carries the current indication and the
+ * active action of each widget. The buttons are updated in place and
+ * the whole prop_list is requested if it does not match the buttons
+ * built by the last prop_list_update.
+ */
+static void
+helper_toolbar_prop_state_update(GtkWidget *widget, gchar **lines)
+{
+  GList *prop_buttons;
+  GtkWidget *button = NULL;
+  guint i;
+  gchar **cols;
+  gchar *charset, *display_time;
+  gboolean is_hidden, is_consistent = TRUE;
+
+  if (prop_menu_showing)
+    return;
+
+  charset = get_charset(lines[1]);
+  prop_buttons = g_object_get_data(G_OBJECT(widget), OBJECT_DATA_PROP_BUTTONS);
+
+  display_time
+        = uim_scm_c_symbol( uim_scm_symbol_value( "toolbar-display-time" ) );
+  is_hidden = strcmp(display_time, "mode");
+  for (i = 0; is_consistent && lines[i] && strcmp("", lines[i]); i++) {
+    gchar *utf8_str = convert_charset(charset, lines[i]);
+
+    if (utf8_str != NULL) {
+      cols = g_strsplit(utf8_str, "\t", 0);
+      g_free(utf8_str);
+    } else {
+      cols = g_strsplit(lines[i], "\t", 0);
+    }
+
+    if (cols && cols[0]) {
+      if (!strcmp("branch", cols[0]) && has_n_strs(cols, 4)) {
+	if (prop_buttons) {
+	  button = prop_buttons->data;
+	  prop_buttons = prop_buttons->next;
+	  prop_button_set_indication(button, cols[1],
+				     safe_gettext(cols[2]),
+				     safe_gettext(cols[3]));
+	  if (!is_hidden && (!strcmp(cols[1], "direct")
+	      || g_str_has_suffix(cols[1], "_direct")))
+	    is_hidden = TRUE;
+	} else {
+	  is_consistent = FALSE;
+	}
+      } else if (!strcmp("active", cols[0]) && has_n_strs(cols, 2)) {
+	is_consistent = (button && prop_button_set_active(button, cols[1]));
+      }
+    }
+    g_strfreev(cols);
+  }
+
+  if (is_consistent && !prop_buttons) {
+    is_hidden = (is_hidden && strcmp(display_time, "always"));
+    set_toplevel_visibility(widget, is_hidden);
+  } else {
+    uim_helper_client_get_prop_list();
+  }
+
+  free(display_time);
+  g_free(charset);
+}
+
 static void
 helper_toolbar_check_custom()
 {
@@ -929,6 +1045,8 @@ helper_toolbar_parse_helper_str(GtkWidget *widget, gchar *str)
   if (lines && lines[0]) {
     if (!strcmp("prop_list_update", lines[0]))
       helper_toolbar_prop_list_update(widget, lines);
+    else if (!strcmp("prop_state_update", lines[0]))
+      helper_toolbar_prop_state_update(widget, lines);
     else if (!strcmp("custom_reload_notify", lines[0])) {
       uim_prop_reload_configs();
       helper_toolbar_check_custom();
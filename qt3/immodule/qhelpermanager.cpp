@@ -49,6 +49,12 @@ SUCH DAMAGE.
 
 static int im_uim_fd = 0;
 static QSocketNotifier *notifier = NULL;
+// the helper messages handled in parseHelperStr()
+static const char *const helper_subscription[] = {
+    "im_change", "prop_update_custom", "custom_reload_notify",
+    "prop_list_get", "prop_label_get", "prop_activate", "im_list_get",
+    "commit_string", "focus_in", 0
+};
 
 extern QUimInputContext *focusedInputContext;
 extern bool disableFocusedContext;
@@ -72,6 +78,7 @@ void QUimHelperManager::checkHelperConnection()
 {
     if ( im_uim_fd < 0 )
     {
+        uim_helper_client_subscribe( helper_subscription );
         im_uim_fd = uim_helper_init_client_fd( QUimHelperManager::helper_disconnect_cb );
 
         if ( im_uim_fd >= 0 )
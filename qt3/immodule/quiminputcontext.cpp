@@ -351,10 +351,12 @@ void QUimInputContext::setFocus()
 
     m_HelperManager->checkHelperConnection();
 
+    uim_helper_client_begin_batch();
     uim_helper_client_focus_in( m_uc );
     uim_prop_list_update( m_uc );
 
     uim_focus_in_context( m_uc );
+    uim_helper_client_end_batch();
 }
 
 void QUimInputContext::unsetFocus()
@@ -115,6 +115,8 @@ void UimStateIndicator::parseHelperStr( const QString& str )
     {
         if ( lines[ 0 ] == "prop_list_update" )
             propListUpdate( lines );
+        else if ( lines[ 0 ] == "prop_state_update" )
+            propStateUpdate( lines );
         else if ( lines[ 0 ] == "custom_reload_notify" )
             uim_prop_reload_configs();
     }
@@ -159,24 +161,7 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
                     buttons.append( button );
                     size_changed = true;
                 }
-                uim_bool isDarkBg = uim_scm_symbol_value_bool("toolbar-icon-for-dark-background?");
-                const QString append = isDarkBg ? "_dark_background" : "";
-                QString fileName = ICONDIR + "/" + fields[1] + append + ".png";
-                struct stat st;
-                if ( isDarkBg && stat( fileName.utf8(), &st ) == -1 )
-		{
-                    fileName = ICONDIR + "/" + fields[1] + ".png";
-                }
-                QPixmap icon = QPixmap( fileName );
-                if (!icon.isNull()) {
-                    QImage image = icon.convertToImage();
-                    QPixmap scaledIcon = image.smoothScale( ICON_SIZE,
-                                                            ICON_SIZE );
-                    button->setPixmap( scaledIcon );
-                } else {
-                    button->setText( fields[ 2 ] );
-                }
-                QToolTip::add( button, fields[ 3 ] );
+                button->setIndication( fields );
 
                 // create popup
                 popupMenu = new QHelperPopupMenu( button );
@@ -224,6 +209,52 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
     this->parentWidget()->show();
 }
 
+// prop_state_update only carries the branch line and the active
+// action of each widget. Update the buttons and check the items in
+// place, or request the whole prop_list if they don't match.
+void UimStateIndicator::propStateUpdate( const QStringList& lines )
+{
+    QValueList<QStringList> branches;
+    QStringList activeIds;
+    QStringList::ConstIterator it = lines.begin();
+    const QStringList::ConstIterator end = lines.end();
+    for ( ; it != end; ++it )
+    {
+        if ( ( *it ).startsWith( "branch\t" ) )
+            branches.append( QStringList::split( "\t", ( *it ) ) );
+        else if ( ( *it ).startsWith( "active\t" ) )
+            activeIds.append( ( *it ).section( '\t', 1 ) );
+    }
+
+    bool isConsistent = ( !buttons.isEmpty()
+        && branches.count() == buttons.count()
+        && activeIds.count() == buttons.count() );
+    QHelperToolbarButton *button;
+    int i = 0;
+    for ( button = buttons.first(); isConsistent && button;
+          button = buttons.next(), i++ )
+    {
+        QHelperPopupMenu *popupMenu
+            = static_cast<QHelperPopupMenu *>( button->popup() );
+        isConsistent = ( branches[ i ].count() > 3 && popupMenu
+            && ( activeIds[ i ].isEmpty()
+                || popupMenu->hasHelperItem( activeIds[ i ] ) ) );
+    }
+    if ( !isConsistent )
+    {
+        uim_helper_client_get_prop_list();
+        return;
+    }
+
+    i = 0;
+    for ( button = buttons.first(); button; button = buttons.next(), i++ )
+    {
+        button->setIndication( branches[ i ] );
+        static_cast<QHelperPopupMenu *>( button->popup() )
+            ->checkHelperItem( activeIds[ i ] );
+    }
+}
+
 void UimStateIndicator::helper_disconnect_cb()
 {
     uim_fd = -1;
@@ -271,6 +302,31 @@ void UimStateIndicator::slotPopupMenuAboutToHide()
 
 /**/
 
+// fields of a branch line: indication_id, iconic_label and label
+void QHelperToolbarButton::setIndication( const QStringList &fields )
+{
+    uim_bool isDarkBg = uim_scm_symbol_value_bool("toolbar-icon-for-dark-background?");
+    const QString append = isDarkBg ? "_dark_background" : "";
+    QString fileName = ICONDIR + "/" + fields[1] + append + ".png";
+    struct stat st;
+    if ( isDarkBg && stat( fileName.utf8(), &st ) == -1 )
+    {
+        fileName = ICONDIR + "/" + fields[1] + ".png";
+    }
+    QPixmap icon = QPixmap( fileName );
+    if (!icon.isNull()) {
+        QImage image = icon.convertToImage();
+        QPixmap scaledIcon = image.smoothScale( ICON_SIZE, ICON_SIZE );
+        setPixmap( scaledIcon );
+    } else {
+        setText( fields[ 2 ] );
+    }
+    QToolTip::remove( this );
+    QToolTip::add( this, fields[ 3 ] );
+}
+
+/**/
+
 QHelperPopupMenu::QHelperPopupMenu( QWidget *parent, const char *name )
     : QPopupMenu( parent, name )
 {
@@ -315,6 +371,25 @@ int QHelperPopupMenu::insertHelperItem( const QString &indicationIdStr,
     return id;
 }
 
+bool QHelperPopupMenu::hasHelperItem( const QString &menucommandStr ) const
+{
+    QIntDictIterator<QString> it( msgDict );
+    for ( ; it.current(); ++it )
+    {
+        if ( *it.current() == menucommandStr )
+            return true;
+    }
+    return false;
+}
+
+// checks the item of the command, and unchecks the others
+void QHelperPopupMenu::checkHelperItem( const QString &menucommandStr )
+{
+    QIntDictIterator<QString> it( msgDict );
+    for ( ; it.current(); ++it )
+        setItemChecked( it.currentKey(), *it.current() == menucommandStr );
+}
+
 void QHelperPopupMenu::slotMenuActivated( int id )
 {
     QString msg = *msgDict.find( id );
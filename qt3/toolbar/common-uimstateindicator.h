@@ -62,6 +62,7 @@ protected:
 
     void parseHelperStr( const QString& str );
     void propListUpdate( const QStringList& lines );
+    void propStateUpdate( const QStringList& lines );
 
     static void helper_disconnect_cb();
 
@@ -90,6 +91,8 @@ public:
     {
         return QSize( BUTTON_SIZE, BUTTON_SIZE );
     }
+
+    void setIndication( const QStringList &fields );
 };
 
 class QHelperPopupMenu : public QPopupMenu
@@ -104,6 +107,8 @@ public:
                           const QString &menulabelStr,
                           const QString &menutooltipStr,
                           const QString &menucommandStr );
+    bool hasHelperItem( const QString &menucommandStr ) const;
+    void checkHelperItem( const QString &menucommandStr );
 
 public slots:
     void slotMenuActivated( int id );
@@ -36,6 +36,7 @@
 
 #include <QtCore/QPoint>
 #include <QtCore/QProcess>
+#include <QtCore/QSocketNotifier>
 #include <QtCore/QTimer>
 #include <QtGui/QMoveEvent>
 #if QT_VERSION < 0x050000
@@ -67,6 +68,7 @@ CandidateWindowProxy::CandidateWindowProxy()
     m_delayTimer = new QTimer(this);
     m_delayTimer->setSingleShot(true);
     connect(m_delayTimer, SIGNAL(timeout()), this, SLOT(timerDone()));
+    m_delayNotifier = 0;
 #endif /* !UIM_QT_USE_DELAY */
 
     process = new QProcess;
@@ -89,7 +91,7 @@ CandidateWindowProxy::~CandidateWindowProxy()
 void CandidateWindowProxy::deactivateCandwin()
 {
 #ifdef UIM_QT_USE_DELAY
-    m_delayTimer->stop();
+    stopDelay();
 #endif /* !UIM_QT_USE_DELAY */
 
     execute("hide");
@@ -140,7 +142,7 @@ void CandidateWindowProxy::layoutWindow(int x, int y, int height)
 void CandidateWindowProxy::candidateActivate(int nr, int displayLimit)
 {
 #ifdef UIM_QT_USE_DELAY
-    m_delayTimer->stop();
+    stopDelay();
 #endif /* !UIM_QT_USE_DELAY */
 
    QList<uim_candidate> list;
@@ -175,9 +177,30 @@ void CandidateWindowProxy::candidateActivate(int nr, int displayLimit)
 #ifdef UIM_QT_USE_DELAY
 void CandidateWindowProxy::candidateActivateWithDelay(int delay)
 {
-    m_delayTimer->stop();
+    stopDelay();
     (delay > 0) ?  m_delayTimer->start(delay * 1000) : timerDone();
 }
+
+void CandidateWindowProxy::candidateActivateOnFd(int fd)
+{
+    stopDelay();
+    if (fd >= 0) {
+        m_delayNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(m_delayNotifier, SIGNAL(activated(int)),
+            this, SLOT(fdReady()));
+    }
+}
+
+void CandidateWindowProxy::stopDelay()
+{
+    m_delayTimer->stop();
+    if (m_delayNotifier) {
+        // may be called from its own signal
+        m_delayNotifier->setEnabled(false);
+        m_delayNotifier->deleteLater();
+        m_delayNotifier = 0;
+    }
+}
 #endif /* !UIM_QT_USE_DELAY */
 
 void CandidateWindowProxy::candidateSelect(int index)
@@ -290,6 +313,12 @@ void CandidateWindowProxy::timerDone()
         candidateSelect(selected_index);
     }
 }
+
+void CandidateWindowProxy::fdReady()
+{
+    stopDelay();
+    timerDone();
+}
 #endif /* !UIM_QT_USE_DELAY */
 
 void CandidateWindowProxy::initializeProcess()
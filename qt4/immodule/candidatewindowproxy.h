@@ -42,6 +42,7 @@
 class QPoint;
 class QProcess;
 class QRect;
+class QSocketNotifier;
 class QTimer;
 
 #if QT_VERSION < 0x050000
@@ -82,6 +83,7 @@ class CandidateWindowProxy : public QObject
         void candidateActivate(int nr, int displayLimit);
 #ifdef UIM_QT_USE_DELAY
         void candidateActivateWithDelay(int delay);
+        void candidateActivateOnFd(int fd);
 #endif /* !UIM_QT_USE_DELAY */
         void candidateSelect(int index);
         void candidateShiftPage(bool forward);
@@ -92,10 +94,14 @@ class CandidateWindowProxy : public QObject
         void slotReadyStandardOutput();
 #ifdef UIM_QT_USE_DELAY
         void timerDone();
+        void fdReady();
 #endif /* !UIM_QT_USE_DELAY */
 
     private:
         void initializeProcess();
+#ifdef UIM_QT_USE_DELAY
+        void stopDelay();
+#endif /* !UIM_QT_USE_DELAY */
         void execute(const QString &command);
 
         void activateCandwin(int dLimit);
@@ -151,8 +157,9 @@ class CandidateWindowProxy : public QObject
 #endif
 
 #ifdef UIM_QT_USE_DELAY
-        // timer for delay API
+        // timer and fd watch for delay API
         QTimer *m_delayTimer;
+        QSocketNotifier *m_delayNotifier;
 #endif /* !UIM_QT_USE_DELAY */
 };
 
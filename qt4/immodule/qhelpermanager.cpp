@@ -51,6 +51,14 @@ SUCH DAMAGE.
 
 static int im_uim_fd = 0;
 static QSocketNotifier *notifier = 0;
+static QUimHelperManager *serverManager = 0;
+static QSocketNotifier *serverNotifier = 0;
+// the helper messages handled in parseHelperStr()
+static const char *const helper_subscription[] = {
+    "im_change", "prop_update_custom", "custom_reload_notify",
+    "prop_list_get", "prop_label_get", "prop_activate", "im_list_get",
+    "commit_string", "focus_in", 0
+};
 
 #if QT_VERSION < 0x050000
 extern QUimInputContext *focusedInputContext;
@@ -70,18 +78,46 @@ QUimHelperManager::QUimHelperManager( QObject *parent )
 {
     notifier = 0;
     im_uim_fd = -1;
+
+    serverManager = this;
+    uim_set_server_watch_cb( QUimHelperManager::server_watch_cb );
 }
 
 QUimHelperManager::~QUimHelperManager()
 {
     if ( im_uim_fd != -1 )
         uim_helper_close_client_fd( im_uim_fd );
+
+    uim_set_server_watch_cb( 0 );
+    server_watch_cb( -1 );
+    serverManager = 0;
+}
+
+void QUimHelperManager::server_watch_cb( int fd )
+{
+    if ( serverNotifier ) {
+        serverNotifier->setEnabled( false );
+        serverNotifier->deleteLater();
+        serverNotifier = 0;
+    }
+    if ( fd < 0 || !serverManager )
+        return;
+
+    serverNotifier = new QSocketNotifier( fd, QSocketNotifier::Read );
+    connect( serverNotifier, SIGNAL( activated( int ) ),
+             serverManager, SLOT( slotServerActivated() ) );
+}
+
+void QUimHelperManager::slotServerActivated()
+{
+    uim_server_read_proc();
 }
 
 void QUimHelperManager::checkHelperConnection()
 {
     if ( im_uim_fd < 0 )
     {
+        uim_helper_client_subscribe( helper_subscription );
         im_uim_fd = uim_helper_init_client_fd( QUimHelperManager::helper_disconnect_cb );
 
         if ( im_uim_fd >= 0 )
@@ -330,6 +366,26 @@ void QUimHelperManager::update_prop_list_cb( void *ptr, const char *str )
     ic->updateIndicator( msg );
 }
 
+void QUimHelperManager::update_prop_state_cb( void *ptr, const char *str )
+{
+#if QT_VERSION < 0x050000
+    QUimInputContext *ic = static_cast<QUimInputContext*>( ptr );
+#else
+    QUimPlatformInputContext *ic = static_cast<QUimPlatformInputContext*>( ptr );
+#endif
+
+    if ( ic != focusedInputContext || disableFocusedContext )
+        return;
+
+    QString msg = "prop_state_update\ncharset=UTF-8\n";
+    msg += QString::fromUtf8( str );
+
+    uim_helper_send_message( im_uim_fd, msg.toUtf8().data() );
+
+    // branch lines are shared with prop_list_update
+    ic->updateIndicator( msg );
+}
+
 void QUimHelperManager::update_prop_label_cb( void *ptr, const char *str )
 {
 #if QT_VERSION < 0x050000
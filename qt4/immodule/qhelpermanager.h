@@ -52,12 +52,15 @@ public:
     void sendImList();
 
     static void helper_disconnect_cb();
+    static void server_watch_cb( int fd );
     static void update_prop_list_cb( void *ptr, const char *str );
+    static void update_prop_state_cb( void *ptr, const char *str );
     static void update_prop_label_cb( void *ptr, const char *str );
     static void send_im_change_whole_desktop( const char *str );
 
 public slots:
     void slotStdinActivated();
+    void slotServerActivated();
 };
 
 #endif /* Not def: UIM_QT4_IMMODULE_QHELPERMANAGER_H */
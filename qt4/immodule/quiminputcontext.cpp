@@ -165,6 +165,7 @@ uim_context QUimInputContext::createUimContext( const char *imname )
 
 
     uim_set_prop_list_update_cb( uc, QUimHelperManager::update_prop_list_cb );
+    uim_set_prop_state_update_cb( uc, QUimHelperManager::update_prop_state_cb );
     uim_set_prop_label_update_cb( uc, QUimHelperManager::update_prop_label_cb );
 
     uim_set_im_switch_request_cb( uc,
@@ -178,6 +179,8 @@ uim_context QUimInputContext::createUimContext( const char *imname )
 #if UIM_QT_USE_DELAY
     uim_set_delay_candidate_selector_cb( uc,
         QUimInputContext::cand_activate_with_delay_cb );
+    uim_set_delay_candidate_selector_fd_cb( uc,
+        QUimInputContext::cand_activate_on_fd_cb );
 #endif /* !UIM_QT_USE_DELAY */
 
     uim_prop_list_update( uc );
@@ -402,10 +405,12 @@ void QUimInputContext::setFocus()
 
     m_HelperManager->checkHelperConnection();
 
+    uim_helper_client_begin_batch();
     uim_helper_client_focus_in( m_uc );
     uim_prop_list_update( m_uc );
 
     uim_focus_in_context( m_uc );
+    uim_helper_client_end_batch();
 }
 
 // Qt4 does not have QInputContext::unsetFocus()
@@ -619,6 +624,12 @@ void QUimInputContext::cand_activate_with_delay_cb( void *ptr, int delay )
     QUimInputContext *ic = static_cast<QUimInputContext*>( ptr );
     ic->proxy->candidateActivateWithDelay( delay );
 }
+
+void QUimInputContext::cand_activate_on_fd_cb( void *ptr, int fd )
+{
+    QUimInputContext *ic = static_cast<QUimInputContext*>( ptr );
+    ic->proxy->candidateActivateOnFd( fd );
+}
 #endif /* !UIM_QT_USE_DELAY */
 
 void QUimInputContext::commitString( const QString& str )
@@ -137,6 +137,8 @@ void UimStateIndicator::parseHelperStr( const QString& str )
     {
         if ( lines[ 0 ] == "prop_list_update" )
             propListUpdate( lines );
+        else if ( lines[ 0 ] == "prop_state_update" )
+            propStateUpdate( lines );
         else if (lines[0] == "custom_reload_notify" )
             uim_prop_reload_configs();
     }
@@ -162,13 +164,7 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
         }
     }
 
-#ifdef PLASMA_APPLET_UIM
-    bool isHidden = true;
-#else
-    char *display_time
-        = uim_scm_c_symbol( uim_scm_symbol_value( "toolbar-display-time" ) );
-    bool isHidden = strcmp( display_time, "mode" );
-#endif
+    QStringList indicationIds;
     foreach ( const QString &line, lines )
     {
         const QStringList fields = line.split( '\t', QString::SkipEmptyParts );
@@ -187,28 +183,8 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
                 QHelperToolbarButton *button = new QHelperToolbarButton;
                 m_layout->addWidget( button );
                 buttons.append( button );
-
-                uim_bool isDarkBg =
-                    uim_scm_symbol_value_bool("toolbar-icon-for-dark-background?");
-                const QString append = isDarkBg ? "_dark_background" : "";
-                QString fileName = ICONDIR + '/' + fields[1] + append + ".png";
-                if ( isDarkBg && !QFile::exists( fileName ) ) {
-                  fileName = ICONDIR + '/' + fields[1] + ".png";
-                }
-                if ( !isHidden && (fields[1] == "direct"
-                        || fields[1].endsWith( "_direct" ) ) ) {
-                    isHidden = true;
-                }
-                QPixmap icon = QPixmap( fileName );
-                if (!icon.isNull()) {
-                    QPixmap scaledIcon = icon.scaled( ICON_SIZE, ICON_SIZE,
-                            Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
-                    button->setIcon( QIcon( scaledIcon ) );
-                } else {
-                    button->setText( fields[ 2 ] );
-                }
-                if ( fields.size() > 3 )
-                    button->setToolTip( fields[ 3 ] );
+                button->setIndication( fields );
+                indicationIds.append( fields[ 1 ] );
 
                 // create popup
 #ifdef PLASMA_APPLET_UIM
@@ -245,7 +221,27 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
             }
         }
     }
+    updateVisibility( indicationIds );
+
+#ifdef PLASMA_APPLET_UIM
+    if ( m_layout->count() != prevCount )
+#endif
+        emit indicatorResized();
+}
+
+// toolbar-display-time 'mode shows the toolbar unless in a direct
+// mode
+void UimStateIndicator::updateVisibility( const QStringList& indicationIds )
+{
 #ifndef PLASMA_APPLET_UIM
+    char *display_time
+        = uim_scm_c_symbol( uim_scm_symbol_value( "toolbar-display-time" ) );
+    bool isHidden = strcmp( display_time, "mode" );
+    foreach ( const QString &id, indicationIds )
+    {
+        if ( !isHidden && ( id == "direct" || id.endsWith( "_direct" ) ) )
+            isHidden = true;
+    }
     foreach ( QWidget *widget, QApplication::topLevelWidgets() ) {
         if ( widget->isAncestorOf( this ) ) {
            isHidden = ( isHidden && strcmp( display_time, "always" ) );
@@ -254,12 +250,53 @@ void UimStateIndicator::propListUpdate( const QStringList& lines )
            break;
         }
     }
+    free( display_time );
+#else
+    Q_UNUSED( indicationIds );
 #endif
+}
 
-#ifdef PLASMA_APPLET_UIM
-    if ( m_layout->count() != prevCount )
-#endif
-        emit indicatorResized();
+// prop_state_update only carries the branch line and the active
+// action of each widget. Update the buttons and check the items in
+// place, or request the whole prop_list if they don't match.
+void UimStateIndicator::propStateUpdate( const QStringList& lines )
+{
+    QList<QStringList> branches;
+    QStringList activeIds;
+    foreach ( const QString &line, lines )
+    {
+        if ( line.startsWith( QLatin1String( "branch\t" ) ) )
+            branches.append( line.split( '\t', QString::SkipEmptyParts ) );
+        else if ( line.startsWith( QLatin1String( "active\t" ) ) )
+            activeIds.append( line.section( '\t', 1 ) );
+    }
+
+    bool isConsistent = ( !buttons.isEmpty()
+        && branches.count() == buttons.count()
+        && activeIds.count() == buttons.count() );
+    for ( int i = 0; isConsistent && i < buttons.count(); i++ )
+    {
+        QHelperPopupMenu *popupMenu
+            = qobject_cast<QHelperPopupMenu *>( buttons[ i ]->menu() );
+        isConsistent = ( branches[ i ].count() > 2 && popupMenu
+            && ( activeIds[ i ].isEmpty()
+                || popupMenu->hasHelperItem( activeIds[ i ] ) ) );
+    }
+    if ( !isConsistent )
+    {
+        uim_helper_client_get_prop_list();
+        return;
+    }
+
+    QStringList indicationIds;
+    for ( int i = 0; i < buttons.count(); i++ )
+    {
+        buttons[ i ]->setIndication( branches[ i ] );
+        indicationIds.append( branches[ i ][ 1 ] );
+        qobject_cast<QHelperPopupMenu *>( buttons[ i ]->menu() )
+            ->checkHelperItem( activeIds[ i ] );
+    }
+    updateVisibility( indicationIds );
 }
 
 void UimStateIndicator::helper_disconnect_cb()
@@ -332,6 +369,30 @@ QSize QHelperToolbarButton::sizeHint() const
     return QSize( BUTTON_SIZE, BUTTON_SIZE );
 }
 
+// fields of a branch line: indication_id, iconic_label and label
+void QHelperToolbarButton::setIndication( const QStringList &fields )
+{
+    uim_bool isDarkBg =
+        uim_scm_symbol_value_bool("toolbar-icon-for-dark-background?");
+    const QString append = isDarkBg ? "_dark_background" : "";
+    QString fileName = ICONDIR + '/' + fields[1] + append + ".png";
+    if ( isDarkBg && !QFile::exists( fileName ) ) {
+      fileName = ICONDIR + '/' + fields[1] + ".png";
+    }
+    QPixmap icon = QPixmap( fileName );
+    if (!icon.isNull()) {
+        QPixmap scaledIcon = icon.scaled( ICON_SIZE, ICON_SIZE,
+                Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+        setIcon( QIcon( scaledIcon ) );
+        setText( QString() );
+    } else {
+        setIcon( QIcon() );
+        setText( fields[ 2 ] );
+    }
+    if ( fields.size() > 3 )
+        setToolTip( fields[ 3 ] );
+}
+
 void QHelperToolbarButton::mousePressEvent( QMouseEvent *event )
 {
 #ifdef PLASMA_APPLET_UIM
@@ -390,6 +451,19 @@ QAction *QHelperPopupMenu::insertHelperItem( const QString &indicationIdStr,
     return action;
 }
 
+bool QHelperPopupMenu::hasHelperItem( const QString &menucommandStr ) const
+{
+    return !msgDict.keys( menucommandStr ).isEmpty();
+}
+
+// checks the item of the command, and unchecks the others
+void QHelperPopupMenu::checkHelperItem( const QString &menucommandStr )
+{
+    QMultiHash<QAction *, QString>::const_iterator it;
+    for ( it = msgDict.constBegin(); it != msgDict.constEnd(); ++it )
+        it.key()->setChecked( it.value() == menucommandStr );
+}
+
 void QHelperPopupMenu::slotMenuActivated( QAction *action )
 {
     QString msg = msgDict.find( action ).value();
@@ -71,6 +71,8 @@ protected:
 
     void parseHelperStr( const QString& str );
     void propListUpdate( const QStringList& lines );
+    void propStateUpdate( const QStringList& lines );
+    void updateVisibility( const QStringList& indicationIds );
 
     static void helper_disconnect_cb();
 
@@ -103,6 +105,7 @@ public:
     explicit QHelperToolbarButton( QWidget *parent = 0 );
 
     QSize sizeHint() const;
+    void setIndication( const QStringList &fields );
 
 signals:
     void menuRequested( QMenu *menu );
@@ -123,6 +126,8 @@ public:
                           const QString &menulabelStr,
                           const QString &menutooltipStr,
                           const QString &menucommandStr );
+    bool hasHelperItem( const QString &menucommandStr ) const;
+    void checkHelperItem( const QString &menucommandStr );
 
 public slots:
     void slotMenuActivated( QAction *action );
@@ -95,7 +95,7 @@ QUimPlatformInputContext::~QUimPlatformInputContext()
     contextList.removeAll(this);
 
     if (m_uc)
-        uim_release_context(m_uc);
+        uim_recycle_context(m_uc);
     delete proxy;
 
     if (focusedInputContext == this) {
@@ -114,7 +114,7 @@ void QUimPlatformInputContext::setFocusObject(QObject *object)
 
 uim_context QUimPlatformInputContext::createUimContext(const char *imname)
 {
-    uim_context uc = uim_create_context(this, "UTF-8", 0, imname, 0,
+    uim_context uc = uim_acquire_context(this, "UTF-8", 0, imname, 0,
             QUimPlatformInputContext::commit_cb);
 
     m_helperManager->checkHelperConnection();
@@ -132,6 +132,7 @@ uim_context QUimPlatformInputContext::createUimContext(const char *imname)
         QUimPlatformInputContext::cand_deactivate_cb);
 
     uim_set_prop_list_update_cb(uc, QUimHelperManager::update_prop_list_cb);
+    uim_set_prop_state_update_cb(uc, QUimHelperManager::update_prop_state_cb);
     uim_set_prop_label_update_cb(uc, QUimHelperManager::update_prop_label_cb);
 
     uim_set_im_switch_request_cb(uc,
@@ -144,9 +145,11 @@ uim_context QUimPlatformInputContext::createUimContext(const char *imname)
 #if UIM_QT_USE_DELAY
     uim_set_delay_candidate_selector_cb(uc,
         QUimPlatformInputContext::cand_activate_with_delay_cb);
+    uim_set_delay_candidate_selector_fd_cb(uc,
+        QUimPlatformInputContext::cand_activate_on_fd_cb);
 #endif /* !UIM_QT_USE_DELAY */
 
-    uim_prop_list_update(uc);
+    // the property list is sent to the helper on the first setFocus()
 
     return uc;
 }
@@ -173,10 +176,12 @@ void QUimPlatformInputContext::setFocus()
 
     m_helperManager->checkHelperConnection();
 
+    uim_helper_client_begin_batch();
     uim_helper_client_focus_in(m_uc);
     uim_prop_list_update(m_uc);
 
     uim_focus_in_context(m_uc);
+    uim_helper_client_end_batch();
 }
 
 void QUimPlatformInputContext::unsetFocus()
@@ -594,6 +599,12 @@ void QUimPlatformInputContext::cand_activate_with_delay_cb(void *ptr, int delay)
     QUimPlatformInputContext *ic = static_cast<QUimPlatformInputContext*>(ptr);
     ic->proxy->candidateActivateWithDelay(delay);
 }
+
+void QUimPlatformInputContext::cand_activate_on_fd_cb(void *ptr, int fd)
+{
+    QUimPlatformInputContext *ic = static_cast<QUimPlatformInputContext*>(ptr);
+    ic->proxy->candidateActivateOnFd(fd);
+}
 #endif /* !UIM_QT_USE_DELAY */
 
 void QUimPlatformInputContext::commitString(const QString& str)
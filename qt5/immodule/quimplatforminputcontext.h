@@ -123,6 +123,7 @@ private:
     static void switch_system_global_im_cb(void *ptr, const char *str);
     // delay
     static void cand_activate_with_delay_cb(void *ptr, int delay);
+    static void cand_activate_on_fd_cb(void *ptr, int fd);
     /// real functions for callbacks (correspond order)
     // preedit
     void clearPreedit();
@@ -296,6 +296,21 @@
 			(widget-actions widget))))
       (apply string-append (cons branch leaves)))))
 
+;; lightweight counterpart of widget-compose-live-branch for
+;; prop_state_update
+(define widget-compose-live-state
+  (lambda (widget)
+    (let* ((owner (widget-owner widget))
+	   (activity (widget-activity widget))
+	   (indicator (widget-indicator widget))
+	   (branch (indication-compose-branch (action-indicate indicator owner))))
+      (string-append branch
+		     "active\t"
+		     (if activity
+			 (symbol->string (action-id activity))
+			 "")
+		     "\n"))))
+
 ;; API for uim developers
 ;;
 ;; Developers must use this procedure to reconfigure order or
@@ -359,32 +374,42 @@
 
 (define bridge-show-input-state-mode-on? #f)
 
+(define context-update-bridge-show-state!
+  (lambda (context)
+    (if (eq? bridge-show-with?
+	     'mode)
+	(if (eq? (context-current-mode context) 0)
+	    (set! bridge-show-input-state-mode-on? #f)
+	    (set! bridge-show-input-state-mode-on? #t)))))
+
 (define context-propagate-prop-list-update
   (lambda (context)
     (let* ((widgets (context-widgets context))
 	   (branches (map widget-compose-live-branch
 			  widgets))
 	   (widget-config-tree (apply string-append branches)))
-      (if (eq? bridge-show-with?
-               'mode)
-          (if (eq? (context-current-mode context) 0)
-              (set! bridge-show-input-state-mode-on? #f)
-              (set! bridge-show-input-state-mode-on? #t)))
+      (context-update-bridge-show-state! context)
       (im-update-prop-list context widget-config-tree))))
 
+;; Only the states are composed if the bridge supports
+;; prop_state_update. libuim then composes the full prop_list by
+;; context-propagate-prop-list-update when it is asked for.
+(define context-propagate-prop-state-update
+  (lambda (context)
+    (let ((states (apply string-append
+			 (map widget-compose-live-state
+			      (context-widgets context)))))
+      (context-update-bridge-show-state! context)
+      (or (im-update-prop-state context states)
+	  (context-propagate-prop-list-update context)))))
+
 ;; API for uim developers
 (define context-propagate-widget-states
   (lambda (context)
     ;; Sending prop_list every time costs all uim participant
-    ;; processes slightly heavy resource consumptions. Although it is
-    ;; not a problem for the rich desktop environment today, we should
-    ;; also consider resource sensitive embedded environments if it is
-    ;; not hard.
-    ;;
-    ;; We should adopt another message to send lightweight status
-    ;; update, and revise prop_list as initial configuration message
-    ;; (i.e. remove the flag field) -- 2004-10-08 YamaKen
-    (context-propagate-prop-list-update context)
+    ;; processes slightly heavy resource consumptions, so only the
+    ;; states are sent as prop_state_update here.
+    (context-propagate-prop-state-update context)
     (context-update-mode context)))
 
 ;; API for uim developers
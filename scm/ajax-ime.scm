@@ -35,7 +35,7 @@
 (require "japanese.scm")
 (require "generic-predict.scm")
 (require "input-parse.scm")
-(require "http-client.scm")
+(require "http-async.scm")
 (require "util.scm")
 (require-custom "generic-key-custom.scm")
 (require-custom "ajax-ime-custom.scm")
@@ -93,7 +93,7 @@
            (list (append (list w1) w2))
            #f)))))
 
-(define (ajax-ime-conversion str opts)
+(define (ajax-ime-conversion str opts . args)
   (define (make-query)
     (let ((utf8-str (iconv-convert "UTF-8" "EUC-JP" str)))
       (if utf8-str
@@ -104,11 +104,14 @@
                   )
           str)))
   (define proxy (make-http-proxy-from-custom))
+  (define owner (and (pair? args)
+                     (car args)))
   (define (fetch url)
-    (and-let* ((utf8-str (http:get (car (assq-cdr ajax-ime-url ajax-ime-url-alist))
-                                   (make-query)
-                                   80
-                                   proxy))
+    (and-let* ((utf8-str (http:async-get owner
+                                         (car (assq-cdr ajax-ime-url ajax-ime-url-alist))
+                                         (make-query)
+                                         80
+                                         proxy))
                (euc-str (iconv-convert "EUC-JP" "UTF-8" utf8-str)))
               euc-str))
 
@@ -116,6 +119,9 @@
     (or
       (and ret
            (ajax-ime-parse ret))
+      (and owner
+           (http:async-requested? owner)
+           #f)
       (list (list str)))))
 
 (define (ajax-ime-lib-init)
@@ -144,8 +150,8 @@
 (define (ajax-ime-lib-resize-segment ac seg cnt)
   #t)
 (define (ajax-ime-lib-begin-conversion ac str)
-  (let* ((cand (ajax-ime-conversion str ""))
-         (ac-ctx (ajax-ime-internal-context-new-internal)))
+  (and-let* ((cand (ajax-ime-conversion str "" (http:async-owner ac)))
+             (ac-ctx (ajax-ime-internal-context-new-internal)))
     (ajax-ime-internal-context-set-str! ac-ctx str)
     (ajax-ime-internal-context-set-candidates! ac-ctx cand)
     (ajax-ime-internal-context-set-seg-cnts!
@@ -591,6 +597,7 @@
     (ajax-ime-make-raw-string (ajax-ime-get-raw-str-seq ac) wide? upper?)))
 
 (define (ajax-ime-init-handler id im arg)
+  (im-set-delay-activating-handler! im ajax-ime-delay-activating-handler)
   (if ajax-ime-warn-connection?
     (let ((diff (string->number
 		  (difftime (time) ajax-ime-prev-warn-connection-time))))
@@ -607,7 +614,9 @@
 
 (define (ajax-ime-release-handler ac)
   (if ac
-      (ajax-ime-lib-release-context ac)))
+      (begin
+        (http:async-cancel! ac)
+        (ajax-ime-lib-release-context ac))))
 
 (define (ajax-ime-flush ac)
   (rk-flush (ajax-ime-context-rkc ac))
@@ -696,7 +705,10 @@
 		(ajax-ime-context-set-state! ac #t)
 		;; Don't perform rk-flush here. The rkc must be restored when
 		;; ajax-ime-cancel-conv invoked -- YamaKen 2004-10-25
-		))))))
+		)
+	      ;; the result is picked up by ajax-ime-delay-activating-handler
+	      (if (http:async-requested? ac)
+		  (http:async-watch ac)))))))
 
 (define ajax-ime-cancel-conv
   (lambda (ac)
@@ -1796,6 +1808,8 @@
       (ajax-ime-proc-input-state ac key key-state)))))
 
 (define (ajax-ime-press-key-handler ac key key-state)
+  ;; new input supersedes the conversion in flight
+  (http:async-cancel! ac)
   (if (ichar-control? key)
       (im-commit-raw ac)
       (if (ajax-ime-context-on ac)
@@ -1816,6 +1830,7 @@
       (ajax-ime-commit-raw ac)))
 ;;;
 (define (ajax-ime-reset-handler ac)
+  (http:async-cancel! ac)
   (if (ajax-ime-context-on ac)
       (begin
 	(if (ajax-ime-context-state ac)
@@ -1843,6 +1858,18 @@
   (if (not (ajax-ime-begin-input ac key key-state))
       (im-commit-raw ac)))
 
+;; Called by the bridge when the response watched in
+;; ajax-ime-begin-conv arrives.
+(define (ajax-ime-delay-activating-handler ac)
+  (http:async-poll ac)
+  (if (and (ajax-ime-context-on ac)
+           (not (ajax-ime-context-state ac))
+           (http:async-requested? ac))
+      (begin
+        (ajax-ime-begin-conv ac)
+        (ajax-ime-update-preedit ac)))
+  '(0 0 -1))
+
 (ajax-ime-configure-widgets)
 (register-im
  'ajax-ime
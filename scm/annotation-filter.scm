@@ -69,9 +69,13 @@
                          (uim-notify-fatal (N_ "Custom filter connection is not defined"))
                          #f))))
          (if fds
-           (set! annotation-filter-socket-pair (cons
-                                                 (open-file-port (car fds))
-                                                 (open-file-port (cdr fds))))
+           ;; a socket is read and written through one port
+           (let ((iport (open-file-port (car fds))))
+             (set! annotation-filter-socket-pair
+                   (cons iport
+                         (if (= (car fds) (cdr fds))
+                             iport
+                             (open-file-port (cdr fds))))))
            (set! annotation-filter-socket-pair #f)))))
 
 (define (annotation-filter-read-message iport)
@@ -96,7 +100,8 @@
        (and-let* ((iport (car annotation-filter-socket-pair))
                   (oport (cdr annotation-filter-socket-pair)))
          (file-display "QUIT\n" oport)
-         (if (not (equal? iport oport))
+         (if (not (eq? iport oport))
              (close-file-port oport))
          (close-file-port iport)))
+  (set! annotation-filter-socket-pair #f)
   #t)
@@ -33,7 +33,7 @@
 
 (require "ustr.scm")
 (require "japanese.scm")
-(require "http-client.scm")
+(require "http-async.scm")
 (require "json.scm")
 (require "generic-predict.scm")
 (require-custom "generic-key-custom.scm")
@@ -60,7 +60,7 @@
 (define-record 'baidu-olime-jp-internal-context baidu-olime-jp-internal-context-rec-spec)
 (define baidu-olime-jp-internal-context-new-internal baidu-olime-jp-internal-context-new)
 
-(define (baidu-olime-jp-conversion str opts)
+(define (baidu-olime-jp-conversion str opts . args)
   (define (fromconv str)
     (iconv-convert "UTF-8" "EUC-JP" str))
   (define (toconv str)
@@ -76,10 +76,13 @@
                    (car (json-read port)))))
       (cons (map toconv cars)
             (map (lambda (x) (map toconv x)) cdrs))))
-  (let* ((proxy (make-http-proxy-from-custom))
-         (ssl (make-http-ssl (SSLv3-client-method) 443))
-         (ret (http:get baidu-olime-jp-server (make-query) 80 proxy ssl)))
-    (parse ret)))
+  (let-optionals* args ((owner #f))
+    (let* ((proxy (make-http-proxy-from-custom))
+           (ssl (make-http-ssl (SSLv3-client-method) 443))
+           (ret (http:async-get owner baidu-olime-jp-server (make-query)
+                                80 proxy ssl)))
+      (and ret
+           (parse ret)))))
 
 (define (baidu-olime-jp-predict bdc str)
   (predict-meta-search
@@ -173,10 +176,11 @@
           (baidu-olime-jp-internal-context-set-yomi-seg! bdx-ctx replace-yomi-seg)))
     #t))
 (define (baidu-olime-jp-lib-begin-conversion bdc str)
-  (let* ((yomi-seg-and-cand (baidu-olime-jp-conversion str ""))
-         (yomi-seg (car yomi-seg-and-cand))
-         (cand (cdr yomi-seg-and-cand))
-         (bdx-ctx (baidu-olime-jp-context-bdx-ctx bdc)))
+  (and-let* ((yomi-seg-and-cand (baidu-olime-jp-conversion
+                                 str "" (http:async-owner bdc)))
+             (yomi-seg (car yomi-seg-and-cand))
+             (cand (cdr yomi-seg-and-cand))
+             (bdx-ctx (baidu-olime-jp-context-bdx-ctx bdc)))
     (baidu-olime-jp-internal-context-set-yomi-seg! bdx-ctx yomi-seg)
     (baidu-olime-jp-internal-context-set-candidates! bdx-ctx cand)
     (length cand)))
@@ -616,6 +620,7 @@
     (baidu-olime-jp-make-raw-string (baidu-olime-jp-get-raw-str-seq bdc) wide? upper?)))
 
 (define (baidu-olime-jp-init-handler id im arg)
+  (im-set-delay-activating-handler! im baidu-olime-jp-delay-activating-handler)
   (if (not baidu-olime-jp-init-lib-ok?)
       (begin
 	(baidu-olime-jp-lib-init)
@@ -624,7 +629,9 @@
 
 (define (baidu-olime-jp-release-handler bdc)
   (if bdc
-      (baidu-olime-jp-lib-release-context bdc)))
+      (begin
+        (http:async-cancel! bdc)
+        (baidu-olime-jp-lib-release-context bdc))))
 
 (define (baidu-olime-jp-flush bdc)
   (rk-flush (baidu-olime-jp-context-rkc bdc))
@@ -714,7 +721,10 @@
 		(baidu-olime-jp-context-set-state! bdc #t)
 		;; Don't perform rk-flush here. The rkc must be restored when
 		;; baidu-olime-jp-cancel-conv invoked -- YamaKen 2004-10-25
-		))))))
+		)
+	      ;; the result is picked up by baidu-olime-jp-delay-activating-handler
+	      (if (http:async-requested? bdc)
+		  (http:async-watch bdc)))))))
 
 (define baidu-olime-jp-cancel-conv
   (lambda (bdc)
@@ -1811,6 +1821,8 @@
       (baidu-olime-jp-proc-input-state bdc key key-state)))))
 
 (define (baidu-olime-jp-press-key-handler bdc key key-state)
+  ;; new input supersedes the conversion in flight
+  (http:async-cancel! bdc)
   (if (ichar-control? key)
       (im-commit-raw bdc)
       (if (baidu-olime-jp-context-on bdc)
@@ -1831,6 +1843,7 @@
       (baidu-olime-jp-commit-raw bdc)))
 ;;;
 (define (baidu-olime-jp-reset-handler bdc)
+  (http:async-cancel! bdc)
   (if (baidu-olime-jp-context-on bdc)
       (begin
 	(if (baidu-olime-jp-context-state bdc)
@@ -1858,6 +1871,18 @@
   (if (not (baidu-olime-jp-begin-input bdc key key-state))
       (im-commit-raw bdc)))
 
+;; Called by the bridge when the response watched in
+;; baidu-olime-jp-begin-conv arrives.
+(define (baidu-olime-jp-delay-activating-handler bdc)
+  (http:async-poll bdc)
+  (if (and (baidu-olime-jp-context-on bdc)
+           (not (baidu-olime-jp-context-state bdc))
+           (http:async-requested? bdc))
+      (begin
+        (baidu-olime-jp-begin-conv bdc)
+        (baidu-olime-jp-update-preedit bdc)))
+  '(0 0 -1))
+
 (baidu-olime-jp-configure-widgets)
 (register-im
  'baidu-olime-jp
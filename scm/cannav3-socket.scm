@@ -31,190 +31,16 @@
 
 (use srfi-1)
 (require "socket.scm")
-(require "lolevel.scm")
 
-;; canna protocol operators
-(define canna-lib-initialize-op          #x1)
-(define canna-lib-finalize-op            #x2)
-(define canna-lib-create-context-op      #x3)
-(define canna-lib-close-context-op       #x5)
-(define canna-lib-get-dictionary-list-op #x6)
-(define canna-lib-mount-dictionary-op    #x8)
-(define canna-lib-unmount-dictionary-op  #x9)
-(define canna-lib-begin-convert-op       #xf)
-(define canna-lib-end-convert-op         #x10)
-(define canna-lib-get-candidacy-list-op  #x11)
-(define canna-lib-get-yomi-op            #x12)
-(define canna-lib-resize-pause-op        #x1a)
-
-(define (canna-var&user-fmt user)
-  (format "3.3:~a" user))
-
-(define (canna-lib-initialize socket user)
-  (let* ((canna-var&user (canna-var&user-fmt user))
-         (canna-var&user-len (+ 1 (string-length canna-var&user))))
-    (file-write socket
-                (u8list->string-buf
-                 (u8list-pack '(u32 u32 s8)
-                              canna-lib-initialize-op canna-var&user-len canna-var&user)))
-    (call-with-u8list-unpack
-     '(u16 u16) (string-buf->u8list (file-read socket 4))
-     (lambda (major minor)
-       (not (and (= major 65535) (= major 65535)))))))
-
-(define (canna-lib-finalize socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16)
-                            canna-lib-finalize-op 0 0)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
-        (lambda (dummy result)
-          (= result 0))))
-
-(define (canna-lib-create-context socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16)
-                            canna-lib-create-context-op 0 0)))
-  (call-with-u8list-unpack
-   '(u32 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy context-id)
-     (and (not (= context-id 65535))
-          context-id))))
-
-(define (canna-lib-close-context socket context-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16)
-                            canna-lib-close-context-op 0 2 context-id)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
-   (lambda (dummy result)
-     (not (= result 255)))))
-
-(define (canna-lib-get-dictionary-list socket context-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16)
-                            canna-lib-get-dictionary-list-op 0 4 context-id 1024)))
-  (call-with-u8list-unpack
-   '(u32 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy result)
-     (and (not (= result 65535))
-          (call-with-u8list-unpack
-           (make-list result 's8) (string-buf->u8list (file-read socket 1024))
-           (lambda dict-list
-             dict-list))))))
-
-(define (canna-lib-mount-dictionary socket context-id dict mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s8)
-                            canna-lib-mount-dictionary-op
-                            0
-                            (+ (string-length dict) 7)
-                            mode context-id dict)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
-   (lambda (dummy result)
-     (not (= result 255)))))
-
-(define (canna-lib-unmount-dictionary socket context-id dict mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s8)
-                            canna-lib-unmount-dictionary-op
-                            0
-                            (+ (string-length dict) 7)
-                            mode context-id dict)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
-   (lambda (dummy result)
-     (not (= result 255)))))
-
-(define (canna-lib-begin-convert socket context-id yomi mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s16)
-                            canna-lib-begin-convert-op
-                            0
-                            (+ (string-length yomi) 8)
-                            mode context-id yomi)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy len bunsetsu)
-     (and (not (= bunsetsu 65535))
-          (call-with-u8list-unpack
-           (make-list bunsetsu 's16) (string-buf->u8list (file-read socket len))
-           (lambda conv
-             conv))))))
-
-(define (canna-lib-end-convert socket context-id cands mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u32 u16list)
-                            canna-lib-end-convert-op
-                            0
-                            (+ (* 2 (length cands)) 8)
-                            context-id (length cands) mode
-                            cands)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
-   (lambda (dummy result)
-     (not (= result 255)))))
-
-(define (canna-lib-get-candidacy-list socket context-id bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-get-candidacy-list-op
-                            0
-                            6
-                            context-id bunsetsu-pos 1024)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy len cands)
-     (call-with-u8list-unpack
-      (make-list cands 's16) (string-buf->u8list (file-read socket len))
-      (lambda cand-list
-        cand-list)))))
-
-(define (canna-lib-get-yomi socket context-id bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-get-yomi-op
-                            0
-                            6
-                            context-id bunsetsu-pos 1024)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy len yomi-len)
-     (call-with-u8list-unpack
-      '(s16) (string-buf->u8list (file-read socket len))
-      (lambda (conv)
-        conv)))))
-
-(define (canna-lib-resize-pause socket context-id yomi-length bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-resize-pause-op
-                            0
-                            6
-                            context-id bunsetsu-pos yomi-length)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy len bunsetsu)
-     (and (not (= bunsetsu 65535))
-          (let loop ((s16list (string-buf->u8list (file-read socket len)))
-                     (rest '()))
-            (if (equal? s16list '(0 0))
-                (reverse rest)
-                (let ((s16 (u8list-unpack '(s16) s16list)))
-                  (loop (drop s16list (+ 2 (string-length (car s16))))
-                        (cons (car s16) rest)))))))))
+;; The canna protocol functions canna-lib-initialize,
+;; canna-lib-finalize, canna-lib-create-context,
+;; canna-lib-close-context, canna-lib-get-dictionary-list,
+;; canna-lib-mount-dictionary, canna-lib-mount-dictionaries,
+;; canna-lib-unmount-dictionary, canna-lib-begin-convert,
+;; canna-lib-end-convert, canna-lib-get-candidacy-list,
+;; canna-lib-get-yomi and canna-lib-resize-pause are provided by the
+;; cannav3 plugin.
+(require-dynlib "cannav3")
 
 ;;
 ;; RK compatible functions
@@ -266,9 +92,7 @@
                  (mode 19))  ;; XXX: (RK_XFER << RK_XFERBITS) | RK_KFER
         (canna-lib-context-set-id! cic id)
         (canna-lib-context-set-mode! cic mode)
-        (map (lambda (dict)
-               (canna-lib-mount-dictionary *canna-lib-socket* id dict 0))
-             dic-list)
+        (canna-lib-mount-dictionaries *canna-lib-socket* id dic-list 0)
         (set! *canna-lib-context-list*
               (cons cic *canna-lib-context-list*))
         cic)))
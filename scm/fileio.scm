@@ -67,36 +67,21 @@
 (define (file-write-string s str)
   (file-write s (string->file-buf str)))
 
+;; Both read the socket up to the terminator with no read-ahead, so
+;; that the following raw file-read on the socket isn't disturbed.
 (define (file-read-string-with-terminate-char socket term-char)
-  (let loop ((c (file-read socket 1))
-             (rest '()))
-    (cond ((eof-object? c)
-           (uim-notify-fatal (N_ "unexpected terminate string."))
-           "")
-          ((eq? (car c) term-char)
-           (file-buf->string (reverse rest)))
-          (else
-           (loop (file-read socket 1) (cons (car c) rest))))))
+  (let ((ret (file-read-until socket term-char)))
+    (if (string? ret)
+        ret
+        (begin
+          (uim-notify-fatal (N_ "unexpected terminate string."))
+          ""))))
 
 (define (file-read-string-with-terminate-chars socket term-chars)
-  (let ((buf (file-read socket (length term-chars))))
-    (cond ((eof-object? buf)
-           (raise (N_ "unexpected terminate string.")))
-          ((equal? term-chars buf)
-           "")
-          (else
-           (let loop ((c (file-read socket 1))
-                      (buf buf)
-                      (rest '()))
-             (cond ((eof-object? c)
-                    (raise (N_ "unexpected terminate string.")))
-                   ((equal? term-chars (append (cdr buf) c))
-                    (file-buf->string (append rest (list (car buf)))))
-                   (else
-                    ;; enqueue
-                    (loop (file-read socket 1)
-                          (append (cdr buf) c)
-                          (append rest (list (car buf)))))))))))
+  (let ((ret (file-read-until socket term-chars)))
+    (if (string? ret)
+        ret
+        (raise (N_ "unexpected terminate string.")))))
 
 (define (file-read-string-with-terminate socket term-char)
   (if (char? term-char)
@@ -112,11 +97,19 @@
   (read     read?     read!)
   (write    write?    write!))
 
+;; inbuf of a file port is a byte buffer. Ports must be closed by
+;; close-file-port (or released by file-port-release!) to free it.
 (define (open-file-port fd)
-  (make-file-port fd fd file-bufsiz '() file-read file-write))
+  (make-file-port fd fd file-bufsiz (make-byte-buffer) file-read file-write))
+
+(define (file-port-release! port)
+  (if (inbuf? port)
+      (begin
+        (byte-buffer-free! (inbuf? port))
+        (inbuf! port #f))))
 
 (define (close-file-port port)
-  (inbuf! port '())
+  (file-port-release! port)
   (file-close (context? port))
   (context! port #f)
   (fd! port #f))
@@ -124,33 +117,52 @@
 (define (call-with-open-file-port fd thunk)
   (and (not (null? fd))
        (< 0 fd)
-       (let ((ret (thunk (open-file-port fd))))
-         (file-close fd)
+       (let* ((port (open-file-port fd))
+              (ret (thunk port)))
+         (close-file-port port)
          ret)))
 
+;; Reads more bytes into the buffer. Plain ports are read directly into
+;; the buffer, and ports with another reader (e.g. SSL) are appended
+;; the list returned. Returns #t, or eof or #f as the reader does.
+(define (file-port-fill! port)
+  (let* ((buf (inbuf? port))
+         (ret (if (eq? (read? port) file-read)
+                  (byte-buffer-fill! buf (context? port) (inbufsiz? port))
+                  (let ((l ((read? port) (context? port) (inbufsiz? port))))
+                    (if (pair? l)
+                        (byte-buffer-append! buf l)
+                        (and (eof-object? l) l))))))
+    (if (or (eof-object? ret) (not ret))
+        ret
+        #t)))
+
+;; Ensures that the buffer has at least n bytes.
+(define (file-port-wait! port n)
+  (let loop ()
+    (if (<= n (byte-buffer-length (inbuf? port)))
+        #t
+        (begin
+          ;; XXX: block
+          (file-ready? (list (fd? port)) -1)
+          (let ((ret (file-port-fill! port)))
+            (if (eq? ret #t)
+                (loop)
+                ret))))))
+
 (define (file-read-char port)
-  (if (null? (inbuf? port))
-      (begin
-        ;; XXX: block
-        (file-ready? (list (fd? port)) -1)
-        (inbuf! port ((read? port) (context? port) (inbufsiz? port)))))
-  (let ((buf (inbuf? port)))
-    (if (or (eof-object? buf) ;; disconnect?
-            (not buf))
-        buf
-        (let ((c (car buf)))
-          (inbuf! port (cdr buf))
-          c))))
+  (let ((ret (file-port-wait! port 1)))
+    (if (eq? ret #t)
+        (let ((c (byte-buffer-ref (inbuf? port) 0)))
+          (byte-buffer-drop! (inbuf? port) 1)
+          (integer->char c))
+        ret)))
 
 (define (file-peek-char port)
-  (if (null? (inbuf? port))
-      (inbuf! port ((read? port) (context? port) (inbufsiz? port))))
-  (let ((buf (inbuf? port)))
-    (if (or (eof-object? buf) ;; disconnect?
-            (not buf))
-        buf
-        (let ((c (car buf)))
-          c))))
+  (let ((ret (file-port-wait! port 1)))
+    (if (eq? ret #t)
+        (integer->char (byte-buffer-ref (inbuf? port) 0))
+        ret)))
 
 (define (file-display str port)
   ((write? port) (context? port) (string->file-buf str)))
@@ -159,23 +171,34 @@
   ((write? port) (context? port) (string->file-buf (list->string '(#\newline)))))
 
 (define (file-read-line port)
-  (let loop ((c (file-read-char port))
-             (rest '()))
-    (cond ((eq? #\newline c)
-           (list->string (reverse rest)))
-          ((or (eof-object? c) ;; disconnect?
-               (not c))
-           (if (null? rest)
-             c
-             (list->string (reverse rest))))
-          (else
-           (loop (file-read-char port) (cons c rest))))))
+  (let ((buf (inbuf? port)))
+    (let loop ((start 0))
+      (let ((i (byte-buffer-index buf #\newline start)))
+        (if i
+            (let ((line (byte-buffer-take-string! buf i)))
+              (byte-buffer-drop! buf 1)
+              line)
+            (let* ((len (byte-buffer-length buf))
+                   (ret (file-port-wait! port (+ len 1))))
+              (cond ((eq? ret #t)
+                     (loop len))
+                    ((= len 0)
+                     ret)
+                    (else
+                     (byte-buffer-take-string! buf len)))))))))
 
+;; Returns fewer bytes at the end of the input, and eof or #f as
+;; file-port-wait! does once nothing is left.
 (define (file-read-buffer port len)
-  (list->string (map (lambda (i) (file-read-char port)) (iota len))))
+  (let ((ret (file-port-wait! port len))
+        (buf (inbuf? port)))
+    (if (or (eq? ret #t)
+            (< 0 (byte-buffer-length buf)))
+        (byte-buffer-take-string! buf len)
+        ret)))
 
 (define (file-get-buffer port)
-  (file-buf->string (inbuf? port)))
+  (byte-buffer->string (inbuf? port)))
 
 (define (file-write-sexp l port)
   ((write? port) (context? port) (string->file-buf (write-to-string l))))
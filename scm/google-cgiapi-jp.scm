@@ -33,7 +33,7 @@
 
 (require "ustr.scm")
 (require "japanese.scm")
-(require "http-client.scm")
+(require "http-async.scm")
 (require "json.scm")
 (require "generic-predict.scm")
 (require "util.scm")
@@ -61,7 +61,7 @@
 (define-record 'google-cgiapi-jp-internal-context google-cgiapi-jp-internal-context-rec-spec)
 (define google-cgiapi-jp-internal-context-new-internal google-cgiapi-jp-internal-context-new)
 
-(define (google-cgiapi-jp-conversion str opts)
+(define (google-cgiapi-jp-conversion str opts . args)
   (define (fromconv str)
     (iconv-convert "UTF-8" "EUC-JP" str))
   (define (toconv str)
@@ -77,11 +77,14 @@
                    (json-read port))))
       (cons (map toconv cars)
             (map (lambda (x) (map toconv x)) cdrs))))
-  (let* ((proxy (make-http-proxy-from-custom))
-         (ssl (and google-cgiapi-jp-use-ssl?
-                   (make-http-ssl (SSLv3-client-method) 443)))
-         (ret (http:get google-cgiapi-jp-server (make-query) 80 proxy ssl)))
-    (parse ret)))
+  (let-optionals* args ((owner #f))
+    (let* ((proxy (make-http-proxy-from-custom))
+           (ssl (and google-cgiapi-jp-use-ssl?
+                     (make-http-ssl (SSLv3-client-method) 443)))
+           (ret (http:async-get owner google-cgiapi-jp-server (make-query)
+                                80 proxy ssl)))
+      (and ret
+           (parse ret)))))
 
 (define (google-cgiapi-jp-predict ggc str)
   (predict-meta-search
@@ -175,10 +178,11 @@
           (google-cgiapi-jp-internal-context-set-yomi-seg! ggx-ctx replace-yomi-seg)))
     #t))
 (define (google-cgiapi-jp-lib-begin-conversion ggc str)
-  (let* ((yomi-seg-and-cand (google-cgiapi-jp-conversion str ""))
-         (yomi-seg (car yomi-seg-and-cand))
-         (cand (cdr yomi-seg-and-cand))
-         (ggx-ctx (google-cgiapi-jp-context-ggx-ctx ggc)))
+  (and-let* ((yomi-seg-and-cand (google-cgiapi-jp-conversion
+                                 str "" (http:async-owner ggc)))
+             (yomi-seg (car yomi-seg-and-cand))
+             (cand (cdr yomi-seg-and-cand))
+             (ggx-ctx (google-cgiapi-jp-context-ggx-ctx ggc)))
     (google-cgiapi-jp-internal-context-set-yomi-seg! ggx-ctx yomi-seg)
     (google-cgiapi-jp-internal-context-set-candidates! ggx-ctx cand)
     (length cand)))
@@ -618,6 +622,7 @@
     (google-cgiapi-jp-make-raw-string (google-cgiapi-jp-get-raw-str-seq ggc) wide? upper?)))
 
 (define (google-cgiapi-jp-init-handler id im arg)
+  (im-set-delay-activating-handler! im google-cgiapi-jp-delay-activating-handler)
   (if (not google-cgiapi-jp-init-lib-ok?)
       (begin
 	(google-cgiapi-jp-lib-init)
@@ -626,7 +631,9 @@
 
 (define (google-cgiapi-jp-release-handler ggc)
   (if ggc
-      (google-cgiapi-jp-lib-release-context ggc)))
+      (begin
+        (http:async-cancel! ggc)
+        (google-cgiapi-jp-lib-release-context ggc))))
 
 (define (google-cgiapi-jp-flush ggc)
   (rk-flush (google-cgiapi-jp-context-rkc ggc))
@@ -716,7 +723,10 @@
 		(google-cgiapi-jp-context-set-state! ggc #t)
 		;; Don't perform rk-flush here. The rkc must be restored when
 		;; google-cgiapi-jp-cancel-conv invoked -- YamaKen 2004-10-25
-		))))))
+		)
+	      ;; the result is picked up by google-cgiapi-jp-delay-activating-handler
+	      (if (http:async-requested? ggc)
+		  (http:async-watch ggc)))))))
 
 (define google-cgiapi-jp-cancel-conv
   (lambda (ggc)
@@ -1813,6 +1823,8 @@
       (google-cgiapi-jp-proc-input-state ggc key key-state)))))
 
 (define (google-cgiapi-jp-press-key-handler ggc key key-state)
+  ;; new input supersedes the conversion in flight
+  (http:async-cancel! ggc)
   (if (ichar-control? key)
       (im-commit-raw ggc)
       (if (google-cgiapi-jp-context-on ggc)
@@ -1833,6 +1845,7 @@
       (google-cgiapi-jp-commit-raw ggc)))
 ;;;
 (define (google-cgiapi-jp-reset-handler ggc)
+  (http:async-cancel! ggc)
   (if (google-cgiapi-jp-context-on ggc)
       (begin
 	(if (google-cgiapi-jp-context-state ggc)
@@ -1860,6 +1873,18 @@
   (if (not (google-cgiapi-jp-begin-input ggc key key-state))
       (im-commit-raw ggc)))
 
+;; Called by the bridge when the response watched in
+;; google-cgiapi-jp-begin-conv arrives.
+(define (google-cgiapi-jp-delay-activating-handler ggc)
+  (http:async-poll ggc)
+  (if (and (google-cgiapi-jp-context-on ggc)
+           (not (google-cgiapi-jp-context-state ggc))
+           (http:async-requested? ggc))
+      (begin
+        (google-cgiapi-jp-begin-conv ggc)
+        (google-cgiapi-jp-update-preedit ggc)))
+  '(0 0 -1))
+
 (google-cgiapi-jp-configure-widgets)
 (register-im
  'google-cgiapi-jp
@@ -99,10 +99,19 @@
     (require "hangul3.scm")
     (generic-context-new id im hangul3-rule #t)))
 
+;; The composing table is looked up directly instead of loading the
+;; large romaja-rule into the heap.
 (define romaja-init-handler
   (lambda (id im arg)
-    (require "romaja.scm")
-    (generic-context-new id im romaja-rule #t)))
+    (generic-context-new id im
+			 (if (file-readable?
+			      (string-append (sys-pkgdatadir)
+					     "/tables/romaja.table"))
+			     "romaja.table"
+			     (begin
+			       (require "romaja.scm")
+			       romaja-rule))
+			 #t)))
 
 (hangul-register-im
  'hangul2
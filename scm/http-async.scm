@@ -0,0 +1,349 @@
+;;; http-async.scm: asynchronous http client for uim.
+;;;
+;;; Copyright (c) 2009-2013 uim Project https://github.com/uim/uim
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;;
+
+;; Asynchronous requests are performed by a worker process, which is
+;; started as 'uim-sh http-worker.scm' and writes the response body to
+;; a pipe. The worker is spawned from C without running any Scheme code
+;; in the forked child, so the bridges can use it from their possibly
+;; multi-threaded processes. The key handler returns immediately, and
+;; http:async-watch asks the bridge to watch the pipe of the request
+;; in its event loop. Once data arrives, the bridge runs the
+;; delay-activating-handler of the IM, which collects the response by
+;; http:async-poll.
+;;
+;; Responses are kept in a small cache keyed by (hostname path
+;; servname), so that re-conversion of the same string, segment
+;; resizing back and forth and prefetched queries cost no network
+;; round trip.
+
+(require-extension (srfi 1 2 9 34))
+(require "i18n.scm")
+(require "util.scm")
+(require "http-client.scm")
+(require "process.scm")
+
+(define-record-type http-async-request
+  (make-http-async-request key owner watcher pid fd chunks) http-async-request?
+  (key     http-async-request-key)
+  (owner   http-async-request-owner   http-async-request-set-owner!)
+  ;; the context whose bridge watches fd
+  (watcher http-async-request-watcher http-async-request-set-watcher!)
+  (pid     http-async-request-pid)
+  (fd      http-async-request-fd)
+  (chunks  http-async-request-chunks  http-async-request-set-chunks!))
+
+;; in-flight requests, newest first
+(define http-async-pending '())
+;; (owner . key) of finished requests not yet taken by the owner
+(define http-async-finished '())
+;; (key . body), most recently used first
+(define http-async-cache '())
+;; workers which have been closed but not reaped yet
+(define http-async-zombies '())
+
+;; upper bound of concurrent workers
+(define http-async-max-pending 4)
+
+;; uim-sh to run http-worker.scm
+(define http-async-worker-command (string-append (sys-bindir) "/uim-sh"))
+
+;; Asks the bridge of context c to run its delay-activating-handler
+;; when fd gets readable, or cancels the watch if fd is -1.
+(define http-async-watch-fd im-delay-activate-candidate-selector-on-fd)
+
+(define (http-async-make-key hostname path servname)
+  (list hostname path servname))
+
+(define (http-async-enabled?)
+  (and (symbol-bound? 'http-use-async?)
+       http-use-async?
+       (symbol-bound? 'process-spawn)))
+
+;; The IM can deliver a response later only if the bridge can watch
+;; the pipe of the worker and activate the candidate selector then.
+;; Returns c if so, otherwise #f to be passed as owner of
+;; http:async-get.
+(define (http:async-owner c)
+  (and (http-async-enabled?)
+       (im-delay-activate-candidate-selector-on-fd-supported? c)
+       c))
+
+;;
+;; cache
+;;
+
+(define (http-async-cache-limit)
+  (if (symbol-bound? 'http-cache-size)
+      http-cache-size
+      64))
+
+(define (http-async-cache-ref key)
+  (let ((ent (assoc key http-async-cache)))
+    (and ent
+         (begin
+           (set! http-async-cache
+                 (cons ent (delete ent http-async-cache eq?)))
+           (cdr ent)))))
+
+(define (http-async-cache-set! key body)
+  (let ((cache (cons (cons key body)
+                     (remove (lambda (ent)
+                               (equal? (car ent) key))
+                             http-async-cache)))
+        (limit (http-async-cache-limit)))
+    (set! http-async-cache
+          (if (< limit (length cache))
+              (take cache limit)
+              cache))))
+
+(define (http:async-cache-clear!)
+  (set! http-async-cache '()))
+
+;;
+;; workers
+;;
+
+(define (http-async-reap-zombies)
+  (let ((wnohang (assq-cdr '$WNOHANG process-waitpid-options-alist)))
+    (set! http-async-zombies
+          (remove (lambda (pid)
+                    (not (= (car (process-waitpid pid wnohang)) 0)))
+                  http-async-zombies))))
+
+(define (http-async-unwatch! req)
+  (let ((c (http-async-request-watcher req)))
+    (if c
+        (begin
+          (http-async-request-set-watcher! req #f)
+          (http-async-watch-fd c -1)))))
+
+;; The watch is removed first, so that the bridge never watches a
+;; closed (and possibly reused) descriptor.
+(define (http-async-close! req)
+  (http-async-unwatch! req)
+  (file-close (http-async-request-fd req))
+  (set! http-async-pending (delete req http-async-pending eq?))
+  (set! http-async-zombies
+        (cons (http-async-request-pid req) http-async-zombies)))
+
+;; Only what can be written out is passed to the worker: the proxy as
+;; (hostname port), and the port of ssl. The worker connects with the
+;; version-flexible client method.
+(define (http-async-worker-args hostname path servname proxy ssl
+                                request-alist)
+  (list hostname path servname
+        (and (http-proxy? proxy)
+             (list (hostname? proxy) (port? proxy)))
+        (and (http-ssl? ssl)
+             (port? ssl))
+        request-alist
+        http-timeout))
+
+(define (http-async-spawn key owner args)
+  (let ((proc (process-spawn http-async-worker-command
+                             (list "uim-sh" "-B" "http-worker.scm"
+                                   (write-to-string args)))))
+    (if (not proc)
+        (begin
+          (uim-notify-fatal (N_ "cannot fork"))
+          #f)
+        (let ((req (make-http-async-request key owner #f
+                                            (car proc) (cdr proc) '())))
+          (set! http-async-pending (cons req http-async-pending))
+          ;; A worker nobody waits for is dropped first. Closing the
+          ;; pipe terminates it by SIGPIPE.
+          (if (< http-async-max-pending (length http-async-pending))
+              (let ((victim (or (find (lambda (r)
+                                        (not (http-async-request-owner r)))
+                                      (reverse http-async-pending))
+                                (last http-async-pending))))
+                (http-async-close! victim)))
+          req))))
+
+;; Drains readable data of req without blocking. Returns #t when the
+;; response is complete.
+(define (http-async-drain! req)
+  (let ((fd (http-async-request-fd req)))
+    (let loop ()
+      (if (file-ready? (list fd) 0)
+          (let ((buf (file-read fd file-bufsiz)))
+            (if (or (eof-object? buf)
+                    (not buf))
+                (let ((body (list->string
+                             (apply append
+                                    (reverse (http-async-request-chunks req))))))
+                  (http-async-close! req)
+                  (if (< 0 (string-length body))
+                      (http-async-cache-set! (http-async-request-key req) body))
+                  (if (http-async-request-owner req)
+                      (set! http-async-finished
+                            (cons (cons (http-async-request-owner req)
+                                        (http-async-request-key req))
+                                  http-async-finished)))
+                  #t)
+                (begin
+                  (http-async-request-set-chunks!
+                   req (cons buf (http-async-request-chunks req)))
+                  (loop))))
+          #f))))
+
+(define (http-async-find-pending key)
+  (find (lambda (req)
+          (equal? (http-async-request-key req) key))
+        http-async-pending))
+
+;;
+;; API
+;;
+
+;; Collects finished responses into the cache without blocking.
+;; Returns #t if any request has been completed. A request watched by
+;; another context than the optional argument is left to the
+;; delay-activating-handler of that context.
+(define (http:async-poll . args)
+  (let ((c (and (pair? args)
+                (car args))))
+    (http-async-reap-zombies)
+    (let ((done (filter (lambda (req)
+                          (and (memq (http-async-request-watcher req)
+                                     (list #f c))
+                               (http-async-drain! req)))
+                        http-async-pending)))
+      (not (null? done)))))
+
+;; Issues GET request asynchronously on behalf of owner, which is
+;; usually an IM context. Returns the response body if it is already
+;; cached, otherwise returns #f and the response becomes available
+;; via the cache once http:async-poll collected it. A new request
+;; supersedes the previous one of the same owner.
+(define (http:async-request owner hostname path . args)
+  (let-optionals* args ((servname 80)
+                        (proxy #f)
+                        (ssl #f)
+                        (request-alist '()))
+    (let ((key (http-async-make-key hostname path servname)))
+      (http:async-poll owner)
+      (let ((failed? (any (lambda (ent)
+                            (and (eq? (car ent) owner)
+                                 (equal? (cdr ent) key)))
+                          http-async-finished)))
+        (http:async-cancel! owner)
+        (or (http-async-cache-ref key)
+            ;; don't retry a request which has just failed
+            (and (not failed?)
+                 (let ((req (http-async-find-pending key)))
+                   (if req
+                       (http-async-request-set-owner! req owner)
+                       (http-async-spawn key owner
+                                         (http-async-worker-args
+                                          hostname path servname
+                                          proxy ssl request-alist)))
+                   #f)))))))
+
+;; Returns #t if the last request of owner is in flight or finished
+;; but not taken yet.
+(define (http:async-requested? owner)
+  (or (any (lambda (req)
+             (eq? (http-async-request-owner req) owner))
+           http-async-pending)
+      (and (assq owner http-async-finished)
+           #t)))
+
+;; Asks the bridge of context c to run the delay-activating-handler of
+;; c when the response to the last request of c arrives. The handler
+;; is expected to call (http:async-poll c) and to issue the request
+;; again, which returns the response or calls this again if it is
+;; still incomplete. Returns #t if the request is in flight.
+(define (http:async-watch c)
+  (let ((req (find (lambda (req)
+                     (eq? (http-async-request-owner req) c))
+                   http-async-pending)))
+    (and req
+         (begin
+           ;; the bridge keeps one watch per context
+           (for-each (lambda (r)
+                       (if (eq? (http-async-request-watcher r) c)
+                           (http-async-request-set-watcher! r #f)))
+                     http-async-pending)
+           (http-async-request-set-watcher! req c)
+           (http-async-watch-fd c (http-async-request-fd req))
+           #t))))
+
+;; Forgets requests of owner and removes its watch. In-flight workers
+;; keep running to fill the cache and are bounded by
+;; http-async-max-pending.
+(define (http:async-cancel! owner)
+  (for-each (lambda (req)
+              (if (eq? (http-async-request-owner req) owner)
+                  (http-async-request-set-owner! req #f))
+              (if (eq? (http-async-request-watcher req) owner)
+                  (http-async-unwatch! req)))
+            http-async-pending)
+  (set! http-async-finished
+        (remove (lambda (ent)
+                  (eq? (car ent) owner))
+                http-async-finished)))
+
+;; Drop-in replacement of http:get which looks up the cache, joins an
+;; in-flight request for the same resource and falls back to a
+;; blocking request.
+(define (http:get-cached hostname path . args)
+  (let-optionals* args ((servname 80)
+                        (proxy #f)
+                        (ssl #f)
+                        (request-alist '()))
+    (let ((key (http-async-make-key hostname path servname)))
+      (or (http-async-cache-ref key)
+          (let ((req (http-async-find-pending key)))
+            (if (and req
+                     (file-ready? (list (http-async-request-fd req))
+                                  http-timeout))
+                (begin
+                  (let loop ()
+                    (if (not (http-async-drain! req))
+                        (and (file-ready? (list (http-async-request-fd req))
+                                          http-timeout)
+                             (loop))))
+                  (http-async-cache-ref key))
+                (let ((body (http:get hostname path servname
+                                      proxy ssl request-alist)))
+                  (if (and (string? body)
+                           (< 0 (string-length body)))
+                      (http-async-cache-set! key body))
+                  body)))))))
+
+;; Asynchronous http:async-request if owner is given and asynchronous
+;; requests are enabled, blocking http:get-cached otherwise.
+(define (http:async-get owner hostname path . args)
+  (if (and owner
+           (http-async-enabled?))
+      (apply http:async-request owner hostname path args)
+      (apply http:get-cached hostname path args)))
@@ -32,9 +32,10 @@
 (require-extension (srfi 1 2 9))
 (require "i18n.scm")
 (require "socket.scm")
-(require "input-parse.scm")
 (require "openssl.scm")
 
+(require-dynlib "http")
+
 (define (http:encode-uri-string str)
   (define hex '("0" "1" "2" "3" "4" "5" "6" "7" "8" "9" "A" "B" "C" "D" "E" "F"))
   (define (hex-format2 x)
@@ -47,111 +48,19 @@
           (hex-format2 (char->integer c)))
         (string->list str))))
 
-(define (http:read-chunk port)
-  (define (hex-decode str)
-    (define hex-alist '((#\0 . 0)  (#\1 . 1)  (#\2 . 2)  (#\3 . 3) (#\4 . 4)
-                        (#\5 . 5)  (#\6 . 6)  (#\7 . 7)  (#\8 . 8) (#\9 . 9)
-                        (#\a . 10) (#\A . 10) (#\b . 11) (#\B . 11)
-                        (#\c . 12) (#\C . 12) (#\d . 13) (#\D . 13)
-                        (#\e . 14) (#\E . 14) (#\f . 15) (#\F . 15)))
-    (let ((n (reverse
-              (map (lambda (c)
-                     (assq-cdr c hex-alist))
-                   (string->list str)))))
-      (let loop ((l n)
-                 (sum 0))
-        (if (null? l)
-            sum
-            (loop (map (lambda (x) (* 16 x)) (cdr l))
-                  (+ sum (car l)))))))
-  (define (http:drop-cr line)
-    (apply string-append (string-split line "\r")))
-  (define (http:drop-space line)
-    (apply string-append (string-split line " ")))
-
-  (let loop ((len-str (http:drop-space (http:drop-cr (file-read-line port))))
-             (rest '()))
-    (let ((len (guard (err
-                       (else #f))
-                      (hex-decode len-str))))
-      (if (or (not len) (= len 0))
-          (apply string-append (reverse rest))
-          (let ((buf (file-read-buffer port len)))
-            (file-read-line port) ;; blank
-            (loop (http:drop-cr (file-read-line port)) (cons buf rest)))))))
-
 (define (http:header-field-search l h)
   (find (lambda (x)
           (and (string? (car x))
                (string-ci=? (car x) h))) l))
 
-(define (http:chunked? l)
-  (and-let* ((f (http:header-field-search l "transfer-encoding"))
-             (l (string-split (cdr f) ";"))
-             (ent (find (lambda (ent)
-                          (string=? "chunked" ent))
-                        l)))
-            #t))
-(define (http:content-length? l)
-  (and-let* ((ret (http:header-field-search l "content-length")))
-            (guard (err
-                    (else #f))
-                   (string->number (cdr ret)))))
-
-(define (http:parse-header lines)
-  (let loop ((lines lines)
-             (state '(status header))
-             (rest '()))
-    (if (null? lines)
-        (reverse rest)
-        (call-with-input-string
-         (car lines)
-         (lambda (port)
-           (cond ((eq? 'status (car state))
-                  (let ((version
-                         (find-string-from-port?
-                          "HTTP/"
-                          port))
-                        (version-number
-                         (next-token '(#\space #\.) '(#\space) (N_ "Invalid header")
-                                     port))
-                        (status-code
-                         (next-token '(#\space) '(#\space) (N_ "Invalid header") port))
-                        (reason-phrase
-                         (next-token '(#\space) '(#\return *eof*) (N_ "Invalid header") port)))
-                    (loop (cdr lines)
-                          (cdr state)
-                          (cons (cons 'header
-                                      (list (cons 'version-number version-number)
-                                            (cons 'status-code status-code)
-                                            (cons 'reason-phrase reason-phrase)))
-                                rest))))
-                 ((eq? 'header (car state))
-                  (let ((field-name
-                         (next-token '(#\space #\tab) '(#\:) (N_ "Invalid header") port))
-                        (field-value
-                         (next-token '(#\: #\space #\tab) '(#\return *eof*) (N_ "Invalid header") port)))
-                    (loop (cdr lines)
-                          state
-                          (cons (cons field-name field-value) rest))))))))))
-
-(define (http:read-header port)
-  (let loop ((str (file-read-line port))
-             (rest '()))
-    (if (or (eof-object? str)
-            (null? str)
-            (string=? "\r" str))
-        (reverse rest)
-        (loop (file-read-line port) (cons str rest)))))
-
 (define (http:make-request-string request-alist)
   (string-append
    (apply
     string-append
     (map (lambda (ent)
-           (string-append (car ent) ": " (cdr ent) "\n"))
+           (string-append (car ent) ": " (cdr ent) "\r\n"))
          (append request-alist)))
-   "\n"))
+   "\r\n"))
 
 (define-record-type http-proxy
   (make-http-proxy hostname port) http-proxy?
@@ -169,55 +78,190 @@
 
 (define (http:make-proxy-request-string hostname port)
   (string-append
-   (format "CONNECT ~a:~d HTTP/1.1\n\n" hostname port)))
+   (format "CONNECT ~a:~d HTTP/1.1\r\n" hostname port)
+   (format "Host: ~a:~d\r\n\r\n" hostname port)))
 
-(define (http:make-get-request-string hostname path servname proxy request-alist)
+(define (http:make-get-request-string hostname path request-alist)
   (string-append
-   (if proxy
-       (http:make-proxy-request-string hostname servname)
-       "")
-   (format "GET ~a HTTP/1.1\n" path)
-   (format "Host: ~a\n" hostname)
-   (format "User-Agent: uim/~a\n" (uim-version))
+   (format "GET ~a HTTP/1.1\r\n" path)
+   (format "Host: ~a\r\n" hostname)
+   (format "User-Agent: uim/~a\r\n" (uim-version))
    (http:make-request-string request-alist)))
 
+;;
+;; persistent connections
+;;
+
+;; number of idle connections kept open
+(define http-connection-pool-size 4)
+;; idle connections older than this (sec) are not reused
+(define http-connection-idle-timeout 30)
+
+(define-record-type http-connection
+  (make-http-connection key port secure? last-used) http-connection?
+  (key       http-connection-key)
+  (port      http-connection-port)
+  (secure?   http-connection-secure?)
+  (last-used http-connection-last-used http-connection-set-last-used!))
+
+(define http-connection-pool '())
+
+(define (http:connection-key hostname servname proxy ssl)
+  (list hostname
+        servname
+        (and (http-proxy? proxy)
+             (cons (hostname? proxy) (port? proxy)))
+        (and (http-ssl? ssl)
+             (port? ssl))))
+
+(define (http:close-connection conn)
+  (let ((port (http-connection-port conn)))
+    (if (http-connection-secure? conn)
+        (close-openssl-file-port port)
+        (close-file-port port))))
+
+;; An idle connection must not be readable; if it is, the server has
+;; closed it (or sent garbage) and writing to it would fail.
+(define (http:connection-stale? conn)
+  (or (> (string->number (difftime (time) (http-connection-last-used conn)))
+         http-connection-idle-timeout)
+      (file-ready? (list (fd? (http-connection-port conn))) 0)))
+
+(define (http:take-pooled-connection key)
+  (let loop ((pool http-connection-pool)
+             (rest '()))
+    (cond ((null? pool)
+           (set! http-connection-pool (reverse rest))
+           #f)
+          ((http:connection-stale? (car pool))
+           (http:close-connection (car pool))
+           (loop (cdr pool) rest))
+          ((equal? key (http-connection-key (car pool)))
+           (set! http-connection-pool (append (reverse rest) (cdr pool)))
+           (car pool))
+          (else
+           (loop (cdr pool) (cons (car pool) rest))))))
+
+(define (http:release-connection conn)
+  (http-connection-set-last-used! conn (time))
+  (set! http-connection-pool (cons conn http-connection-pool))
+  (if (< http-connection-pool-size (length http-connection-pool))
+      (let ((last (list-tail http-connection-pool http-connection-pool-size)))
+        (for-each http:close-connection last)
+        (set! http-connection-pool
+              (list-head http-connection-pool http-connection-pool-size)))))
+
+(define (http:close-all-connections)
+  (for-each http:close-connection http-connection-pool)
+  (set! http-connection-pool '()))
+
+;; Reads a response from port. Returns the parser in the final state
+;; ('done, 'error, 'closed or 'timeout) with the state itself.
+(define (http:read-response port head-only? ssl?)
+  (let ((parser (make-http-response-parser head-only?)))
+    (let loop ((first? #t))
+      (let ((state (cond ((and (or first? (not ssl?))
+                               (not (file-ready? (list (fd? port)) http-timeout)))
+                          'timeout)
+                         (ssl?
+                          (http-response-parser-feed!
+                           parser
+                           ((read? port) (context? port) (inbufsiz? port))))
+                         (else
+                          (http-response-parser-read! parser (fd? port))))))
+        (if (eq? state 'continue)
+            (loop #f)
+            (cons state parser))))))
+
+(define (http:open-connection key hostname servname proxy ssl)
+  (let* ((with-ssl? (and (provided? "openssl")
+                         (http-ssl? ssl)
+                         (method? ssl)))
+         (port (if with-ssl? (port? ssl) servname))
+         (fd (if (http-proxy? proxy)
+                 (tcp-connect (hostname? proxy) (port? proxy))
+                 (tcp-connect hostname port))))
+    (and (integer? fd)
+         (< 0 fd)
+         (let ((raw-port (open-file-port fd)))
+           (if (and (http-proxy? proxy)
+                    (not (and-let* ((nr (file-display
+                                         (http:make-proxy-request-string hostname port)
+                                         raw-port))
+                                    (res (http:read-response raw-port #t #f)))
+                           (let ((ok? (and (eq? (car res) 'done)
+                                           (= 200 (http-response-parser-status (cdr res))))))
+                             (delete-http-response-parser (cdr res))
+                             ok?))))
+               (begin
+                 (close-file-port raw-port)
+                 #f)
+               (if with-ssl?
+                   (let ((ssl-port (open-openssl-file-port fd (method? ssl))))
+                     (if ssl-port
+                         (begin
+                           (file-port-release! raw-port)
+                           (make-http-connection key ssl-port #t (time)))
+                         (begin
+                           (close-file-port raw-port)
+                           #f)))
+                   (make-http-connection key raw-port #f (time))))))))
+
+;; Writes request to conn. A plain connection is written without
+;; SIGPIPE, which a connection closed by the server would raise.
+(define (http:send-request conn request)
+  (let ((port (http-connection-port conn)))
+    (if (http-connection-secure? conn)
+        (let ((nr (file-display request port)))
+          (and nr
+               (<= 0 nr)))
+        (eq? (http-send-request (fd? port) request) #t))))
+
+;; Sends request over conn. Returns the response body, #f on failure,
+;; or 'closed if the server has already closed or reset the reused
+;; connection.
+(define (http:request conn request)
+  (let ((port (http-connection-port conn)))
+    (if (not (http:send-request conn request))
+        (begin
+          (http:close-connection conn)
+          'closed)
+        (let* ((res (http:read-response port #f (http-connection-secure? conn)))
+               (state (car res))
+               (parser (cdr res))
+               (body (and (eq? state 'done)
+                          (http-response-parser-body parser))))
+          (cond ((and body
+                      (http-response-parser-keep-alive? parser))
+                 (http:release-connection conn))
+                (else
+                 (http:close-connection conn)))
+          (delete-http-response-parser parser)
+          (if (eq? state 'closed)
+              'closed
+              body)))))
+
 (define (http:get hostname path . args)
   (let-optionals* args ((servname 80)
                         (proxy #f)
                         (ssl #f)
                         (request-alist '()))
-    (let* ((with-ssl? (and (provided? "openssl")
-                           (http-ssl? ssl)
-                           (method? ssl)))
-           (call-with-open-file-port-function
-            (if with-ssl?
-                ;; cut
-                (lambda (file thunk)
-                  (call-with-open-openssl-file-port file (method? ssl) thunk))
-                call-with-open-file-port))
-           (file (if (http-proxy? proxy)
-                     (tcp-connect (hostname? proxy) (port? proxy))
-                     (if with-ssl?
-                         (tcp-connect hostname (port? ssl))
-                         (tcp-connect hostname servname)))))
-      (if (not file)
-          (uim-notify-fatal (N_ "cannot connect server")))
-      (call-with-open-file-port-function
-       file
-       (lambda (port)
-         (and-let* ((request (http:make-get-request-string hostname path servname proxy request-alist))
-                    (nr (file-display request port))
-                    (ready? (file-ready? (list (fd? port)) http-timeout))
-                    (proxy-header (if proxy
-                                      (http:read-header port)
-                                      '()))
-                    (header (http:read-header port))
-                    (parsed-header (http:parse-header header)))
-             (let ((content-length (http:content-length? parsed-header)))
-               (cond (content-length
-                      (file-read-buffer port content-length))
-                     ((http:chunked? parsed-header)
-                      (http:read-chunk port))
-                     (else
-                      (file-get-buffer port))))))))))
-
+    (let ((key (http:connection-key hostname servname proxy ssl))
+          (request (http:make-get-request-string hostname path request-alist)))
+      (let retry ((conn (http:take-pooled-connection key))
+                  (reused? #t))
+        (cond ((and conn reused?)
+               (let ((ret (http:request conn request)))
+                 ;; the server may close an idle connection at any time
+                 (if (eq? ret 'closed)
+                     (retry (http:take-pooled-connection key) #t)
+                     ret)))
+              (reused?
+               (retry (http:open-connection key hostname servname proxy ssl) #f))
+              ((not conn)
+               (uim-notify-fatal (N_ "cannot connect server"))
+               #f)
+              (else
+               (let ((ret (http:request conn request)))
+                 (and (not (eq? ret 'closed))
+                      ret))))))))
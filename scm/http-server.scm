@@ -120,7 +120,8 @@
     (if (or (eof-object? str)
             (not str)
             (not (string? str))
-            (string=? "\r" str))
+            (string=? "\r" str)
+            (string=? "" str))
         (reverse rest)
         (loop (file-read-line port) (cons str rest)))))
 
@@ -173,21 +174,93 @@
 (define http-server-not-found-response
   (string-append "HTTP/1.0 404 Not Found\r\n"
                  "Content-Type: text/plain\r\n"
-                 "\n"
+                 "\r\n"
                  "File not Found\n"))
 (define http-server-internal-error
   (string-append "HTTP/1.0 501 Internal Error\r\n"
                  "Content-Type: text/plain\r\n"
-                 "\n"
+                 "\r\n"
                  "File not Found\n"))
 
+(define (http-server:persistent-response message)
+  (if (list? message)
+      (apply string-append
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: text/plain\r\n"
+             "Transfer-Encoding: chunked\r\n"
+             "\r\n"
+             (append
+              (map (lambda (chunk)
+                     (string-append (number->string (string-length chunk) 16)
+                                    "\r\n" chunk "\r\n"))
+                   message)
+              '("0\r\n\r\n")))
+      (string-append "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: text/plain\r\n"
+                     "Content-Length: " (number->string (string-length message)) "\r\n"
+                     "\r\n"
+                     message)))
+
+;; Answers a request read from port. Returns #t if the connection
+;; stays open for the next request.
+(define (http-server:respond self port)
+  (let ((header (http-server:read-header port)))
+    (cond
+     ;; closed by the client
+     ((null? header)
+      #f)
+     ((and-let* ((parsed-header (http-server:parse-header header))
+                 (resource (assq-cdr 'resource parsed-header)))
+        (cons resource parsed-header))
+      => (lambda (resource.header)
+           (let* ((resource (car resource.header))
+                  (parsed-header (cdr resource.header))
+                  (persistent (alist-cdr resource (http-server-persistent-resource self) string=?))
+                  (service (or persistent
+                               (alist-cdr resource (http-server-resource self) string=?)))
+                  (content-length (http-server:header-field-search parsed-header "Content-Length")))
+             (if (not service)
+                 (begin
+                   (file-display http-server-not-found-response port)
+                   #f)
+                 (let* ((body (if content-length
+                                  (file-read-buffer port (string->number content-length))
+                                  #f))
+                        (message (service resource parsed-header (http-server:parse-post body))))
+                   (cond ((not message)
+                          (file-display http-server-internal-error port)
+                          #f)
+                         (persistent
+                          (file-display (http-server:persistent-response message) port)
+                          #t)
+                         (else
+                          (file-display
+                           (string-append "HTTP/1.0 302 Found\r\n"
+                                          "Content-Type: text/html\r\n"
+                                          "Content-Length: " (number->string (string-length message)) "\r\n"
+                                          "\r\n"
+                                          message)
+                           port)
+                          #f)))))))
+     ;; unknown request
+     (else
+      (file-display http-server-internal-error port)
+      #f))))
+
 (define-class http-server object
   '((sockets #f)
     (resource ())
+    (persistent-resource ())
+    ;; For the tests of the clients: 'close drops the next request
+    ;; after reading it, 'reset before reading it, so that the client
+    ;; gets a connection reset.
+    (drop-next #f)
     (server #f))
   '(start
+    serve
     stop
     regist-resource!
+    regist-persistent-resource!
     ))
 
 (class-set-method! http-server start
@@ -195,38 +268,41 @@
     (http-server-set-sockets!
      self
      (tcp-listen hostname servname))
-    (http-server-set-server!
-     self
-     (make-tcp-server
-      (lambda (s)
-        (call-with-open-file-port
-         s
-         (lambda (port)
-           (or
-            (and-let* ((header (http-server:read-header port))
-                       (parsed-header (http-server:parse-header header))
-                       (resource (assq-cdr 'resource parsed-header)))
-                      (let* ((service (alist-cdr resource (http-server-resource self) string=?))
-                             (content-length (http-server:header-field-search parsed-header "Content-Length")))
-                        (if (not service)
-                            (file-display http-server-not-found-response port)
-                            (let* ((body (if content-length
-                                             (file-read-buffer port (string->number content-length))
-                                             #f))
-                                   (message (service resource parsed-header (http-server:parse-post body))))
-                              (if message
-                                  (file-display
-                                   (string-append "HTTP/1.0 302 Found\r\n"
-                                                  "Content-Type: text/html\r\n"
-                                                  "Content-Length: " (number->string (string-length message)) "\r\n"
-                                                  "\n"
-                                                  message)
-                                   port)
-                                  (file-display http-server-internal-error port))))))
-            ;; unknown request
-            (file-display http-server-internal-error port)))))))
-    ((http-server-server self)
-     (http-server-sockets self))))
+    (http-server-serve self)))
+
+;; Serves on the sockets set by the caller, which may listen and fork
+;; before serving. The connections which have got a response from a
+;; persistent resource are kept open, with their ports, for the next
+;; request.
+(class-set-method! http-server serve
+  (lambda (self)
+    (let ((ports '()))
+      (http-server-set-server!
+       self
+       (make-tcp-server
+        (lambda (s)
+          (let* ((ent (assv s ports))
+                 (port (if ent
+                           (cdr ent)
+                           (open-file-port s)))
+                 (drop (http-server-drop-next self))
+                 (keep? (cond ((eq? drop 'reset)
+                               #f)
+                              ((eq? drop 'close)
+                               (http-server:read-header port)
+                               #f)
+                              (else
+                               (http-server:respond self port)))))
+            (if drop
+                (http-server-set-drop-next! self #f))
+            (set! ports (alist-delete s ports =))
+            (if keep?
+                (set! ports (cons (cons s port) ports))
+                ;; the server closes the socket
+                (file-port-release! port))
+            keep?))))
+      ((http-server-server self)
+       (http-server-sockets self)))))
 
 (class-set-method! http-server stop
   (lambda (self)
@@ -238,3 +314,12 @@
      self
      (alist-replace (cons resource thunk)
                     (http-server-resource self)))))
+
+;; The response of thunk is sent as HTTP/1.1 keeping the connection
+;; open. A list of strings is sent as chunks.
+(class-set-method! http-server regist-persistent-resource!
+  (lambda (self resource thunk)
+    (http-server-set-persistent-resource!
+     self
+     (alist-replace (cons resource thunk)
+                    (http-server-persistent-resource self)))))
@@ -0,0 +1,66 @@
+;;; http-worker.scm: performs a request of http-async.scm in a worker process
+;;;
+;;; Copyright (c) 2009-2013 uim Project https://github.com/uim/uim
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;;
+
+
+;; Run by http-async.scm as
+;;
+;;   uim-sh -B http-worker.scm '(hostname path servname proxy ssl-port
+;;                               request-alist timeout)'
+;;
+;; where proxy is (hostname port) or #f. The response body is written
+;; to the standard output, nothing on failure.
+
+(require-extension (srfi 1 2 34))
+(require "util.scm")
+(require "fileio.scm")
+(require "http-client.scm")
+
+;; the custom of the requesting process is passed with the request
+(define http-timeout 3000)
+
+(define (http-worker-get hostname path servname proxy ssl-port
+                         request-alist timeout)
+  (set! http-timeout timeout)
+  (http:get hostname path servname
+            (and proxy
+                 (make-http-proxy (car proxy) (cadr proxy)))
+            (and ssl-port
+                 (symbol-bound? 'SSLv23-client-method)
+                 (make-http-ssl (SSLv23-client-method) ssl-port))
+            request-alist))
+
+(define (main args)
+  (let ((body (guard (err
+                      (else #f))
+                (apply http-worker-get (read-from-string (cadr args))))))
+    (if (string? body)
+        (file-write-string 1 body))
+    0))
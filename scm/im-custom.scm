@@ -459,6 +459,18 @@
 		   (if enable-lazy-loading?
 		       (require "lazy-load.scm"))))
 
+(define-custom 'scm-heaps-prealloc 0
+  '(global advanced)
+  '(integer 0 8192)
+  (N_ "Number of heaps allocated at startup")
+  (N_ "Preallocating heaps for large input methods reduces garbage collection during typing. A heap takes 128KB by default."))
+
+(custom-add-hook 'scm-heaps-prealloc
+		 'custom-set-hooks
+		 (lambda ()
+		   (if (> scm-heaps-prealloc 0)
+		       (%%prealloc-heaps scm-heaps-prealloc))))
+
 (define-custom 'toolbar-display-time 'always
   '(toolbar toolbar-display)
   (list 'choice
@@ -751,6 +763,18 @@
   (N_ "Timeout (msec)")
   (N_ "Timeout of http connection (msec)."))
 
+(define-custom 'http-use-async? #t
+  '(http)
+  '(boolean)
+  (N_ "Asynchronous request")
+  (N_ "Send requests of web-based input methods in background so that typing is not blocked."))
+
+(define-custom 'http-cache-size 64
+  '(http)
+  '(integer 0 4096)
+  (N_ "Number of cached responses")
+  (N_ "Number of responses of web-based input methods kept in memory to answer repeated requests without network access."))
+
 (load "predict-custom.scm")
 
 
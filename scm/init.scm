@@ -71,6 +71,25 @@
   (lambda ()
     (%%prealloc-heaps 64)))
 
+;; Heap parameters, which can be tuned by LIBUIM_SCM_HEAP_SIZE,
+;; LIBUIM_SCM_HEAP_ALLOC_THRESHOLD and LIBUIM_SCM_N_HEAPS_INIT, and the
+;; time spent in key handlers including GC pauses on the keystroke path.
+(define scm-stat
+  (lambda ()
+    (append (%%heap-conf)
+	    (if (symbol-bound? 'key-event-stat)
+		(key-event-stat)
+		'()))))
+
+;; "name\tvalue\n" lines for the scm_stat helper message
+(define scm-stat-string
+  (lambda ()
+    (apply string-append
+	   (map (lambda (ent)
+		  (string-append (symbol->string (car ent)) "\t"
+				 (number->string (cdr ent)) "\n"))
+		(scm-stat)))))
+
 (define load-user-conf
   (lambda ()
     (let ((home-dir (or (home-directory (user-name)) "")))
@@ -139,3 +158,6 @@
 (or (getenv "LIBUIM_VANILLA")
     (load-user-conf)
     (load "default.scm"))
+
+(if (> scm-heaps-prealloc 0)
+    (%%prealloc-heaps scm-heaps-prealloc))
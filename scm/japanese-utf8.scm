@@ -0,0 +1,161 @@
+;;;
+;;; Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;;
+
+;; The kana tables in japanese*.scm are written in EUC-JP. IMs that talk
+;; UTF-8 to their engine (anthy-utf8) used to feed those EUC-JP strings
+;; through iconv on every keystroke. The procedures here hand out UTF-8
+;; copies of the tables instead, converted once when first needed, so the
+;; input path of such IMs never transcodes.
+
+(require-extension (srfi 1))
+(require "util.scm")
+(require "japanese.scm")
+
+(define ja-utf8-convert-tree
+  (lambda (ic obj)
+    (cond
+     ((string? obj)
+      (or (iconv-code-conv ic obj)
+	  obj))
+     ((pair? obj)
+      (cons (ja-utf8-convert-tree ic (car obj))
+	    (ja-utf8-convert-tree ic (cdr obj))))
+     (else
+      obj))))
+
+;; convert every string in a EUC-JP table to UTF-8
+(define ja-utf8-convert-table
+  (lambda (table)
+    (let ((ic (iconv-open "UTF-8" "EUC-JP")))
+      (if ic
+	  (let ((res (map (lambda (x)
+			    (ja-utf8-convert-tree ic x))
+			  table)))
+	    (iconv-release ic)
+	    res)
+	  table))))
+
+;; alist of (symbol eucjp-table . utf8-table)
+(define ja-utf8-table-cache '())
+
+;; (ja-utf8-table 'ja-rk-rule) returns UTF-8 version of ja-rk-rule. The
+;; conversion is redone only when the variable has been rebound to another
+;; list, as ja-rk-rule-update does on customization.
+(define ja-utf8-table
+  (lambda (sym)
+    (let ((table (symbol-value sym))
+	  (cached (assq sym ja-utf8-table-cache)))
+      (if (and cached
+	       (eq? (cadr cached) table))
+	  (cddr cached)
+	  (let ((utf8-table (ja-utf8-convert-table table)))
+	    (set! ja-utf8-table-cache
+		  (cons (cons sym (cons table utf8-table))
+			(alist-delete sym ja-utf8-table-cache eq?)))
+	    utf8-table)))))
+
+;; split UTF-8 string into reversed character list
+(define ja-utf8-string-to-list
+  (lambda (s)
+    (with-char-codec "UTF-8"
+      (lambda ()
+	(map! (lambda (c)
+		(let ((str (list->string (list c))))
+		  (with-char-codec "ISO-8859-1"
+		    (lambda ()
+		      (%%string-reconstruct! str)))))
+	      (reverse! (string->list s)))))))
+
+(define ja-utf8-wide
+  (lambda (c)
+    (or (ja-find-rec c (ja-utf8-table 'ja-wide-rule))
+        c)))
+
+(define ja-utf8-direct
+  (lambda (c)
+    (ja-find-rec c (ja-utf8-table 'ja-direct-rule))))
+
+(define ja-utf8-space
+  (lambda (kana)
+    (list-ref (ja-utf8-table 'ja-space) kana)))
+
+(define ja-utf8-alnum-space
+  (lambda (alnum)
+    (list-ref (ja-utf8-table 'ja-alnum-space) alnum)))
+
+(define ja-utf8-auto-start-henkan-keyword-list
+  (lambda ()
+    (ja-utf8-table 'japanese-auto-start-henkan-keyword-list)))
+
+(define ja-utf8-string-list-to-wide-alphabet
+  (lambda (char-list)
+    (if (not (null? char-list))
+        (string-append (ja-utf8-string-list-to-wide-alphabet (cdr char-list))
+                       (ja-utf8-wide (car char-list)))
+        "")))
+
+;; UTF-8 version of ja-join-vu
+;; (("゛") ("う")) -> ("う゛")
+(define ja-utf8-join-vu
+  (lambda (lst)
+    (let ((sub (member "゛" lst)))
+      (if (and
+	   sub
+	   (not (null? (cdr sub)))
+	   (string=? (car (cdr sub)) "う"))
+	  (append
+	   (list-head lst (- (length lst) (length sub)))
+	   '("う゛")
+	   (ja-utf8-join-vu (list-tail lst (+ (- (length lst) (length sub)) 2))))
+	  (if (and
+	       sub
+	       (member "゛" (cdr sub)))
+	      (append
+	       (list-head lst (+ (- (length lst) (length sub)) 1))
+	       (ja-utf8-join-vu (cdr sub)))
+	      lst)))))
+
+(define ja-utf8-find-kana-list-from-rule
+  (lambda (rule str)
+    (if (not (null? rule))
+	(if (pair? (member str (car (cdr (car rule)))))
+	    (car (cdr (car rule)))
+	    (ja-utf8-find-kana-list-from-rule (cdr rule) str))
+        (if (string=?  str "゛")
+	    (list "゛" "゛" "ﾞ")
+	    (list str str str)))))
+
+;; UTF-8 version of ja-make-kana-str-list
+(define ja-utf8-make-kana-str-list
+  (lambda (sl)
+    (let ((rule (ja-utf8-table 'ja-rk-rule-basic)))
+      (map (lambda (s)
+	     (ja-utf8-find-kana-list-from-rule rule s))
+	   sl))))
@@ -68,16 +68,27 @@
 
 (define mana-add-new-word
   (lambda (kaki yomi)
-    (mana-eval (list 'mana-add-new-word kaki yomi))))
+    (mana-queue (list 'mana-add-new-word kaki yomi))))
 
 (define mana-learn
   (lambda (yomi state pos len path)
-    (mana-eval (list 'mana-learn yomi state pos len (list 'quote path)))))
+    (mana-queue (list 'mana-learn yomi state pos len (list 'quote path)))))
 
 (define mana-eval
   (lambda (val)
     (mana-lib-eval (string-append (mana-list->string val) "\n"))))
 
+;; The command goes out with the next mana-eval, which skips its
+;; result, or with mana-send-queue at the end of the key event.
+(define mana-queue
+  (lambda (val)
+    (mana-lib-queue (string-append (mana-list->string val) "\n"))))
+
+(define mana-send-queue
+  (lambda ()
+    (if mana-lib-initialized?
+        (mana-lib-send-queue))))
+
 (define mana-list->string
   (lambda (lst)
     (let ((canonicalized (map (lambda (elem)
@@ -1627,7 +1638,9 @@
                     (mana-proc-input-state mc key key-state)))
 	    (mana-proc-raw-state mc key key-state)))
     ;; preedit
-    (mana-update-preedit mc)))
+    (mana-update-preedit mc)
+    ;; learning
+    (mana-send-queue)))
 
 
 (define mana-release-key-handler
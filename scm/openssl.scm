@@ -49,14 +49,20 @@
   (and (not (null? fd))
        (< 0 fd)
        (let* ((port (open-openssl-file-port fd method))
-              (ctx (context? port))
               (ret (thunk port)))
-         (SSL-shutdown (ssl? ctx))
-         (SSL-free (ssl? ctx))
-         (SSL-CTX-free (ssl-ctx? ctx))
-         (file-close fd)
+         (close-openssl-file-port port)
          ret)))
 
+(define (close-openssl-file-port port)
+  (let ((ctx (context? port)))
+    (SSL-shutdown (ssl? ctx))
+    (SSL-free (ssl? ctx))
+    (SSL-CTX-free (ssl-ctx? ctx))
+    (file-close (fd? port))
+    (file-port-release! port)
+    (context! port #f)
+    (fd! port #f)))
+
 (define (open-openssl-file-port fd method)
   (call/cc
    (lambda (block)
@@ -81,5 +87,6 @@
                     (block #f)))
          (make-file-port (make-openssl-file-internal-port ssl-ctx ssl)
                          fd
-                         file-bufsiz '() ssl-read-internal ssl-write-internal))))))
+                         file-bufsiz (make-byte-buffer)
+                         ssl-read-internal ssl-write-internal))))))
 
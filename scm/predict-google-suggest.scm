@@ -30,7 +30,7 @@
 ;;;;
 
 (require-extension (srfi 1))
-(require "http-client.scm")
+(require "http-async.scm")
 (require "util.scm")
 (require "wlos.scm")
 
@@ -40,7 +40,8 @@
   '((use-ssl #t)
     (language 'en)
     (internal-charset "UTF-8")
-    (limit 5))
+    (limit 5)
+    (recent ()))  ;; (str . suggestions) of the last answered query
   '(parse
     suggest
     search))
@@ -92,17 +93,30 @@
       (let* ((proxy (make-http-proxy-from-custom))
              (ssl (and (predict-google-suggest-use-ssl self)
                        (make-http-ssl (SSLv3-client-method) 443)))
-             (result (http:get google-suggest-server
-                               (format "/complete/search?output=toolbar&q=~a~a"
-                                       uri-string
-                                       lang-query)
-                               80
-                               proxy
-                               ssl))
-             (parsed (predict-google-suggest-parse self (string->lang result))))
-        (map (lambda (s)
-               (predict->external-charset self s))
-             parsed)))))
+             (result (http:async-get self
+                                     google-suggest-server
+                                     (format "/complete/search?output=toolbar&q=~a~a"
+                                             uri-string
+                                             lang-query)
+                                     80
+                                     proxy
+                                     ssl)))
+        (if result
+            (let* ((parsed (predict-google-suggest-parse self (string->lang result)))
+                   (suggestions (map (lambda (s)
+                                       (predict->external-charset self s))
+                                     parsed)))
+              (predict-google-suggest-set-recent! self (cons str suggestions))
+              suggestions)
+            ;; While the query is in flight, suggestions for its
+            ;; prefix are still valid ones.
+            (let ((recent (predict-google-suggest-recent self)))
+              (if (and (pair? recent)
+                       (string-prefix? (car recent) str))
+                  (filter (lambda (s)
+                            (string-prefix? str s))
+                          (cdr recent))
+                  '())))))))
 
 (class-set-method! predict-google-suggest search
   (lambda (self str)
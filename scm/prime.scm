@@ -858,6 +858,17 @@
   (lambda (path)
     (process-io path)))
 
+;; A connection to the PRIME server. Editing commands whose result is
+;; not used are queued and written together with the next command that
+;; waits for an answer, so a key press costs at most one round trip.
+;; 'pending' counts the replies to skip before that answer.
+(define prime-connection-rec-spec
+  '((iport   #f)
+    (oport   #f)
+    (queue   ())
+    (pending 0)))
+(define-record 'prime-connection prime-connection-rec-spec)
+
 (define prime-connection-init
   (lambda ()
     (let ((fds (cond ((eq? prime-server-setting? 'unixdomain)
@@ -870,26 +881,70 @@
                       (uim-notify-fatal (N_ "Prime connection is not defined"))
                       #f))))
       (if fds
-        (cons (open-file-port (car fds))
-              (open-file-port (cdr fds)))
+        ;; a socket is read and written through one port
+        (let ((iport (open-file-port (car fds))))
+          (prime-connection-new iport
+                                (if (= (car fds) (cdr fds))
+                                    iport
+                                    (open-file-port (cdr fds)))))
         #f))))
 
+;; This returns the queued commands followed by msg, and empties the
+;; queue.
+(define prime-connection-take-queue!
+  (lambda (connection msg)
+    (let ((str (apply string-append
+                      (reverse (cons msg (prime-connection-queue connection))))))
+      (prime-connection-set-queue! connection '())
+      str)))
+
+(define prime-read-reply
+  (lambda (iport)
+    (let loop ((line (file-read-line iport))
+               (rest '()))
+      (if (or (not line)
+              (eof-object? line)
+              (= 0 (string-length line))
+              (string=? line ""))
+          (reverse rest) ;; drop last "\n"
+          (loop (file-read-line iport) (cons line rest))))))
+
 (define prime-send-command
   (lambda (connection msg)
     (if (pair? connection)
-        (let ((iport (car connection))
-              (oport (cdr connection)))
-          (file-display msg oport)
-          (let loop ((line (file-read-line iport))
-                     (rest '()))
-            (if (or (not line)
-                    (eof-object? line)
-                    (= 0 (string-length line))
-                    (string=? line ""))
-                (reverse rest) ;; drop last "\n"
-                (loop (file-read-line iport) (cons line rest)))))
+        (let ((iport (prime-connection-iport connection))
+              (oport (prime-connection-oport connection)))
+          (file-display (prime-connection-take-queue! connection msg) oport)
+          ;; skip the replies to the queued commands
+          (let skip ((n (prime-connection-pending connection)))
+            (if (> n 0)
+                (begin
+                  (prime-read-reply iport)
+                  (skip (- n 1)))))
+          (prime-connection-set-pending! connection 0)
+          (prime-read-reply iport))
         #f)))
 
+(define prime-queue-command
+  (lambda (connection msg)
+    (if (pair? connection)
+        (begin
+          (prime-connection-set-queue!
+           connection (cons msg (prime-connection-queue connection)))
+          (prime-connection-set-pending!
+           connection (+ 1 (prime-connection-pending connection)))))))
+
+;; This writes the queued commands without waiting for their replies,
+;; which are skipped by the next prime-send-command. It is called at
+;; the end of a key event so that learn_word and session_end don't wait
+;; for the next key.
+(define prime-send-queue
+  (lambda (connection)
+    (if (and (pair? connection)
+             (not (null? (prime-connection-queue connection))))
+        (file-display (prime-connection-take-queue! connection "")
+                      (prime-connection-oport connection)))))
+
 ;; Don't append "\n" to arg-list in this function. That will cause a
 ;; problem with unix domain socket.
 (define prime-engine-send-command
@@ -905,14 +960,25 @@
         (cdr result) ;; drop status line
         (list "\t\t")))))
 
+;; Same as prime-engine-send-command for commands whose result is not
+;; used. The command is sent with the next prime-engine-send-command.
+(define prime-engine-queue-command
+  (lambda (connection arg-list)
+    (prime-queue-command connection
+                         (string-append (prime-util-string-concat arg-list "\t")
+                                        "\n"))))
+
 (define prime-engine-close
   (lambda (prime-connection)
     (if (pair? prime-connection)
-        (let ((iport (car prime-connection))
-              (oport (cdr prime-connection)))
-          (file-display "close\n" oport)
-          (close-file-port (car prime-connection))
-          (close-file-port (cdr prime-connection))))))
+        (let ((iport (prime-connection-iport prime-connection))
+              (oport (prime-connection-oport prime-connection)))
+          (file-display (prime-connection-take-queue! prime-connection
+                                                      "close\n")
+                        oport)
+          (if (not (eq? iport oport))
+              (close-file-port oport))
+          (close-file-port iport)))))
 
 (define prime-engine-conv-predict
   (lambda (prime-connection prime-session)
@@ -938,10 +1004,10 @@
 
 (define prime-engine-conv-select
   (lambda (prime-connection prime-session index-no)
-    (prime-engine-send-command prime-connection
-                               (list "conv_select"
-				     prime-session
-				     (digit->string index-no)))))
+    (prime-engine-queue-command prime-connection
+                                (list "conv_select"
+				      prime-session
+				      (digit->string index-no)))))
 
 ;; This sends a conv_commit command to the server and returns the commited
 ;; string.
@@ -997,7 +1063,7 @@
 
 (define prime-engine-context-reset
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "context_reset" prime-session))))
+    (prime-engine-queue-command prime-connection (list "context_reset" prime-session))))
 
 
 ;; session operations
@@ -1006,7 +1072,7 @@
     (car (prime-engine-send-command prime-connection (list "session_start")))))
 (define prime-engine-session-end
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "session_end" prime-session))))
+    (prime-engine-queue-command prime-connection (list "session_end" prime-session))))
 
 (define prime-engine-session-language-set
   (lambda (prime-connection language)
@@ -1029,16 +1095,16 @@
 ;; composing operations
 (define prime-engine-edit-insert
   (lambda (prime-connection prime-session string)
-    (prime-engine-send-command prime-connection (list "edit_insert"    prime-session string))))
+    (prime-engine-queue-command prime-connection (list "edit_insert"    prime-session string))))
 (define prime-engine-edit-delete
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_delete"    prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_delete"    prime-session))))
 (define prime-engine-edit-backspace
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_backspace" prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_backspace" prime-session))))
 (define prime-engine-edit-erase
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_erase"     prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_erase"     prime-session))))
 
 ;; This sends a edit_commit command to the server and returns the commited
 ;; string.
@@ -1049,16 +1115,16 @@
 ;; cursor operations
 (define prime-engine-edit-cursor-left
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_cursor_left" prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_cursor_left" prime-session))))
 (define prime-engine-edit-cursor-right
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_cursor_right" prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_cursor_right" prime-session))))
 (define prime-engine-edit-cursor-left-edge
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_cursor_left_edge" prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_cursor_left_edge" prime-session))))
 (define prime-engine-edit-cursor-right-edge
   (lambda (prime-connection prime-session)
-    (prime-engine-send-command prime-connection (list "edit_cursor_right_edge" prime-session))))
+    (prime-engine-queue-command prime-connection (list "edit_cursor_right_edge" prime-session))))
 
 ;; preedition-getting operations
 (define prime-engine-edit-get-preedition
@@ -1076,7 +1142,7 @@
 ;; mode operations
 (define prime-engine-edit-set-mode
   (lambda (prime-connection prime-session mode)
-    (prime-engine-send-command prime-connection (list "edit_set_mode" prime-session mode))))
+    (prime-engine-queue-command prime-connection (list "edit_set_mode" prime-session mode))))
 
 (define prime-engine-preedit-convert-input
   (lambda (prime-connection string)
@@ -1095,9 +1161,9 @@
 
 (define prime-engine-learn-word
   (lambda (prime-connection pron literal pos context suffix rest)
-    (prime-engine-send-command prime-connection
-                               (list "learn_word"
-				     pron literal pos context suffix rest))))
+    (prime-engine-queue-command prime-connection
+                                (list "learn_word"
+				      pron literal pos context suffix rest))))
 
 ;; This returns a version string of the PRIME server.
 (define prime-engine-get-version
@@ -2208,7 +2274,8 @@
 	(let ((keymap (prime-keymap-get-keymap context key key-state)))
 	  (prime-proc-call-command keymap context key key-state)
 	  (prime-update-key-press context)
-	  ))))
+	  ))
+    (prime-send-queue (prime-context-connection context))))
 
 (define prime-release-key-handler
   (lambda (context key key-state)
@@ -2329,6 +2396,7 @@
                   (prime-commit-candidate context selection-index)
                   (prime-context-set-nth! context selection-index))))
 	  (prime-update context)
+	  (prime-send-queue (prime-context-connection context))
 	  ))))
 
 (prime-configure-widgets)
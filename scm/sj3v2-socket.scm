@@ -33,26 +33,6 @@
 (require "util.scm")
 (require "i18n.scm")
 (require "socket.scm")
-(require "lolevel.scm")
-(require "process.scm") ;; getpid
-
-;; sj3v2 protocol operators
-(define $SJ3_CONNECT        1)
-(define $SJ3_DISCONNECT     2)
-(define $SJ3_OPENDICT       11)
-(define $SJ3_CLOSEDICT      12)
-(define $SJ3_OPENSTDY       21)
-(define $SJ3_CLOSESTDY      22)
-(define $SJ3_STDYSIZE       23)
-(define $SJ3_STUDY          61)
-(define $SJ3_MAKEDICT       81)
-(define $SJ3_MAKESTDY       82)
-(define $SJ3_MAKEDIR        83)
-(define $SJ3_ACCESS         84)
-(define $SJ3_PH2KNJ_EUC     111)
-(define $SJ3_CL2KNJ_ALL_EUC 115)
-(define $SJ3_CL2KNJ_CNT_EUC 116)
-(define $SJ3_CLSTUDY_EUC    117)
 
 (define sj3-lib-error-str-alist
   `((-1  . ,(N_ "Internal server error."))    ;; SJ3_InternalError
@@ -110,207 +90,27 @@
     (133 . ,(N_ "Cannot code convert."))))    ;; SJ3_CannotCodeConvert
 
 
-(define sj3-protocol-version 2)
-
 ;;
 ;; sj3 protocol api
 ;;
-(define (sj3-lib-connect socket user)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8 s8 s8)
-                            $SJ3_CONNECT sj3-protocol-version
-                            "unix" user (format "~a.uim-sj3" (current-process-id)))))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= -2 (u32->s32 result)))))
-
-(define (sj3-lib-disconnect socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_DISCONNECT)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= 0 result))))
-
-(define (sj3-lib-opendict socket dictionary-name passwd)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8) $SJ3_OPENDICT
-                            dictionary-name passwd)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
-           (lambda (result)
-             result))))))
-
-(define (sj3-lib-closedict socket dict-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32) $SJ3_CLOSEDICT dict-id)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= 0 result))))
-
-(define (sj3-lib-openstdy socket stdy-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8) $SJ3_OPENSTDY stdy-name "")))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     result)))
-
-(define (sj3-lib-closestdy socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_CLOSESTDY)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     result)))
-
-(define (sj3-lib-stdy-size socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_STDYSIZE)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
-           (lambda (result)
-             result))))))
-
-(define (sj3-lib-study socket stdy)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u8list) $SJ3_STUDY stdy)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     result)))
-
-(define (sj3-lib-makedict socket dictionary-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32 u32 u32) $SJ3_MAKEDICT
-                            dictionary-name
-                            2048  ; Index length
-                            2048  ; Length
-                            256   ; Number
-                            )))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= 0 result))))
-
-(define (sj3-lib-makestdy socket stdy-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32 u32 u32) $SJ3_MAKESTDY
-                            stdy-name
-                            2048  ; Number
-                            1     ; Step
-                            2048  ; Length
-                            )))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= 0 result))))
-
-(define (sj3-lib-makedir socket directory-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8) $SJ3_MAKEDIR directory-name)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     result)))
-
-(define (sj3-lib-access? socket directory-name mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32) $SJ3_ACCESS
-                            directory-name
-                            mode)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (= 0 result))))
+;; The requests are encoded and the replies decoded by the sj3v2
+;; plugin, which defines sj3-lib-connect, sj3-lib-disconnect,
+;; sj3-lib-opendict, sj3-lib-closedict, sj3-lib-openstdy,
+;; sj3-lib-closestdy, sj3-lib-stdy-size, sj3-lib-study,
+;; sj3-lib-makedict, sj3-lib-makestdy, sj3-lib-makedir,
+;; sj3-lib-access?, sj3-lib-cl2knj-cnt-euc and sj3-lib-clstudy-euc.
+;;
+(require-dynlib "sj3v2")
 
 (define (sj3-lib-ph2knj-euc socket stdy-size yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8) $SJ3_PH2KNJ_EUC yomi)))
-  (call-with-u8list-unpack
-   '(u32 u32) (string-buf->u8list (file-read socket 8))
-   (lambda (result yomi-length)
-     (and (= result 0)
-          (let loop ((yomi-len (cons (car (string-buf->u8list (file-read socket 1)))
-                                     '()))
-                     (rest-stdy '())
-                     (rest-kouho '()))
-            (if (<= (car yomi-len) 0)
-                (values (reverse yomi-len) (reverse rest-stdy) (reverse rest-kouho))
-                (let* ((new-stdy (string-buf->u8list (file-read socket stdy-size)))
-                       (new-kouho (file-read-string-with-terminate socket #\nul)))
-                  (loop (cons (car (string-buf->u8list (file-read socket 1)))
-                              yomi-len)
-                        (cons new-stdy rest-stdy)
-                        (cons new-kouho rest-kouho)))))))))
+  (let ((res (%sj3-lib-ph2knj-euc socket stdy-size yomi)))
+    (and res
+         (apply values res))))
 
 (define (sj3-lib-cl2knj-all-euc socket stdy-size len yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8) $SJ3_CL2KNJ_ALL_EUC len yomi)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (and (= result 0)
-          (let loop ((yomi-len
-                      (cons (u8list->u32 (string-buf->u8list (file-read socket 4)))
-                            '()))
-                     (rest-stdy '())
-                     (rest-kouho '()))
-            (if (<= (car yomi-len) 0)
-                (values (reverse yomi-len) (reverse rest-stdy) (reverse rest-kouho))
-                (let* ((new-stdy (string-buf->u8list (file-read socket stdy-size)))
-                       (new-kouho (file-read-string-with-terminate socket #\nul)))
-                  (loop (cons (u8list->u32 (string-buf->u8list (file-read socket 4)))
-                              yomi-len)
-                        (cons new-stdy rest-stdy)
-                        (cons new-kouho rest-kouho)))))))))
-
-(define (sj3-lib-cl2knj-cnt-euc socket stdy-size len yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8) $SJ3_CL2KNJ_CNT_EUC len yomi)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
-           (lambda (result)
-             result))))))
-
-(define (sj3-lib-clstudy-euc socket yomi1 yomi2 stdy)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8 u8list) $SJ3_CLSTUDY_EUC
-                            yomi1 yomi2 stdy)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
-   (lambda (result)
-     result)))
+  (let ((res (%sj3-lib-cl2knj-all-euc socket stdy-size len yomi)))
+    (and res
+         (apply values res))))
 
 
 ;;
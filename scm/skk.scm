@@ -349,7 +349,8 @@
     (list 'okuri	      '())
     (list 'appendix	      '())
     (list 'dcomp-word	      "")
-    ;(list 'candidates	      '())
+    ;; (key . vector) of the candidates paged in the candidate window
+    (list 'candidates	      '())
     (list 'nth		      0)
     (list 'nr-candidates      0)
     (list 'rk-context	      '())
@@ -578,16 +579,41 @@
     (let ((kana (skk-context-kana-mode sc)))
       (skk-get-string sc str kana))))
 
+(define skk-candidates-key
+  (lambda (sc)
+    (list (skk-make-string (skk-context-head sc) skk-type-hiragana)
+          (skk-context-okuri-head sc)
+          (skk-make-string (skk-context-okuri sc) skk-type-hiragana)
+          skk-use-numeric-conversion?)))
+
+;; Fetches all the candidates of the current conversion at once for
+;; the candidate window. Returns the number of them.
+(define skk-fetch-candidates!
+  (lambda (sc)
+    (let* ((key (skk-candidates-key sc))
+           (cands (list->vector
+                   (skk-lib-get-candidates skk-dic
+                                           (cons (car key) (cadr key))
+                                           (list-ref key 2)
+                                           (list-ref key 3)))))
+      (skk-context-set-candidates! sc (cons key cands))
+      (vector-length cands))))
+
 (define skk-get-nth-candidate
   (lambda (sc n)
-    (let* ((head (skk-context-head sc))
-    	   (cand (skk-lib-get-nth-candidate
-                  skk-dic
-                  n
-                  (cons (skk-make-string head skk-type-hiragana)
-                        (skk-context-okuri-head sc))
-                  (skk-make-string (skk-context-okuri sc) skk-type-hiragana)
-                  skk-use-numeric-conversion?)))
+    (let* ((key (skk-candidates-key sc))
+           (fetched (skk-context-candidates sc))
+           (cand (if (and (pair? fetched)
+                          (<= 0 n)
+                          (< n (vector-length (cdr fetched)))
+                          (equal? (car fetched) key))
+                     (vector-ref (cdr fetched) n)
+                     (skk-lib-get-nth-candidate
+                      skk-dic
+                      n
+                      (cons (car key) (cadr key))
+                      (list-ref key 2)
+                      (list-ref key 3)))))
       (if skk-show-annotation?
 	  cand
 	  (skk-lib-remove-annotation cand)))))
@@ -1665,14 +1691,7 @@
 	 (> (skk-context-nth sc) (- skk-candidate-op-count 2)))
 	(begin
 	  (skk-context-set-candidate-window! sc #t)
-	  (skk-context-set-nr-candidates!
-	   sc
-	   (skk-lib-get-nr-candidates
-            skk-dic
-            (skk-make-string (skk-context-head sc) skk-type-hiragana)
-            (skk-context-okuri-head sc)
-            (skk-make-string (skk-context-okuri sc) skk-type-hiragana)
-            skk-use-numeric-conversion?))
+	  (skk-context-set-nr-candidates! sc (skk-fetch-candidates! sc))
 	  (im-activate-candidate-selector
 	   sc
 	   (cond
@@ -1819,6 +1838,7 @@
 	(begin
 	  (im-deactivate-candidate-selector sc)
 	  (skk-context-set-candidate-window! sc #f)))
+    (skk-context-set-candidates! sc '())
     (skk-context-set-candidate-op-count! sc 0)))
 
 (define skk-back-to-kanji-state
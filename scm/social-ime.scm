@@ -33,7 +33,7 @@
 
 (require "ustr.scm")
 (require "japanese.scm")
-(require "http-client.scm")
+(require "http-async.scm")
 (require "generic-predict.scm")
 (require-custom "generic-key-custom.scm")
 (require-custom "social-ime-custom.scm")
@@ -77,21 +77,27 @@
                         col)))
             ret2))
 
-(define (social-ime-conversion str opts)
+(define (social-ime-conversion str opts . args)
   (define (make-query user)
         (format "~a?string=~a&charset=EUC-JP&applicartion=uim~a~a"
                 social-ime-path
                 (http:encode-uri-string str)
                 user
                 opts))
-  (let* ((user (if (string=? social-ime-user "")
-                   ""
-                   (format "&user=~a" (http:encode-uri-string social-ime-user))))
-         (proxy (make-http-proxy-from-custom))
-         (ret (http:get social-ime-server (make-query user) 80 proxy)))
-    (if (string? ret)
-        (social-ime-parse-csv ret)
-        (list (list str)))))
+  (let-optionals* args ((owner #f)
+                        (fetch http:async-get))
+    (let* ((user (if (string=? social-ime-user "")
+                     ""
+                     (format "&user=~a" (http:encode-uri-string social-ime-user))))
+           (proxy (make-http-proxy-from-custom))
+           (ret (fetch owner social-ime-server (make-query user) 80 proxy)))
+      (cond ((string? ret)
+             (social-ime-parse-csv ret))
+            ((and owner
+                  (http:async-requested? owner))
+             #f)
+            (else
+             (list (list str)))))))
 
 (define (social-ime-conversion-make-resize-query seg-cnts)
   (apply string-append
@@ -120,7 +126,9 @@
 (define (social-ime-send-commit str resize delta)
   (let ((ret (social-ime-conversion-make-commit-query resize delta)))
     (if (not (string=? ret ""))
-        (social-ime-conversion str ret))))
+        (social-ime-conversion str ret #f
+                               (lambda (owner . args)
+                                 (apply http:get args))))))
 (define (social-ime-predict-memoize! sc str cand)
   (let ((cache (social-ime-context-prediction-cache sc)))
     (social-ime-context-set-prediction-cache!
@@ -199,8 +207,8 @@
           (social-ime-internal-context-set-seg-cnts! sc-ctx next-seg-cnts)))
     #t))
 (define (social-ime-lib-begin-conversion sc str)
-  (let* ((cand (social-ime-conversion str ""))
-         (sc-ctx (social-ime-context-sc-ctx sc)))
+  (and-let* ((cand (social-ime-conversion str "" (http:async-owner sc)))
+             (sc-ctx (social-ime-context-sc-ctx sc)))
     (social-ime-internal-context-set-str! sc-ctx str)
     (social-ime-internal-context-set-candidates! sc-ctx cand)
     (social-ime-internal-context-set-seg-cnts!
@@ -656,6 +664,7 @@
     (social-ime-make-raw-string (social-ime-get-raw-str-seq sc) wide? upper?)))
 
 (define (social-ime-init-handler id im arg)
+  (im-set-delay-activating-handler! im social-ime-delay-activating-handler)
   (if social-ime-warn-connection?
     (let ((diff (string->number
 		  (difftime (time) social-ime-prev-warn-connection-time))))
@@ -672,7 +681,9 @@
 
 (define (social-ime-release-handler sc)
   (if sc
-      (social-ime-lib-release-context sc)))
+      (begin
+        (http:async-cancel! sc)
+        (social-ime-lib-release-context sc))))
 
 (define (social-ime-flush sc)
   (rk-flush (social-ime-context-rkc sc))
@@ -762,7 +773,10 @@
 		(social-ime-context-set-state! sc #t)
 		;; Don't perform rk-flush here. The rkc must be restored when
 		;; social-ime-cancel-conv invoked -- YamaKen 2004-10-25
-		))))))
+		)
+	      ;; the result is picked up by social-ime-delay-activating-handler
+	      (if (http:async-requested? sc)
+		  (http:async-watch sc)))))))
 
 (define social-ime-cancel-conv
   (lambda (sc)
@@ -1860,6 +1874,8 @@
       (social-ime-proc-input-state sc key key-state)))))
 
 (define (social-ime-press-key-handler sc key key-state)
+  ;; new input supersedes the conversion in flight
+  (http:async-cancel! sc)
   (if (ichar-control? key)
       (im-commit-raw sc)
       (if (social-ime-context-on sc)
@@ -1880,6 +1896,7 @@
       (social-ime-commit-raw sc)))
 ;;;
 (define (social-ime-reset-handler sc)
+  (http:async-cancel! sc)
   (if (social-ime-context-on sc)
       (begin
 	(if (social-ime-context-state sc)
@@ -1907,6 +1924,18 @@
   (if (not (social-ime-begin-input sc key key-state))
       (im-commit-raw sc)))
 
+;; Called by the bridge when the response watched in
+;; social-ime-begin-conv arrives.
+(define (social-ime-delay-activating-handler sc)
+  (http:async-poll sc)
+  (if (and (social-ime-context-on sc)
+           (not (social-ime-context-state sc))
+           (http:async-requested? sc))
+      (begin
+        (social-ime-begin-conv sc)
+        (social-ime-update-preedit sc)))
+  '(0 0 -1))
+
 (social-ime-configure-widgets)
 (register-im
  'social-ime
@@ -53,6 +53,13 @@
     (eval '(define trec-enable-reroutable-search? #f)
 	  (interaction-environment)))
 
+;; The native index (libuim-trec) speeds up descending string-keyed
+;; ruletrees. It is used transparently if available.
+(guard (err (else #f))
+  (require-dynlib "trec"))
+
+(define trec-native-available? (symbol-bound? 'trec-native-index!))
+
 
 ;;
 ;; generic utilities
@@ -97,7 +104,17 @@
       (trec-node-merge-ruleset! root key=? backward-match ruleset)
       (if (trec-node-val root)
 	  (error "root node cannot hold value")
-      root))))
+	  (begin
+	    (if (eq? key=? string=?)
+		(trec-native-register! root))
+	    root)))))
+
+;; .parameter root A ruletree returned by trec-parse-ruleset
+;; Call this when root is no longer used, so that the native index lets
+;; it be garbage collected. root must not be routed afterwards.
+(define trec-release-ruletree!
+  (lambda (root)
+    (trec-native-unregister! root)))
 
 
 ;;
@@ -171,6 +188,40 @@
       (fold merge! node ruleset))))
 
 
+;;
+;; native index
+;;
+
+;; Indexed ruletrees must be kept alive since the index refers them,
+;; until trec-native-unregister! drops their index.
+(define trec-native-ruletrees ())
+
+;; Nodes modified after registration are silently excluded from the
+;; index, and routed by the Scheme implementation.
+(define trec-native-register!
+  (lambda (root)
+    (and trec-native-available?
+	 (trec-native-index! root)
+	 (set! trec-native-ruletrees (cons root trec-native-ruletrees)))))
+
+(define trec-native-unregister!
+  (lambda (root)
+    (if (memq root trec-native-ruletrees)
+	(begin
+	  (trec-native-unindex! root)
+	  (set! trec-native-ruletrees
+		(remove-once (lambda (tree) (eq? tree root))
+			     trec-native-ruletrees))))))
+
+;; .returns (node . siblings) of the child matched with key, () if cands
+;; has no such child, or #f if cands is not indexed
+(define trec-native-descend
+  (if trec-native-available?
+      trec-native-lookup
+      (lambda (cands key)
+	#f)))
+
+
 ;;
 ;; trec-route
 ;;
@@ -330,7 +381,19 @@
 			(cons (cons (cons key (cdr node)) route)
 			      ()))
 		   (advance route rest key))))))
-    advance))
+    (if (and trec-native-available?
+	     (eq? match? string=?))
+	(lambda (route cands key)
+	  (let ((found (trec-native-descend cands key)))
+	    (cond
+	     ((pair? found)
+	      (cons (cons (car found) route)
+		    ()))
+	     ((null? found)
+	      #f)
+	     (else
+	      (advance route cands key)))))
+	advance)))
 
 (define trec-router-advance-with-fallback-new
   (lambda (base-router fallback-router)
@@ -354,22 +417,33 @@
 ;; TODO: simplify
 (define trec-router-std-advance-new
   (lambda (matcher)
+    (define native? (memq matcher trec-native-matchers))
     (define advance
       (lambda (route cands key)
 	(and (not (null? cands))
 	     (let ((node (car cands))
-		   (rest (cdr cands)))
-	       (or (if (trec-vnode? node)
-		       (node advance route matcher key)
-		       (and-let* ((matched (matcher (trec-node-key node) key))
-				  (new-node (trec-make-node node matched key))
-				  (advanced (cons (cons new-node rest)
-						  route)))
-			 (if (eq? matched TREC-MATCHER-RETRY)
-			     (advance advanced
-				      (trec-node-branches new-node) key)
-			     (cons advanced ()))))
-		   (advance route rest key))))))
+		   (rest (cdr cands))
+		   (found (and native?
+			       (trec-native-descend cands key))))
+	       (cond
+		;; (node . siblings) is also a reroutable route point
+		((pair? found)
+		 (cons (cons found route)
+		       ()))
+		((null? found)
+		 #f)
+		(else
+		 (or (if (trec-vnode? node)
+			 (node advance route matcher key)
+			 (and-let* ((matched (matcher (trec-node-key node) key))
+				    (new-node (trec-make-node node matched key))
+				    (advanced (cons (cons new-node rest)
+						    route)))
+			   (if (eq? matched TREC-MATCHER-RETRY)
+			       (advance advanced
+					(trec-node-branches new-node) key)
+			       (cons advanced ()))))
+		     (advance route rest key))))))))
     advance))
 
 
@@ -397,13 +471,20 @@
 
 (define trec-vkey? procedure?)
 
+;; std matchers that behave as string=? on plain keys
+(define trec-native-matchers ())
+
 (define trec-matcher-std-new
   (lambda (match?)
-    (lambda (key-exp key)
-      (if (trec-vkey? key-exp)
-	  (key-exp key-exp key)
-	  (and (match? key-exp key)
-	       TREC-MATCHER-FIN)))))
+    (let ((matcher (lambda (key-exp key)
+		     (if (trec-vkey? key-exp)
+			 (key-exp key-exp key)
+			 (and (match? key-exp key)
+			      TREC-MATCHER-FIN)))))
+      (if (and trec-native-available?
+	       (eq? match? string=?))
+	  (set! trec-native-matchers (cons matcher trec-native-matchers)))
+      matcher)))
 
 
 ;;
@@ -102,6 +102,13 @@
 (require "util.scm")
 (require-dynlib "look")
 
+;;; libuim-tutcode.soСθȽ黻CǹԤ
+(define tutcode-bushu-lib? (require-dynlib "tutcode"))
+
+;;; tutcode-lib-bushu-openɤ߹ȡΥե̾
+;;; (expand-filename index2-filename . )
+(define tutcode-bushu-lib-db ())
+
 ;;; #tξ硢¤ˤäƹʸͥ٤Ѥ
 (define tutcode-bushu-sequence-sensitive? #t)
 
@@ -125,6 +132,27 @@
 ;;; tutcode-bushu-for-charΥåhash-table
 (define tutcode-bushu-for-char-hash-table (make-hash-table =))
 
+;;; libuim-tutcode.soɤ߹bushu.expandbushu.index2μ֤
+;;; ե̾ѹƤɤ߹ľ
+;;; @return libuim-tutcode.so̵ɤ߹ʤä#f
+(define (tutcode-bushu-db)
+  (and tutcode-bushu-lib?
+    (begin
+      (if (not (and (pair? tutcode-bushu-lib-db)
+                    (equal? (car tutcode-bushu-lib-db)
+                            tutcode-bushu-expand-filename)
+                    (equal? (cadr tutcode-bushu-lib-db)
+                            tutcode-bushu-index2-filename)))
+        (begin
+          (if (and (pair? tutcode-bushu-lib-db) (cddr tutcode-bushu-lib-db))
+            (tutcode-lib-bushu-close (cddr tutcode-bushu-lib-db)))
+          (set! tutcode-bushu-lib-db
+            (cons tutcode-bushu-expand-filename
+              (cons tutcode-bushu-index2-filename
+                (tutcode-lib-bushu-open tutcode-bushu-expand-filename
+                  tutcode-bushu-index2-filename))))))
+      (cddr tutcode-bushu-lib-db))))
+
 ;;; ʸΥꥹȤȤ֤
 (define (tutcode-bushu-parse-entry str)
   (reverse! (string-to-list str)))
@@ -980,3 +1008,81 @@
                         (or res
                           (loop2 (cdr lis2))))))
                   (loop1 (cdr lis)))))))))))
+
+;;; libuim-tutcode.soСʲμ³CμƤ֡
+;;; Ȥ³ϡɤ߹ʤиSchemeμƤ֡
+(define tutcode-bushu-for-char
+  (let ((scm-proc tutcode-bushu-for-char))
+    (lambda (char)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-for-char db char)
+          (scm-proc char))))))
+
+(define tutcode-bushu-lookup-index2-entry-internal
+  (let ((scm-proc tutcode-bushu-lookup-index2-entry-internal))
+    (lambda (str)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-lookup-index2 db str)
+          (scm-proc str))))))
+
+(define tutcode-bushu-included-set?
+  (let ((scm-proc tutcode-bushu-included-set?))
+    (lambda (list1 list2)
+      (if tutcode-bushu-lib?
+        (tutcode-lib-bushu-included-set? list1 list2)
+        (scm-proc list1 list2)))))
+
+(define tutcode-bushu-char-list-for-bushu
+  (let ((scm-proc tutcode-bushu-char-list-for-bushu))
+    (lambda (bushu-list)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-char-list-for-bushu db bushu-list)
+          (scm-proc bushu-list))))))
+
+(define tutcode-bushu-intersection
+  (let ((scm-proc tutcode-bushu-intersection))
+    (lambda (list1 list2)
+      (if tutcode-bushu-lib?
+        (tutcode-lib-bushu-intersection list1 list2)
+        (scm-proc list1 list2)))))
+
+(define tutcode-bushu-complement-intersection
+  (let ((scm-proc tutcode-bushu-complement-intersection))
+    (lambda (list1 list2)
+      (if tutcode-bushu-lib?
+        (tutcode-lib-bushu-complement-intersection list1 list2)
+        (scm-proc list1 list2)))))
+
+(define tutcode-bushu-subtract-set
+  (let ((scm-proc tutcode-bushu-subtract-set))
+    (lambda (list1 list2)
+      (if tutcode-bushu-lib?
+        (tutcode-lib-bushu-subtract-set list1 list2)
+        (scm-proc list1 list2)))))
+
+(define tutcode-bushu-superset
+  (let ((scm-proc tutcode-bushu-superset))
+    (lambda (bushu-list)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-superset db bushu-list)
+          (scm-proc bushu-list))))))
+
+(define tutcode-bushu-all-compose-set
+  (let ((scm-proc tutcode-bushu-all-compose-set))
+    (lambda (char-list bushu-list)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-all-compose-set db char-list bushu-list)
+          (scm-proc char-list bushu-list))))))
+
+(define tutcode-bushu-subset
+  (let ((scm-proc tutcode-bushu-subset))
+    (lambda (bushu-list)
+      (let ((db (tutcode-bushu-db)))
+        (if db
+          (tutcode-lib-bushu-subset db bushu-list)
+          (scm-proc bushu-list))))))
@@ -412,6 +412,7 @@
 (require-custom "generic-key-custom.scm")
 (require-custom "tutcode-key-custom.scm")
 (require-custom "tutcode-rule-custom.scm");uim-prefɽΤ(tcode̵)
+(define tutcode-reverse-index-lib? (require-dynlib "tutcode")) ;հ
 (require-dynlib "skk") ;SKKθ򤼽񤭼θΤlibuim-skk.so
 (require "tutcode-bushudic.scm") ;Ѵ
 (require "tutcode-kigoudic.scm") ;ϥ⡼Ѥεɽ
@@ -448,14 +449,15 @@
 (define tutcode-rule ())
 ;;; 2ȥϥ⡼ѥɽ
 (define tutcode-kigou-rule ())
-;;; tutcode-rule롢հ(ǸꥹȤ)hash-table
+;;; tutcode-rule롢հ(ǸꥹȤ)Ѥ
+;;; (tutcode-rule . ǥå)tutcode-reverse-index
 ;;; (ưإѤѴ両ι®Τ)
 (define tutcode-reverse-rule-hash-table ())
-;;; tutcode-kigou-rule롢հhash-table
+;;; tutcode-kigou-rule롢հѤ(rule . ǥå)
 (define tutcode-reverse-kigou-rule-hash-table ())
 ;;; tutcode-bushudic롢
-;;; հ(ʸѤ2ʸ)hash-table
-;;; (ưإѤѴ両ι®ѡ٤)
+;;; հ(ʸѤ2ʸ)Ѥ(rule . ǥå)
+;;; (ưإѤѴ両ι®)
 (define tutcode-reverse-bushudic-hash-table ())
 ;;; stroke-helpǡ⥭Ϥ̵ɽƤalist
 ;;; ɽʤ~/.uim()ꤹ뤫
@@ -820,6 +822,9 @@
      (list 'nth 0)
      ;;; 򤼽Ѵθ
      (list 'nr-candidates 0)
+     ;;; 򤼽ѴɤߤȡΥ٥С
+     ;;; (䥦ɥΥڡڤؤǼ䤴Ȥ˰ʤ)
+     (list 'mazegaki-candidates #f)
      ;;; ַ򤼽ѴˡѴ˻ѤɤߤĹ
      ;;; (im-delete-text뤿˻)
      ;;; ַ()ַ(0)selection()Ƚˤѡ
@@ -1297,6 +1302,7 @@
       (tutcode-context-set-state! pc 'tutcode-state-on)) ; Ѵ֤򥯥ꥢ
     (tutcode-context-set-head! pc ())
     (tutcode-context-set-nr-candidates! pc 0)
+    (tutcode-context-set-mazegaki-candidates! pc #f)
     (tutcode-context-set-postfix-yomi-len! pc 0)
     (tutcode-context-set-mazegaki-yomi-len-specified! pc 0)
     (tutcode-context-set-mazegaki-yomi-all! pc ())
@@ -1313,15 +1319,30 @@
 ;;; @param pc ƥȥꥹ
 ;;; @param n оݤθֹ
 (define (tutcode-get-nth-candidate pc n)
-  (let* ((head (tutcode-context-head pc))
-         (cand (skk-lib-get-nth-candidate
-                tutcode-dic
-                n
-                (cons (string-list-concat head) "")
-                ""
-                #f)))
+  (let* ((yomi-str (string-list-concat (tutcode-context-head pc)))
+         (fetched (tutcode-context-mazegaki-candidates pc))
+         (cand (if (and fetched
+                        (<= 0 n)
+                        (< n (vector-length (cdr fetched)))
+                        (string=? (car fetched) yomi-str))
+                 (vector-ref (cdr fetched) n)
+                 (skk-lib-get-nth-candidate
+                  tutcode-dic
+                  n
+                  (cons yomi-str "")
+                  ""
+                  #f))))
     cand))
 
+;;; 򤼽Ѵ򼭽񤫤٤˼롣
+;;; @param yomi-str Ѵоݤɤ
+;;; @return 
+(define (tutcode-fetch-candidates! pc yomi-str)
+  (let ((cands (list->vector
+                (skk-lib-get-candidates tutcode-dic (cons yomi-str "") "" #f))))
+    (tutcode-context-set-mazegaki-candidates! pc (cons yomi-str cands))
+    (vector-length cands)))
+
 ;;; ϥ⡼ɻnܤθ֤
 ;;; @param n оݤθֹ
 (define (tutcode-get-nth-candidate-for-kigou-mode pc n)
@@ -1675,7 +1696,7 @@
     ((yomi-str (string-list-concat yomi))
      (res (and (symbol-bound? 'skk-lib-get-entry)
                (skk-lib-get-entry tutcode-dic yomi-str "" "" #f)
-               (skk-lib-get-nr-candidates tutcode-dic yomi-str "" "" #f))))
+               (tutcode-fetch-candidates! pc yomi-str))))
     (if res
       (begin
         (tutcode-context-set-head! pc yomi)
@@ -5618,12 +5639,85 @@
 ;;; @param c ʬоݤʸ
 ;;; @return ʬ򤷤ƤǤ2ĤΥꥹȡʬǤʤäȤ#f
 (define (tutcode-bushu-decompose c)
-  (if (null? tutcode-reverse-bushudic-hash-table)
-    (set! tutcode-reverse-bushudic-hash-table
-      (tutcode-rule->reverse-hash-table tutcode-bushudic)))
-  (let ((i (tutcode-euc-jp-string->ichar c)))
-    (and i
-      (hash-table-ref/default tutcode-reverse-bushudic-hash-table i #f))))
+  (set! tutcode-reverse-bushudic-hash-table
+    (tutcode-reverse-index tutcode-reverse-bushudic-hash-table
+      tutcode-bushudic))
+  (tutcode-reverse-index-ref tutcode-reverse-bushudic-hash-table c))
+
+;;; եι֤
+;;; @param filename ե̾Хѥξuimscmǥ쥯ȥ꤫õ
+;;; @return ե뤬̵#f
+(define (tutcode-file-mtime filename)
+  (let ((path
+          (if (and (> (string-length filename) 0)
+                   (string=? (substring filename 0 1) "/"))
+            filename
+            (string-append (sys-pkgdatadir) "/" filename))))
+    (and (file-readable? path)
+      (file-mtime path))))
+
+;;; ~/.uimι֤(ɽľѹƤ礬뤿)
+;;; @return ե뤬̵#f
+(define (tutcode-user-conf-mtime)
+  (let ((home-dir (home-directory (user-name))))
+    (tutcode-file-mtime
+      (or (getenv "LIBUIM_USER_SCM_FILE")
+          (string-append (or home-dir "") "/.uim")))))
+
+;;; հѥǥåΥåΥˤ롢ruleνн֤
+;;; ruleƤ¸롢ɽΥեȤι
+;;; ޥ¤٤ꥹȡruleƤɤ餺˺Ѥ褦ˡ
+;;; libuim-tutcode.soϤǥåõ
+;;; @param rule tutcode-ruleΥꥹ
+;;; @return ("" ...)н꤬狼ʤruleξ#f
+(define (tutcode-reverse-index-source rule)
+  (cond
+    ((eq? rule tutcode-rule)
+      (list "rule" tutcode-rule-filename
+        (tutcode-file-mtime tutcode-rule-filename)
+        tutcode-use-dvorak? tutcode-rule-userconfig
+        (tutcode-user-conf-mtime)))
+    ((eq? rule tutcode-kigou-rule)
+      (list "kigou-rule" tutcode-candidate-window-table-layout
+        (tutcode-file-mtime "tutcode-kigou-rule.scm")
+        (tutcode-user-conf-mtime)))
+    ((eq? rule tutcode-bushudic)
+      (list "bushudic"
+        (tutcode-file-mtime "tutcode-bushudic.scm")
+        (tutcode-user-conf-mtime)))
+    (else #f)))
+
+;;; tutcode-ruleΥꥹȤ顢հѥǥå롣
+;;; libuim-tutcode.soФǺ(~/.uim.d/tutcode/ruleνнꤴȤ
+;;; å夵졢󤫤mmap)
+;;; ʤ(ޤϽн꤬狼ʤruleʤ)hash-table롣
+;;; cacheruleȰۤʤruleϤ줿(ޥ)ľ
+;;; @param cache (rule . ǥå)̤ξ()
+;;; @param rule tutcode-ruleΥꥹ
+;;; @return (rule . ǥå)
+(define (tutcode-reverse-index cache rule)
+  (if (and (pair? cache) (eq? (car cache) rule))
+    cache
+    (let ((source
+            (and tutcode-reverse-index-lib?
+              (tutcode-reverse-index-source rule))))
+      (if (and (pair? cache) (not (hash-table? (cdr cache))))
+        (tutcode-lib-reverse-index-close (cdr cache)))
+      (cons rule
+        (if source
+          (tutcode-lib-reverse-index-open rule source)
+          (tutcode-rule->reverse-hash-table rule))))))
+
+;;; հѥǥå򸡺롣
+;;; @param cache tutcode-reverse-index֤(rule . ǥå)
+;;; @param c ʸ
+;;; @return cбǸꥹ(ޤΥꥹ)Ĥʤ#f
+(define (tutcode-reverse-index-ref cache c)
+  (if (hash-table? (cdr cache))
+    (let ((i (tutcode-euc-jp-string->ichar c)))
+      (and i
+        (hash-table-ref/default (cdr cache) i #f)))
+    (tutcode-lib-reverse-index-lookup (cdr cache) c)))
 
 ;;; tutcode-ruleΥꥹȤ顢հ(ǸꥹȤ)Ѥ
 ;;; hash-table
@@ -5948,22 +6042,15 @@
 ;;; @return ϥΥꥹȡtutcode-rulecĤʤä#f
 (define (tutcode-reverse-find-seq c rule)
   (and (string? c)
-    (let*
-      ((hash-table
-        (if (eq? rule tutcode-kigou-rule)
-          (begin
-            (if (null? tutcode-reverse-kigou-rule-hash-table)
-              (set! tutcode-reverse-kigou-rule-hash-table
-                (tutcode-rule->reverse-hash-table rule)))
-            tutcode-reverse-kigou-rule-hash-table)
-          (begin
-            (if (null? tutcode-reverse-rule-hash-table)
-              (set! tutcode-reverse-rule-hash-table
-                (tutcode-rule->reverse-hash-table rule)))
-            tutcode-reverse-rule-hash-table)))
-       (i (tutcode-euc-jp-string->ichar c)))
-      (and i
-        (hash-table-ref/default hash-table i #f)))))
+    (if (eq? rule tutcode-kigou-rule)
+      (begin
+        (set! tutcode-reverse-kigou-rule-hash-table
+          (tutcode-reverse-index tutcode-reverse-kigou-rule-hash-table rule))
+        (tutcode-reverse-index-ref tutcode-reverse-kigou-rule-hash-table c))
+      (begin
+        (set! tutcode-reverse-rule-hash-table
+          (tutcode-reverse-index tutcode-reverse-rule-hash-table rule))
+        (tutcode-reverse-index-ref tutcode-reverse-rule-hash-table c)))))
 
 ;;; ߤstatepreeditĤɤ֤
 ;;; @param pc ƥȥꥹ
@@ -54,6 +54,7 @@
 				    (and-let* ((expr (safe-car args)))
 				      (set! uim-sh-opt-arg-expression expr)
 				      (safe-cdr args))))
+    (("--stat")                . stat)
     (("-V" "--version")        . version)
     (("-h" "--help")           . help)))
 
@@ -68,6 +69,7 @@
   -r <name>
   --require-module <name> require module
   --editline              require editline module for Emacs-like line editing
+  --stat                  print heap parameters and key handling time on exit
   -e <expr>
   --expression <expr>     evaluate <expr> (after loading the file, and disables
                           'main' procedure of it)
@@ -84,6 +86,13 @@
     (format #t "uim-sh ~a [SigScheme ~a]" (uim-version) (sscm-version))
     (newline)))
 
+(define uim-sh-display-stat
+  (lambda ()
+    (for-each (lambda (ent)
+		(format #t "~a: ~a" (car ent) (cdr ent))
+		(newline))
+	      (scm-stat))))
+
 (define uim-sh-define-opt-vars
   (lambda (opt-table prefix)
     (for-each (lambda (name)
@@ -145,41 +154,45 @@
 			read))
 	   (EX_OK       0)
 	   (EX_SOFTWARE 70))
-      (cond
-       (uim-sh-opt-help
-	(uim-sh-usage)
-	EX_OK)
-
-       (uim-sh-opt-version
-	(uim-sh-display-version)
-	EX_OK)
-
-       (uim-sh-opt-expression
-	(let* ((expr (read (open-input-string uim-sh-opt-arg-expression)))
-	       (result (eval expr (interaction-environment))))
-	  (if (not uim-sh-opt-strict-batch)
-	      (begin
-		(write result)
-		(newline)))
-	  EX_OK))
-
-       (script
-	(require script)
-	(if (symbol-bound? 'main)
-	    (let ((status (main file.args)))
-	      (if (integer? status)
-		  status
-		  EX_SOFTWARE))
-	    EX_OK))
-
-       (else
-	(let reloop ()
-	  (and (guard (err (else
-			    (%%inspect-error err)
-			    #t))
-		 (uim-sh-loop my-read))
-	       (reloop)))
-	EX_OK)))))
+      (let ((status
+	     (cond
+	      (uim-sh-opt-help
+	       (uim-sh-usage)
+	       EX_OK)
+
+	      (uim-sh-opt-version
+	       (uim-sh-display-version)
+	       EX_OK)
+
+	      (uim-sh-opt-expression
+	       (let* ((expr (read (open-input-string uim-sh-opt-arg-expression)))
+		      (result (eval expr (interaction-environment))))
+		 (if (not uim-sh-opt-strict-batch)
+		     (begin
+		       (write result)
+		       (newline)))
+		 EX_OK))
+
+	      (script
+	       (require script)
+	       (if (symbol-bound? 'main)
+		   (let ((status (main file.args)))
+		     (if (integer? status)
+			 status
+			 EX_SOFTWARE))
+		   EX_OK))
+
+	      (else
+	       (let reloop ()
+		 (and (guard (err (else
+				   (%%inspect-error err)
+				   #t))
+			(uim-sh-loop my-read))
+		      (reloop)))
+	       EX_OK))))
+	(if uim-sh-opt-stat
+	    (uim-sh-display-stat))
+	status))))
 
 ;; Verbose level must be greater than or equal to 1 to print anything.
 (if (< (verbose) 1)
@@ -33,7 +33,7 @@
 
 (require "ustr.scm")
 (require "japanese.scm")
-(require "http-client.scm")
+(require "http-async.scm")
 (require "generic-predict.scm")
 (require "util.scm")
 (require-custom "generic-key-custom.scm")
@@ -62,7 +62,7 @@
 (define-record 'yahoo-jp-internal-context yahoo-jp-internal-context-rec-spec)
 (define yahoo-jp-internal-context-new-internal yahoo-jp-internal-context-new)
 
-(define (yahoo-jp-conversion str opts)
+(define (yahoo-jp-conversion str opts . args)
   (define (fromconv str)
     (iconv-convert "UTF-8" "EUC-JP" str))
   (define (toconv str)
@@ -105,18 +105,24 @@
       (xml-parser-free parser)
       (cons seg candidate)))
 
-  (let* ((appid (if (string=? yahoo-jp-appid "")
-                    (begin (uim-notify-fatal (N_ "Please regist Api key from <a href='http://developer.yahoo.co.jp/'>developer network</a> and set value on advanced menu."))
-                           #f)
-                    yahoo-jp-appid))
-         (proxy (make-http-proxy-from-custom))
-         (ssl (and yahoo-jp-use-ssl?
-                   (make-http-ssl (SSLv3-client-method) 443)))
-         (ret (and appid
-                   (http:get yahoo-jp-server (make-query appid) 80 proxy ssl))))
-    (if (string? ret)
-        (parse ret)
-        (cons '() (list (list str))))))
+  (let-optionals* args ((owner #f))
+    (let* ((appid (if (string=? yahoo-jp-appid "")
+                      (begin (uim-notify-fatal (N_ "Please regist Api key from <a href='http://developer.yahoo.co.jp/'>developer network</a> and set value on advanced menu."))
+                             #f)
+                      yahoo-jp-appid))
+           (proxy (make-http-proxy-from-custom))
+           (ssl (and yahoo-jp-use-ssl?
+                     (make-http-ssl (SSLv3-client-method) 443)))
+           (ret (and appid
+                     (http:async-get owner yahoo-jp-server (make-query appid)
+                                     80 proxy ssl))))
+      (cond ((string? ret)
+             (parse ret))
+            ((and owner
+                  (http:async-requested? owner))
+             #f)
+            (else
+             (cons '() (list (list str))))))))
 
 (define (yahoo-jp-predict-memoize! yc str cand)
   (let ((cache (yahoo-jp-context-prediction-cache yc)))
@@ -225,10 +231,11 @@
           (yahoo-jp-internal-context-set-yomi-seg! yx-ctx replace-yomi-seg)))
     #t))
 (define (yahoo-jp-lib-begin-conversion yc str)
-  (let* ((yomi-seg-and-cand (yahoo-jp-conversion str ""))
-         (yomi-seg (car yomi-seg-and-cand))
-         (cand (cdr yomi-seg-and-cand))
-         (yx-ctx (yahoo-jp-context-yx-ctx yc)))
+  (and-let* ((yomi-seg-and-cand (yahoo-jp-conversion
+                                 str "" (http:async-owner yc)))
+             (yomi-seg (car yomi-seg-and-cand))
+             (cand (cdr yomi-seg-and-cand))
+             (yx-ctx (yahoo-jp-context-yx-ctx yc)))
     (yahoo-jp-internal-context-set-yomi-seg! yx-ctx yomi-seg)
     (yahoo-jp-internal-context-set-candidates! yx-ctx cand)
     (length cand)))
@@ -676,6 +683,7 @@
     (yahoo-jp-make-raw-string (yahoo-jp-get-raw-str-seq yc) wide? upper?)))
 
 (define (yahoo-jp-init-handler id im arg)
+  (im-set-delay-activating-handler! im yahoo-jp-delay-activating-handler)
   (if (not yahoo-jp-init-lib-ok?)
       (begin
 	(yahoo-jp-lib-init)
@@ -684,7 +692,9 @@
 
 (define (yahoo-jp-release-handler yc)
   (if yc
-      (yahoo-jp-lib-release-context yc)))
+      (begin
+        (http:async-cancel! yc)
+        (yahoo-jp-lib-release-context yc))))
 
 (define (yahoo-jp-flush yc)
   (rk-flush (yahoo-jp-context-rkc yc))
@@ -774,7 +784,10 @@
 		(yahoo-jp-context-set-state! yc #t)
 		;; Don't perform rk-flush here. The rkc must be restored when
 		;; yahoo-jp-cancel-conv invoked -- YamaKen 2004-10-25
-		))))))
+		)
+	      ;; the result is picked up by yahoo-jp-delay-activating-handler
+	      (if (http:async-requested? yc)
+		  (http:async-watch yc)))))))
 
 (define yahoo-jp-cancel-conv
   (lambda (yc)
@@ -1871,6 +1884,8 @@
       (yahoo-jp-proc-input-state yc key key-state)))))
 
 (define (yahoo-jp-press-key-handler yc key key-state)
+  ;; new input supersedes the conversion in flight
+  (http:async-cancel! yc)
   (if (ichar-control? key)
       (im-commit-raw yc)
       (if (yahoo-jp-context-on yc)
@@ -1891,6 +1906,7 @@
       (yahoo-jp-commit-raw yc)))
 ;;;
 (define (yahoo-jp-reset-handler yc)
+  (http:async-cancel! yc)
   (if (yahoo-jp-context-on yc)
       (begin
 	(if (yahoo-jp-context-state yc)
@@ -1918,6 +1934,18 @@
   (if (not (yahoo-jp-begin-input yc key key-state))
       (im-commit-raw yc)))
 
+;; Called by the bridge when the response watched in
+;; yahoo-jp-begin-conv arrives.
+(define (yahoo-jp-delay-activating-handler yc)
+  (http:async-poll yc)
+  (if (and (yahoo-jp-context-on yc)
+           (not (yahoo-jp-context-state yc))
+           (http:async-requested? yc))
+      (begin
+        (yahoo-jp-begin-conv yc)
+        (yahoo-jp-update-preedit yc)))
+  '(0 0 -1))
+
 (yahoo-jp-configure-widgets)
 (register-im
  'yahoo-jp
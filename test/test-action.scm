@@ -239,6 +239,13 @@
       (define im-update-prop-list
         (lambda (context message)
           (set! test-prop-list message)))
+      (define test-prop-state #f)
+      ;; whether the bridge takes prop_state_update
+      (define test-prop-state-supported? #f)
+      (define im-update-prop-state
+        (lambda (context state)
+          (set! test-prop-state state)
+          test-prop-state-supported?))
 
       (define test-mode-list ())
       (define test-updated-mode-list ())
@@ -1668,6 +1675,12 @@
                      "leaf\tfigure_ja_roma\tＲ\tローマ字\tローマ字入力モード\taction_test_roma\t*\n"
                      "leaf\tfigure_ja_kana\tか\tかな\tかな入力モード\taction_test_kana\t\n")
                     'test-prop-list)
+  (assert-uim-equal (string-append
+                     "branch\tfigure_ja_katakana\tア\tカタカナ\n"
+                     "active\taction_test_katakana\n"
+                     "branch\tfigure_ja_roma\tＲ\tローマ字\n"
+                     "active\taction_test_roma\n")
+                    'test-prop-state)
   (assert-uim-false 'test-prop-label)
   (assert-uim-equal 1
                     'test-updated-mode)
@@ -1709,9 +1722,24 @@
       (context-propagate-widget-states tc)))
   (assert-uim-equal "branch\tunknown\t?\tunknown\n"
                     'test-prop-list)
+  (assert-uim-equal "branch\tunknown\t?\tunknown\nactive\t\n"
+                    'test-prop-state)
   (assert-uim-false 'test-prop-label)
   (assert-uim-equal 0
                     'test-updated-mode)
+  ;; the full list is not composed for a bridge taking the states
+  (uim-eval
+   '(begin
+      (context-init-widgets! tc '(widget_test_kana_input_method))
+      (set! test-prop-state-supported? #t)
+      (set! test-prop-list #f)
+      (context-propagate-widget-states tc)
+      (set! test-prop-state-supported? #f)))
+  (assert-uim-false 'test-prop-list)
+  (assert-uim-equal (string-append
+                     "branch\tfigure_ja_roma\tＲ\tローマ字\n"
+                     "active\taction_test_roma\n")
+                    'test-prop-state)
   #f)
 
 (define (test-context-propagate-widget-configuration)
@@ -124,6 +124,7 @@
       (define im-pushback-preedit (lambda arg #f))
       (define im-update-preedit (lambda arg #f))
       (define im-update-prop-list (lambda arg #f))
+      (define im-update-prop-state (lambda arg #f))
       (define im-clear-mode-list (lambda arg #f))
       (define im-pushback-mode-list (lambda arg #f))
       (define im-update-mode-list (lambda arg #f))
@@ -0,0 +1,94 @@
+;;  bench-trec.scm: Benchmark for trec.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+
+
+;; Per-keystroke preedit cost of anthy-utf8 before and after the kana
+;; tables were made UTF-8 native. Each keystroke of a long romaji sentence
+;; goes through rk, and the whole preedit is rebuilt as anthy-utf8 does on
+;; every update. The old route converted the EUC-JP result with iconv; the
+;; new one uses the UTF-8 table as is. Run as:
+;;
+;;   $ sh test2/run-singletest.sh bench-anthy-utf8.scm
+
+(require "rk.scm")
+(require "japanese.scm")
+(require "japanese-utf8.scm")
+
+(define bench-anthy-utf8-iterations 20)
+
+(define bench-anthy-utf8-sentence
+  (string-append
+   "kyouhatotemoiitenkidesitanode,tomodatitoissyonikouennidekakete"
+   "bentouwotabemasita.kaerinihahonnyanisuwotteatarasiihonwokaimasita."))
+
+(define bench-anthy-utf8-keys
+  (map (lambda (c) (list->string (list c)))
+       (string->list bench-anthy-utf8-sentence)))
+
+(define bench-anthy-utf8-type
+  (lambda (rule preedit-proc)
+    (let ((rkc (rk-context-new rule #t #f)))
+      (let loop ((keys bench-anthy-utf8-keys)
+		 (kana '()))
+	(if (null? keys)
+	    (length kana)
+	    (let* ((res (rk-push-key! rkc (car keys)))
+		   (kana (if (and res
+				  (not (list? (car res)))
+				  (not (string=? (car res) "")))
+			     (cons (car res) kana)
+			     kana)))
+	      (preedit-proc (string-append
+			     (apply string-append (reverse kana))
+			     (rk-pending rkc)))
+	      (loop (cdr keys) kana)))))))
+
+(define bench-anthy-utf8-run
+  (lambda (name rule preedit-proc)
+    (let ((start (time)))
+      (let loop ((n bench-anthy-utf8-iterations))
+	(if (> n 0)
+	    (begin
+	      (bench-anthy-utf8-type rule preedit-proc)
+	      (loop (- n 1)))))
+      (display (string-append name ": "
+			      (difftime (time) start)
+			      " sec ("
+			      (number->string
+			       (* bench-anthy-utf8-iterations
+				  (length bench-anthy-utf8-keys)))
+			      " keystrokes)\n")))))
+
+(bench-anthy-utf8-run "EUC-JP tables + iconv" ja-rk-rule
+		      (lambda (str)
+			(iconv-convert "UTF-8" "EUC-JP" str)))
+(bench-anthy-utf8-run "UTF-8 tables" (ja-utf8-table 'ja-rk-rule)
+		      (lambda (str)
+			str))
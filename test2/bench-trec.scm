@@ -0,0 +1,92 @@
+;;  bench-trec.scm: Benchmark for trec.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+;; Benchmark of trec routing on the Japanese kana rulesets, with and
+;; without the native index. Run as:
+;;
+;;   $ sh test2/run-singletest.sh bench-trec.scm
+
+(require "trec.scm")
+(require "japanese.scm")
+(require "japanese-azik.scm")
+
+(define bench-trec-iterations 200)
+
+;; (((path) . ()) kana) -> ((path) . kana)
+(define bench-trec-rk-rule->trec-rule
+  (lambda (rule)
+    (trec-rule-new (caar rule) (cadr rule))))
+
+;; (sec . usec) pairs of clock-monotonic -> msec
+(define bench-trec-elapsed-msec
+  (lambda (start end)
+    (quotient (+ (* (- (car end) (car start)) 1000000)
+		 (- (cdr end) (cdr start)))
+	      1000)))
+
+(define bench-trec-run
+  (lambda (name ruleset router)
+    (let* ((rules (map bench-trec-rk-rule->trec-rule ruleset))
+	   (tree (trec-parse-ruleset string=? #f rules))
+	   (initial (trec-route-new tree))
+	   (paths (map trec-rule-path rules))
+	   (start (clock-monotonic)))
+      (let loop ((n bench-trec-iterations))
+	(if (> n 0)
+	    (begin
+	      (for-each (lambda (path)
+			  (trec-route-route initial router path))
+			paths)
+	      (loop (- n 1)))))
+      (display (string-append name ": "
+			      (number->string
+			       (bench-trec-elapsed-msec start
+							(clock-monotonic)))
+			      " msec ("
+			      (number->string
+			       (* bench-trec-iterations (length paths)))
+			      " paths)\n"))
+      (trec-release-ruletree! tree))))
+
+(define bench-trec-scheme-router
+  ;; not eq? to string=?, so that the native index is never consulted
+  (trec-router-vanilla-advance-new (lambda (x y) (string=? x y))))
+(define bench-trec-native-router
+  (trec-router-vanilla-advance-new string=?))
+
+(if (not trec-native-available?)
+    (display "libuim-trec is not available\n"))
+
+(bench-trec-run "ja-rk-rule (scheme)" ja-rk-rule bench-trec-scheme-router)
+(bench-trec-run "ja-rk-rule (native)" ja-rk-rule bench-trec-native-router)
+(bench-trec-run "ja-azik-rule (scheme)" ja-azik-rule bench-trec-scheme-router)
+(bench-trec-run "ja-azik-rule (native)" ja-azik-rule bench-trec-native-router)
@@ -0,0 +1,115 @@
+;;  test-fileio.scm: Unit tests for fileio.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+(require-extension (unittest))
+
+(require "fileio.scm")
+
+(set! *test-track-progress* #f)
+
+(test-begin "byte-buffer")
+(define buf (make-byte-buffer))
+(test-equal 0 (byte-buffer-length buf))
+(test-equal 5 (byte-buffer-append! buf "hello"))
+(test-equal 8 (byte-buffer-append! buf '(#\space 119 #\o)))
+(test-equal 104 (byte-buffer-ref buf 0))
+(test-false (byte-buffer-ref buf 8))
+(test-equal 2 (byte-buffer-index buf "llo" 0))
+(test-equal 7 (byte-buffer-index buf #\o 5))
+(test-false (byte-buffer-index buf #\z 0))
+(test-equal "hello wo" (byte-buffer->string buf))
+(test-equal "hel" (byte-buffer-take-string! buf 3))
+(test-equal '(108 111) (byte-buffer-take-u8list! buf 2))
+(test-equal 2 (byte-buffer-drop! buf 1))
+(test-equal "wo" (byte-buffer-take-string! buf 10))
+(test-equal 0 (byte-buffer-length buf))
+(test-end)
+
+(test-begin "byte-buffer pack")
+(test-equal 13 (byte-buffer-pack! buf '(u8 u16 u32 s8 s16)
+                                  '(1 515 67305985 "ab" "c")))
+(test-equal '(1 2 3 4 3 2 1 97 98 0 99 0 0)
+            (byte-buffer-take-u8list! buf 13))
+(test-equal '() (byte-buffer-unpack! buf '()))
+(byte-buffer-clear! buf)
+(byte-buffer-pack! buf '(u32 s8 u16list) '(305419896 "xyz" (1 258)))
+(test-equal '(305419896 "xyz" 1 258)
+            (byte-buffer-unpack! buf '(u32 s8 u16 u16)))
+(test-equal 0 (byte-buffer-length buf))
+;; not enough data
+(byte-buffer-append! buf '(0 1 2))
+(test-false (byte-buffer-unpack! buf '(u32)))
+(test-equal 3 (byte-buffer-length buf))
+(test-equal '(1 (2)) (byte-buffer-unpack! buf '(u16 u8list)))
+(byte-buffer-append! buf '(0 1 1 2 3 4 5))
+(test-equal '(1 (258 772)) (byte-buffer-unpack! buf '(u16 u16list)))
+;; an odd byte is left
+(test-equal 1 (byte-buffer-length buf))
+(byte-buffer-free! buf)
+(test-end)
+
+(test-begin "file-read-until")
+(define pipe (create-pipe))
+(file-write (cdr pipe) (string->list "abc\r\ndef"))
+(file-write (cdr pipe) (list #\x (integer->char 0) #\y))
+(file-close (cdr pipe))
+(test-equal "abc" (file-read-until (car pipe) "\r\n"))
+(test-equal "defx" (file-read-string-with-terminate (car pipe) #\nul))
+(test-equal '(121) (file-read-u8list (car pipe) 10))
+(test-true  (eof-object? (file-read-until (car pipe) #\newline)))
+(file-close (car pipe))
+(test-end)
+
+(test-begin "file-port")
+(define pipe (create-pipe))
+(file-write (cdr pipe) (string->list "first line\nsecond\nrest"))
+(file-close (cdr pipe))
+(define port (open-file-port (car pipe)))
+(test-equal #\f (file-peek-char port))
+(test-equal #\f (file-read-char port))
+(test-equal "irst line" (file-read-line port))
+(test-equal "sec" (file-read-buffer port 3))
+(test-equal "ond" (file-read-line port))
+(test-equal "rest" (file-get-buffer port))
+(test-equal "rest" (file-read-line port))
+(test-true  (eof-object? (file-read-line port)))
+(test-true  (eof-object? (file-read-buffer port 3)))
+(close-file-port port)
+(test-false (inbuf? port))
+;; short at the end of the input
+(define pipe (create-pipe))
+(file-write (cdr pipe) (string->list "ab"))
+(file-close (cdr pipe))
+(define port (open-file-port (car pipe)))
+(test-equal "ab" (file-read-buffer port 3))
+(close-file-port port)
+(test-end)
@@ -0,0 +1,345 @@
+;;  test-http-async.scm: Unit tests for http-async.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(require "http-async.scm")
+(require "http-server.scm")
+
+(set! *test-track-progress* #f)
+
+;; customs referred by http-client.scm and http-async.scm
+(define http-proxy-setting 'direct)
+(define http-timeout 3000)
+(define http-use-async? #t)
+(define http-cache-size 8)
+
+(define test-host "127.0.0.1")
+
+;; the workers run the uim-sh under test
+(set! http-async-worker-command (getenv "UIM_SH"))
+
+;; A local stand-in for the web conversion servers. It counts the
+;; requests it has served.
+(define test-server (make-http-server))
+(let ((count 0))
+  (http-server-regist-resource! test-server "/hello"
+                                (lambda (resource header body)
+                                  "hello, world"))
+  (http-server-regist-resource! test-server "/count"
+                                (lambda (resource header body)
+                                  (set! count (+ count 1))
+                                  (number->string count)))
+  (http-server-regist-resource! test-server "/slow"
+                                (lambda (resource header body)
+                                  (sleep 1)
+                                  "slow"))
+  (http-server-regist-resource! test-server "/quit"
+                                (lambda (resource header body)
+                                  (_exit 0))))
+
+;; Keep-alive resources for the connection pool of http-client.scm
+(let ((count 0))
+  (http-server-regist-persistent-resource! test-server "/keep"
+                                           (lambda (resource header body)
+                                             (set! count (+ count 1))
+                                             (number->string count)))
+  (http-server-regist-persistent-resource! test-server "/chunked"
+                                           (lambda (resource header body)
+                                             '("hello, " "chunked " "world")))
+  ;; the server drops the request which follows on the connection
+  (http-server-regist-persistent-resource! test-server "/drop-close"
+                                           (lambda (resource header body)
+                                             (http-server-set-drop-next! test-server 'close)
+                                             "close next"))
+  (http-server-regist-persistent-resource! test-server "/drop-reset"
+                                           (lambda (resource header body)
+                                             (http-server-set-drop-next! test-server 'reset)
+                                             "reset next")))
+
+;; Returns the first port from 18569 on which nothing listens, with
+;; the listening sockets.
+(define (test-listen)
+  (let loop ((port 18569))
+    (let ((socks (tcp-listen test-host port)))
+      (if (null? socks)
+          (loop (+ port 1))
+          (cons port socks)))))
+
+;; The server listens before the fork, so it accepts the first request
+;; without waiting for the child to start.
+(define test-port
+  (let ((port.socks (test-listen)))
+    (http-server-set-sockets! test-server (cdr port.socks))
+    (car port.socks)))
+
+(define test-server-pid
+  (let ((pid (process-fork)))
+    (if (= pid 0)
+        (begin
+          (http-server-serve test-server)
+          (_exit 0))
+        (begin
+          (for-each file-close (http-server-sockets test-server))
+          pid))))
+
+;; a port nobody listens on
+(define test-dead-port
+  (let ((port.socks (test-listen)))
+    (for-each file-close (cdr port.socks))
+    (car port.socks)))
+
+(define (test-wait-pending)
+  (let loop ((n 0))
+    (if (and (< n 50)
+             (not (null? http-async-pending)))
+        (begin
+          (file-ready? (map http-async-request-fd http-async-pending) 100)
+          (http:async-poll)
+          (loop (+ n 1))))))
+
+(define owner-a (list 'owner-a))
+(define owner-b (list 'owner-b))
+
+(test-begin "http:async-request")
+(test-false (http:async-request owner-a test-host "/hello" test-port))
+(test-true  (http:async-requested? owner-a))
+(test-false (http:async-requested? owner-b))
+(test-wait-pending)
+(test-true  (http:async-requested? owner-a))
+(test-equal "hello, world"
+            (http:async-request owner-a test-host "/hello" test-port))
+(test-false (http:async-requested? owner-a))
+(test-end)
+
+(test-begin "http:async-cancel!")
+(test-false (http:async-request owner-a test-host "/slow" test-port))
+(http:async-cancel! owner-a)
+(test-false (http:async-requested? owner-a))
+(test-wait-pending)
+;; the superseded response still fills the cache
+(test-false (http:async-requested? owner-a))
+(test-equal "slow"
+            (http:async-request owner-b test-host "/slow" test-port))
+(test-end)
+
+(test-begin "cache")
+(http:async-cache-clear!)
+(test-false (http:async-request owner-a test-host "/count" test-port))
+(test-wait-pending)
+(test-equal "1" (http:async-request owner-a test-host "/count" test-port))
+(test-equal "1" (http:get-cached test-host "/count" test-port))
+(test-equal "1" (http:async-get #f test-host "/count" test-port))
+(http:async-cache-clear!)
+(test-equal "2" (http:get-cached test-host "/count" test-port))
+(test-end)
+
+(test-begin "http:get-cached joins a request in flight")
+(http:async-cache-clear!)
+(test-false (http:async-request owner-a test-host "/count" test-port))
+(test-equal "3" (http:get-cached test-host "/count" test-port))
+(test-true  (null? http-async-pending))
+(test-end)
+
+;; A stand-in for the bridges, which keep one fd watch per context.
+(define test-watches '())
+(set! http-async-watch-fd
+      (lambda (c fd)
+        (set! test-watches (remove (lambda (w)
+                                     (eq? (car w) c))
+                                   test-watches))
+        (if (<= 0 fd)
+            (set! test-watches (cons (cons c fd) test-watches)))))
+
+(define (test-watched? c)
+  (and (assq c test-watches)
+       #t))
+
+;; An IM which issues requests in its key handler and takes the
+;; response in its delay-activating-handler, as ajax-ime.scm does.
+(define test-paths '())
+(define test-results '())
+
+(define (test-request c path)
+  (set! test-paths (cons (cons c path)
+                         (remove (lambda (ent)
+                                   (eq? (car ent) c))
+                                 test-paths)))
+  (let ((body (http:async-request c test-host path
+                                  (if (equal? path "/dead")
+                                      test-dead-port
+                                      test-port))))
+    (if body
+        (set! test-results (cons (cons c body) test-results))
+        (if (http:async-requested? c)
+            (http:async-watch c)))
+    body))
+
+(define (test-delay-activating-handler c)
+  (http:async-poll c)
+  (if (http:async-requested? c)
+      (test-request c (cdr (assq c test-paths)))))
+
+;; The event loop of the bridge. A watch is removed when it has fired.
+(define (test-run-watches)
+  (let loop ((n 0))
+    (if (and (< n 100)
+             (not (null? test-watches)))
+        (let ((ready (file-ready? (map cdr test-watches) 100)))
+          (if ready
+              (for-each (lambda (pfd)
+                          (let ((w (find (lambda (w)
+                                           (= (cdr w) (car pfd)))
+                                         test-watches)))
+                            (if w
+                                (begin
+                                  (set! test-watches (delete w test-watches eq?))
+                                  (test-delay-activating-handler (car w))))))
+                        ready))
+          (loop (+ n 1))))))
+
+(test-begin "delay-activating-handler")
+(http:async-cache-clear!)
+(set! test-results '())
+(test-false (test-request owner-a "/hello"))
+(test-true  (test-watched? owner-a))
+(test-run-watches)
+(test-equal "hello, world" (assq-cdr owner-a test-results))
+(test-false (http:async-requested? owner-a))
+(test-true  (null? test-watches))
+(test-true  (null? http-async-pending))
+(test-end)
+
+(test-begin "watched requests are left to their context")
+(http:async-cache-clear!)
+(set! test-results '())
+(test-false (test-request owner-a "/count"))
+(file-ready? (map http-async-request-fd http-async-pending) 3000)
+(test-false (http:async-poll owner-b))
+(test-false (http:async-poll))
+(test-false (null? http-async-pending))
+(test-true  (test-watched? owner-a))
+(test-run-watches)
+(test-true  (null? test-watches))
+(test-true  (string? (assq-cdr owner-a test-results)))
+(test-end)
+
+(test-begin "failed request")
+(http:async-cache-clear!)
+(set! test-results '())
+(test-false (test-request owner-a "/dead"))
+(test-true  (test-watched? owner-a))
+(test-run-watches)
+(test-false (assq owner-a test-results))
+;; not retried, and nothing is left behind
+(test-false (http:async-requested? owner-a))
+(test-true  (null? test-watches))
+(test-true  (null? http-async-pending))
+(test-true  (null? http-async-finished))
+(test-end)
+
+(test-begin "cancelled request")
+(http:async-cache-clear!)
+(set! test-results '())
+(test-false (test-request owner-a "/slow"))
+(test-true  (test-watched? owner-a))
+(http:async-cancel! owner-a)
+(test-false (test-watched? owner-a))
+(test-false (http:async-requested? owner-a))
+(test-wait-pending)
+(test-false (assq owner-a test-results))
+(test-equal "slow" (http:get-cached test-host "/slow" test-port))
+(test-end)
+
+(test-begin "a dropped request removes its watch")
+(http:async-cache-clear!)
+(set! http-async-max-pending 1)
+(test-false (test-request owner-a "/slow"))
+(test-false (test-request owner-b "/hello"))
+(test-false (test-watched? owner-a))
+(test-true  (test-watched? owner-b))
+(test-run-watches)
+(test-true  (null? test-watches))
+(set! http-async-max-pending 4)
+(test-end)
+
+(test-begin "http:get")
+(test-equal "hello, world" (http:get test-host "/hello" test-port))
+;; HTTP/1.0 responses without keep-alive are not pooled
+(test-true  (null? http-connection-pool))
+(test-equal "hello, world" (http:get test-host "/hello" test-port))
+(test-end)
+
+(define (test-pooled-port)
+  (and (= 1 (length http-connection-pool))
+       (http-connection-port (car http-connection-pool))))
+
+(test-begin "keep-alive")
+(http:close-all-connections)
+(test-equal "1" (http:get test-host "/keep" test-port))
+(define test-port-1 (test-pooled-port))
+(test-true  test-port-1)
+(test-equal "2" (http:get test-host "/keep" test-port))
+(test-eq    test-port-1 (test-pooled-port))
+(test-end)
+
+(test-begin "chunked response")
+(test-equal "hello, chunked world" (http:get test-host "/chunked" test-port))
+;; read to the last chunk, so the connection is reusable
+(test-eq    test-port-1 (test-pooled-port))
+(test-equal "3" (http:get test-host "/keep" test-port))
+(test-eq    test-port-1 (test-pooled-port))
+(test-end)
+
+(test-begin "retry on a closed pooled connection")
+(test-equal "close next" (http:get test-host "/drop-close" test-port))
+(test-eq    test-port-1 (test-pooled-port))
+;; the server reads the request and closes the connection without
+;; responding; the request is sent again on a new connection
+(test-equal "4" (http:get test-host "/keep" test-port))
+(define test-port-2 (test-pooled-port))
+(test-true  test-port-2)
+(test-false (eq? test-port-1 test-port-2))
+(test-end)
+
+(test-begin "retry on a reset pooled connection")
+(test-equal "reset next" (http:get test-host "/drop-reset" test-port))
+(test-eq    test-port-2 (test-pooled-port))
+;; the server closes the connection with the request unread, which
+;; resets it
+(test-equal "5" (http:get test-host "/keep" test-port))
+(test-true  (test-pooled-port))
+(test-false (eq? test-port-2 (test-pooled-port)))
+(test-end)
+
+(http:close-all-connections)
+(http:get test-host "/quit" test-port)
+(process-waitpid test-server-pid 0)
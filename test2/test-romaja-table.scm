@@ -0,0 +1,119 @@
+;;  test-romaja-table.scm: Checks tables/romaja.table against romaja.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+;; romaja.table is generated from romaja-rule by the .scm.table rule of
+;; tables/Makefile.am and looked up instead of the rule by
+;; romaja-init-handler. The rule takes the first of duplicate keys, as
+;; rk-lib-find-seq does, so the table must hold exactly that one.
+
+(require-extension (unittest))
+
+(require "fileio.scm")
+(require "romaja.scm")
+
+(set! *test-track-progress* #f)
+
+(define romaja-table-path "tables/romaja.table")
+
+;; #((key . value) ...) of the table lines in order
+(define romaja-table-read
+  (lambda (path)
+    (let* ((fd (file-open path
+			  (file-open-flags-number '($O_RDONLY))
+			  (file-open-mode-number '($S_IRUSR))))
+	   (port (open-file-port fd)))
+      (let loop ((line (file-read-line port))
+		 (entries '()))
+	(if (eof-object? line)
+	    (begin
+	      (close-file-port port)
+	      (list->vector (reverse entries)))
+	    (let ((sep (string-contains line " " 0)))
+	      (loop (file-read-line port)
+		    (cons (cons (substring line 0 sep)
+				(read-from-string
+				 (substring line (+ sep 1)
+					    (string-length line))))
+			  entries))))))))
+
+(define romaja-table-search
+  (lambda (table key)
+    (let loop ((lo 0)
+	       (hi (vector-length table)))
+      (and (< lo hi)
+	   (let* ((mid (quotient (+ lo hi) 2))
+		  (mid-key (car (vector-ref table mid))))
+	     (cond
+	      ((string=? key mid-key) mid)
+	      ((string<? key mid-key) (loop lo mid))
+	      (else (loop (+ mid 1) hi))))))))
+
+(if (not (file-readable? romaja-table-path))
+    (display "tables/romaja.table is not built; skipped\n")
+    (let* ((table (romaja-table-read romaja-table-path))
+	   (nr-lines (vector-length table))
+	   (seen (make-vector nr-lines #f))
+	   (unsorted
+	    (let loop ((i 1) (ret '()))
+	      (if (>= i nr-lines)
+		  ret
+		  (loop (+ i 1)
+			(if (string<? (car (vector-ref table (- i 1)))
+				      (car (vector-ref table i)))
+			    ret
+			    (cons (car (vector-ref table i)) ret))))))
+	   (missing '())
+	   (differing '()))
+      (for-each
+       (lambda (rule)
+	 (let* ((key (apply string-append (caar rule)))
+		(pos (romaja-table-search table key)))
+	   (cond
+	    ((not pos)
+	     (set! missing (cons key missing)))
+	    ((vector-ref seen pos))	; a later duplicate
+	    (else
+	     (vector-set! seen pos #t)
+	     (if (not (equal? (cdr (vector-ref table pos)) (cadr rule)))
+		 (set! differing (cons key differing)))))))
+       romaja-rule)
+      (test-begin "romaja.table")
+      ;; sorted for look, with one line per key
+      (test-equal '() unsorted)
+      (test-equal '() missing)
+      (test-equal '() differing)
+      ;; no line without a rule
+      (test-equal nr-lines
+		  (length (filter (lambda (x) x) (vector->list seen))))
+      (test-end)))
+
+(test-report-result)
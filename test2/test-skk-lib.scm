@@ -0,0 +1,82 @@
+;;  test-skk-lib.scm: Unit tests for the candidate lists of libuim-skk
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+(require-extension (unittest))
+
+(require-dynlib "skk")
+
+(set! *test-track-progress* #f)
+
+;; "#ko" is a numeric entry with two candidates of the #4 method, each
+;; of which expands to every candidate of "2"
+(define test-dic (skk-lib-dic-open "test2/skk-test.dic" #f "localhost" 1178
+                                   "inet"))
+
+(define (test-candidates head numeric?)
+  (skk-lib-get-candidates test-dic (cons head "") '() numeric?))
+
+(define (test-nth-candidates head numeric?)
+  (let loop ((n (- (skk-lib-get-nr-candidates test-dic head "" '() numeric?) 1))
+             (cands '()))
+    (if (< n 0)
+        cands
+        (loop (- n 1)
+              (cons (skk-lib-get-nth-candidate test-dic n (cons head "") '()
+                                               numeric?)
+                    cands)))))
+
+(test-begin "skk-lib-get-candidates")
+(test-equal '("ko1" "ko2;note") (test-candidates "ko" #f))
+(test-equal '("twoko" "niko" "2ko" "twopcs" "nipcs")
+            (test-candidates "2ko" #t))
+(test-equal '() (test-candidates "2ko" #f))
+(test-equal '() (test-candidates "none" #f))
+(test-end)
+
+(test-begin "skk-lib-get-nr-candidates")
+(test-equal 2 (skk-lib-get-nr-candidates test-dic "ko" "" '() #f))
+;; every #4 candidate is expanded, not only the first one
+(test-equal 5 (skk-lib-get-nr-candidates test-dic "2ko" "" '() #t))
+(test-equal 0 (skk-lib-get-nr-candidates test-dic "2ko" "" '() #f))
+(test-end)
+
+(test-begin "skk-lib-get-nth-candidate")
+(test-equal (test-candidates "ko" #f) (test-nth-candidates "ko" #f))
+(test-equal (test-candidates "2ko" #t) (test-nth-candidates "2ko" #t))
+;; alternating keys rebuild the list each time
+(test-equal "twopcs" (skk-lib-get-nth-candidate test-dic 3 (cons "2ko" "") '() #t))
+(test-equal "ko2;note" (skk-lib-get-nth-candidate test-dic 1 (cons "ko" "") '() #f))
+(test-equal "nipcs" (skk-lib-get-nth-candidate test-dic 4 (cons "2ko" "") '() #t))
+(test-equal '() (skk-lib-get-nth-candidate test-dic 5 (cons "2ko" "") '() #t))
+(test-end)
+
+(skk-lib-free-dic test-dic)
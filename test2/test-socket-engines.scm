@@ -0,0 +1,221 @@
+;;  test-socket-engines.scm: Unit tests for sj3v2-socket.scm and cannav3-socket.scm
+;;
+;;; Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+(require-extension (unittest))
+
+(require "util.scm")
+(require "lolevel.scm")
+(require "process.scm")
+(require "sj3v2-socket.scm")
+(require "cannav3-socket.scm")
+
+(set! *test-track-progress* #f)
+
+(define test-socket-path
+  (format "/tmp/uim-test-socket-engines-~a" (current-process-id)))
+
+(define (test-read-u8list fd n)
+  (let loop ((acc '()))
+    (let ((got (and (< (length acc) n)
+                    (file-read-u8list fd (- n (length acc))))))
+      (if (pair? got)
+          (loop (append acc got))
+          acc))))
+
+;; A stand-in for sj3serv and cannaserver. It accepts one connection
+;; in a child process and replays a recorded session: each request must
+;; arrive byte for byte as recorded and is answered with the recorded
+;; reply. The child exits with 1 on the first unexpected request.
+(define (test-replay-server session)
+  (let ((listener (car (unix-domain-listen test-socket-path))))
+    (let ((pid (process-fork)))
+      (if (= pid 0)
+          (let ((fd (call-with-sockaddr-un
+                     (addrinfo-ai-family-number '$PF_LOCAL)
+                     ""
+                     (lambda (ss)
+                       (accept listener ss)))))
+            (for-each (lambda (exchange)
+                        (if (not (equal? (car exchange)
+                                         (test-read-u8list
+                                          fd (length (car exchange)))))
+                            (_exit 1))
+                        (file-write fd (u8list->string-buf (cdr exchange))))
+                      session)
+            (_exit 0))
+          (begin
+            (file-close listener)
+            pid)))))
+
+(define (test-replay-finish pid fd)
+  (file-close fd)
+  (unlink test-socket-path)
+  (let ((status (process-waitpid pid 0)))
+    (and (cadr status)
+         (= 0 (list-ref status 4)))))
+
+;; requests are recorded with u8list-pack, the encoder the Scheme
+;; implementation of both protocols used
+(define (s8 str)
+  (string->u8list str))
+(define (s16 str)
+  (append (string->u8list str) '(0)))
+
+(define sj3-session
+  (list
+   ;; connect
+   (cons (u8list-pack '(u32 u32 s8 s8 s8) 1 2 "unix" "alice"
+                      (format "~a.uim-sj3" (current-process-id)))
+         '(255 255 255 254))
+   ;; opendict
+   (cons (u8list-pack '(u32 s8 s8) 11 "sj3main.dic" "")
+         '(0 0 0 0  0 0 0 3))
+   ;; stdy-size
+   (cons (u8list-pack '(u32) 23)
+         '(0 0 0 0  0 0 0 2))
+   ;; cl2knj-all-euc
+   (cons (u8list-pack '(u32 u32 s8) 115 4 "kana")
+         (append '(0 0 0 0)
+                 '(0 0 0 4) '(1 2) (s8 "KANA")
+                 '(0 0 0 4) '(3 4) (s8 "kana")
+                 '(0 0 0 0)))
+   ;; cl2knj-all-euc failing
+   (cons (u8list-pack '(u32 u32 s8) 115 4 "xxxx")
+         '(0 0 0 74))
+   ;; ph2knj-euc
+   (cons (u8list-pack '(u32 s8) 111 "abcd")
+         (append '(0 0 0 0  0 0 0 4)
+                 '(2) '(5 6) (s8 "AB")
+                 '(2) '(7 8) (s8 "CD")
+                 '(0)))
+   ;; cl2knj-cnt-euc
+   (cons (u8list-pack '(u32 u32 s8) 116 4 "kana")
+         '(0 0 0 0  0 0 0 2))
+   ;; clstudy-euc
+   (cons (u8list-pack '(u32 s8 s8 u8list) 117 "ka" "na" '(1 2))
+         '(0 0 0 0))
+   ;; access?
+   (cons (u8list-pack '(u32 s8 u32) 84 "user/alice" 0)
+         '(0 0 0 35))
+   ;; disconnect
+   (cons (u8list-pack '(u32) 2)
+         '(0 0 0 0))))
+
+(test-begin "sj3v2 protocol")
+(define sj3-server (test-replay-server sj3-session))
+(define sj3-fd (unix-domain-socket-connect test-socket-path))
+(test-true  (sj3-lib-connect sj3-fd "alice"))
+(test-equal 3 (sj3-lib-opendict sj3-fd "sj3main.dic" ""))
+(test-equal 2 (sj3-lib-stdy-size sj3-fd))
+(receive (yomi-len stdy kouho)
+    (sj3-lib-cl2knj-all-euc sj3-fd 2 4 "kana")
+  (test-equal '(4 4 0) yomi-len)
+  (test-equal '((1 2) (3 4)) stdy)
+  (test-equal '("KANA" "kana") kouho))
+(test-false (sj3-lib-cl2knj-all-euc sj3-fd 2 4 "xxxx"))
+(receive (yomi-len stdy kouho)
+    (sj3-lib-ph2knj-euc sj3-fd 2 "abcd")
+  (test-equal '(2 2 0) yomi-len)
+  (test-equal '((5 6) (7 8)) stdy)
+  (test-equal '("AB" "CD") kouho)
+  (test-equal '("ab" "cd") (sj3-lib-split-yomi "abcd" yomi-len)))
+(test-equal 2 (sj3-lib-cl2knj-cnt-euc sj3-fd 2 4 "kana"))
+(test-equal 0 (sj3-lib-clstudy-euc sj3-fd "ka" "na" '(1 2)))
+(test-false (sj3-lib-access? sj3-fd "user/alice" 0))
+(test-true  (sj3-lib-disconnect sj3-fd))
+(test-true  (test-replay-finish sj3-server sj3-fd))
+(test-end)
+
+(define canna-session
+  (list
+   ;; initialize
+   (cons (u8list-pack '(u32 u32 s8) 1 10 "3.3:alice")
+         '(0 3 0 3))
+   ;; create-context
+   (cons (u8list-pack '(u8 u8 u16) 3 0 0)
+         '(3 0 0 2  0 7))
+   ;; get-dictionary-list
+   (cons (u8list-pack '(u8 u8 u16 u16 u16) 6 0 4 7 1024)
+         (append '(6 0 0 13  0 2) (s8 "kihon") (s8 "user")))
+   ;; mount-dictionaries, pipelined; the server still sees the
+   ;; requests one at a time
+   (cons (u8list-pack '(u8 u8 u16 u32 u16 s8) 8 0 12 0 7 "kihon")
+         '(8 0 0 1  0))
+   (cons (u8list-pack '(u8 u8 u16 u32 u16 s8) 8 0 11 0 7 "user")
+         '(8 0 0 1  255))
+   ;; begin-convert
+   (cons (u8list-pack '(u8 u8 u16 u32 u16 s16) 15 0 13 19 7 "kanji")
+         (append '(15 0 0 11  0 2) (s16 "KAN") (s16 "JI")))
+   ;; get-candidacy-list
+   (cons (u8list-pack '(u8 u8 u16 u16 u16 u16) 17 0 6 7 0 1024)
+         (append '(17 0 0 14  0 2) (s16 "KAN") (s16 "kan") '(0 0)))
+   ;; resize-pause
+   (cons (u8list-pack '(u8 u8 u16 u16 u16 u16) 26 0 6 7 0 65535)
+         (append '(26 0 0 11  0 1) (s16 "KANJI") '(0 0)))
+   ;; get-yomi
+   (cons (u8list-pack '(u8 u8 u16 u16 u16 u16) 18 0 6 7 0 1024)
+         (append '(18 0 0 9  0 5) (s16 "kanji")))
+   ;; end-convert
+   (cons (u8list-pack '(u8 u8 u16 u16 u16 u32 u16list) 16 0 10 7 1 1 '(0))
+         '(16 0 0 1  0))
+   ;; close-context
+   (cons (u8list-pack '(u8 u8 u16 u16) 5 0 2 7)
+         '(5 0 0 1  0))
+   ;; finalize
+   (cons (u8list-pack '(u8 u8 u16) 2 0 0)
+         '(2 0 0 1  0))))
+
+(test-begin "cannav3 protocol")
+(define canna-server (test-replay-server canna-session))
+(define canna-fd (unix-domain-socket-connect test-socket-path))
+(test-true  (canna-lib-initialize canna-fd "alice"))
+(test-equal 7 (canna-lib-create-context canna-fd))
+(test-equal '("kihon" "user") (canna-lib-get-dictionary-list canna-fd 7))
+(test-equal '(#t #f)
+            (canna-lib-mount-dictionaries canna-fd 7 '("kihon" "user") 0))
+(test-equal '("KAN" "JI") (canna-lib-begin-convert canna-fd 7 "kanji" 19))
+(test-equal '("KAN" "kan") (canna-lib-get-candidacy-list canna-fd 7 0))
+(test-equal '("KANJI") (canna-lib-resize-pause canna-fd 7 -1 0))
+(test-equal "kanji" (canna-lib-get-yomi canna-fd 7 0))
+(test-true  (canna-lib-end-convert canna-fd 7 '(0) 1))
+(test-true  (canna-lib-close-context canna-fd 7))
+(test-true  (canna-lib-finalize canna-fd))
+(test-true  (test-replay-finish canna-server canna-fd))
+(test-end)
+
+(test-begin "truncated reply")
+(define short-server
+  (test-replay-server (list (cons (u8list-pack '(u32) 23)
+                                  '(0 0 0 0  0 0)))))
+(define short-fd (unix-domain-socket-connect test-socket-path))
+(test-error (sj3-lib-stdy-size short-fd))
+(test-true  (test-replay-finish short-server short-fd))
+(test-end)
@@ -205,4 +205,52 @@
 	    (trec-route-values kkya))
 (test-end)
 
+(test-begin "native index")
+(define rtr-scheme-string=? (trec-router-vanilla-advance-new
+			     (lambda (x y) (string=? x y))))
+(if trec-native-available?
+    (begin
+      (test-true  (pair? (trec-native-descend
+			  (trec-node-branches romaji-ruletree) "k")))
+      (test-equal '()
+		  (trec-native-descend
+		   (trec-node-branches romaji-ruletree) "z"))
+      ;; leaf
+      (test-false (trec-native-descend () "k"))))
+(test-equal (trec-route-keys
+	     (car (trec-route-route initial rtr-scheme-string=? '("k" "k" "y" "a" "f"))))
+	    (trec-route-keys
+	     (car (trec-route-route initial rtr-string=? '("k" "k" "y" "a" "f")))))
+(test-equal (trec-route-values
+	     (car (trec-route-route initial rtr-scheme-string=? '("k" "k" "a"))))
+	    (trec-route-values
+	     (car (trec-route-route initial rtr-string=? '("k" "k" "a")))))
+(test-false (trec-route-advance initial rtr-scheme-string=? "z"))
+(test-false (trec-route-advance initial rtr-string=? "z"))
+(test-end)
+
+(test-begin "release ruletree")
+(define released-ruletree (trec-parse-ruleset string=? #f romaji-ruleset))
+(if trec-native-available?
+    (begin
+      (test-true  (pair? (memq released-ruletree trec-native-ruletrees)))
+      (test-true  (pair? (trec-native-descend
+			  (trec-node-branches released-ruletree) "k")))))
+(trec-release-ruletree! released-ruletree)
+(test-false (memq released-ruletree trec-native-ruletrees))
+(test-false (trec-native-descend
+	     (trec-node-branches released-ruletree) "k"))
+;; the index of the other ruletree survives
+(if trec-native-available?
+    (begin
+      (test-true  (pair? (memq romaji-ruletree trec-native-ruletrees)))
+      (test-true  (pair? (trec-native-descend
+			  (trec-node-branches romaji-ruletree) "k")))))
+(test-equal '(("KKA"))
+	    (trec-route-values
+	     (car (trec-route-route initial rtr-string=? '("k" "k" "a")))))
+;; releasing twice is harmless
+(trec-release-ruletree! released-ruletree)
+(test-end)
+
 (test-report-result)
@@ -0,0 +1,101 @@
+;;  test-tutcode-bushu.scm: Unit tests for tutcode-bushu.scm
+;;
+;;; Copyright (c) 2008-2013 uim Project https://github.com/uim/uim
+;;
+;;  All rights reserved.
+;;
+;;  Redistribution and use in source and binary forms, with or without
+;;  modification, are permitted provided that the following conditions
+;;  are met:
+;;
+;;  1. Redistributions of source code must retain the above copyright
+;;     notice, this list of conditions and the following disclaimer.
+;;  2. Redistributions in binary form must reproduce the above copyright
+;;     notice, this list of conditions and the following disclaimer in the
+;;     documentation and/or other materials provided with the distribution.
+;;  3. Neither the name of authors nor the names of its contributors
+;;     may be used to endorse or promote products derived from this software
+;;     without specific prior written permission.
+;;
+;;  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS
+;;  IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+;;  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+;;  PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+;;  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+;;  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+;;  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;  PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;  LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+(require-extension (unittest))
+
+(require "tutcode-bushu.scm")
+
+(set! *test-track-progress* #f)
+
+;; A small db over ASCII "characters": A is composed of a and b, etc.
+(define tutcode-bushu-expand-filename "test2/tutcode-bushu-test.expand")
+(define tutcode-bushu-index2-filename "test2/tutcode-bushu-test.index2")
+
+;; tutcode.scm is not loaded; the ichar only keys the cache of
+;; tutcode-bushu-for-char
+(define (tutcode-euc-jp-string->ichar s)
+  #f)
+
+;; the result of THUNK with the Scheme implementation
+(define (test-bushu-scm thunk)
+  (let ((lib? tutcode-bushu-lib?))
+    (set! tutcode-bushu-lib? #f)
+    (let ((ret (thunk)))
+      (set! tutcode-bushu-lib? lib?)
+      ret)))
+
+(define (test-bushu-same thunk)
+  (test-equal (test-bushu-scm thunk) (thunk)))
+
+(test-begin "libuim-tutcode")
+(test-true (and tutcode-bushu-lib? #t))
+(test-true (and (tutcode-bushu-db) #t))
+(test-equal '("a" "b") (tutcode-bushu-for-char "A"))
+(test-equal '("Z") (tutcode-bushu-for-char "Z"))
+(test-end)
+
+(test-begin "tutcode-bushu-intersection")
+(test-bushu-same (lambda () (tutcode-bushu-intersection '() '())))
+(test-bushu-same (lambda () (tutcode-bushu-intersection '("a") '())))
+(test-bushu-same (lambda () (tutcode-bushu-intersection '("a" "b" "a") '("a" "c"))))
+(test-bushu-same (lambda () (tutcode-bushu-intersection '("c" "a" "a" "b")
+                                                        '("a" "b" "a" "b"))))
+(test-bushu-same (lambda () (tutcode-bushu-intersection '("x" "y") '("z"))))
+(test-end)
+
+(test-begin "tutcode-bushu-subtract-set")
+(test-bushu-same (lambda () (tutcode-bushu-subtract-set '("a" "b") '())))
+(test-bushu-same (lambda () (tutcode-bushu-subtract-set '() '("a"))))
+(test-bushu-same (lambda () (tutcode-bushu-subtract-set '("a" "b" "a") '("a"))))
+(test-bushu-same (lambda () (tutcode-bushu-subtract-set '("c" "a" "b" "a" "c")
+                                                        '("c" "b" "d"))))
+(test-bushu-same (lambda () (tutcode-bushu-subtract-set '("a") '("a" "a"))))
+(test-end)
+
+(test-begin "tutcode-bushu-superset")
+(test-bushu-same (lambda () (tutcode-bushu-superset '())))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("a"))))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("b" "a"))))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("a" "a"))))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("a" "b" "c"))))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("a" "a" "b"))))
+(test-bushu-same (lambda () (tutcode-bushu-superset '("x" "y" "z"))))
+(test-end)
+
+(test-begin "tutcode-bushu-all-compose-set")
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("A") '())))
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("a" "c") '())))
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("A" "c") '())))
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("b" "A") '())))
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("C" "B") '())))
+(test-bushu-same (lambda () (tutcode-bushu-all-compose-set '("x" "y") '())))
+(test-end)
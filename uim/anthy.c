@@ -40,6 +40,7 @@
 #include "uim.h"
 #include "uim-scm.h"
 #include "uim-scm-abbrev.h"
+#include "uim-trace.h"
 #include "dynlib.h"
 
 
@@ -130,11 +131,14 @@ static uim_lisp
 set_string(uim_lisp ac_, uim_lisp str_)
 {
   anthy_context_t ac;
+  struct uim_trace_span span;
   const char *str;
 
   ac = get_anthy_context(ac_);
   str = REFER_C_STR(str_);
+  UIM_TRACE_BEGIN(&span, "anthy_set_string");
   anthy_set_string(ac, str);
+  UIM_TRACE_END(&span);
 
   return uim_scm_f();
 }
@@ -232,13 +236,16 @@ static uim_lisp
 resize_segment(uim_lisp ac_, uim_lisp seg_, uim_lisp delta_)
 {
   anthy_context_t ac;
+  struct uim_trace_span span;
   int seg, delta;
 
   ac = get_anthy_context(ac_);
   seg = C_INT(seg_);
   delta = C_INT(delta_);
 
+  UIM_TRACE_BEGIN(&span, "anthy_resize_segment");
   anthy_resize_segment(ac, seg, delta);
+  UIM_TRACE_END(&span);
   return uim_scm_f();
 }
 
@@ -246,13 +253,16 @@ static uim_lisp
 commit_segment(uim_lisp ac_, uim_lisp seg_, uim_lisp nth_)
 {
   anthy_context_t ac;
+  struct uim_trace_span span;
   int seg, nth;
 
   ac = get_anthy_context(ac_);
   seg = C_INT(seg_);
   nth = C_INT(nth_);
 
+  UIM_TRACE_BEGIN(&span, "anthy_commit_segment");
   anthy_commit_segment(ac, seg, nth);
+  UIM_TRACE_END(&span);
   return uim_scm_f();
 }
 
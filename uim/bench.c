@@ -0,0 +1,703 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * uim-bench: replays recorded keystrokes through uim_press_key() and
+ * uim_release_key() on headless contexts, and reports the per-key
+ * latency and allocations for each IM.
+ *
+ * Script format (see test2/bench-keystrokes.txt):
+ *
+ *   # comment
+ *   im NAME        create a context of IM NAME for the following lines
+ *   setup KEYS     replay KEYS once without measuring, e.g. to turn
+ *                  the IM on
+ *   KEYS           a measured sequence; the context is reset after it
+ *
+ * KEYS are typed literally except for:
+ *
+ *   [name]         a special key, e.g. [space], [return], [backspace]
+ *   <Modifier>     Shift, Control, Alt, Meta, Super or Hyper applied to
+ *                  the next key, e.g. <Control>j
+ *   \c             the character c itself
+ *
+ * Baseline format (written by -o, compared by -b):
+ *
+ *   # uim-bench baseline 1
+ *   IM<TAB>keys<TAB>p50<TAB>p99<TAB>max<TAB>allocs/key<TAB>bytes/key
+ *
+ * Latencies are in microseconds per key (press and release). The
+ * allocation columns are 0 where allocations can't be counted.
+ *
+ * With -c, the keys are ignored and each IM of the script is timed for
+ * a context's lifetime instead: uim_create_context() and
+ * uim_release_context() against uim_acquire_context() and
+ * uim_recycle_context(), in microseconds per context.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "uim.h"
+#include "uim-im-switcher.h"
+#include "uim-util.h"
+
+
+#define DEFAULT_ITERATIONS 20
+#define DEFAULT_TOLERANCE  20  /* percent */
+#define MAX_LINE 1024
+
+struct key_event {
+  int key;
+  int state;
+};
+
+struct sequence {
+  struct key_event *keys;
+  int nr_keys;
+};
+
+struct im_bench {
+  char *name;
+  struct sequence setup;
+  struct sequence *seqs;
+  int nr_seqs;
+};
+
+struct result {
+  char *name;
+  long nr_keys;
+  double p50, p99, max;
+  double allocs, bytes;
+};
+
+static const struct {
+  const char *name;
+  int key;
+} key_names[] = {
+  {"space",            ' '},
+  {"backspace",        UKey_Backspace},
+  {"delete",           UKey_Delete},
+  {"escape",           UKey_Escape},
+  {"return",           UKey_Return},
+  {"tab",              UKey_Tab},
+  {"left",             UKey_Left},
+  {"up",               UKey_Up},
+  {"right",            UKey_Right},
+  {"down",             UKey_Down},
+  {"prior",            UKey_Prior},
+  {"next",             UKey_Next},
+  {"home",             UKey_Home},
+  {"end",              UKey_End},
+  {"muhenkan",         UKey_Muhenkan},
+  {"henkan",           UKey_Henkan},
+  {"zenkaku-hankaku",  UKey_Zenkaku_Hankaku},
+  {"hangul",           UKey_Hangul},
+  {"hangul-hanja",     UKey_Hangul_Hanja},
+  {NULL, 0}
+};
+
+static const struct {
+  const char *name;
+  int mod;
+} mod_names[] = {
+  {"Shift",   UMod_Shift},
+  {"Control", UMod_Control},
+  {"Alt",     UMod_Alt},
+  {"Meta",    UMod_Meta},
+  {"Super",   UMod_Super},
+  {"Hyper",   UMod_Hyper},
+  {NULL, 0}
+};
+
+/*
+ * Allocation counting. glibc lets the program override malloc() for
+ * the whole process, libuim and SigScheme included.
+ */
+#if defined(__GLIBC__)
+#define COUNT_ALLOCS 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static int counting_allocs;
+static unsigned long nr_allocs, nr_alloc_bytes;
+
+void *
+malloc(size_t size)
+{
+  if (counting_allocs) {
+    nr_allocs++;
+    nr_alloc_bytes += size;
+  }
+  return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+  if (counting_allocs) {
+    nr_allocs++;
+    nr_alloc_bytes += nmemb * size;
+  }
+  return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+  if (counting_allocs) {
+    nr_allocs++;
+    nr_alloc_bytes += size;
+  }
+  return __libc_realloc(ptr, size);
+}
+#else
+#define COUNT_ALLOCS 0
+static int counting_allocs;
+static unsigned long nr_allocs, nr_alloc_bytes;
+#endif
+
+static double
+now_usec(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+  {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+  }
+}
+
+/*
+ * Script parsing
+ */
+static void
+push_key(struct sequence *seq, int key, int state)
+{
+  seq->keys = uim_realloc(seq->keys, sizeof(struct key_event) * (seq->nr_keys + 1));
+  seq->keys[seq->nr_keys].key = key;
+  seq->keys[seq->nr_keys].state = state;
+  seq->nr_keys++;
+}
+
+static int
+parse_keys(struct sequence *seq, const char *p, const char *file, int lineno)
+{
+  const char *end;
+  size_t len;
+  int i, state;
+
+  memset(seq, 0, sizeof(*seq));
+  state = 0;
+  while (*p) {
+    if (*p == '<' || *p == '[') {
+      end = strchr(p, (*p == '<') ? '>' : ']');
+      if (!end)
+	goto error;
+      len = end - p - 1;
+      if (*p == '<') {
+	for (i = 0; mod_names[i].name; i++) {
+	  if (strlen(mod_names[i].name) == len
+	      && strncmp(p + 1, mod_names[i].name, len) == 0)
+	    break;
+	}
+	if (!mod_names[i].name)
+	  goto error;
+	state |= mod_names[i].mod;
+      } else {
+	for (i = 0; key_names[i].name; i++) {
+	  if (strlen(key_names[i].name) == len
+	      && strncmp(p + 1, key_names[i].name, len) == 0)
+	    break;
+	}
+	if (!key_names[i].name)
+	  goto error;
+	push_key(seq, key_names[i].key, state);
+	state = 0;
+      }
+      p = end + 1;
+    } else {
+      if (*p == '\\' && p[1])
+	p++;
+      push_key(seq, (unsigned char)*p, state);
+      state = 0;
+      p++;
+    }
+  }
+
+  return 0;
+
+ error:
+  fprintf(stderr, "%s:%d: invalid key at \"%s\"\n", file, lineno, p);
+  return -1;
+}
+
+static struct im_bench *
+load_script(const char *file, int *nr_ims)
+{
+  FILE *fp;
+  char line[MAX_LINE], *p;
+  struct im_bench *ims, *im;
+  struct sequence seq;
+  int lineno, n;
+
+  fp = fopen(file, "r");
+  if (!fp) {
+    perror(file);
+    return NULL;
+  }
+
+  ims = NULL;
+  im = NULL;
+  n = 0;
+  for (lineno = 1; fgets(line, sizeof(line), fp); lineno++) {
+    line[strcspn(line, "\r\n")] = '\0';
+    for (p = line; isspace((unsigned char)*p); p++)
+      ;
+    if (*p == '\0' || *p == '#')
+      continue;
+
+    if (strncmp(p, "im ", 3) == 0) {
+      ims = uim_realloc(ims, sizeof(struct im_bench) * (n + 1));
+      im = &ims[n++];
+      memset(im, 0, sizeof(*im));
+      for (p += 3; isspace((unsigned char)*p); p++)
+	;
+      im->name = uim_strdup(p);
+      continue;
+    }
+
+    if (!im) {
+      fprintf(stderr, "%s:%d: keys before \"im\" line\n", file, lineno);
+      goto error;
+    }
+    if (strncmp(p, "setup ", 6) == 0) {
+      if (parse_keys(&im->setup, p + 6, file, lineno) < 0)
+	goto error;
+      continue;
+    }
+    if (parse_keys(&seq, p, file, lineno) < 0)
+      goto error;
+    im->seqs = uim_realloc(im->seqs, sizeof(struct sequence) * (im->nr_seqs + 1));
+    im->seqs[im->nr_seqs++] = seq;
+  }
+  fclose(fp);
+
+  *nr_ims = n;
+  return ims;
+
+ error:
+  fclose(fp);
+  return NULL;
+}
+
+/*
+ * Replay
+ */
+static void
+commit_cb(void *ptr, const char *str)
+{
+}
+
+static void
+preedit_clear_cb(void *ptr)
+{
+}
+
+static void
+preedit_pushback_cb(void *ptr, int attr, const char *str)
+{
+}
+
+static void
+preedit_update_cb(void *ptr)
+{
+}
+
+static void
+cand_activate_cb(void *ptr, int nr, int display_limit)
+{
+}
+
+static void
+cand_select_cb(void *ptr, int index)
+{
+}
+
+static void
+cand_shift_page_cb(void *ptr, int direction)
+{
+}
+
+static void
+cand_deactivate_cb(void *ptr)
+{
+}
+
+static void
+setup_context(uim_context uc)
+{
+  uim_set_preedit_cb(uc, preedit_clear_cb, preedit_pushback_cb,
+		     preedit_update_cb);
+  uim_set_candidate_selector_cb(uc, cand_activate_cb, cand_select_cb,
+				cand_shift_page_cb, cand_deactivate_cb);
+}
+
+static void
+replay(uim_context uc, const struct sequence *seq, double *samples)
+{
+  double start;
+  int i;
+
+  for (i = 0; i < seq->nr_keys; i++) {
+    start = now_usec();
+    uim_press_key(uc, seq->keys[i].key, seq->keys[i].state);
+    uim_release_key(uc, seq->keys[i].key, seq->keys[i].state);
+    if (samples)
+      samples[i] = now_usec() - start;
+  }
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static double
+percentile(const double *sorted, long n, int pct)
+{
+  long i;
+
+  i = (n * pct + 99) / 100 - 1;
+  if (i < 0)
+    i = 0;
+  return sorted[i];
+}
+
+static int
+run_im(const struct im_bench *im, int iterations, struct result *res)
+{
+  uim_context uc;
+  double *samples;
+  long nr_samples, total_keys;
+  int i, j;
+
+  uc = uim_create_context(NULL, "UTF-8", NULL, im->name, NULL, commit_cb);
+  if (!uc)
+    return -1;
+  if (strcmp(uim_get_current_im_name(uc), im->name) != 0) {
+    uim_release_context(uc);
+    return -1;
+  }
+  setup_context(uc);
+
+  total_keys = 0;
+  for (j = 0; j < im->nr_seqs; j++)
+    total_keys += im->seqs[j].nr_keys;
+  samples = uim_malloc(sizeof(double) * (total_keys * iterations + 1));
+
+  /* a warm-up round loads the lazily loaded parts of the IM */
+  replay(uc, &im->setup, NULL);
+  for (j = 0; j < im->nr_seqs; j++) {
+    replay(uc, &im->seqs[j], NULL);
+    uim_reset_context(uc);
+  }
+
+  nr_allocs = nr_alloc_bytes = 0;
+  nr_samples = 0;
+  for (i = 0; i < iterations; i++) {
+    for (j = 0; j < im->nr_seqs; j++) {
+      counting_allocs = 1;
+      replay(uc, &im->seqs[j], &samples[nr_samples]);
+      counting_allocs = 0;
+      nr_samples += im->seqs[j].nr_keys;
+      uim_reset_context(uc);
+    }
+  }
+  uim_release_context(uc);
+
+  memset(res, 0, sizeof(*res));
+  res->name = im->name;
+  res->nr_keys = nr_samples;
+  if (nr_samples > 0) {
+    qsort(samples, nr_samples, sizeof(double), compare_double);
+    res->p50 = percentile(samples, nr_samples, 50);
+    res->p99 = percentile(samples, nr_samples, 99);
+    res->max = samples[nr_samples - 1];
+    res->allocs = (double)nr_allocs / nr_samples;
+    res->bytes = (double)nr_alloc_bytes / nr_samples;
+  }
+  free(samples);
+
+  return 0;
+}
+
+static int
+run_contexts(const struct im_bench *im, int iterations)
+{
+  uim_context uc;
+  double start, create, acquire;
+  int i;
+
+  uc = uim_create_context(NULL, "UTF-8", NULL, im->name, NULL, commit_cb);
+  if (!uc)
+    return -1;
+  if (strcmp(uim_get_current_im_name(uc), im->name) != 0) {
+    uim_release_context(uc);
+    return -1;
+  }
+  uim_release_context(uc);
+
+  start = now_usec();
+  for (i = 0; i < iterations; i++) {
+    uc = uim_create_context(NULL, "UTF-8", NULL, im->name, NULL, commit_cb);
+    setup_context(uc);
+    uim_focus_in_context(uc);
+    uim_focus_out_context(uc);
+    uim_release_context(uc);
+  }
+  create = (now_usec() - start) / iterations;
+
+  /* the first one fills the pool */
+  uc = uim_acquire_context(NULL, "UTF-8", NULL, im->name, NULL, commit_cb);
+  uim_recycle_context(uc);
+  start = now_usec();
+  for (i = 0; i < iterations; i++) {
+    uc = uim_acquire_context(NULL, "UTF-8", NULL, im->name, NULL, commit_cb);
+    setup_context(uc);
+    uim_focus_in_context(uc);
+    uim_focus_out_context(uc);
+    uim_recycle_context(uc);
+  }
+  acquire = (now_usec() - start) / iterations;
+
+  printf("%s\t%.1f\t%.1f\n", im->name, create, acquire);
+
+  return 0;
+}
+
+/*
+ * Baseline
+ */
+static void
+print_result(FILE *fp, const struct result *res)
+{
+  fprintf(fp, "%s\t%ld\t%.1f\t%.1f\t%.1f\t%.1f\t%.0f\n",
+	  res->name, res->nr_keys, res->p50, res->p99, res->max,
+	  res->allocs, res->bytes);
+}
+
+static int
+save_baseline(const char *file, const struct result *results, int n)
+{
+  FILE *fp;
+  int i;
+
+  fp = fopen(file, "w");
+  if (!fp) {
+    perror(file);
+    return -1;
+  }
+  fprintf(fp, "# uim-bench baseline 1\n");
+  fprintf(fp, "# im\tkeys\tp50\tp99\tmax\tallocs/key\tbytes/key\n");
+  for (i = 0; i < n; i++)
+    print_result(fp, &results[i]);
+  fclose(fp);
+
+  return 0;
+}
+
+static uim_bool
+regressed(const char *im, const char *what, double base, double cur,
+	  int tolerance)
+{
+  /* ignore sub-microsecond noise */
+  if (cur <= base * (100 + tolerance) / 100 || cur - base < 1.0)
+    return UIM_FALSE;
+
+  printf("REGRESSION: %s: %s %.1f -> %.1f\n", im, what, base, cur);
+  return UIM_TRUE;
+}
+
+static int
+compare_baseline(const char *file, const struct result *results, int n,
+		 int tolerance)
+{
+  FILE *fp;
+  char line[MAX_LINE], name[MAX_LINE];
+  double p50, p99, max, allocs, bytes;
+  long keys;
+  int i, nr_regressions;
+
+  fp = fopen(file, "r");
+  if (!fp) {
+    perror(file);
+    return -1;
+  }
+
+  nr_regressions = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%s %ld %lf %lf %lf %lf %lf", name, &keys,
+	       &p50, &p99, &max, &allocs, &bytes) != 7)
+      continue;
+    for (i = 0; i < n; i++) {
+      if (strcmp(results[i].name, name) != 0)
+	continue;
+      nr_regressions += regressed(name, "p50", p50, results[i].p50, tolerance);
+      nr_regressions += regressed(name, "p99", p99, results[i].p99, tolerance);
+      if (COUNT_ALLOCS)
+	nr_regressions += regressed(name, "allocs/key", allocs,
+				    results[i].allocs, tolerance);
+    }
+  }
+  fclose(fp);
+
+  return nr_regressions;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+	  "Usage: %s [-c] [-n iterations] [-b baseline] [-o baseline] [-t tolerance] script\n"
+	  "  -c      time context creation instead of keystrokes\n"
+	  "  -n N    replay each sequence N times (default %d)\n"
+	  "  -b FILE compare with FILE and exit with 1 on regressions\n"
+	  "  -o FILE write the results to FILE in the baseline format\n"
+	  "  -t PCT  allowed slowdown in percent (default %d)\n",
+	  prog, DEFAULT_ITERATIONS, DEFAULT_TOLERANCE);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct im_bench *ims;
+  struct result *results;
+  const char *baseline, *output;
+  int opt, iterations, tolerance, nr_ims, nr_results, i, status;
+  uim_bool contexts;
+
+  iterations = DEFAULT_ITERATIONS;
+  tolerance = DEFAULT_TOLERANCE;
+  baseline = output = NULL;
+  contexts = UIM_FALSE;
+  while ((opt = getopt(argc, argv, "cn:b:o:t:h")) != -1) {
+    switch (opt) {
+    case 'c':
+      contexts = UIM_TRUE;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'b':
+      baseline = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 't':
+      tolerance = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind != argc - 1 || iterations <= 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  ims = load_script(argv[optind], &nr_ims);
+  if (!ims)
+    return EXIT_FAILURE;
+
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return EXIT_FAILURE;
+  }
+
+  if (contexts) {
+    printf("# im\tcreate\tacquire\n");
+    for (i = 0; i < nr_ims; i++) {
+      if (run_contexts(&ims[i], iterations) < 0)
+	printf("# %s: not available, skipped\n", ims[i].name);
+    }
+    uim_quit();
+    return EXIT_SUCCESS;
+  }
+
+  results = uim_malloc(sizeof(struct result) * (nr_ims + 1));
+  nr_results = 0;
+  printf("# im\tkeys\tp50\tp99\tmax\tallocs/key\tbytes/key\n");
+  for (i = 0; i < nr_ims; i++) {
+    if (run_im(&ims[i], iterations, &results[nr_results]) < 0) {
+      printf("# %s: not available, skipped\n", ims[i].name);
+      continue;
+    }
+    print_result(stdout, &results[nr_results]);
+    nr_results++;
+  }
+  if (!COUNT_ALLOCS)
+    printf("# allocations are not counted on this platform\n");
+
+  status = EXIT_SUCCESS;
+  if (output && save_baseline(output, results, nr_results) < 0)
+    status = EXIT_FAILURE;
+  if (baseline && compare_baseline(baseline, results, nr_results, tolerance))
+    status = EXIT_FAILURE;
+
+  uim_quit();
+
+  return status;
+}
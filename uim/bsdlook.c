@@ -90,7 +90,6 @@ static char rcsid[] = "$OpenBSD: look.c,v 1.11 2005/06/25 17:00:35 niallo Exp $"
 #endif
 
 struct uim_look_ctx {
-	int fd;
 	size_t len;
 	char *front0, *back0;
 	char *front, *back;
@@ -169,31 +168,35 @@ uim_look_finish(uim_look_ctx *ctx)
 	if ((uintptr_t)ctx->front0 > 0 && munmap(ctx->front0, ctx->len) == -1)
 		perror("uim_look_finish");
 
-	if (ctx->fd > 0)
-		close(ctx->fd);
-
 	free(ctx);
 	return;
 }
 
+/*
+ * The mapping outlives the descriptor, so callers may keep many
+ * dictionaries open without holding their fds.
+ */
 int
 uim_look_open_dict(const char *dict, uim_look_ctx *ctx)
 {
 	struct stat sb;
+	int fd;
 
-	if ((ctx->fd = open(dict, O_RDONLY, 0)) < 0 || fstat(ctx->fd, &sb)) {
+	if ((fd = open(dict, O_RDONLY, 0)) < 0) {
 		perror("uim_look_open_dict");
 		return 0;
 	}
-	if ((size_t)sb.st_size > SIZE_T_MAX) {
+	if (fstat(fd, &sb) || (size_t)sb.st_size > SIZE_T_MAX) {
 		perror("uim_look_open_dict");
+		close(fd);
 		return 0;
 	}
 	if ((ctx->front0 = ctx->front = mmap(NULL,
-		    (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, ctx->fd, (off_t)0)) == MAP_FAILED) {
+		    (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, (off_t)0)) == MAP_FAILED) {
 		perror("uim_look_open_dict");
 		ctx->front0 = ctx->front = 0;
 	}
+	close(fd);
 	ctx->len = (size_t)sb.st_size;
 	ctx->back0 = ctx->back = ctx->front + sb.st_size;
 
@@ -0,0 +1,482 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Native codec for the Canna protocol version 3.3 as spoken by
+ * cannaserver.  The functions keep the names and return values of the
+ * former pure Scheme implementation in cannav3-socket.scm.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+#include "wire.h"
+
+/* canna protocol operators */
+#define CANNA_INITIALIZE           0x01
+#define CANNA_FINALIZE             0x02
+#define CANNA_CREATE_CONTEXT       0x03
+#define CANNA_CLOSE_CONTEXT        0x05
+#define CANNA_GET_DICTIONARY_LIST  0x06
+#define CANNA_MOUNT_DICTIONARY     0x08
+#define CANNA_UNMOUNT_DICTIONARY   0x09
+#define CANNA_BEGIN_CONVERT        0x0f
+#define CANNA_END_CONVERT          0x10
+#define CANNA_GET_CANDIDACY_LIST   0x11
+#define CANNA_GET_YOMI             0x12
+#define CANNA_RESIZE_PAUSE         0x1a
+
+#define CANNA_BUFSIZE 1024
+#define CANNA_ERROR16 65535
+#define CANNA_ERROR8  255
+
+/* request header: operator, 0, length of the rest */
+static void
+canna_put_header(uim_wire_buf *req, int op, size_t len)
+{
+  uim_wire_put_u8(req, op);
+  uim_wire_put_u8(req, 0);
+  uim_wire_put_u16(req, len);
+}
+
+/* replies are read through this buffer, kept for the next exchange */
+static uim_wire_buf canna_reply_buf;
+
+static void
+canna_send(uim_lisp fd_, uim_wire_buf *req, uim_wire_reader *rd)
+{
+  int ret, err;
+
+  ret = uim_wire_write(C_INT(fd_), req);
+  err = errno;
+  uim_wire_buf_free(req);
+  if (ret < 0)
+    ERROR_OBJ(strerror(err), fd_);
+  uim_wire_reader_init(rd, C_INT(fd_), &canna_reply_buf);
+}
+
+static void
+canna_read(uim_lisp fd_, uim_wire_reader *rd, void *dst, size_t len)
+{
+  if (uim_wire_read(rd, dst, len) < 0)
+    ERROR_OBJ("canna: truncated reply", fd_);
+}
+
+/* reply header followed by a one byte result */
+static unsigned int
+canna_read_result8(uim_lisp fd_, uim_wire_reader *rd)
+{
+  unsigned char reply[5];
+
+  canna_read(fd_, rd, reply, sizeof(reply));
+  return reply[4];
+}
+
+/* reply header followed by a two byte result */
+static unsigned int
+canna_read_result16(uim_lisp fd_, uim_wire_reader *rd)
+{
+  unsigned char reply[6];
+
+  canna_read(fd_, rd, reply, sizeof(reply));
+  return uim_wire_get_u16(reply + 4);
+}
+
+/*
+ * Reply header, a two byte count and the rest of the data counted by
+ * the header.  The data is returned with two extra NULs so that a
+ * truncated string still terminates.
+ */
+static unsigned char *
+canna_read_data(uim_lisp fd_, uim_wire_reader *rd, unsigned int *count,
+		size_t *len)
+{
+  unsigned char reply[6], *data;
+  unsigned int datalen;
+
+  canna_read(fd_, rd, reply, sizeof(reply));
+  datalen = uim_wire_get_u16(reply + 2);
+  *count = uim_wire_get_u16(reply + 4);
+  *len = datalen >= 2 ? datalen - 2 : 0;
+
+  data = uim_malloc(*len + 2);
+  if (uim_wire_read(rd, data, *len) < 0) {
+    free(data);
+    ERROR_OBJ("canna: truncated reply", fd_);
+  }
+  data[*len] = data[*len + 1] = '\0';
+  return data;
+}
+
+/*
+ * Split data into at most count strings each followed by pad NULs
+ * (1 for s8, 2 for s16).  A negative count reads up to the empty
+ * string that ends the list.
+ */
+static uim_lisp
+canna_decode_strings(const unsigned char *data, size_t len, int count,
+		     size_t pad)
+{
+  uim_lisp ret_ = uim_scm_null();
+  size_t off = 0;
+
+  while (off < len && count != 0) {
+    const char *str = (const char *)data + off;
+    size_t slen = strlen(str);
+
+    if (count < 0 && slen == 0)
+      break;
+    ret_ = CONS(MAKE_STR(str), ret_);
+    off += slen + pad;
+    if (count > 0)
+      count--;
+  }
+  return uim_scm_callf("reverse", "o", ret_);
+}
+
+static uim_lisp
+c_canna_initialize(uim_lisp fd_, uim_lisp user_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  unsigned char reply[4];
+  const char *user = REFER_C_STR(user_);
+  char *var_user;
+
+  var_user = uim_malloc(strlen(user) + sizeof("3.3:"));
+  sprintf(var_user, "3.3:%s", user);
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, CANNA_INITIALIZE);
+  uim_wire_put_u32(&req, strlen(var_user) + 1);
+  uim_wire_put_s8(&req, var_user);
+  free(var_user);
+
+  canna_send(fd_, &req, &rd);
+  canna_read(fd_, &rd, reply, sizeof(reply));
+  /* major and minor version, both 65535 on failure */
+  return MAKE_BOOL(uim_wire_get_u16(reply) != CANNA_ERROR16);
+}
+
+static uim_lisp
+c_canna_finalize(uim_lisp fd_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_FINALIZE, 0);
+  canna_send(fd_, &req, &rd);
+  return MAKE_BOOL(canna_read_result8(fd_, &rd) == 0);
+}
+
+static uim_lisp
+c_canna_create_context(uim_lisp fd_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  unsigned int context_id;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_CREATE_CONTEXT, 0);
+  canna_send(fd_, &req, &rd);
+  context_id = canna_read_result16(fd_, &rd);
+  if (context_id == CANNA_ERROR16)
+    return uim_scm_f();
+  return MAKE_INT(context_id);
+}
+
+static uim_lisp
+c_canna_close_context(uim_lisp fd_, uim_lisp context_id_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_CLOSE_CONTEXT, 2);
+  uim_wire_put_u16(&req, C_INT(context_id_));
+  canna_send(fd_, &req, &rd);
+  return MAKE_BOOL(canna_read_result8(fd_, &rd) != CANNA_ERROR8);
+}
+
+static uim_lisp
+c_canna_get_dictionary_list(uim_lisp fd_, uim_lisp context_id_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  unsigned char *data;
+  unsigned int count;
+  size_t len;
+  uim_lisp ret_;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_GET_DICTIONARY_LIST, 4);
+  uim_wire_put_u16(&req, C_INT(context_id_));
+  uim_wire_put_u16(&req, CANNA_BUFSIZE);
+  canna_send(fd_, &req, &rd);
+
+  data = canna_read_data(fd_, &rd, &count, &len);
+  if (count == CANNA_ERROR16)
+    ret_ = uim_scm_f();
+  else
+    ret_ = canna_decode_strings(data, len, count, 1);
+  free(data);
+  return ret_;
+}
+
+static void
+canna_put_dictionary_request(uim_wire_buf *req, int op, uim_lisp context_id_,
+			     uim_lisp dict_, uim_lisp mode_)
+{
+  const char *dict = REFER_C_STR(dict_);
+
+  canna_put_header(req, op, strlen(dict) + 7);
+  uim_wire_put_u32(req, C_INT(mode_));
+  uim_wire_put_u16(req, C_INT(context_id_));
+  uim_wire_put_s8(req, dict);
+}
+
+static uim_lisp
+c_canna_mount_dictionary(uim_lisp fd_, uim_lisp context_id_, uim_lisp dict_,
+			 uim_lisp mode_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  canna_put_dictionary_request(&req, CANNA_MOUNT_DICTIONARY,
+			       context_id_, dict_, mode_);
+  canna_send(fd_, &req, &rd);
+  return MAKE_BOOL(canna_read_result8(fd_, &rd) != CANNA_ERROR8);
+}
+
+/*
+ * cannaserver reads requests from a buffered stream, so the mount
+ * requests for all dictionaries go out in one write and the replies
+ * are collected afterwards in order.
+ */
+static uim_lisp
+c_canna_mount_dictionaries(uim_lisp fd_, uim_lisp context_id_,
+			   uim_lisp dicts_, uim_lisp mode_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  uim_lisp lst_, ret_;
+
+  uim_wire_buf_init(&req);
+  for (lst_ = dicts_; CONSP(lst_); lst_ = CDR(lst_))
+    canna_put_dictionary_request(&req, CANNA_MOUNT_DICTIONARY,
+				 context_id_, CAR(lst_), mode_);
+  if (UIM_WIRE_BUF_LEN(&req) == 0)
+    return uim_scm_null();
+  canna_send(fd_, &req, &rd);
+
+  ret_ = uim_scm_null();
+  for (lst_ = dicts_; CONSP(lst_); lst_ = CDR(lst_))
+    ret_ = CONS(MAKE_BOOL(canna_read_result8(fd_, &rd) != CANNA_ERROR8),
+		ret_);
+  return uim_scm_callf("reverse", "o", ret_);
+}
+
+static uim_lisp
+c_canna_unmount_dictionary(uim_lisp fd_, uim_lisp context_id_,
+			   uim_lisp dict_, uim_lisp mode_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  canna_put_dictionary_request(&req, CANNA_UNMOUNT_DICTIONARY,
+			       context_id_, dict_, mode_);
+  canna_send(fd_, &req, &rd);
+  return MAKE_BOOL(canna_read_result8(fd_, &rd) != CANNA_ERROR8);
+}
+
+/* how the strings of a reply are delimited */
+enum canna_strings {
+  CANNA_STRINGS_COUNTED,	/* as many as the count in the reply */
+  CANNA_STRINGS_UNTIL_EMPTY,	/* up to an empty string */
+  CANNA_STRINGS_ONE
+};
+
+/* a request with three u16 arguments, answered by a list of strings */
+static uim_lisp
+canna_string_list_request(uim_lisp fd_, int op, unsigned int a,
+			  unsigned int b, unsigned int c,
+			  enum canna_strings delim)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  unsigned char *data;
+  unsigned int count;
+  size_t len;
+  uim_lisp ret_;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, op, 6);
+  uim_wire_put_u16(&req, a);
+  uim_wire_put_u16(&req, b);
+  uim_wire_put_u16(&req, c);
+  canna_send(fd_, &req, &rd);
+
+  data = canna_read_data(fd_, &rd, &count, &len);
+  switch (delim) {
+  case CANNA_STRINGS_UNTIL_EMPTY:
+    ret_ = (count == CANNA_ERROR16) ? uim_scm_f()
+      : canna_decode_strings(data, len, -1, 2);
+    break;
+  case CANNA_STRINGS_ONE:
+    ret_ = canna_decode_strings(data, len, 1, 2);
+    break;
+  default:
+    ret_ = canna_decode_strings(data, len, count, 2);
+    break;
+  }
+  free(data);
+  return ret_;
+}
+
+static uim_lisp
+c_canna_begin_convert(uim_lisp fd_, uim_lisp context_id_, uim_lisp yomi_,
+		      uim_lisp mode_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  unsigned char *data;
+  unsigned int count;
+  size_t len;
+  const char *yomi = REFER_C_STR(yomi_);
+  uim_lisp ret_;
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_BEGIN_CONVERT, strlen(yomi) + 8);
+  uim_wire_put_u32(&req, C_INT(mode_));
+  uim_wire_put_u16(&req, C_INT(context_id_));
+  uim_wire_put_s16(&req, yomi);
+  canna_send(fd_, &req, &rd);
+
+  data = canna_read_data(fd_, &rd, &count, &len);
+  if (count == CANNA_ERROR16)
+    ret_ = uim_scm_f();
+  else
+    ret_ = canna_decode_strings(data, len, count, 2);
+  free(data);
+  return ret_;
+}
+
+static uim_lisp
+c_canna_end_convert(uim_lisp fd_, uim_lisp context_id_, uim_lisp cands_,
+		    uim_lisp mode_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+  uim_lisp lst_;
+  long n = uim_scm_length(cands_);
+
+  uim_wire_buf_init(&req);
+  canna_put_header(&req, CANNA_END_CONVERT, 2 * n + 8);
+  uim_wire_put_u16(&req, C_INT(context_id_));
+  uim_wire_put_u16(&req, n);
+  uim_wire_put_u32(&req, C_INT(mode_));
+  for (lst_ = cands_; CONSP(lst_); lst_ = CDR(lst_))
+    uim_wire_put_u16(&req, C_INT(CAR(lst_)));
+  canna_send(fd_, &req, &rd);
+  return MAKE_BOOL(canna_read_result8(fd_, &rd) != CANNA_ERROR8);
+}
+
+static uim_lisp
+c_canna_get_candidacy_list(uim_lisp fd_, uim_lisp context_id_,
+			   uim_lisp bunsetsu_pos_)
+{
+  return canna_string_list_request(fd_, CANNA_GET_CANDIDACY_LIST,
+				   C_INT(context_id_), C_INT(bunsetsu_pos_),
+				   CANNA_BUFSIZE, CANNA_STRINGS_COUNTED);
+}
+
+static uim_lisp
+c_canna_get_yomi(uim_lisp fd_, uim_lisp context_id_, uim_lisp bunsetsu_pos_)
+{
+  uim_lisp ret_;
+
+  ret_ = canna_string_list_request(fd_, CANNA_GET_YOMI,
+				   C_INT(context_id_), C_INT(bunsetsu_pos_),
+				   CANNA_BUFSIZE, CANNA_STRINGS_ONE);
+  return CONSP(ret_) ? CAR(ret_) : MAKE_STR("");
+}
+
+static uim_lisp
+c_canna_resize_pause(uim_lisp fd_, uim_lisp context_id_,
+		     uim_lisp yomi_length_, uim_lisp bunsetsu_pos_)
+{
+  return canna_string_list_request(fd_, CANNA_RESIZE_PAUSE,
+				   C_INT(context_id_), C_INT(bunsetsu_pos_),
+				   C_INT(yomi_length_),
+				   CANNA_STRINGS_UNTIL_EMPTY);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc2("canna-lib-initialize", c_canna_initialize);
+  uim_scm_init_proc1("canna-lib-finalize", c_canna_finalize);
+  uim_scm_init_proc1("canna-lib-create-context", c_canna_create_context);
+  uim_scm_init_proc2("canna-lib-close-context", c_canna_close_context);
+  uim_scm_init_proc2("canna-lib-get-dictionary-list",
+		     c_canna_get_dictionary_list);
+  uim_scm_init_proc4("canna-lib-mount-dictionary", c_canna_mount_dictionary);
+  uim_scm_init_proc4("canna-lib-mount-dictionaries",
+		     c_canna_mount_dictionaries);
+  uim_scm_init_proc4("canna-lib-unmount-dictionary",
+		     c_canna_unmount_dictionary);
+  uim_scm_init_proc4("canna-lib-begin-convert", c_canna_begin_convert);
+  uim_scm_init_proc4("canna-lib-end-convert", c_canna_end_convert);
+  uim_scm_init_proc3("canna-lib-get-candidacy-list",
+		     c_canna_get_candidacy_list);
+  uim_scm_init_proc3("canna-lib-get-yomi", c_canna_get_yomi);
+  uim_scm_init_proc4("canna-lib-resize-pause", c_canna_resize_pause);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  uim_wire_buf_free(&canna_reply_buf);
+}
@@ -42,6 +42,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/param.h>
+#include <sys/socket.h>
 #include <errno.h>
 
 #ifdef HAVE_POLL_H
@@ -60,6 +61,7 @@
 #include "uim-notify.h"
 #include "gettext.h"
 #include "dynlib.h"
+#include "wire.h"
 
 typedef struct {
   int flag;
@@ -176,13 +178,21 @@ c_file_read_internal(struct c_file_read_args *args)
 {
   int i;
   uim_lisp ret_ = uim_scm_null();
-  const unsigned char *p = args->buf;
 
-  ret_ = uim_scm_null();
-  for (i = 0; i < args->nr; i++) {
-    ret_ = CONS(MAKE_CHAR(*p), ret_);
-    p++;
-  }
+  /* cons from the tail to avoid reversing the list */
+  for (i = args->nr - 1; i >= 0; i--)
+    ret_ = CONS(MAKE_CHAR(args->buf[i]), ret_);
+  return ret_;
+}
+
+static uim_lisp
+c_file_read_u8list_internal(struct c_file_read_args *args)
+{
+  int i;
+  uim_lisp ret_ = uim_scm_null();
+
+  for (i = args->nr - 1; i >= 0; i--)
+    ret_ = CONS(MAKE_INT(args->buf[i]), ret_);
   return ret_;
 }
 
@@ -196,17 +206,41 @@ c_file_read(uim_lisp d_, uim_lisp nbytes_)
   struct c_file_read_args args;
 
   buf = uim_malloc(nbytes);
-  if ((nr = read(C_INT(d_), buf, nbytes)) == 0)
-    return uim_scm_eof();
-  if (nr < 0)
-    return uim_scm_f();
+  if ((nr = read(C_INT(d_), buf, nbytes)) <= 0) {
+    free(buf);
+    return (nr == 0) ? uim_scm_eof() : uim_scm_f();
+  }
 
   args.buf = buf;
   args.nr = nr;
   ret_ = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)c_file_read_internal,
 						    (void *)&args);
   free(buf);
-  return uim_scm_callf("reverse", "o", ret_);
+  return ret_;
+}
+
+/* same as file-read but returns a list of integers instead of chars */
+static uim_lisp
+c_file_read_u8list(uim_lisp d_, uim_lisp nbytes_)
+{
+  unsigned char *buf;
+  uim_lisp ret_;
+  int nbytes = C_INT(nbytes_);
+  int nr;
+  struct c_file_read_args args;
+
+  buf = uim_malloc(nbytes);
+  if ((nr = read(C_INT(d_), buf, nbytes)) <= 0) {
+    free(buf);
+    return (nr == 0) ? uim_scm_eof() : uim_scm_f();
+  }
+
+  args.buf = buf;
+  args.nr = nr;
+  ret_ = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)c_file_read_u8list_internal,
+						    (void *)&args);
+  free(buf);
+  return ret_;
 }
 
 static uim_lisp
@@ -364,6 +398,413 @@ c_create_pipe(void)
   return CONS(MAKE_INT(fildes[0]), MAKE_INT(fildes[1]));
 }
 
+/*
+ * byte buffer
+ *
+ * A uim_wire_buf used as the input buffer of file ports and for
+ * building binary protocol messages, so reading a message from a
+ * socket does not cons a list cell per byte. The buffer is not
+ * managed by the GC; free it with byte-buffer-free!.
+ */
+#define BYTE_BUFFER_LEN(b) UIM_WIRE_BUF_LEN(b)
+#define BYTE_BUFFER_HEAD(b) UIM_WIRE_BUF_HEAD(b)
+
+static uim_lisp sym_u8, sym_u16, sym_u32, sym_s8, sym_s16;
+static uim_lisp sym_u8list, sym_u16list;
+
+static uim_wire_buf *
+byte_buffer_get(uim_lisp buf_)
+{
+  uim_wire_buf *b = C_PTR(buf_);
+
+  if (!b)
+    ERROR_OBJ("invalid byte buffer", buf_);
+  return b;
+}
+
+/* appends a string, a char, an integer or a list of them */
+static void
+byte_buffer_append_obj(uim_wire_buf *b, uim_lisp obj_)
+{
+  if (STRP(obj_)) {
+    const char *str = REFER_C_STR(obj_);
+
+    uim_wire_put_bytes(b, str, strlen(str));
+  } else if (CHARP(obj_)) {
+    uim_wire_put_u8(b, C_CHAR(obj_));
+  } else if (INTP(obj_)) {
+    uim_wire_put_u8(b, C_INT(obj_));
+  } else if (CONSP(obj_) || NULLP(obj_)) {
+    for (; CONSP(obj_); obj_ = CDR(obj_))
+      byte_buffer_append_obj(b, CAR(obj_));
+  } else {
+    ERROR_OBJ("invalid byte sequence", obj_);
+  }
+}
+
+static uim_lisp
+c_make_byte_buffer(void)
+{
+  return MAKE_PTR(uim_calloc(1, sizeof(uim_wire_buf)));
+}
+
+static uim_lisp
+c_byte_buffer_free(uim_lisp buf_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+
+  free(b->data);
+  free(b);
+  uim_scm_nullify_c_ptr(buf_);
+  return uim_scm_t();
+}
+
+static uim_lisp
+c_byte_buffer_length(uim_lisp buf_)
+{
+  return MAKE_INT(BYTE_BUFFER_LEN(byte_buffer_get(buf_)));
+}
+
+static uim_lisp
+c_byte_buffer_clear(uim_lisp buf_)
+{
+  uim_wire_consume(byte_buffer_get(buf_), (size_t)-1);
+  return uim_scm_t();
+}
+
+/* reads at most nbytes from fd into the tail of the buffer */
+static uim_lisp
+c_byte_buffer_fill(uim_lisp buf_, uim_lisp fd_, uim_lisp nbytes_)
+{
+  ssize_t nr;
+
+  nr = uim_wire_fill(byte_buffer_get(buf_), C_INT(fd_), C_INT(nbytes_));
+  if (nr == 0)
+    return uim_scm_eof();
+  if (nr < 0)
+    return uim_scm_f();
+  return MAKE_INT(nr);
+}
+
+static uim_lisp
+c_byte_buffer_append(uim_lisp buf_, uim_lisp obj_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+
+  byte_buffer_append_obj(b, obj_);
+  return MAKE_INT(BYTE_BUFFER_LEN(b));
+}
+
+static uim_lisp
+c_byte_buffer_ref(uim_lisp buf_, uim_lisp k_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  long k = C_INT(k_);
+
+  if (k < 0 || (size_t)k >= BYTE_BUFFER_LEN(b))
+    return uim_scm_f();
+  return MAKE_INT(BYTE_BUFFER_HEAD(b)[k]);
+}
+
+/* returns the offset of delim at or after start, or #f */
+static uim_lisp
+c_byte_buffer_index(uim_lisp buf_, uim_lisp delim_, uim_lisp start_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  uim_wire_buf delim;
+  const unsigned char *found;
+
+  uim_wire_buf_init(&delim);
+  byte_buffer_append_obj(&delim, delim_);
+  found = uim_wire_find(b, C_INT(start_),
+			BYTE_BUFFER_HEAD(&delim), BYTE_BUFFER_LEN(&delim));
+  uim_wire_buf_free(&delim);
+
+  return found ? MAKE_INT(found - BYTE_BUFFER_HEAD(b)) : uim_scm_f();
+}
+
+static char *
+byte_buffer_strndup(uim_wire_buf *b, size_t n)
+{
+  char *str;
+
+  if (n > BYTE_BUFFER_LEN(b))
+    n = BYTE_BUFFER_LEN(b);
+  str = uim_malloc(n + 1);
+  memcpy(str, BYTE_BUFFER_HEAD(b), n);
+  str[n] = '\0';
+  return str;
+}
+
+static uim_lisp
+c_byte_buffer_to_string(uim_lisp buf_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+
+  return MAKE_STR_DIRECTLY(byte_buffer_strndup(b, BYTE_BUFFER_LEN(b)));
+}
+
+static uim_lisp
+c_byte_buffer_take_string(uim_lisp buf_, uim_lisp n_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  size_t n = C_INT(n_);
+  char *str = byte_buffer_strndup(b, n);
+
+  uim_wire_consume(b, n);
+  return MAKE_STR_DIRECTLY(str);
+}
+
+static uim_lisp
+c_byte_buffer_take_u8list(uim_lisp buf_, uim_lisp n_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  struct c_file_read_args args;
+  size_t n = C_INT(n_);
+  uim_lisp ret_;
+
+  if (n > BYTE_BUFFER_LEN(b))
+    n = BYTE_BUFFER_LEN(b);
+  args.buf = BYTE_BUFFER_HEAD(b);
+  args.nr = n;
+  ret_ = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)c_file_read_u8list_internal,
+						    (void *)&args);
+  uim_wire_consume(b, n);
+  return ret_;
+}
+
+static uim_lisp
+c_byte_buffer_drop(uim_lisp buf_, uim_lisp n_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+
+  uim_wire_consume(b, C_INT(n_));
+  return MAKE_INT(BYTE_BUFFER_LEN(b));
+}
+
+/* writes out the whole content and consumes what has been written */
+static uim_lisp
+c_byte_buffer_write(uim_lisp buf_, uim_lisp fd_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  size_t total = BYTE_BUFFER_LEN(b);
+
+  if (uim_wire_write(C_INT(fd_), b) < 0)
+    return uim_scm_f();
+  return MAKE_INT(total);
+}
+
+/*
+ * Binary pack/unpack with the same format as u8list-pack and
+ * u8list-unpack of lolevel.scm. Integers are in network byte order.
+ */
+static uim_lisp
+c_byte_buffer_pack(uim_lisp buf_, uim_lisp fmt_, uim_lisp args_)
+{
+  uim_wire_buf *b = byte_buffer_get(buf_);
+  uim_lisp f_, arg_;
+
+  for (; CONSP(fmt_) && CONSP(args_); fmt_ = CDR(fmt_), args_ = CDR(args_)) {
+    f_ = CAR(fmt_);
+    arg_ = CAR(args_);
+    if (uim_scm_eq(f_, sym_u8)) {
+      uim_wire_put_u8(b, C_INT(arg_));
+    } else if (uim_scm_eq(f_, sym_u16)) {
+      uim_wire_put_u16(b, C_INT(arg_));
+    } else if (uim_scm_eq(f_, sym_u32)) {
+      uim_wire_put_u32(b, C_INT(arg_));
+    } else if (uim_scm_eq(f_, sym_s8) || uim_scm_eq(f_, sym_s16)) {
+      const char *str = REFER_C_STR(arg_);
+
+      /* s16 is terminated by 2 NULs as u8list-pack does */
+      uim_wire_put_bytes(b, str, strlen(str) + 1);
+      if (uim_scm_eq(f_, sym_s16))
+	uim_wire_put_u8(b, 0);
+    } else if (uim_scm_eq(f_, sym_u8list)) {
+      byte_buffer_append_obj(b, arg_);
+    } else if (uim_scm_eq(f_, sym_u16list)) {
+      for (; CONSP(arg_); arg_ = CDR(arg_))
+	uim_wire_put_u16(b, C_INT(CAR(arg_)));
+    } else {
+      ERROR_OBJ("unknown byte operator", f_);
+    }
+  }
+  return MAKE_INT(BYTE_BUFFER_LEN(b));
+}
+
+struct byte_buffer_unpack_args {
+  uim_wire_buf *b;
+  uim_lisp fmt;
+};
+
+/* returns the number of bytes required by fmt, or -1 if not enough */
+static ssize_t
+byte_buffer_unpack_size(uim_wire_buf *b, uim_lisp fmt_)
+{
+  const unsigned char *p = BYTE_BUFFER_HEAD(b), *nul;
+  size_t len = BYTE_BUFFER_LEN(b), off = 0, n;
+  uim_lisp f_;
+
+  for (; CONSP(fmt_); fmt_ = CDR(fmt_)) {
+    f_ = CAR(fmt_);
+    if (uim_scm_eq(f_, sym_u8)) {
+      n = 1;
+    } else if (uim_scm_eq(f_, sym_u16)) {
+      n = 2;
+    } else if (uim_scm_eq(f_, sym_u32)) {
+      n = 4;
+    } else if (uim_scm_eq(f_, sym_s8) || uim_scm_eq(f_, sym_s16)) {
+      if (off >= len || !(nul = memchr(p + off, '\0', len - off)))
+	return -1;
+      n = nul - (p + off) + (uim_scm_eq(f_, sym_s16) ? 2 : 1);
+    } else if (uim_scm_eq(f_, sym_u8list)) {
+      n = len - off;
+    } else if (uim_scm_eq(f_, sym_u16list)) {
+      /* an odd byte at the end is left in the buffer */
+      n = (len - off) & ~(size_t)1;
+    } else {
+      ERROR_OBJ("unknown byte operator", f_);
+    }
+    if (off + n > len)
+      return -1;
+    off += n;
+  }
+  return off;
+}
+
+static uim_lisp
+byte_buffer_unpack_internal(struct byte_buffer_unpack_args *args)
+{
+  uim_wire_buf *b = args->b;
+  const unsigned char *p = BYTE_BUFFER_HEAD(b);
+  uim_lisp fmt_, f_, ret_ = uim_scm_null();
+  size_t off = 0, n;
+
+  for (fmt_ = args->fmt; CONSP(fmt_); fmt_ = CDR(fmt_)) {
+    f_ = CAR(fmt_);
+    if (uim_scm_eq(f_, sym_u8)) {
+      ret_ = CONS(MAKE_INT(p[off]), ret_);
+      off += 1;
+    } else if (uim_scm_eq(f_, sym_u16)) {
+      ret_ = CONS(MAKE_INT((p[off] << 8) | p[off + 1]), ret_);
+      off += 2;
+    } else if (uim_scm_eq(f_, sym_u32)) {
+      ret_ = CONS(MAKE_INT(((unsigned long)p[off] << 24)
+			   | ((unsigned long)p[off + 1] << 16)
+			   | ((unsigned long)p[off + 2] << 8)
+			   | p[off + 3]),
+		  ret_);
+      off += 4;
+    } else if (uim_scm_eq(f_, sym_s8) || uim_scm_eq(f_, sym_s16)) {
+      n = strlen((const char *)p + off);
+      ret_ = CONS(MAKE_STR((const char *)p + off), ret_);
+      off += n + (uim_scm_eq(f_, sym_s16) ? 2 : 1);
+    } else if (uim_scm_eq(f_, sym_u8list)) {
+      uim_lisp l_ = uim_scm_null();
+
+      for (n = BYTE_BUFFER_LEN(b); n > off; n--)
+	l_ = CONS(MAKE_INT(p[n - 1]), l_);
+      ret_ = CONS(l_, ret_);
+      off = BYTE_BUFFER_LEN(b);
+    } else if (uim_scm_eq(f_, sym_u16list)) {
+      uim_lisp l_ = uim_scm_null();
+      size_t end = off + ((BYTE_BUFFER_LEN(b) - off) & ~(size_t)1);
+
+      for (n = end; n > off; n -= 2)
+	l_ = CONS(MAKE_INT((p[n - 2] << 8) | p[n - 1]), l_);
+      ret_ = CONS(l_, ret_);
+      off = end;
+    }
+  }
+  uim_wire_consume(b, off);
+  return uim_scm_callf("reverse", "o", ret_);
+}
+
+/* returns #f without consuming anything if the buffer is too short */
+static uim_lisp
+c_byte_buffer_unpack(uim_lisp buf_, uim_lisp fmt_)
+{
+  struct byte_buffer_unpack_args args;
+
+  args.b = byte_buffer_get(buf_);
+  args.fmt = fmt_;
+  if (byte_buffer_unpack_size(args.b, fmt_) < 0)
+    return uim_scm_f();
+
+  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)byte_buffer_unpack_internal,
+						    (void *)&args);
+}
+
+/*
+ * Reads a string terminated by delim from fd without reading beyond
+ * the terminator. Sockets are peeked with MSG_PEEK to read chunks
+ * instead of issuing read(2) for each byte.
+ */
+static uim_lisp
+c_file_read_until(uim_lisp fd_, uim_lisp delim_)
+{
+  uim_wire_buf acc, delim;
+  int fd = C_INT(fd_);
+  int peekable = 1;
+  const unsigned char *found = NULL;
+  size_t delim_len, from, prev, n;
+  ssize_t nr;
+  char *str;
+
+  uim_wire_buf_init(&acc);
+  uim_wire_buf_init(&delim);
+  byte_buffer_append_obj(&delim, delim_);
+  delim_len = BYTE_BUFFER_LEN(&delim);
+  if (delim_len == 0) {
+    uim_wire_buf_free(&delim);
+    return MAKE_STR("");
+  }
+
+  while (!found) {
+    unsigned char *p = uim_wire_reserve(&acc, BUFSIZ);
+
+    nr = -1;
+    if (peekable) {
+      nr = recv(fd, p, BUFSIZ, MSG_PEEK);
+      if (nr < 0 && errno == ENOTSOCK)
+	peekable = 0;
+    }
+    if (!peekable)
+      nr = read(fd, p, 1);
+    if (nr < 0 && errno == EINTR)
+      continue;
+    if (nr <= 0) {
+      uim_wire_buf_free(&acc);
+      uim_wire_buf_free(&delim);
+      return (nr == 0) ? uim_scm_eof() : uim_scm_f();
+    }
+
+    /* the terminator may straddle the previous chunk */
+    prev = acc.tail;
+    from = (prev >= delim_len - 1) ? prev - (delim_len - 1) : 0;
+    acc.tail += nr;
+    found = uim_wire_find(&acc, from, BYTE_BUFFER_HEAD(&delim), delim_len);
+    n = found ? (size_t)(found - acc.data) + delim_len - prev : (size_t)nr;
+    acc.tail = prev + n;
+    if (peekable) {
+      /* consume what is actually needed */
+      do {
+	nr = read(fd, p, n);
+      } while (nr < 0 && errno == EINTR);
+      if (nr != (ssize_t)n) {
+	uim_wire_buf_free(&acc);
+	uim_wire_buf_free(&delim);
+	return uim_scm_f();
+      }
+    }
+  }
+
+  str = byte_buffer_strndup(&acc, BYTE_BUFFER_LEN(&acc) - delim_len);
+  uim_wire_buf_free(&acc);
+  uim_wire_buf_free(&delim);
+  return MAKE_STR_DIRECTLY(str);
+}
+
 void
 uim_plugin_instance_init(void)
 {
@@ -391,6 +832,40 @@ uim_plugin_instance_init(void)
   uim_scm_gc_protect(&uim_lisp_poll_flags);
 
   uim_scm_init_proc0("create-pipe", c_create_pipe);
+
+  uim_scm_init_proc2("file-read-u8list", c_file_read_u8list);
+  uim_scm_init_proc2("file-read-until", c_file_read_until);
+
+  uim_scm_init_proc0("make-byte-buffer", c_make_byte_buffer);
+  uim_scm_init_proc1("byte-buffer-free!", c_byte_buffer_free);
+  uim_scm_init_proc1("byte-buffer-length", c_byte_buffer_length);
+  uim_scm_init_proc1("byte-buffer-clear!", c_byte_buffer_clear);
+  uim_scm_init_proc3("byte-buffer-fill!", c_byte_buffer_fill);
+  uim_scm_init_proc2("byte-buffer-append!", c_byte_buffer_append);
+  uim_scm_init_proc2("byte-buffer-ref", c_byte_buffer_ref);
+  uim_scm_init_proc3("byte-buffer-index", c_byte_buffer_index);
+  uim_scm_init_proc1("byte-buffer->string", c_byte_buffer_to_string);
+  uim_scm_init_proc2("byte-buffer-take-string!", c_byte_buffer_take_string);
+  uim_scm_init_proc2("byte-buffer-take-u8list!", c_byte_buffer_take_u8list);
+  uim_scm_init_proc2("byte-buffer-drop!", c_byte_buffer_drop);
+  uim_scm_init_proc2("byte-buffer-write", c_byte_buffer_write);
+  uim_scm_init_proc3("byte-buffer-pack!", c_byte_buffer_pack);
+  uim_scm_init_proc2("byte-buffer-unpack!", c_byte_buffer_unpack);
+
+  sym_u8 = MAKE_SYM("u8");
+  sym_u16 = MAKE_SYM("u16");
+  sym_u32 = MAKE_SYM("u32");
+  sym_s8 = MAKE_SYM("s8");
+  sym_s16 = MAKE_SYM("s16");
+  sym_u8list = MAKE_SYM("u8list");
+  sym_u16list = MAKE_SYM("u16list");
+  uim_scm_gc_protect(&sym_u8);
+  uim_scm_gc_protect(&sym_u16);
+  uim_scm_gc_protect(&sym_u32);
+  uim_scm_gc_protect(&sym_s8);
+  uim_scm_gc_protect(&sym_s16);
+  uim_scm_gc_protect(&sym_u8list);
+  uim_scm_gc_protect(&sym_u16list);
 }
 
 void
@@ -400,4 +875,11 @@ uim_plugin_instance_quit(void)
   uim_scm_gc_unprotect(&uim_lisp_open_mode);
   uim_scm_gc_unprotect(&uim_lisp_position_whence);
   uim_scm_gc_unprotect(&uim_lisp_poll_flags);
+  uim_scm_gc_unprotect(&sym_u8);
+  uim_scm_gc_unprotect(&sym_u16);
+  uim_scm_gc_unprotect(&sym_u32);
+  uim_scm_gc_unprotect(&sym_s8);
+  uim_scm_gc_unprotect(&sym_s16);
+  uim_scm_gc_unprotect(&sym_u8list);
+  uim_scm_gc_unprotect(&sym_u16list);
 }
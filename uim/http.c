@@ -0,0 +1,583 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * HTTP/1.1 response parser for http-client.scm.
+ *
+ * The parser is fed by raw bytes, either read(2) directly from a
+ * socket or passed as a file-buf (list of chars) from a Scheme port
+ * such as the openssl one, and recognizes the status line, header
+ * fields and the message body framed by Content-Length, chunked
+ * transfer-coding or connection close. It also determines whether the
+ * connection can be reused for the next request.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+#define HTTP_READ_BUFSIZ 8192
+
+#ifndef HAVE_SIG_T
+typedef void (*sig_t)(int);
+#endif
+
+enum http_parser_state {
+  HTTP_STATUS_LINE,
+  HTTP_HEADER,
+  HTTP_BODY,
+  HTTP_CHUNK_SIZE,
+  HTTP_CHUNK_DATA,
+  HTTP_CHUNK_DATA_END,
+  HTTP_TRAILER,
+  HTTP_DONE,
+  HTTP_ERROR
+};
+
+struct http_buf {
+  char *str;
+  size_t len;
+  size_t size;
+};
+
+struct http_header {
+  char *name;
+  char *value;
+};
+
+struct http_parser {
+  enum http_parser_state state;
+  uim_bool head_only;    /* response has no body (e.g. CONNECT, HEAD) */
+  uim_bool received;     /* at least one byte arrived */
+  uim_bool eof;
+  uim_bool keep_alive;
+  uim_bool chunked;
+  long content_length;   /* -1 if not given */
+  size_t remain;         /* rest of the body or the current chunk */
+  int status;
+  struct http_buf in;
+  size_t in_pos;
+  struct http_buf body;
+  struct http_header *headers;
+  int nr_headers;
+};
+
+static void
+http_buf_append(struct http_buf *buf, const char *str, size_t len)
+{
+  if (buf->len + len + 1 > buf->size) {
+    size_t size = buf->size ? buf->size : 256;
+
+    while (buf->len + len + 1 > size)
+      size *= 2;
+    buf->str = uim_realloc(buf->str, size);
+    buf->size = size;
+  }
+  memcpy(buf->str + buf->len, str, len);
+  buf->len += len;
+  buf->str[buf->len] = '\0';
+}
+
+static void
+http_parser_free(struct http_parser *p)
+{
+  int i;
+
+  for (i = 0; i < p->nr_headers; i++) {
+    free(p->headers[i].name);
+    free(p->headers[i].value);
+  }
+  free(p->headers);
+  free(p->in.str);
+  free(p->body.str);
+  free(p);
+}
+
+static char *
+http_strndup_trim(const char *str, size_t len)
+{
+  char *ret;
+
+  while (len > 0 && (*str == ' ' || *str == '\t')) {
+    str++;
+    len--;
+  }
+  while (len > 0 && (str[len - 1] == ' ' || str[len - 1] == '\t'))
+    len--;
+  ret = uim_malloc(len + 1);
+  memcpy(ret, str, len);
+  ret[len] = '\0';
+
+  return ret;
+}
+
+static uim_bool
+http_token_contains(const char *value, const char *token)
+{
+  size_t len = strlen(token);
+  const char *p;
+
+  for (p = value; *p; p++)
+    if (strncasecmp(p, token, len) == 0)
+      return UIM_TRUE;
+  return UIM_FALSE;
+}
+
+static void
+http_parser_add_header(struct http_parser *p, const char *line, size_t len)
+{
+  const char *colon;
+  struct http_header *h;
+
+  /* obsolete line folding */
+  if ((*line == ' ' || *line == '\t') && p->nr_headers > 0) {
+    char *cont = http_strndup_trim(line, len);
+    struct http_buf value;
+
+    h = &p->headers[p->nr_headers - 1];
+    value.str = h->value;
+    value.len = strlen(h->value);
+    value.size = value.len + 1;
+    http_buf_append(&value, " ", 1);
+    http_buf_append(&value, cont, strlen(cont));
+    h->value = value.str;
+    free(cont);
+    return;
+  }
+
+  colon = memchr(line, ':', len);
+  if (!colon)
+    return;
+
+  p->headers = uim_realloc(p->headers,
+                           sizeof(struct http_header) * (p->nr_headers + 1));
+  h = &p->headers[p->nr_headers++];
+  h->name = http_strndup_trim(line, colon - line);
+  h->value = http_strndup_trim(colon + 1, len - (colon - line) - 1);
+
+  if (strcasecmp(h->name, "Content-Length") == 0) {
+    char *end;
+    long l = strtol(h->value, &end, 10);
+
+    if (end != h->value && l >= 0)
+      p->content_length = l;
+  } else if (strcasecmp(h->name, "Transfer-Encoding") == 0) {
+    if (http_token_contains(h->value, "chunked"))
+      p->chunked = UIM_TRUE;
+  } else if (strcasecmp(h->name, "Connection") == 0) {
+    if (http_token_contains(h->value, "close"))
+      p->keep_alive = UIM_FALSE;
+    else if (http_token_contains(h->value, "keep-alive"))
+      p->keep_alive = UIM_TRUE;
+  }
+}
+
+static uim_bool
+http_parser_status_line(struct http_parser *p, const char *line, size_t len)
+{
+  int major, minor, status;
+  char *buf;
+  uim_bool ret;
+
+  buf = http_strndup_trim(line, len);
+  ret = (sscanf(buf, "HTTP/%d.%d %d", &major, &minor, &status) == 3);
+  free(buf);
+  if (!ret)
+    return UIM_FALSE;
+
+  p->status = status;
+  /* persistent by default since HTTP/1.1 */
+  p->keep_alive = (major > 1 || (major == 1 && minor >= 1));
+
+  return UIM_TRUE;
+}
+
+static void
+http_parser_end_of_header(struct http_parser *p)
+{
+  if (p->status >= 100 && p->status < 200) {
+    /* interim response such as 100 Continue */
+    p->state = HTTP_STATUS_LINE;
+    return;
+  }
+  if (p->head_only || p->status == 204 || p->status == 304) {
+    p->state = HTTP_DONE;
+  } else if (p->chunked) {
+    p->state = HTTP_CHUNK_SIZE;
+  } else if (p->content_length >= 0) {
+    p->remain = p->content_length;
+    p->state = p->remain ? HTTP_BODY : HTTP_DONE;
+  } else {
+    /* delimited by close */
+    p->keep_alive = UIM_FALSE;
+    p->state = HTTP_BODY;
+  }
+}
+
+/* Returns a line without CRLF, or NULL if the line is incomplete. */
+static const char *
+http_parser_getline(struct http_parser *p, size_t *len)
+{
+  const char *line = p->in.str + p->in_pos;
+  const char *nl;
+
+  nl = memchr(line, '\n', p->in.len - p->in_pos);
+  if (!nl)
+    return NULL;
+
+  *len = nl - line;
+  p->in_pos += *len + 1;
+  if (*len > 0 && line[*len - 1] == '\r')
+    (*len)--;
+
+  return line;
+}
+
+static void
+http_parser_execute(struct http_parser *p)
+{
+  const char *line;
+  size_t len;
+
+  while (p->state != HTTP_DONE && p->state != HTTP_ERROR) {
+    size_t avail = p->in.len - p->in_pos;
+
+    switch (p->state) {
+    case HTTP_STATUS_LINE:
+      if (!(line = http_parser_getline(p, &len)))
+        goto need_more;
+      if (len == 0)
+        break;  /* tolerate an extra CRLF */
+      p->state = http_parser_status_line(p, line, len) ? HTTP_HEADER : HTTP_ERROR;
+      break;
+    case HTTP_HEADER:
+      if (!(line = http_parser_getline(p, &len)))
+        goto need_more;
+      if (len == 0)
+        http_parser_end_of_header(p);
+      else
+        http_parser_add_header(p, line, len);
+      break;
+    case HTTP_BODY:
+      if (avail == 0)
+        goto need_more;
+      if (p->content_length < 0) {
+        http_buf_append(&p->body, p->in.str + p->in_pos, avail);
+        p->in_pos += avail;
+        break;
+      }
+      /* FALLTHROUGH */
+    case HTTP_CHUNK_DATA:
+      if (avail == 0)
+        goto need_more;
+      len = (avail < p->remain) ? avail : p->remain;
+      http_buf_append(&p->body, p->in.str + p->in_pos, len);
+      p->in_pos += len;
+      p->remain -= len;
+      if (p->remain == 0)
+        p->state = (p->state == HTTP_BODY) ? HTTP_DONE : HTTP_CHUNK_DATA_END;
+      break;
+    case HTTP_CHUNK_DATA_END:
+      if (!(line = http_parser_getline(p, &len)))
+        goto need_more;
+      p->state = HTTP_CHUNK_SIZE;
+      break;
+    case HTTP_CHUNK_SIZE:
+      if (!(line = http_parser_getline(p, &len)))
+        goto need_more;
+      {
+        char *buf = http_strndup_trim(line, len);
+        char *end;
+        unsigned long size = strtoul(buf, &end, 16);
+
+        if (end == buf) {
+          p->state = HTTP_ERROR;
+        } else if (size == 0) {
+          p->state = HTTP_TRAILER;
+        } else {
+          p->remain = size;
+          p->state = HTTP_CHUNK_DATA;
+        }
+        free(buf);
+      }
+      break;
+    case HTTP_TRAILER:
+      if (!(line = http_parser_getline(p, &len)))
+        goto need_more;
+      if (len == 0)
+        p->state = HTTP_DONE;
+      break;
+    default:
+      break;
+    }
+  }
+
+ need_more:
+  /* discard consumed input */
+  if (p->in_pos > 0) {
+    memmove(p->in.str, p->in.str + p->in_pos, p->in.len - p->in_pos);
+    p->in.len -= p->in_pos;
+    p->in_pos = 0;
+    p->in.str[p->in.len] = '\0';
+  }
+
+  if (p->eof && p->state != HTTP_DONE) {
+    if (p->state == HTTP_BODY && p->content_length < 0)
+      p->state = HTTP_DONE;
+    else
+      p->state = HTTP_ERROR;
+  }
+}
+
+static uim_lisp
+http_parser_state_sym(struct http_parser *p)
+{
+  switch (p->state) {
+  case HTTP_DONE:
+    return MAKE_SYM("done");
+  case HTTP_ERROR:
+    /* peer closed or reset the connection before responding */
+    if (p->eof && !p->received)
+      return MAKE_SYM("closed");
+    return MAKE_SYM("error");
+  default:
+    return MAKE_SYM("continue");
+  }
+}
+
+static uim_lisp
+c_make_http_response_parser(uim_lisp head_only_)
+{
+  struct http_parser *p;
+
+  p = uim_malloc(sizeof(*p));
+  memset(p, 0, sizeof(*p));
+  p->state = HTTP_STATUS_LINE;
+  p->head_only = C_BOOL(head_only_);
+  p->content_length = -1;
+
+  return MAKE_PTR(p);
+}
+
+static uim_lisp
+c_delete_http_response_parser(uim_lisp p_)
+{
+  http_parser_free(C_PTR(p_));
+  return uim_scm_t();
+}
+
+static uim_lisp
+c_http_response_parser_read(uim_lisp p_, uim_lisp fd_)
+{
+  struct http_parser *p = C_PTR(p_);
+  char buf[HTTP_READ_BUFSIZ];
+  ssize_t nr;
+
+  nr = read(C_INT(fd_), buf, sizeof(buf));
+  if (nr < 0) {
+    if (errno == EINTR || errno == EAGAIN)
+      return http_parser_state_sym(p);
+    /* a reused connection dropped by the server */
+    if (errno == ECONNRESET || errno == EPIPE)
+      p->eof = UIM_TRUE;
+    p->state = HTTP_ERROR;
+    return http_parser_state_sym(p);
+  }
+  if (nr == 0) {
+    p->eof = UIM_TRUE;
+  } else {
+    p->received = UIM_TRUE;
+    http_buf_append(&p->in, buf, nr);
+  }
+  http_parser_execute(p);
+
+  return http_parser_state_sym(p);
+}
+
+static uim_lisp
+c_http_response_parser_feed(uim_lisp p_, uim_lisp buf_)
+{
+  struct http_parser *p = C_PTR(p_);
+  char buf[HTTP_READ_BUFSIZ];
+  size_t len = 0;
+
+  if (FALSEP(buf_)) {
+    /* the TLS layer doesn't tell a reset from other errors */
+    p->eof = UIM_TRUE;
+    p->state = HTTP_ERROR;
+    return http_parser_state_sym(p);
+  }
+  if (!CONSP(buf_) && !NULLP(buf_)) {
+    /* eof-object */
+    p->eof = UIM_TRUE;
+  }
+  for (; CONSP(buf_); buf_ = CDR(buf_)) {
+    buf[len++] = C_CHAR(CAR(buf_));
+    if (len == sizeof(buf)) {
+      http_buf_append(&p->in, buf, len);
+      len = 0;
+    }
+    p->received = UIM_TRUE;
+  }
+  http_buf_append(&p->in, buf, len);
+  http_parser_execute(p);
+
+  return http_parser_state_sym(p);
+}
+
+/* Writes a request to a plain socket. Returns #t, 'closed if the
+ * server has closed or reset the connection, or #f on other errors.
+ * SIGPIPE is not raised for a closed connection. */
+static uim_lisp
+c_http_send_request(uim_lisp fd_, uim_lisp request_)
+{
+  int fd = C_INT(fd_);
+  const char *p = REFER_C_STR(request_);
+  size_t len = strlen(p);
+  ssize_t nr;
+  int err = 0;
+#ifndef MSG_NOSIGNAL
+  sig_t old_sigpipe = signal(SIGPIPE, SIG_IGN);
+#endif
+
+  while (len > 0) {
+#ifdef MSG_NOSIGNAL
+    nr = send(fd, p, len, MSG_NOSIGNAL);
+#else
+    nr = write(fd, p, len);
+#endif
+    if (nr < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      err = errno;
+      break;
+    }
+    p += nr;
+    len -= nr;
+  }
+#ifndef MSG_NOSIGNAL
+  signal(SIGPIPE, old_sigpipe);
+#endif
+
+  if (!err)
+    return uim_scm_t();
+  if (err == EPIPE || err == ECONNRESET)
+    return MAKE_SYM("closed");
+  return uim_scm_f();
+}
+
+static uim_lisp
+c_http_response_parser_status(uim_lisp p_)
+{
+  struct http_parser *p = C_PTR(p_);
+
+  return MAKE_INT(p->status);
+}
+
+static uim_lisp
+c_http_response_parser_keep_alive(uim_lisp p_)
+{
+  struct http_parser *p = C_PTR(p_);
+
+  /* unexpected bytes after the response make the connection unusable */
+  return MAKE_BOOL(p->state == HTTP_DONE && p->keep_alive && p->in.len == 0);
+}
+
+static void *
+c_http_response_parser_header_internal(struct http_parser *p)
+{
+  uim_lisp ret_ = uim_scm_null();
+  int i;
+
+  for (i = p->nr_headers - 1; i >= 0; i--)
+    ret_ = CONS(CONS(MAKE_STR(p->headers[i].name),
+                     MAKE_STR(p->headers[i].value)),
+                ret_);
+  return (void *)ret_;
+}
+
+static uim_lisp
+c_http_response_parser_header(uim_lisp p_)
+{
+  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)c_http_response_parser_header_internal,
+                                                    C_PTR(p_));
+}
+
+static uim_lisp
+c_http_response_parser_body(uim_lisp p_)
+{
+  struct http_parser *p = C_PTR(p_);
+  char *body;
+
+  if (!p->body.str)
+    return MAKE_STR("");
+
+  /* hand the buffer over to the string object */
+  body = p->body.str;
+  memset(&p->body, 0, sizeof(p->body));
+  return MAKE_STR_DIRECTLY(body);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc1("make-http-response-parser", c_make_http_response_parser);
+  uim_scm_init_proc1("delete-http-response-parser", c_delete_http_response_parser);
+  uim_scm_init_proc2("http-response-parser-read!", c_http_response_parser_read);
+  uim_scm_init_proc2("http-response-parser-feed!", c_http_response_parser_feed);
+  uim_scm_init_proc2("http-send-request", c_http_send_request);
+  uim_scm_init_proc1("http-response-parser-status", c_http_response_parser_status);
+  uim_scm_init_proc1("http-response-parser-header", c_http_response_parser_header);
+  uim_scm_init_proc1("http-response-parser-body", c_http_response_parser_body);
+  uim_scm_init_proc1("http-response-parser-keep-alive?", c_http_response_parser_keep_alive);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+}
@@ -30,6 +30,8 @@
 
 */
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -37,10 +39,92 @@
 #include "uim-scm.h"
 #include "uim-scm-abbrev.h"
 #include "uim-helper.h"
+#include "uim-trace.h"
 #include "dynlib.h"
 
 #include "bsdlook.h"
 
+/*
+ * Dictionaries such as the composing tables in $(pkgdatadir)/tables are
+ * looked up several times per key press. Keep recently used ones
+ * mapped instead of mapping them for each lookup. Only the mappings are
+ * kept; bsdlook closes the files once they are mapped.
+ */
+#define LOOK_DICT_CACHE_SIZE 8
+
+struct look_dict {
+  char *path;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  uim_look_ctx *ctx;
+};
+
+static struct look_dict look_dict_cache[LOOK_DICT_CACHE_SIZE];
+
+static void
+look_dict_free(struct look_dict *dict)
+{
+  free(dict->path);
+  uim_look_finish(dict->ctx);
+  memset(dict, 0, sizeof(*dict));
+}
+
+static uim_look_ctx *
+look_dict_open(const char *path)
+{
+  struct look_dict *dict, tmp;
+  struct stat st;
+  int i;
+
+  if (stat(path, &st) == -1)
+    return NULL;
+
+  for (i = 0; i < LOOK_DICT_CACHE_SIZE; i++) {
+    dict = &look_dict_cache[i];
+    if (!dict->path || strcmp(dict->path, path) != 0)
+      continue;
+    if (dict->dev == st.st_dev && dict->ino == st.st_ino
+        && dict->size == st.st_size && dict->mtime == st.st_mtime)
+      break;
+    /* the file has been replaced */
+    look_dict_free(dict);
+  }
+
+  if (i == LOOK_DICT_CACHE_SIZE) {
+    uim_look_ctx *ctx;
+
+    if (!(ctx = uim_look_init()))
+      uim_fatal_error("uim_look_init() failed");
+    if (!uim_look_open_dict(path, ctx)) {
+      uim_look_finish(ctx);
+      return NULL;
+    }
+    /* take a vacant slot, or evict the least recently used one */
+    for (i = 0; i < LOOK_DICT_CACHE_SIZE - 1; i++)
+      if (!look_dict_cache[i].path)
+        break;
+    if (look_dict_cache[i].path)
+      look_dict_free(&look_dict_cache[i]);
+    dict = &look_dict_cache[i];
+    dict->path = uim_strdup(path);
+    dict->dev = st.st_dev;
+    dict->ino = st.st_ino;
+    dict->size = st.st_size;
+    dict->mtime = st.st_mtime;
+    dict->ctx = ctx;
+  }
+
+  /* move to front */
+  tmp = look_dict_cache[i];
+  memmove(&look_dict_cache[1], &look_dict_cache[0], sizeof(struct look_dict) * i);
+  look_dict_cache[0] = tmp;
+
+  uim_look_reset(look_dict_cache[0].ctx);
+  return look_dict_cache[0].ctx;
+}
+
 struct uim_look_look_internal_args {
   uim_look_ctx *ctx;
   char *dict_str;
@@ -79,23 +163,20 @@ uim_look_look(uim_lisp isdict_, uim_lisp iscase_, uim_lisp words_, uim_lisp dict
   char *dict_str;
   uim_lisp ret_ = uim_scm_f();
   int words = -1;
+  struct uim_trace_span span;
 
-  ctx = uim_look_init();
+  if (!(ctx = look_dict_open(dict)))
+    return ret_;
 
   uim_look_set_option_dictionary_order(C_BOOL(isdict_), ctx);
   uim_look_set_option_ignore_case(C_BOOL(iscase_), ctx);
 
-  if (!ctx)
-    uim_fatal_error("uim_look_init() failed");
-
-  if (!uim_look_open_dict(dict, ctx))
-    return ret_;
-
   dict_str = uim_strdup(str);
 
   if (INTP(words_))
     words = C_INT(words_);
 
+  UIM_TRACE_BEGIN(&span, "look-lib-look");
   ret_ = uim_scm_null();
   if (uim_look(dict_str, ctx) != 0) {
     struct uim_look_look_internal_args args;
@@ -109,8 +190,8 @@ uim_look_look(uim_lisp isdict_, uim_lisp iscase_, uim_lisp words_, uim_lisp dict
 						      (void *)&args);
   }
 
-  uim_look_finish(ctx);
   free(dict_str);
+  UIM_TRACE_END(&span);
 
   return uim_scm_callf("reverse", "o", ret_);
 }
@@ -124,4 +205,9 @@ uim_plugin_instance_init(void)
 void
 uim_plugin_instance_quit(void)
 {
+  int i;
+
+  for (i = 0; i < LOOK_DICT_CACHE_SIZE; i++)
+    if (look_dict_cache[i].path)
+      look_dict_free(&look_dict_cache[i]);
 }
@@ -60,25 +60,78 @@ static FILE *mana_r;
 static FILE *mana_w;
 static pid_t mana_pid;
 
+/*
+ * Commands nobody waits an answer for (learning) are not sent at once
+ * but queued, and go out in the same write as the next command that
+ * needs an answer.  Their replies are skipped before reading that
+ * answer.
+ */
+static char *mana_queue;
+static size_t mana_queue_len, mana_queue_size;
+static int mana_nr_pending;
+
 static char *mana_ipc_send_command(pid_t *pid,
 				   FILE **read_fp, FILE **write_fp,
 				   const char *str);
 static uim_lisp mana_init(void);
 static uim_lisp mana_eval(uim_lisp buf_);
+static uim_lisp mana_queue_command(uim_lisp buf_);
+static uim_lisp mana_send_queue(void);
 static uim_lisp eucjp_string_length(uim_lisp str_);
 
 #ifdef DEBUG
 static FILE *log;
 #endif
 
+static void
+mana_ipc_clear_queue(void)
+{
+  mana_queue_len = 0;
+  mana_nr_pending = 0;
+}
+
+static void
+mana_ipc_close(pid_t *pid, FILE **read_fp, FILE **write_fp)
+{
+  *pid = 0;
+  fclose(*read_fp);
+  fclose(*write_fp);
+  *read_fp = NULL;
+  *write_fp = NULL;
+  mana_ipc_clear_queue();
+}
+
+/* one reply line, read into a buffer grown by doubling */
+static char *
+mana_ipc_read_line(FILE *fp)
+{
+  char *line = NULL;
+  size_t len = 0, size = 0;
+
+  for (;;) {
+    if (size - len < 2) {
+      size = size ? size * 2 : 8192;
+      line = uim_realloc(line, size);
+    }
+    if (fgets(line + len, size - len, fp) == NULL)
+      break;
+    len += strlen(line + len);
+    if (line[len - 1] == '\n')
+      return line;
+  }
+  if (len > 0)
+    return line;
+
+  free(line);
+  return NULL;
+}
+
 static char *
 mana_ipc_send_command(pid_t *pid,
 		      FILE **read_fp, FILE **write_fp,
 		      const char *str)
 {
-  char *tmp = uim_strdup("");
-  char buf[8192];
-
+  char *line;
   struct sigaction act, oact;
 
   act.sa_handler = SIG_IGN;
@@ -87,6 +140,8 @@ mana_ipc_send_command(pid_t *pid,
 
   sigaction(SIGPIPE, &act, &oact);
 
+  if (mana_queue_len > 0)
+    fwrite(mana_queue, 1, mana_queue_len, *write_fp);
   fputs(str, *write_fp);
 
  again:
@@ -96,29 +151,20 @@ mana_ipc_send_command(pid_t *pid,
       goto again;
     case EPIPE:
 
-      while (!feof(*read_fp)) {
-        fgets(buf, sizeof(buf), *read_fp);
-        if (buf != NULL) {
-          if (strcmp(buf, "err") == 0)
-            uim_notify_fatal(N_("uim-mana: Command 'mana' not found."));
-          else
-            uim_notify_fatal("uim-mana: %s", buf);
-	}
+      while ((line = mana_ipc_read_line(*read_fp)) != NULL) {
+        if (strcmp(line, "err") == 0)
+          uim_notify_fatal(N_("uim-mana: Command 'mana' not found."));
+        else
+          uim_notify_fatal("uim-mana: %s", line);
+        free(line);
       }
 
-      *pid = 0;
-      fclose(*read_fp);
-      fclose(*write_fp);
-      *read_fp = NULL;
-      *write_fp = NULL;
-
+      mana_ipc_close(pid, read_fp, write_fp);
       sigaction(SIGPIPE, &oact, NULL);
-      free(tmp);
-
       return NULL;
     default:
+      mana_ipc_clear_queue();
       sigaction(SIGPIPE, &oact, NULL);
-      free(tmp);
       return NULL;
     }
   }
@@ -126,27 +172,19 @@ mana_ipc_send_command(pid_t *pid,
   sigaction(SIGPIPE, &oact, NULL);
 
   if (feof(*read_fp)) {
-    *pid = 0;
-    fclose(*read_fp);
-    fclose(*write_fp);
-    *read_fp = NULL;
-    *write_fp = NULL;
-    free(tmp);
+    mana_ipc_close(pid, read_fp, write_fp);
     return NULL;
   }
 
-  while (fgets (buf, sizeof(buf), *read_fp) != NULL) {
-
-    tmp = uim_realloc(tmp, strlen(tmp) + strlen(buf) + 1);
-    strcat(tmp, buf);
-
-    if (strchr( buf, '\n' )) {
+  /* skip the replies to the queued commands */
+  for (; mana_nr_pending > 0; mana_nr_pending--) {
+    if ((line = mana_ipc_read_line(*read_fp)) == NULL)
       break;
-    }
+    free(line);
   }
- 
-  return tmp;
+  mana_ipc_clear_queue();
 
+  return mana_ipc_read_line(*read_fp);
 }
 
 static uim_lisp
@@ -187,6 +225,13 @@ mana_init(void)
   return uim_scm_t();
 }
 
+/* mana is started again if it has exited */
+static uim_bool
+mana_ipc_start(void)
+{
+  return (mana_pid != 0 || C_BOOL(mana_init()));
+}
+
 static uim_lisp
 mana_eval(uim_lisp buf_)
 {
@@ -195,7 +240,7 @@ mana_eval(uim_lisp buf_)
   char *eval_buf;
   uim_lisp ret;
 
-  if (mana_pid == 0)
+  if (!mana_ipc_start())
     return uim_scm_f();
 
   ret_buf = mana_ipc_send_command(&mana_pid, &mana_r, &mana_w, buf);
@@ -217,6 +262,66 @@ mana_eval(uim_lisp buf_)
   return ret;
 }
 
+static uim_lisp
+mana_queue_command(uim_lisp buf_)
+{
+  const char *buf = REFER_C_STR(buf_);
+  size_t len = strlen(buf);
+
+  if (!mana_ipc_start())
+    return uim_scm_f();
+
+  if (mana_queue_len + len > mana_queue_size) {
+    mana_queue_size = mana_queue_len + len + 1024;
+    mana_queue = uim_realloc(mana_queue, mana_queue_size);
+  }
+  memcpy(mana_queue + mana_queue_len, buf, len);
+  mana_queue_len += len;
+  mana_nr_pending++;
+
+#ifdef DEBUG
+  fputs(buf, log);
+  fflush(log);
+#endif
+
+  return uim_scm_t();
+}
+
+/*
+ * Writes the queued commands without waiting for their replies, which
+ * are skipped by the next command. Called at the end of a key event so
+ * that learning doesn't wait for the next conversion.
+ */
+static uim_lisp
+mana_send_queue(void)
+{
+  struct sigaction act, oact;
+  int ret;
+
+  if (mana_pid == 0 || mana_queue_len == 0)
+    return uim_scm_f();
+
+  act.sa_handler = SIG_IGN;
+  sigemptyset(&act.sa_mask);
+  act.sa_flags = 0;
+
+  sigaction(SIGPIPE, &act, &oact);
+
+  fwrite(mana_queue, 1, mana_queue_len, mana_w);
+  mana_queue_len = 0;
+  while ((ret = fflush(mana_w)) != 0 && errno == EINTR)
+    ;
+
+  sigaction(SIGPIPE, &oact, NULL);
+
+  if (ret != 0) {
+    mana_ipc_close(&mana_pid, &mana_r, &mana_w);
+    return uim_scm_f();
+  }
+
+  return uim_scm_t();
+}
+
 static uim_lisp
 eucjp_string_length(uim_lisp str_)
 {
@@ -243,6 +348,8 @@ uim_plugin_instance_init(void)
 {
   uim_scm_init_proc0("mana-lib-init", mana_init);
   uim_scm_init_proc1("mana-lib-eval", mana_eval);
+  uim_scm_init_proc1("mana-lib-queue", mana_queue_command);
+  uim_scm_init_proc0("mana-lib-send-queue", mana_send_queue);
   uim_scm_init_proc1("mana-lib-eucjp-string-length", eucjp_string_length);
 }
 
@@ -250,7 +357,11 @@ void
 uim_plugin_instance_quit(void)
 {
   if (mana_pid != 0) {
-    mana_ipc_send_command(&mana_pid, &mana_r, &mana_w, "(quit)\n");
+    free(mana_ipc_send_command(&mana_pid, &mana_r, &mana_w, "(quit)\n"));
     mana_pid = 0;
   }
+  free(mana_queue);
+  mana_queue = NULL;
+  mana_queue_size = 0;
+  mana_ipc_clear_queue();
 }
@@ -34,7 +34,9 @@
 #include <config.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -216,6 +218,64 @@ c_execvp(uim_lisp file_, uim_lisp argv_)
   return ret_;
 }
 
+/* Starts file with argv and returns (pid . fd), where fd reads the
+ * standard output of the child. Unlike process-fork followed by
+ * execvp, the child runs no Scheme code and calls async-signal-safe
+ * functions only before the exec, so it can be used from a process
+ * with several threads. The other descriptors aren't inherited. */
+static uim_lisp
+c_process_spawn(uim_lisp file_, uim_lisp argv_)
+{
+  char **argv;
+  const char *file;
+  int i, len, open_max, null_fd, fds[2];
+  pid_t pid;
+
+  len = uim_scm_length(argv_);
+  if (len < 1)
+    return uim_scm_f();
+
+  if (pipe(fds) < 0)
+    return uim_scm_f();
+  null_fd = open("/dev/null", O_RDONLY);
+
+  file = REFER_C_STR(file_);
+  argv = uim_malloc(sizeof(char *) * (len + 1));
+  for (i = 0; i < len; i++) {
+    argv[i] = uim_strdup(REFER_C_STR(CAR(argv_)));
+    argv_ = CDR(argv_);
+  }
+  argv[len] = NULL;
+  open_max = sysconf(_SC_OPEN_MAX);
+
+  pid = fork();
+  if (pid == 0) {
+    /* child */
+    if (null_fd >= 0)
+      dup2(null_fd, 0);
+    if (dup2(fds[1], 1) < 0)
+      _exit(127);
+    for (i = 3; i < open_max; i++)
+      close(i);
+    execv(file, argv);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  if (null_fd >= 0)
+    close(null_fd);
+  for (i = 0; i < len; i++)
+    free(argv[i]);
+  free(argv);
+
+  if (pid < 0) {
+    close(fds[0]);
+    return uim_scm_f();
+  }
+
+  return CONS(MAKE_INT(pid), MAKE_INT(fds[0]));
+}
+
 void
 uim_plugin_instance_init(void)
 {
@@ -233,6 +293,7 @@ uim_plugin_instance_init(void)
 
   uim_scm_init_proc3("execve", c_execve);
   uim_scm_init_proc2("execvp", c_execvp);
+  uim_scm_init_proc2("process-spawn", c_process_spawn);
 }
 
 void
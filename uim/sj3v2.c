@@ -0,0 +1,418 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Native codec for the SJ3 protocol version 2.  The functions keep the
+ * names and return values of the former pure Scheme implementation in
+ * sj3v2-socket.scm; replies are decoded straight off the socket instead
+ * of being read into u8lists and unpacked byte by byte.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+#include "wire.h"
+
+#define SJ3_PROTOCOL_VERSION 2
+
+/* sj3v2 protocol operators */
+#define SJ3_CONNECT        1
+#define SJ3_DISCONNECT     2
+#define SJ3_OPENDICT       11
+#define SJ3_CLOSEDICT      12
+#define SJ3_OPENSTDY       21
+#define SJ3_CLOSESTDY      22
+#define SJ3_STDYSIZE       23
+#define SJ3_STUDY          61
+#define SJ3_MAKEDICT       81
+#define SJ3_MAKESTDY       82
+#define SJ3_MAKEDIR        83
+#define SJ3_ACCESS         84
+#define SJ3_PH2KNJ_EUC     111
+#define SJ3_CL2KNJ_ALL_EUC 115
+#define SJ3_CL2KNJ_CNT_EUC 116
+#define SJ3_CLSTUDY_EUC    117
+
+/* replies are read through this buffer, kept for the next exchange */
+static uim_wire_buf sj3_reply_buf;
+
+/* sj3serv answers one request at a time, so each exchange is a
+   write of the whole request followed by reading its reply */
+static void
+sj3_send(uim_lisp fd_, uim_wire_buf *req, uim_wire_reader *rd)
+{
+  int ret, err;
+
+  ret = uim_wire_write(C_INT(fd_), req);
+  err = errno;
+  uim_wire_buf_free(req);
+  if (ret < 0)
+    ERROR_OBJ(strerror(err), fd_);
+  uim_wire_reader_init(rd, C_INT(fd_), &sj3_reply_buf);
+}
+
+static uint32_t
+sj3_read_u32(uim_lisp fd_, uim_wire_reader *rd)
+{
+  uint32_t val = 0;
+
+  if (uim_wire_read_u32(rd, &val) < 0)
+    ERROR_OBJ("sj3: truncated reply", fd_);
+  return val;
+}
+
+static uim_lisp
+sj3_simple_request(uim_lisp fd_, uim_wire_buf *req)
+{
+  uim_wire_reader rd;
+
+  sj3_send(fd_, req, &rd);
+  return MAKE_INT(sj3_read_u32(fd_, &rd));
+}
+
+/* the result code, followed by a value only when it is 0 */
+static uim_lisp
+sj3_value_request(uim_lisp fd_, uim_wire_buf *req)
+{
+  uim_wire_reader rd;
+
+  sj3_send(fd_, req, &rd);
+  if (sj3_read_u32(fd_, &rd) != 0)
+    return uim_scm_f();
+  return MAKE_INT(sj3_read_u32(fd_, &rd));
+}
+
+static void
+sj3_put_u8list(uim_wire_buf *req, uim_lisp lst_)
+{
+  for (; CONSP(lst_); lst_ = CDR(lst_))
+    uim_wire_put_u8(req, C_INT(CAR(lst_)));
+}
+
+static uim_lisp
+c_sj3_connect(uim_lisp fd_, uim_lisp user_)
+{
+  uim_wire_buf req;
+  char id[32];
+
+  snprintf(id, sizeof(id), "%d.uim-sj3", (int)getpid());
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CONNECT);
+  uim_wire_put_u32(&req, SJ3_PROTOCOL_VERSION);
+  uim_wire_put_s8(&req, "unix");
+  uim_wire_put_s8(&req, REFER_C_STR(user_));
+  uim_wire_put_s8(&req, id);
+  return MAKE_BOOL((int32_t)C_INT(sj3_simple_request(fd_, &req)) == -2);
+}
+
+static uim_lisp
+c_sj3_disconnect(uim_lisp fd_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_DISCONNECT);
+  return MAKE_BOOL(C_INT(sj3_simple_request(fd_, &req)) == 0);
+}
+
+static uim_lisp
+c_sj3_opendict(uim_lisp fd_, uim_lisp name_, uim_lisp passwd_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_OPENDICT);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  uim_wire_put_s8(&req, REFER_C_STR(passwd_));
+  return sj3_value_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_closedict(uim_lisp fd_, uim_lisp dict_id_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CLOSEDICT);
+  uim_wire_put_u32(&req, C_INT(dict_id_));
+  return MAKE_BOOL(C_INT(sj3_simple_request(fd_, &req)) == 0);
+}
+
+static uim_lisp
+c_sj3_openstdy(uim_lisp fd_, uim_lisp name_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_OPENSTDY);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  uim_wire_put_s8(&req, "");
+  return sj3_simple_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_closestdy(uim_lisp fd_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CLOSESTDY);
+  return sj3_simple_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_stdy_size(uim_lisp fd_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_STDYSIZE);
+  return sj3_value_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_study(uim_lisp fd_, uim_lisp stdy_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_STUDY);
+  sj3_put_u8list(&req, stdy_);
+  return sj3_simple_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_makedict(uim_lisp fd_, uim_lisp name_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_MAKEDICT);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  uim_wire_put_u32(&req, 2048);  /* index length */
+  uim_wire_put_u32(&req, 2048);  /* length */
+  uim_wire_put_u32(&req, 256);   /* number */
+  return MAKE_BOOL(C_INT(sj3_simple_request(fd_, &req)) == 0);
+}
+
+static uim_lisp
+c_sj3_makestdy(uim_lisp fd_, uim_lisp name_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_MAKESTDY);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  uim_wire_put_u32(&req, 2048);  /* number */
+  uim_wire_put_u32(&req, 1);     /* step */
+  uim_wire_put_u32(&req, 2048);  /* length */
+  return MAKE_BOOL(C_INT(sj3_simple_request(fd_, &req)) == 0);
+}
+
+static uim_lisp
+c_sj3_makedir(uim_lisp fd_, uim_lisp name_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_MAKEDIR);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  return sj3_simple_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_access(uim_lisp fd_, uim_lisp name_, uim_lisp mode_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_ACCESS);
+  uim_wire_put_s8(&req, REFER_C_STR(name_));
+  uim_wire_put_u32(&req, C_INT(mode_));
+  return MAKE_BOOL(C_INT(sj3_simple_request(fd_, &req)) == 0);
+}
+
+/*
+ * Decode the candidate records of ph2knj and cl2knj_all: a yomi length
+ * (u8 or u32), a study record of stdy_size bytes and a NUL terminated
+ * kanji string, repeated until a zero yomi length.  Returns
+ * (yomi-lens stdys kouhos) where yomi-lens keeps the closing 0.
+ */
+static uim_lisp
+sj3_read_kouho_list(uim_lisp fd_, uim_wire_reader *rd, int stdy_size,
+		    int wide_len)
+{
+  uim_lisp lens_, stdys_, kouhos_;
+  uim_wire_buf str;
+  unsigned char *stdy;
+  int i;
+
+  lens_ = stdys_ = kouhos_ = uim_scm_null();
+  stdy = uim_malloc(stdy_size > 0 ? stdy_size : 1);
+  uim_wire_buf_init(&str);
+  for (;;) {
+    uint32_t len;
+    unsigned int len8;
+    uim_lisp stdy_;
+
+    if (wide_len) {
+      if (uim_wire_read_u32(rd, &len) < 0)
+	break;
+    } else {
+      if (uim_wire_read_u8(rd, &len8) < 0)
+	break;
+      len = len8;
+    }
+    lens_ = CONS(MAKE_INT(len), lens_);
+    if (len == 0) {
+      free(stdy);
+      uim_wire_buf_free(&str);
+      return LIST3(uim_scm_callf("reverse", "o", lens_),
+		   uim_scm_callf("reverse", "o", stdys_),
+		   uim_scm_callf("reverse", "o", kouhos_));
+    }
+
+    uim_wire_clear(&str);
+    if (uim_wire_read(rd, stdy, stdy_size) < 0
+	|| uim_wire_read_s8(rd, &str) < 0)
+      break;
+    stdy_ = uim_scm_null();
+    for (i = stdy_size - 1; i >= 0; i--)
+      stdy_ = CONS(MAKE_INT(stdy[i]), stdy_);
+    stdys_ = CONS(stdy_, stdys_);
+    kouhos_ = CONS(MAKE_STR((const char *)UIM_WIRE_BUF_HEAD(&str)), kouhos_);
+  }
+  free(stdy);
+  uim_wire_buf_free(&str);
+  ERROR_OBJ("sj3: truncated reply", fd_);
+  return uim_scm_f();
+}
+
+static uim_lisp
+c_sj3_ph2knj_euc(uim_lisp fd_, uim_lisp stdy_size_, uim_lisp yomi_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_PH2KNJ_EUC);
+  uim_wire_put_s8(&req, REFER_C_STR(yomi_));
+  sj3_send(fd_, &req, &rd);
+  if (sj3_read_u32(fd_, &rd) != 0)
+    return uim_scm_f();
+  sj3_read_u32(fd_, &rd);  /* yomi length */
+  return sj3_read_kouho_list(fd_, &rd, C_INT(stdy_size_), 0);
+}
+
+static uim_lisp
+c_sj3_cl2knj_all_euc(uim_lisp fd_, uim_lisp stdy_size_, uim_lisp len_,
+		     uim_lisp yomi_)
+{
+  uim_wire_buf req;
+  uim_wire_reader rd;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CL2KNJ_ALL_EUC);
+  uim_wire_put_u32(&req, C_INT(len_));
+  uim_wire_put_s8(&req, REFER_C_STR(yomi_));
+  sj3_send(fd_, &req, &rd);
+  if (sj3_read_u32(fd_, &rd) != 0)
+    return uim_scm_f();
+  return sj3_read_kouho_list(fd_, &rd, C_INT(stdy_size_), 1);
+}
+
+static uim_lisp
+c_sj3_cl2knj_cnt_euc(uim_lisp fd_, uim_lisp stdy_size_, uim_lisp len_,
+		     uim_lisp yomi_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CL2KNJ_CNT_EUC);
+  uim_wire_put_u32(&req, C_INT(len_));
+  uim_wire_put_s8(&req, REFER_C_STR(yomi_));
+  return sj3_value_request(fd_, &req);
+}
+
+static uim_lisp
+c_sj3_clstudy_euc(uim_lisp fd_, uim_lisp yomi1_, uim_lisp yomi2_,
+		  uim_lisp stdy_)
+{
+  uim_wire_buf req;
+
+  uim_wire_buf_init(&req);
+  uim_wire_put_u32(&req, SJ3_CLSTUDY_EUC);
+  uim_wire_put_s8(&req, REFER_C_STR(yomi1_));
+  uim_wire_put_s8(&req, REFER_C_STR(yomi2_));
+  sj3_put_u8list(&req, stdy_);
+  return sj3_simple_request(fd_, &req);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc2("sj3-lib-connect", c_sj3_connect);
+  uim_scm_init_proc1("sj3-lib-disconnect", c_sj3_disconnect);
+  uim_scm_init_proc3("sj3-lib-opendict", c_sj3_opendict);
+  uim_scm_init_proc2("sj3-lib-closedict", c_sj3_closedict);
+  uim_scm_init_proc2("sj3-lib-openstdy", c_sj3_openstdy);
+  uim_scm_init_proc1("sj3-lib-closestdy", c_sj3_closestdy);
+  uim_scm_init_proc1("sj3-lib-stdy-size", c_sj3_stdy_size);
+  uim_scm_init_proc2("sj3-lib-study", c_sj3_study);
+  uim_scm_init_proc2("sj3-lib-makedict", c_sj3_makedict);
+  uim_scm_init_proc2("sj3-lib-makestdy", c_sj3_makestdy);
+  uim_scm_init_proc2("sj3-lib-makedir", c_sj3_makedir);
+  uim_scm_init_proc3("sj3-lib-access?", c_sj3_access);
+  uim_scm_init_proc3("%sj3-lib-ph2knj-euc", c_sj3_ph2knj_euc);
+  uim_scm_init_proc4("%sj3-lib-cl2knj-all-euc", c_sj3_cl2knj_all_euc);
+  uim_scm_init_proc4("sj3-lib-cl2knj-cnt-euc", c_sj3_cl2knj_cnt_euc);
+  uim_scm_init_proc4("sj3-lib-clstudy-euc", c_sj3_clstudy_euc);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  uim_wire_buf_free(&sj3_reply_buf);
+}
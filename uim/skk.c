@@ -68,6 +68,7 @@
 #include "uim-helper.h"
 #include "dynlib.h"
 #include "uim-notify.h"
+#include "uim-trace.h"
 #include "gettext.h"
 
 #include "bsdlook.h"
@@ -170,8 +171,23 @@ struct skk_comp_array {
   struct skk_comp_array *next;
 } *skk_comp;
 
+/* fully expanded candidates of the last conversion, valid until the
+ * dictionary is modified */
+struct skk_cand_list {
+  /* key */
+  dic_info *dic;
+  char *head;
+  char okuri_head;
+  char *okuri;
+  int numeric;
+  /* candidates, numeric conversion applied */
+  int nr_cands;
+  char **cands;
+} *skk_cand_list;
+
 /* XXX should create skk.h */
 static uim_lisp skk_replace_numeric(uim_lisp head_);
+static void clear_cand_list(void);
 
 static uim_lisp restore_numeric(const char *s, uim_lisp numlst_);
 static char *replace_numeric(const char *str);
@@ -533,6 +549,7 @@ skk_free_dic(uim_lisp skk_dic_)
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
   free_skk_dic(skk_dic);
 
   return uim_scm_f();
@@ -1202,11 +1219,14 @@ skk_get_entry(uim_lisp skk_dic_, uim_lisp head_, uim_lisp okuri_head_,
 {
   struct skk_cand_array *ca;
   dic_info *skk_dic = NULL;
+  struct uim_trace_span span;
 
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  UIM_TRACE_BEGIN(&span, "skk-lib-get-entry");
   ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0, numeric_conv_);
+  UIM_TRACE_END(&span);
 
   if (ca && ca->nr_cands > 0 && !is_purged_only(ca))
       return uim_scm_t();
@@ -1725,161 +1745,208 @@ get_ignoring_indices(struct skk_cand_array *ca, int indices[])
   return k;
 }
 
-static uim_lisp
-skk_get_nth_candidate(uim_lisp skk_dic_, uim_lisp nth_,
-		      uim_lisp head_and_okuri_head_,
-		      uim_lisp okuri_,
-		      uim_lisp numeric_conv_)
+static void
+clear_cand_list(void)
 {
-  int n;
-  struct skk_cand_array *ca, *subca;
-  int i, j, k = 0;
-  const char *cands = NULL;
-  char *p;
+  int i;
+
+  if (!skk_cand_list)
+    return;
+
+  for (i = 0; i < skk_cand_list->nr_cands; i++)
+    free(skk_cand_list->cands[i]);
+  free(skk_cand_list->cands);
+  free(skk_cand_list->head);
+  free(skk_cand_list->okuri);
+  free(skk_cand_list);
+  skk_cand_list = NULL;
+}
+
+static void
+push_back_cand_to_list(struct skk_cand_list *cl, char *str)
+{
+  cl->cands = uim_realloc(cl->cands, sizeof(char *) * (cl->nr_cands + 1));
+  cl->cands[cl->nr_cands] = str;
+  cl->nr_cands++;
+}
+
+static void
+push_back_numeric_cand_to_list(struct skk_cand_list *cl, uim_lisp str_,
+			       uim_lisp numlst_)
+{
+  uim_lisp merged_;
+
+  merged_ = skk_merge_replaced_numeric_str(str_, numlst_);
+  push_back_cand_to_list(cl, uim_strdup(REFER_C_STR(merged_)));
+}
+
+/* append the candidates of ca except purged ones, expanding the #4
+ * method of numeric conversion if numlst_ is not null */
+static void
+push_back_cand_array_to_list(struct skk_cand_list *cl, dic_info *skk_dic,
+			     struct skk_cand_array *ca, uim_lisp numlst_)
+{
+  struct skk_cand_array *subca;
+  int i, j;
+  char *p, *str;
   const char *numstr;
   int method_place = 0;
   int sublen, newlen;
   int mark;
-  uim_lisp str_ = uim_scm_null();
-  uim_lisp numlst_ = uim_scm_null();
   int ignoring_indices[IGNORING_WORD_MAX + 1];
-  dic_info *skk_dic = NULL;
-  uim_lisp head_ = CAR(head_and_okuri_head_);
-  uim_lisp okuri_head_ = CDR(head_and_okuri_head_);
-
-  if (PTRP(skk_dic_))
-    skk_dic = C_PTR(skk_dic_);
-
-  if (TRUEP(numeric_conv_))
-    numlst_ = skk_store_replaced_numeric_str(head_);
-
-  n = C_INT(nth_);
 
-  if (!NULLP(numlst_))
-    ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0, numeric_conv_);
-  else
-    ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0, uim_scm_f());
+  if (!ca)
+    return;
 
   get_ignoring_indices(ca, ignoring_indices);
 
-  if (ca) {
-    /* handle #4 method of numeric conversion */
-    if (!NULLP(numlst_)) {
-      for (i = 0; i < ca->nr_cands; i++) {
-	if (match_to_discarding_index(ignoring_indices, i))
-	  continue;
-
-	if ((p = find_numeric_conv_method4_mark(ca->cands[i], &method_place))) {
-	  numstr = REFER_C_STR(get_nth(method_place, numlst_));
-	  subca = find_cand_array(skk_dic, numstr, 0, NULL, 0);
-	  if (subca) {
-	    for (j = 0; j < subca->nr_cands; j++) {
-	      if (k == n) {
-		char *str;
-		str = uim_strdup(ca->cands[i]);
-		sublen = strlen(subca->cands[j]);
-		newlen = strlen(ca->cands[i]) - 2 + sublen;
-		mark = p - ca->cands[i];
-
-		str = uim_realloc(str, newlen + 1);
-		memmove(&str[mark + sublen],
-			&str[mark + 2],
-			newlen - mark - sublen + 1);
-		memcpy(&str[mark], subca->cands[j], sublen);
-
-		str_ = MAKE_STR_DIRECTLY(str);
-		return skk_merge_replaced_numeric_str(str_, numlst_);
-	      }
-	      k++;
-	    }
-	  }
-	} else {
-	   if (k == n) {
-	     cands = ca->cands[i];
-	     break;
-	   }
-	   k++;
-	}
+  for (i = 0; i < ca->nr_cands; i++) {
+    if (match_to_discarding_index(ignoring_indices, i))
+      continue;
+
+    if (NULLP(numlst_)) {
+      push_back_cand_to_list(cl, uim_strdup(ca->cands[i]));
+    } else if ((p = find_numeric_conv_method4_mark(ca->cands[i],
+						     &method_place))) {
+      numstr = REFER_C_STR(get_nth(method_place, numlst_));
+      subca = find_cand_array(skk_dic, numstr, 0, NULL, 0);
+      if (!subca)
+	continue;
+      for (j = 0; j < subca->nr_cands; j++) {
+	str = uim_strdup(ca->cands[i]);
+	sublen = strlen(subca->cands[j]);
+	newlen = strlen(ca->cands[i]) - 2 + sublen;
+	mark = p - ca->cands[i];
+
+	str = uim_realloc(str, newlen + 1);
+	memmove(&str[mark + sublen],
+		&str[mark + 2],
+		newlen - mark - sublen + 1);
+	memcpy(&str[mark], subca->cands[j], sublen);
+
+	push_back_numeric_cand_to_list(cl, MAKE_STR_DIRECTLY(str), numlst_);
       }
     } else {
-      for (i = 0; i < ca->nr_cands; i++) {
-	if (match_to_discarding_index(ignoring_indices, i))
-	  continue;
-	if (k == n) {
-	  cands = ca->cands[i];
-	  break;
-	}
-	k++;
-      }
+      push_back_numeric_cand_to_list(cl, MAKE_STR(ca->cands[i]), numlst_);
     }
   }
+}
+
+/*
+ * Returns the candidates for head_and_okuri_head_ and okuri_: the
+ * numeric converted ones first if numeric_conv_ is true, then the
+ * plain ones. The list is built once and reused while the candidate
+ * window is paged, since each lookup parses the purged words and
+ * expands the numeric conversion again.
+ */
+static struct skk_cand_list *
+get_cand_list(dic_info *skk_dic, uim_lisp head_and_okuri_head_,
+	      uim_lisp okuri_, uim_lisp numeric_conv_)
+{
+  struct skk_cand_list *cl;
+  struct skk_cand_array *ca;
+  uim_lisp head_, okuri_head_;
+  uim_lisp numlst_ = uim_scm_null();
+  const char *hs, *okuri = NULL;
+  char o;
+
+  head_ = CAR(head_and_okuri_head_);
+  okuri_head_ = CDR(head_and_okuri_head_);
+
+  if (TRUEP(numeric_conv_))
+    numlst_ = skk_store_replaced_numeric_str(head_);
+
+  hs = REFER_C_STR(head_);
+  if (okuri_ != uim_scm_null())
+    okuri = REFER_C_STR(okuri_);
+  o = (okuri_head_ == uim_scm_null()) ? '\0' : REFER_C_STR(okuri_head_)[0];
+
+  cl = skk_cand_list;
+  if (cl && cl->dic == skk_dic && !strcmp(cl->head, hs)
+      && cl->okuri_head == o
+      && ((!cl->okuri && !okuri)
+	  || (cl->okuri && okuri && !strcmp(cl->okuri, okuri)))
+      && cl->numeric == !NULLP(numlst_))
+    return cl;
+
+  clear_cand_list();
+  cl = uim_malloc(sizeof(struct skk_cand_list));
+  cl->dic = skk_dic;
+  cl->head = uim_strdup(hs);
+  cl->okuri_head = o;
+  cl->okuri = (okuri) ? uim_strdup(okuri) : NULL;
+  cl->numeric = !NULLP(numlst_);
+  cl->nr_cands = 0;
+  cl->cands = NULL;
+
+  if (!NULLP(numlst_)) {
+    ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0,
+			      numeric_conv_);
+    push_back_cand_array_to_list(cl, skk_dic, ca, numlst_);
+  }
+  ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0,
+			    uim_scm_f());
+  push_back_cand_array_to_list(cl, skk_dic, ca, uim_scm_null());
 
-  /* check non-numeric conversion */
-  if (!cands && n >= k && !NULLP(numlst_))
-    return skk_get_nth_candidate(skk_dic_, MAKE_INT(n - k),
-		    head_and_okuri_head_, okuri_, uim_scm_f());
+  skk_cand_list = cl;
 
-  if (cands)
-    str_ = MAKE_STR(cands);
+  return cl;
+}
 
-  if (!NULLP(numlst_))
-    return skk_merge_replaced_numeric_str(str_, numlst_);
-  else
-    return str_;
+static uim_lisp
+skk_get_nth_candidate(uim_lisp skk_dic_, uim_lisp nth_,
+		      uim_lisp head_and_okuri_head_,
+		      uim_lisp okuri_,
+		      uim_lisp numeric_conv_)
+{
+  struct skk_cand_list *cl;
+  dic_info *skk_dic = NULL;
+  int n;
+
+  if (PTRP(skk_dic_))
+    skk_dic = C_PTR(skk_dic_);
+
+  n = C_INT(nth_);
+  cl = get_cand_list(skk_dic, head_and_okuri_head_, okuri_, numeric_conv_);
+  if (n < 0 || n >= cl->nr_cands)
+    return uim_scm_null();
+
+  return MAKE_STR(cl->cands[n]);
 }
 
 static uim_lisp
 skk_get_nr_candidates(uim_lisp skk_dic_, uim_lisp head_, uim_lisp okuri_head_, uim_lisp okuri_, uim_lisp numeric_conv_)
 {
-  struct skk_cand_array *ca, *subca;
-  int n = 0;
-  int i, nr_cands = 0;
-  const char *numstr;
-  int method_place = 0;
-  uim_lisp numlst_ = uim_scm_null();
-  int ignoring_indices[IGNORING_WORD_MAX + 1];
+  struct skk_cand_list *cl;
   dic_info *skk_dic = NULL;
 
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
-  if (TRUEP(numeric_conv_))
-    numlst_ = skk_store_replaced_numeric_str(head_);
-
-  if (!NULLP(numlst_))
-    ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0, numeric_conv_);
-  else
-    ca = find_cand_array_lisp(skk_dic, head_, okuri_head_, okuri_, 0, uim_scm_f());
+  cl = get_cand_list(skk_dic, CONS(head_, okuri_head_), okuri_,
+		     numeric_conv_);
 
-  if (ca)
-    n = ca->nr_cands;
-  nr_cands = n;
-  nr_cands -= get_ignoring_indices(ca, ignoring_indices);
+  return MAKE_INT(cl->nr_cands);
+}
 
-  /* handle #4 method of numeric conversion */
-  if (!NULLP(numlst_)) {
-    for (i = 0; i < n; i++) {
-      if (match_to_discarding_index(ignoring_indices, i))
-	continue;
+/* all the candidates skk-lib-get-nth-candidate indexes, for paging */
+static uim_lisp
+skk_get_candidates(uim_lisp skk_dic_, uim_lisp head_and_okuri_head_,
+		   uim_lisp okuri_, uim_lisp numeric_conv_)
+{
+  struct skk_cand_list *cl;
+  dic_info *skk_dic = NULL;
+  uim_lisp lst_ = uim_scm_null();
+  int i;
 
-      if (find_numeric_conv_method4_mark(ca->cands[i], &method_place)) {
-	numstr = REFER_C_STR(get_nth(method_place, numlst_));
-	nr_cands--;
-	subca = find_cand_array(skk_dic, numstr, 0, NULL, 0);
-	if (subca)
-	  nr_cands += subca->nr_cands;
-	break;
-      }
-    }
-  }
+  if (PTRP(skk_dic_))
+    skk_dic = C_PTR(skk_dic_);
 
-  /* add non-numeric conversion */
-  if (!NULLP(numlst_))
-    return MAKE_INT(nr_cands +
-		    C_INT(skk_get_nr_candidates(skk_dic_, head_, okuri_head_,
-				    okuri_, uim_scm_f())));
+  cl = get_cand_list(skk_dic, head_and_okuri_head_, okuri_, numeric_conv_);
+  for (i = cl->nr_cands - 1; i >= 0; i--)
+    lst_ = CONS(MAKE_STR(cl->cands[i]), lst_);
 
-  return MAKE_INT(nr_cands);
+  return lst_;
 }
 
 static struct skk_comp_array *
@@ -2093,11 +2160,14 @@ skk_get_completion(uim_lisp skk_dic_, uim_lisp head_, uim_lisp numeric_conv_, ui
 {
   struct skk_comp_array *ca;
   dic_info *skk_dic = NULL;
+  struct uim_trace_span span;
 
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  UIM_TRACE_BEGIN(&span, "skk-lib-get-completion");
   ca = find_comp_array_lisp(skk_dic, head_, numeric_conv_, use_look_);
+  UIM_TRACE_END(&span);
   if (ca) {
     ca->refcount++;
     return uim_scm_t();
@@ -2615,6 +2685,8 @@ skk_commit_candidate(uim_lisp skk_dic_, uim_lisp head_and_okuri_head_,
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
+
   if (TRUEP(numeric_conv_))
     numlst_ = skk_store_replaced_numeric_str(head_);
 
@@ -2769,6 +2841,8 @@ skk_purge_candidate(uim_lisp skk_dic_, uim_lisp head_and_okuri_head_,
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
+
   if (TRUEP(numeric_conv_))
     numlst_ = skk_store_replaced_numeric_str(head_);
 
@@ -2968,6 +3042,8 @@ skk_learn_word(uim_lisp skk_dic_, uim_lisp head_and_okuri_head_,
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
+
   tmp = REFER_C_STR(word_);
   word = sanitize_word(tmp, "(concat \"");
   if (!word)
@@ -3175,6 +3251,8 @@ skk_read_personal_dictionary(uim_lisp skk_dic_, uim_lisp fn_)
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
+
   fn = REFER_C_STR(fn_);
   ret = (stat(fn, &st) != -1) ? uim_scm_t() : uim_scm_f();
 
@@ -3435,6 +3513,8 @@ skk_save_personal_dictionary(uim_lisp skk_dic_, uim_lisp fn_)
   if (PTRP(skk_dic_))
     skk_dic = C_PTR(skk_dic_);
 
+  clear_cand_list();
+
   if (!skk_dic || skk_dic->cache_modified == 0)
     return uim_scm_f();
 
@@ -3767,6 +3847,7 @@ uim_plugin_instance_init(void)
   uim_scm_init_proc1("skk-lib-replace-numeric", skk_replace_numeric);
   uim_scm_init_proc5("skk-lib-get-nth-candidate", skk_get_nth_candidate);
   uim_scm_init_proc5("skk-lib-get-nr-candidates", skk_get_nr_candidates);
+  uim_scm_init_proc4("skk-lib-get-candidates", skk_get_candidates);
   uim_scm_init_proc5("skk-lib-commit-candidate", skk_commit_candidate);
   uim_scm_init_proc5("skk-lib-purge-candidate", skk_purge_candidate);
   uim_scm_init_proc5("skk-lib-learn-word", skk_learn_word);
@@ -3786,6 +3867,7 @@ uim_plugin_instance_init(void)
 void
 uim_plugin_instance_quit(void)
 {
+  clear_cand_list();
 }
 
 /* skkserv related */
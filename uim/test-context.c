@@ -0,0 +1,257 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Contexts put back by uim_recycle_context() and reused by
+ * uim_acquire_context(). A reused context must look like a new one to
+ * its next owner: reset, in the initial input mode, and with none of
+ * the callbacks of the previous owner.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-internal.h"
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+/* off and on modes; each key commits the mode and toggles it */
+static const char test_im[] =
+  "(begin"
+  " (define test-on '())"
+  " (define (test-on? c) (and (memq c test-on) #t))"
+  " (define (test-set-on! c on)"
+  "   (set! test-on (if on (cons c test-on) (delete c test-on eq?))))"
+  " (define test-nr-resets 0)"
+  " (register-action 'action_test_off"
+  "  (lambda (c) '(off \"-\" \"off\" \"off\"))"
+  "  (lambda (c) (not (test-on? c)))"
+  "  (lambda (c) (test-set-on! c #f)))"
+  " (register-action 'action_test_on"
+  "  (lambda (c) '(on \"O\" \"on\" \"on\"))"
+  "  test-on?"
+  "  (lambda (c) (test-set-on! c #t)))"
+  " (register-widget 'widget_test_input_mode"
+  "  (activity-indicator-new '(action_test_off action_test_on))"
+  "  (actions-new '(action_test_off action_test_on)))"
+  " (set! enabled-im-list (cons 'test-mode enabled-im-list))"
+  " (register-im 'test-mode \"\" \"UTF-8\" \"test-mode\" \"\" #f"
+  "  (lambda (id im arg)"
+  "    (let ((c (context-new id im)))"
+  "      (context-set-widgets! c '(widget_test_input_mode))"
+  "      c))"
+  "  (lambda (c) (test-set-on! c #f))"
+  "  context-mode-handler"
+  "  (lambda (c key state)"
+  "    (im-commit c (if (test-on? c) \"on\" \"off\"))"
+  "    (test-set-on! c (not (test-on? c))))"
+  "  (lambda (c key state) #f)"
+  "  (lambda (c) (set! test-nr-resets (+ test-nr-resets 1)))"
+  "  (lambda (c idx accel-enum-hint) #f)"
+  "  (lambda (c idx) #f)"
+  "  context-prop-activate-handler"
+  "  #f #f #f #f #f))";
+
+/* what the callbacks of an owner have been called with */
+struct owner {
+  char committed[16];
+  int nr_preedit_updates;
+  int mode;
+  int nr_mode_updates;
+  int nr_prop_list_updates;
+  int nr_prop_state_updates;
+};
+
+static void
+commit_cb(void *ptr, const char *str)
+{
+  struct owner *o = ptr;
+
+  strncpy(o->committed, str, sizeof(o->committed) - 1);
+}
+
+static void
+preedit_clear_cb(void *ptr)
+{
+}
+
+static void
+preedit_pushback_cb(void *ptr, int attr, const char *str)
+{
+}
+
+static void
+preedit_update_cb(void *ptr)
+{
+  struct owner *o = ptr;
+
+  o->nr_preedit_updates++;
+}
+
+static void
+mode_update_cb(void *ptr, int mode)
+{
+  struct owner *o = ptr;
+
+  o->mode = mode;
+  o->nr_mode_updates++;
+}
+
+static void
+prop_list_update_cb(void *ptr, const char *str)
+{
+  struct owner *o = ptr;
+
+  o->nr_prop_list_updates++;
+}
+
+static void
+prop_state_update_cb(void *ptr, const char *str)
+{
+  struct owner *o = ptr;
+
+  o->nr_prop_state_updates++;
+}
+
+static void
+set_callbacks(uim_context uc)
+{
+  uim_set_preedit_cb(uc, preedit_clear_cb, preedit_pushback_cb,
+		     preedit_update_cb);
+  uim_set_mode_cb(uc, mode_update_cb);
+  uim_set_prop_list_update_cb(uc, prop_list_update_cb);
+  uim_set_prop_state_update_cb(uc, prop_state_update_cb);
+}
+
+static int
+nr_resets(void)
+{
+  return uim_scm_c_int(uim_scm_eval_c_string("test-nr-resets"));
+}
+
+static void
+test_recycle(void)
+{
+  struct owner first, second;
+  uim_context uc, reused;
+  int resets;
+
+  memset(&first, 0, sizeof(first));
+  memset(&second, 0, sizeof(second));
+
+  uc = uim_acquire_context(&first, "UTF-8", NULL, "test-mode", NULL,
+			   commit_cb);
+  TEST(uc);
+  TEST(uim_get_current_mode(uc) == 0);
+  set_callbacks(uc);
+
+  uim_set_mode(uc, 1);
+  TEST(uim_get_current_mode(uc) == 1);
+  TEST(first.mode == 1);
+  TEST(first.nr_prop_state_updates > 0);
+  uim_press_key(uc, 'a', 0);
+  TEST(strcmp(first.committed, "on") == 0);
+  uim_set_mode(uc, 1);
+
+  /* nothing of the first owner is called while it is put back */
+  memset(&first, 0, sizeof(first));
+  resets = nr_resets();
+  uim_recycle_context(uc);
+  TEST(nr_resets() == resets + 1);
+  TEST(first.nr_mode_updates == 0);
+  TEST(first.nr_prop_list_updates == 0);
+  TEST(first.nr_prop_state_updates == 0);
+  TEST(first.nr_preedit_updates == 0);
+
+  reused = uim_acquire_context(&second, "UTF-8", NULL, "test-mode", NULL,
+			       commit_cb);
+  TEST(reused == uc);
+  TEST(uim_get_current_mode(reused) == 0);
+  TEST(reused->ptr == &second);
+  TEST(reused->commit_cb == commit_cb);
+  TEST(reused->preedit_clear_cb == NULL);
+  TEST(reused->preedit_pushback_cb == NULL);
+  TEST(reused->preedit_update_cb == NULL);
+  TEST(reused->mode_update_cb == NULL);
+  TEST(reused->prop_list_update_cb == NULL);
+  TEST(reused->prop_state_update_cb == NULL);
+  TEST(!reused->prop_list_stale);
+
+  /* the key toggles the mode, which no one is told of until the
+     callbacks are set again */
+  uim_press_key(reused, 'a', 0);
+  TEST(strcmp(second.committed, "off") == 0);
+  TEST(uim_get_current_mode(reused) == 1);
+  TEST(first.nr_mode_updates == 0);
+  TEST(first.nr_prop_state_updates == 0);
+  TEST(first.committed[0] == '\0');
+
+  set_callbacks(reused);
+  uim_press_key(reused, 'a', 0);
+  TEST(strcmp(second.committed, "on") == 0);
+  TEST(second.mode == 0);
+  TEST(second.nr_prop_state_updates > 0);
+  TEST(first.nr_mode_updates == 0);
+
+  uim_release_context(reused);
+}
+
+int
+main(void)
+{
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return EXIT_FAILURE;
+  }
+  uim_scm_eval_c_string(test_im);
+
+  test_recycle();
+
+  uim_quit();
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,504 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Tests of the helper protocol: the requests libuim answers by itself
+ * in uim_helper_get_message(), their routing by uim-helper-server,
+ * which is run from the build directory, and the queue of messages a
+ * non-blocking connection has not taken yet.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/param.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "uim.h"
+#include "uim-helper.h"
+#include "uim-util.h"
+
+#define TIMEOUT 5000  /* msec */
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+struct peer {
+  int fd;
+  char *buf;
+};
+
+static void
+peer_init(struct peer *p, int fd)
+{
+  p->fd = fd;
+  p->buf = uim_strdup("");
+}
+
+static void
+peer_close(struct peer *p)
+{
+  close(p->fd);
+  free(p->buf);
+}
+
+static void
+peer_send(struct peer *p, const char *str)
+{
+  size_t len = strlen(str);
+
+  TEST(write(p->fd, str, len) == (ssize_t)len);
+}
+
+static uim_bool
+wait_readable(int fd, int timeout)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  return (poll(&pfd, 1, timeout) > 0);
+}
+
+/* returns the next message or NULL on timeout */
+static char *
+peer_receive(struct peer *p, int timeout)
+{
+  char buf[1024], *msg;
+  ssize_t n;
+
+  while (!(msg = uim_helper_buffer_get_message(p->buf))) {
+    if (!wait_readable(p->fd, timeout))
+      return NULL;
+    n = read(p->fd, buf, sizeof(buf));
+    if (n <= 0)
+      return NULL;
+    p->buf = uim_helper_buffer_append(p->buf, buf, n);
+  }
+
+  return msg;
+}
+
+static void
+expect_message(struct peer *p, const char *expected)
+{
+  char *msg;
+
+  msg = peer_receive(p, TIMEOUT);
+  TEST(msg != NULL);
+  TEST(strcmp(msg, expected) == 0);
+  free(msg);
+}
+
+static int
+socket_at(const char *path, uim_bool listening)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = PF_UNIX;
+  strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+  fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  TEST(fd >= 0);
+  if (listening) {
+    unlink(path);
+    TEST(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST(listen(fd, 5) == 0);
+  } else {
+    TEST(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+  }
+
+  return fd;
+}
+
+/* libuim answers the requests in uim_helper_get_message() */
+static void
+test_client_requests(const char *path)
+{
+  struct peer server;
+  int lfd, fd;
+  char *msg;
+
+  lfd = socket_at(path, UIM_TRUE);
+  fd = uim_helper_init_client_fd(NULL);
+  TEST(fd >= 0);
+  peer_init(&server, accept(lfd, NULL, NULL));
+  TEST(server.fd >= 0);
+
+  /* the messages arrive with their "\n\n" terminator */
+  peer_send(&server, "scm_stat_get\n\n"
+	    "scm_stat_get_all\n\n"
+	    "trace_get\n\n"
+	    "prop_list_get\n\n");
+  TEST(wait_readable(fd, TIMEOUT));
+  uim_helper_read_proc(fd);
+
+  msg = uim_helper_get_message();
+  TEST(msg && strcmp(msg, "scm_stat_get_all\n\n") == 0);
+  free(msg);
+  msg = uim_helper_get_message();
+  TEST(msg && strcmp(msg, "prop_list_get\n\n") == 0);
+  free(msg);
+  TEST(uim_helper_get_message() == NULL);
+
+  msg = peer_receive(&server, TIMEOUT);
+  TEST(msg && strncmp(msg, "scm_stat\npid\t", strlen("scm_stat\npid\t")) == 0);
+  TEST(strstr(msg, "\nheap-size\t") != NULL);
+  TEST(strstr(msg, "\nkey-events\t") != NULL);
+  free(msg);
+  msg = peer_receive(&server, TIMEOUT);
+  TEST(msg && strncmp(msg, "trace\npid\t", strlen("trace\npid\t")) == 0);
+  TEST(strstr(msg, "\nuim_helper_read_proc\t") != NULL);
+  free(msg);
+  /* answered only once */
+  TEST(peer_receive(&server, 100) == NULL);
+
+  uim_helper_close_client_fd(fd);
+  peer_close(&server);
+  close(lfd);
+  unlink(path);
+}
+
+/* a batch pending when the connection is closed is not carried over */
+static void
+test_batch_reset(const char *path)
+{
+  struct peer server;
+  int lfd, fd;
+
+  lfd = socket_at(path, UIM_TRUE);
+  fd = uim_helper_init_client_fd(NULL);
+  TEST(fd >= 0);
+  peer_init(&server, accept(lfd, NULL, NULL));
+  TEST(server.fd >= 0);
+
+  uim_helper_client_begin_batch();
+  uim_helper_send_message(fd, "lost\n");
+  uim_helper_close_client_fd(fd);
+  uim_helper_client_end_batch();
+  peer_close(&server);
+
+  /* the new connection most likely gets the same fd */
+  fd = uim_helper_init_client_fd(NULL);
+  TEST(fd >= 0);
+  peer_init(&server, accept(lfd, NULL, NULL));
+  TEST(server.fd >= 0);
+
+  uim_helper_send_message(fd, "unbatched\n");
+  expect_message(&server, "unbatched\n\n");
+  uim_helper_client_begin_batch();
+  uim_helper_send_message(fd, "first\n");
+  uim_helper_send_message(fd, "second\n");
+  TEST(peer_receive(&server, 100) == NULL);
+  uim_helper_client_end_batch();
+  expect_message(&server, "first\n\n");
+  expect_message(&server, "second\n\n");
+
+  /* begun on a connection that is closed before it ends */
+  uim_helper_client_begin_batch();
+  uim_helper_send_message(fd, "lost\n");
+  uim_helper_close_client_fd(fd);
+  peer_close(&server);
+  fd = uim_helper_init_client_fd(NULL);
+  TEST(fd >= 0);
+  peer_init(&server, accept(lfd, NULL, NULL));
+  TEST(server.fd >= 0);
+  uim_helper_client_end_batch();
+  uim_helper_send_message(fd, "unbatched\n");
+  expect_message(&server, "unbatched\n\n");
+
+  uim_helper_close_client_fd(fd);
+  peer_close(&server);
+  close(lfd);
+  unlink(path);
+}
+
+static pid_t
+start_server(void)
+{
+  char buf[64];
+  FILE *fp;
+  pid_t pid;
+  int fds[2];
+
+  TEST(pipe(fds) == 0);
+  pid = fork();
+  TEST(pid >= 0);
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    execl("./uim-helper-server", "uim-helper-server", (char *)NULL);
+    _exit(127);
+  }
+  close(fds[1]);
+
+  /* it prints "waiting\n\n" when listening */
+  fp = fdopen(fds[0], "r");
+  while (fgets(buf, sizeof(buf), fp) && strcmp(buf, "\n") != 0)
+    ;
+  fclose(fp);
+
+  return pid;
+}
+
+/* replies go only to the clients that have sent the request */
+static void
+test_server_routing(const char *path)
+{
+  struct peer requester, im, other;
+  pid_t pid;
+  int status;
+
+  pid = start_server();
+  peer_init(&requester, socket_at(path, UIM_FALSE));
+  peer_init(&im, socket_at(path, UIM_FALSE));
+  peer_init(&other, socket_at(path, UIM_FALSE));
+
+  /* all three have been accepted once the others got it */
+  peer_send(&other, "hello\n\n");
+  expect_message(&requester, "hello\n\n");
+  expect_message(&im, "hello\n\n");
+
+  peer_send(&requester, "scm_stat_get\n\n");
+  expect_message(&im, "scm_stat_get\n\n");
+  expect_message(&other, "scm_stat_get\n\n");
+
+  peer_send(&im, "scm_stat\npid\t1\n\n");
+  peer_send(&im, "marker\n\n");
+  expect_message(&requester, "scm_stat\npid\t1\n\n");
+  expect_message(&requester, "marker\n\n");
+  expect_message(&other, "marker\n\n");
+
+  peer_send(&other, "trace_get\n\n");
+  expect_message(&requester, "trace_get\n\n");
+  expect_message(&im, "trace_get\n\n");
+  peer_send(&im, "trace\npid\t1\nkey\t0\t1.0\n\n");
+  peer_send(&im, "marker\n\n");
+  expect_message(&other, "trace\npid\t1\nkey\t0\t1.0\n\n");
+  expect_message(&other, "marker\n\n");
+  /* it has asked for scm_stat only */
+  expect_message(&requester, "marker\n\n");
+
+  peer_close(&requester);
+  peer_close(&im);
+  peer_close(&other);
+
+  /* the server quits when the last client has gone */
+  TEST(waitpid(pid, &status, 0) == pid);
+  unlink(path);
+}
+
+/* a subscribed client gets only the types it has subscribed to */
+static void
+test_server_subscribe(const char *path)
+{
+  struct peer sender, sub, unsub;
+  pid_t pid;
+  int status;
+
+  pid = start_server();
+  peer_init(&sender, socket_at(path, UIM_FALSE));
+  peer_init(&sub, socket_at(path, UIM_FALSE));
+  peer_init(&unsub, socket_at(path, UIM_FALSE));
+
+  peer_send(&sender, "hello\n\n");
+  expect_message(&sub, "hello\n\n");
+  expect_message(&unsub, "hello\n\n");
+
+  /* the others get hello once the server has read the subscription */
+  peer_send(&sub, "subscribe\nfocus_in\n\n");
+  peer_send(&sub, "hello\n\n");
+  expect_message(&sender, "hello\n\n");
+  expect_message(&unsub, "hello\n\n");
+
+  peer_send(&sender, "prop_list_update\ncharset=UTF-8\nbranch\tA\n\n");
+  peer_send(&sender, "im_list\ncharset=UTF-8\nanthy\tja\t\n\n");
+  peer_send(&sender, "focus_in\n\n");
+  /* messages keep their order, so the others have been dropped */
+  expect_message(&sub, "focus_in\n\n");
+  expect_message(&unsub, "prop_list_update\ncharset=UTF-8\nbranch\tA\n\n");
+  expect_message(&unsub, "im_list\ncharset=UTF-8\nanthy\tja\t\n\n");
+  expect_message(&unsub, "focus_in\n\n");
+
+  /* a new subscription replaces the topics, which are type prefixes */
+  peer_send(&sub, "subscribe\nprop_\n\n");
+  peer_send(&sub, "hello\n\n");
+  expect_message(&sender, "hello\n\n");
+  expect_message(&unsub, "hello\n\n");
+
+  peer_send(&sender, "focus_in\n\n");
+  peer_send(&sender, "prop_list_update\ncharset=UTF-8\nbranch\tB\n\n");
+  expect_message(&sub, "prop_list_update\ncharset=UTF-8\nbranch\tB\n\n");
+  expect_message(&unsub, "focus_in\n\n");
+  expect_message(&unsub, "prop_list_update\ncharset=UTF-8\nbranch\tB\n\n");
+
+  peer_close(&sender);
+  peer_close(&sub);
+  peer_close(&unsub);
+
+  TEST(waitpid(pid, &status, 0) == pid);
+  unlink(path);
+}
+
+#define N_QUEUED 1000
+
+/* leaves room for the blank line that ends the message on receipt */
+static void
+queued_message(char *buf, size_t len, int i)
+{
+  snprintf(buf, len, "%04d", i);
+  memset(buf + 4, 'x', len - 7);
+  buf[len - 3] = '\n';
+  buf[len - 2] = '\0';
+}
+
+/* a connection nobody reads from must not block the sender */
+static void
+test_send_queue(void)
+{
+  struct peer reader;
+  char msg[1024], *received, *big;
+  int fds[2], other[2];
+  size_t big_len = 4 * 1024 * 1024;
+  ssize_t n;
+  int i;
+
+  TEST(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  TEST(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+  peer_init(&reader, fds[1]);
+
+  alarm(TIMEOUT / 1000);
+  for (i = 0; i < N_QUEUED; i++) {
+    queued_message(msg, sizeof(msg), i);
+    uim_helper_send_message(fds[0], msg);
+  }
+  alarm(0);
+  TEST(uim_helper_flush(fds[0]) == 1);
+
+  /* another fd is waited for a limited time instead */
+  TEST(socketpair(AF_UNIX, SOCK_STREAM, 0, other) == 0);
+  TEST(fcntl(other[0], F_SETFL, O_NONBLOCK) == 0);
+  TEST((big = calloc(1, big_len)) != NULL);
+  alarm(TIMEOUT / 1000);
+  TEST(uim_helper_write(other[0], big, big_len) == -1);
+  TEST(errno == ETIMEDOUT);
+  alarm(0);
+  free(big);
+  close(other[0]);
+  close(other[1]);
+
+  /* the queue goes out in order as the reader catches up */
+  for (i = 0; i < N_QUEUED; i++) {
+    while (!(received = uim_helper_buffer_get_message(reader.buf))) {
+      TEST(uim_helper_flush(fds[0]) >= 0);
+      TEST(wait_readable(reader.fd, TIMEOUT));
+      n = read(reader.fd, msg, sizeof(msg));
+      TEST(n > 0);
+      reader.buf = uim_helper_buffer_append(reader.buf, msg, n);
+    }
+    queued_message(msg, sizeof(msg), i);
+    strcat(msg, "\n");
+    TEST(strcmp(received, msg) == 0);
+    free(received);
+  }
+  TEST(uim_helper_flush(fds[0]) == 0);
+
+  /* dropped along with the connection */
+  for (i = 0; i < N_QUEUED; i++) {
+    queued_message(msg, sizeof(msg), i);
+    uim_helper_send_message(fds[0], msg);
+  }
+  TEST(uim_helper_flush(fds[0]) == 1);
+  uim_helper_cancel_batch(fds[0]);
+  TEST(uim_helper_flush(fds[0]) == 0);
+
+  close(fds[0]);
+  peer_close(&reader);
+}
+
+int
+main(void)
+{
+  char dir[] = "/tmp/uim-test-helper.XXXXXX";
+  char path[MAXPATHLEN], sockdir[MAXPATHLEN];
+
+  TEST(mkdtemp(dir) != NULL);
+  setenv("XDG_RUNTIME_DIR", dir, 1);
+  /* record the spans answered to trace_get */
+  setenv("LIBUIM_TRACE", "1", 1);
+  unsetenv("LIBUIM_TRACE_FILE");
+  signal(SIGPIPE, SIG_IGN);
+
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return EXIT_FAILURE;
+  }
+  TEST(uim_helper_get_pathname(path, sizeof(path)));
+
+  test_client_requests(path);
+  test_batch_reset(path);
+  test_server_routing(path);
+  test_server_subscribe(path);
+  test_send_queue();
+
+  uim_quit();
+
+  snprintf(sockdir, sizeof(sockdir), "%s/uim/socket", dir);
+  rmdir(sockdir);
+  snprintf(sockdir, sizeof(sockdir), "%s/uim", dir);
+  rmdir(sockdir);
+  rmdir(dir);
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
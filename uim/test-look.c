@@ -0,0 +1,166 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+/*
+ * The dictionaries kept mapped by look.c, whose code is included here.
+ * A mapping must follow the file when it is replaced or rewritten, and
+ * must not hold a file descriptor.
+ */
+
+#include "look.c"
+
+#include <sys/param.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+static void
+write_dict(const char *path, const char *content, time_t mtime)
+{
+  struct timeval tv[2];
+  FILE *fp;
+
+  TEST((fp = fopen(path, "w")) != NULL);
+  fputs(content, fp);
+  TEST(fclose(fp) == 0);
+  if (mtime) {
+    tv[0].tv_sec = tv[1].tv_sec = mtime;
+    tv[0].tv_usec = tv[1].tv_usec = 0;
+    TEST(utimes(path, tv) == 0);
+  }
+}
+
+/* the rest of the first line starting with key, or "" if none */
+static const char *
+lookup(const char *path, const char *key)
+{
+  static char buf[256];
+  char str[64];
+  uim_look_ctx *ctx;
+
+  TEST((ctx = look_dict_open(path)) != NULL);
+  uim_look_set_option_dictionary_order(0, ctx);
+  uim_look_set_option_ignore_case(0, ctx);
+  snprintf(str, sizeof(str), "%s", key);
+  buf[0] = '\0';
+  if (uim_look(str, ctx) != 0) {
+    uim_look_set(ctx);
+    uim_look_get(str, buf, sizeof(buf), ctx);
+  }
+
+  return buf + (buf[0] ? strlen(key) : 0);
+}
+
+/* the lowest free fd, which the cache must not use up */
+static int
+next_fd(void)
+{
+  int fd;
+
+  TEST((fd = open("/dev/null", O_RDONLY)) >= 0);
+  close(fd);
+  return fd;
+}
+
+int
+main(void)
+{
+  char dir[] = "/tmp/uim-test-look.XXXXXX";
+  char path[MAXPATHLEN], tmp[MAXPATHLEN], other[MAXPATHLEN];
+  uim_look_ctx *ctx;
+  time_t mtime = 1000000000;
+  int fd, i;
+
+  TEST(mkdtemp(dir) != NULL);
+  snprintf(path, sizeof(path), "%s/dict", dir);
+  snprintf(tmp, sizeof(tmp), "%s/dict.new", dir);
+
+  fd = next_fd();
+  write_dict(path, "apple 1\nbanana 2\n", mtime);
+  TEST(strcmp(lookup(path, "apple"), " 1") == 0);
+  TEST(strcmp(lookup(path, "banana"), " 2") == 0);
+  TEST(strcmp(lookup(path, "cherry"), "") == 0);
+  /* mapped once, and without an fd left open */
+  ctx = look_dict_cache[0].ctx;
+  TEST(look_dict_open(path) == ctx);
+  TEST(next_fd() == fd);
+
+  /* renamed over by another file of the same size and mtime */
+  write_dict(tmp, "apple 3\nbanana 4\n", mtime);
+  TEST(rename(tmp, path) == 0);
+  TEST(strcmp(lookup(path, "apple"), " 3") == 0);
+
+  /* rewritten in place with the same size; only mtime tells */
+  write_dict(path, "apple 5\nbanana 6\n", mtime + 1);
+  TEST(strcmp(lookup(path, "apple"), " 5") == 0);
+  TEST(look_dict_cache[0].mtime == mtime + 1);
+
+  /* grown in place */
+  write_dict(path, "apple 7\nbanana 8\ncherry 9\n", mtime + 1);
+  TEST(strcmp(lookup(path, "cherry"), " 9") == 0);
+
+  /* a removed dictionary is not looked up any more */
+  unlink(path);
+  TEST(look_dict_open(path) == NULL);
+
+  /* the least recently used one is evicted; no fds are left behind */
+  for (i = 0; i <= LOOK_DICT_CACHE_SIZE; i++) {
+    snprintf(other, sizeof(other), "%s/dict%d", dir, i);
+    write_dict(other, "apple 1\n", 0);
+    TEST(strcmp(lookup(other, "apple"), " 1") == 0);
+  }
+  snprintf(other, sizeof(other), "%s/dict0", dir);
+  for (i = 0; i < LOOK_DICT_CACHE_SIZE; i++)
+    TEST(look_dict_cache[i].path && strcmp(look_dict_cache[i].path, other));
+  TEST(next_fd() == fd);
+
+  uim_plugin_instance_quit();
+  for (i = 0; i <= LOOK_DICT_CACHE_SIZE; i++) {
+    snprintf(other, sizeof(other), "%s/dict%d", dir, i);
+    unlink(other);
+  }
+  rmdir(dir);
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
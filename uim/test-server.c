@@ -0,0 +1,224 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Round trips through uim-server, whose code is included here. The
+ * client is the other end of a socketpair, and its answers to the text
+ * acquisition are written in advance along with the nested requests.
+ */
+
+#define main uim_server_main
+#include "uim-server.c"
+#undef main
+
+#define TIMEOUT 5000  /* msec */
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+/* commits the text before the cursor on each key */
+static const char test_im[] =
+  "(begin"
+  " (set! enabled-im-list (cons 'test-acquire enabled-im-list))"
+  " (register-im 'test-acquire \"\" \"UTF-8\" \"test-acquire\" \"\" #f"
+  "  (lambda (id im arg) (context-new id im))"
+  "  (lambda (c) #f)"
+  "  #f"
+  "  (lambda (c key state)"
+  "    (let ((text (im-acquire-text c 'primary 'cursor 1 0)))"
+  "      (im-commit c (if (and text (pair? (ustr-former-seq text)))"
+  "                       (car (ustr-former-seq text))"
+  "                       \"none\"))"
+  "      #t))"
+  "  (lambda (c key state) #f)"
+  "  (lambda (c) #f)"
+  "  (lambda (c idx accel-enum-hint) #f)"
+  "  (lambda (c idx) #f)"
+  "  (lambda (c msg) #f)"
+  "  #f #f #f #f #f))";
+
+static int server_ci, client_fd;
+static char *client_buf;
+
+/* writes the requests and lets the server serve them */
+static void
+request(const char *str)
+{
+  size_t len = strlen(str);
+
+  TEST(write(client_fd, str, len) == (ssize_t)len);
+  serve_client(server_ci);
+  TEST(!clients[server_ci].dead);
+}
+
+static char *
+receive(int timeout)
+{
+  struct pollfd pfd;
+  char buf[1024], *msg;
+  ssize_t n;
+
+  while (!(msg = uim_helper_buffer_get_message(client_buf))) {
+    pfd.fd = client_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout) <= 0)
+      return NULL;
+    n = read(client_fd, buf, sizeof(buf));
+    if (n <= 0)
+      return NULL;
+    client_buf = uim_helper_buffer_append(client_buf, buf, n);
+  }
+
+  return msg;
+}
+
+static void
+expect_message(const char *expected)
+{
+  char *msg;
+
+  msg = receive(TIMEOUT);
+  TEST(msg != NULL);
+  TEST(strcmp(msg, expected) == 0);
+  free(msg);
+}
+
+static void
+expect_prefix(const char *expected)
+{
+  char *msg;
+
+  msg = receive(TIMEOUT);
+  TEST(msg != NULL);
+  TEST(strncmp(msg, expected, strlen(expected)) == 0);
+  free(msg);
+}
+
+static void
+test_create(void)
+{
+  char req[64];
+
+  request("create\t1\tUTF-8\t\ttest-acquire\n\n");
+  expect_message("done\t1\n\n");
+  TEST(lookup_context(server_ci, 1) != NULL);
+
+  snprintf(req, sizeof(req), "callbacks\t1\t%d\n\n",
+	   UIM_REMOTE_CB_ACQUIRE_TEXT);
+  request(req);
+  expect_message("done\t1\n\n");
+}
+
+static void
+test_press_and_commit(void)
+{
+  request("press_key\t1\t97\t0\n\n"
+	  "acquired\t1\t0\tx\t\n\n");
+  expect_prefix("acquire\t1\t");
+  expect_message("commit\t1\tx\ndone\t1\t1\n\n");
+}
+
+/* a key pressed while the context waits for the text comes after */
+static void
+test_nested_press(void)
+{
+  request("press_key\t1\t97\t0\n\n"
+	  "press_key\t1\t98\t0\n\n"
+	  "acquired\t1\t0\tx\t\n\n"
+	  "acquired\t1\t0\ty\t\n\n");
+  expect_prefix("acquire\t1\t");
+  /* reported as filtered meanwhile */
+  expect_message("done\t1\t1\n\n");
+  expect_message("commit\t1\tx\ndone\t1\t1\n\n");
+  expect_prefix("acquire\t1\t");
+  expect_message("commit\t1\ty\n\n");
+  TEST(receive(100) == NULL);
+}
+
+/* the context outlives the request using it */
+static void
+test_nested_release(void)
+{
+  request("press_key\t1\t97\t0\n\n"
+	  "release\t1\n\n"
+	  "acquired\t1\t0\tz\t\n\n");
+  expect_prefix("acquire\t1\t");
+  expect_message("done\t1\n\n");
+  expect_message("commit\t1\tz\ndone\t1\t1\n\n");
+  TEST(lookup_context(server_ci, 1) == NULL);
+
+  request("current_im\t1\n\n");
+  expect_message("done\t1\n\n");
+}
+
+int
+main(void)
+{
+  int fds[2];
+
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return EXIT_FAILURE;
+  }
+  uim_scm_eval_c_string(test_im);
+
+  TEST(socketpair(PF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  TEST(fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) == 0);
+  server_ci = get_unused_client();
+  clients[server_ci].fd = fds[0];
+  client_fd = fds[1];
+  client_buf = uim_strdup("");
+
+  test_create();
+  test_press_and_commit();
+  test_nested_press();
+  test_nested_release();
+
+  close(client_fd);
+  serve_client(server_ci);
+  TEST(clients[server_ci].dead);
+  close_client(server_ci);
+  free(client_buf);
+
+  uim_quit();
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Several threads using libuim at once with LIBUIM_USE_THREAD. Each
+ * presses keys on a context of its own, whose callbacks must be run on
+ * it, and keeps objects made by uim_scm_* functions on its stack while
+ * the others make the collector run.
+ */
+
+#include <config.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+
+#define NR_THREADS 4
+#define NR_ROUNDS 200
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+/* commits each key pressed, after making some garbage */
+static const char test_im[] =
+  "(begin"
+  " (set! enabled-im-list (cons 'test-echo enabled-im-list))"
+  " (register-im 'test-echo \"\" \"UTF-8\" \"test-echo\" \"\" #f"
+  "  (lambda (id im arg) (context-new id im))"
+  "  (lambda (c) #f)"
+  "  #f"
+  "  (lambda (c key state)"
+  "    (let loop ((i 0) (l '()))"
+  "      (if (< i 100) (loop (+ i 1) (cons (number->string i) l))))"
+  "    (im-commit c (string (integer->char key)))"
+  "    #t)"
+  "  (lambda (c key state) #f)"
+  "  (lambda (c) #f)"
+  "  (lambda (c idx accel-enum-hint) #f)"
+  "  (lambda (c idx) #f)"
+  "  (lambda (c msg) #f)"
+  "  #f #f #f #f #f))";
+
+/* enough garbage for a collection */
+static const char garbage[] =
+  "(let loop ((i 0) (l '()))"
+  "  (if (< i 2000) (loop (+ i 1) (cons (number->string i) l)) (length l)))";
+
+struct worker {
+  pthread_t thread, self;
+  int id;
+  char committed[NR_ROUNDS + 1];
+  int nr_committed;
+  int wrong_thread;
+};
+
+static void
+commit_cb(void *ptr, const char *str)
+{
+  struct worker *w = ptr;
+
+  if (!pthread_equal(pthread_self(), w->self))
+    w->wrong_thread++;
+  if (w->nr_committed < NR_ROUNDS)
+    w->committed[w->nr_committed++] = str[0];
+}
+
+static void *
+work(void *arg)
+{
+  struct worker *w = arg;
+  uim_context uc;
+  uim_lisp str_, len_;
+  char name[32], expected[NR_ROUNDS + 1];
+  int i;
+
+  w->self = pthread_self();
+  uc = uim_create_context(w, "UTF-8", NULL, "test-echo", NULL, commit_cb);
+  TEST(uc);
+
+  for (i = 0; i < NR_ROUNDS; i++) {
+    expected[i] = 'a' + (w->id + i) % 26;
+    TEST(uim_press_key(uc, expected[i], 0) == 0);
+
+    /* str_ lives only on this stack while the collector runs */
+    snprintf(name, sizeof(name), "thread %d round %d", w->id, i);
+    str_ = uim_scm_make_str(name);
+    len_ = uim_scm_eval_c_string(garbage);
+    TEST(uim_scm_c_int(len_) == 2000);
+    TEST(strcmp(uim_scm_refer_c_str(str_), name) == 0);
+  }
+  expected[NR_ROUNDS] = '\0';
+
+  uim_release_context(uc);
+
+  TEST(w->wrong_thread == 0);
+  TEST(w->nr_committed == NR_ROUNDS);
+  TEST(memcmp(w->committed, expected, NR_ROUNDS) == 0);
+
+  return NULL;
+}
+
+int
+main(void)
+{
+  struct worker workers[NR_THREADS];
+  int i;
+
+  setenv("LIBUIM_USE_THREAD", "1", 1);
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return EXIT_FAILURE;
+  }
+  uim_scm_eval_c_string(test_im);
+
+  memset(workers, 0, sizeof(workers));
+  for (i = 0; i < NR_THREADS; i++) {
+    workers[i].id = i;
+    TEST(pthread_create(&workers[i].thread, NULL, work, &workers[i]) == 0);
+  }
+  for (i = 0; i < NR_THREADS; i++)
+    TEST(pthread_join(workers[i].thread, NULL) == 0);
+
+  uim_quit();
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+/*
+ * Compiled Compose tables (uim-x-compose.c, included here so that the
+ * cache image can be found and damaged). A small Compose file is fed
+ * to the builder as the frontends' parser would, and the table is
+ * checked both as written and as mmapped again from ~/.uim.d/compose.
+ */
+
+#include "uim-x-compose.c"
+
+#include <X11/keysym.h>
+
+#define TEST(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: test failed: %s\n",			\
+	      __FILE__, __LINE__, #cond);				\
+      exit(EXIT_FAILURE);						\
+    }									\
+  } while (0)
+
+#define LOCALE "en_US.UTF-8"
+
+static const char compose_file[] =
+  "<Multi_key> <a> <e> : \"\xc3\xa6\" ae\n"
+  "<Multi_key> <o> <c> : \"\xc2\xa9\" copyright\n"
+  "<dead_acute> <a> : \"\xc3\xa1\" aacute\n"
+  "Shift <y> : \"Y\"\n"
+  "<y> : \"y\"\n"
+  "<z> : \"z\"\n"
+  "Shift <z> : \"Z\"\n"
+  "<dead_acute> <a> : \"a'\"\n";
+
+static void
+build(const char *file)
+{
+  static const uim_x_compose_key ae[] = {
+    { XK_Multi_key, 0, 0 }, { XK_a, 0, 0 }, { XK_e, 0, 0 }
+  };
+  static const uim_x_compose_key oc[] = {
+    { XK_Multi_key, 0, 0 }, { XK_o, 0, 0 }, { XK_c, 0, 0 }
+  };
+  static const uim_x_compose_key aacute[] = {
+    { XK_dead_acute, 0, 0 }, { XK_a, 0, 0 }
+  };
+  static const uim_x_compose_key shift_y = { XK_y, ShiftMask, ShiftMask };
+  static const uim_x_compose_key y = { XK_y, 0, 0 };
+  static const uim_x_compose_key z = { XK_z, 0, 0 };
+  static const uim_x_compose_key shift_z = { XK_z, ShiftMask, ShiftMask };
+  uim_x_compose_builder *b;
+  uim_x_compose_table *t;
+
+  TEST((b = uim_x_compose_builder_new()) != NULL);
+  uim_x_compose_builder_add_source(b, file);
+  TEST(uim_x_compose_builder_add(b, ae, 3, "\xc3\xa6") == 3);
+  TEST(uim_x_compose_builder_add(b, oc, 3, "\xc2\xa9") == 3);
+  TEST(uim_x_compose_builder_add(b, aacute, 2, "\xc3\xa1") == 2);
+  TEST(uim_x_compose_builder_add(b, &shift_y, 1, "Y") == 1);
+  TEST(uim_x_compose_builder_add(b, &y, 1, "y") == 1);
+  TEST(uim_x_compose_builder_add(b, &z, 1, "z") == 1);
+  TEST(uim_x_compose_builder_add(b, &shift_z, 1, "Z") == 1);
+  /* a later definition of the same sequence wins */
+  TEST(uim_x_compose_builder_add(b, aacute, 2, "a'") == 2);
+
+  TEST((t = uim_x_compose_builder_finish(b, file, LOCALE)) != NULL);
+  TEST(t->mapped);
+  uim_x_compose_table_free(t);
+}
+
+/* the string composed by the keys, or NULL if they go nowhere */
+static const char *
+compose(const uim_x_compose_table *t, const KeySym *keys, int n,
+	unsigned int modstate)
+{
+  const uim_x_compose_entry *e = NULL;
+  unsigned int state = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    e = uim_x_compose_table_lookup(t, state, keys[i], modstate);
+    if (!e)
+      return NULL;
+    state = e->next_state;
+    if (state == 0 && i != n - 1)
+      return NULL;
+  }
+  if (state != 0)
+    return "";
+
+  return uim_x_compose_table_utf8(t, e);
+}
+
+static void
+check_lookups(const uim_x_compose_table *t)
+{
+  static const KeySym ae[] = { XK_Multi_key, XK_a, XK_e };
+  static const KeySym oc[] = { XK_Multi_key, XK_o, XK_c };
+  static const KeySym ao[] = { XK_Multi_key, XK_a, XK_o };
+  static const KeySym aacute[] = { XK_dead_acute, XK_a };
+  static const KeySym y[] = { XK_y };
+  static const KeySym z[] = { XK_z };
+
+  TEST(strcmp(compose(t, ae, 3, 0), "\xc3\xa6") == 0);
+  TEST(strcmp(compose(t, oc, 3, 0), "\xc2\xa9") == 0);
+  TEST(strcmp(compose(t, aacute, 2, 0), "a'") == 0);
+  /* in the middle of a sequence */
+  TEST(strcmp(compose(t, ae, 2, 0), "") == 0);
+  TEST(compose(t, ao, 3, 0) == NULL);
+  TEST(compose(t, &oc[2], 1, 0) == NULL);
+  TEST(uim_x_compose_table_lookup(t, t->hdr->n_states, XK_a, 0) == NULL);
+
+  /*
+   * Entries of a keysym are tried newest first, as the frontends
+   * walked the sibling lists: the plain <y> added after Shift <y>
+   * shadows it, while Shift <z> added after <z> is found first.
+   */
+  TEST(strcmp(compose(t, y, 1, 0), "y") == 0);
+  TEST(strcmp(compose(t, y, 1, ShiftMask), "y") == 0);
+  TEST(strcmp(compose(t, z, 1, 0), "z") == 0);
+  TEST(strcmp(compose(t, z, 1, ShiftMask), "Z") == 0);
+  /* bits outside the mask do not matter */
+  TEST(strcmp(compose(t, z, 1, ShiftMask | ControlMask), "Z") == 0);
+}
+
+static char *
+read_image(const char *path, size_t *size)
+{
+  struct stat st;
+  char *image;
+  int fd;
+
+  TEST((fd = open(path, O_RDONLY)) >= 0);
+  TEST(fstat(fd, &st) == 0);
+  TEST((image = malloc(st.st_size)) != NULL);
+  TEST(read(fd, image, st.st_size) == st.st_size);
+  close(fd);
+  *size = st.st_size;
+
+  return image;
+}
+
+static void
+write_file(const char *path, const char *data, size_t size)
+{
+  int fd;
+
+  TEST((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0);
+  TEST(write(fd, data, size) == (ssize_t)size);
+  TEST(close(fd) == 0);
+}
+
+/* a damaged image is not used */
+static void
+test_corrupt(const char *file, const char *path)
+{
+  struct cache_header *hdr;
+  uim_x_compose_entry *entries;
+  char *image, *copy;
+  size_t size;
+
+  image = read_image(path, &size);
+  TEST((copy = malloc(size)) != NULL);
+
+  write_file(path, image, size - 1);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+  write_file(path, image, sizeof(struct cache_header) - 1);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  memcpy(copy, image, size);
+  hdr = (struct cache_header *)copy;
+  hdr->magic = ~hdr->magic;
+  write_file(path, copy, size);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  memcpy(copy, image, size);
+  hdr = (struct cache_header *)copy;
+  hdr->n_entries += 1000;
+  write_file(path, copy, size);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  memcpy(copy, image, size);
+  hdr = (struct cache_header *)copy;
+  entries = (uim_x_compose_entry *)(copy + hdr->entries);
+  entries[0].next_state = hdr->n_states;
+  write_file(path, copy, size);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  memcpy(copy, image, size);
+  hdr = (struct cache_header *)copy;
+  entries = (uim_x_compose_entry *)(copy + hdr->entries);
+  entries[0].utf8 = hdr->size;
+  write_file(path, copy, size);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  /* no terminating NUL at the end of the string pool */
+  memcpy(copy, image, size);
+  copy[size - 1] = 'x';
+  write_file(path, copy, size);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  free(copy);
+  free(image);
+}
+
+int
+main(void)
+{
+  char dir[] = "/tmp/uim-test-x-compose.XXXXXX";
+  char file[MAXPATHLEN], path[MAXPATHLEN];
+  uim_x_compose_table *t;
+  FILE *fp;
+
+  TEST(mkdtemp(dir) != NULL);
+  snprintf(file, sizeof(file), "%s/Compose", dir);
+  TEST((fp = fopen(file, "w")) != NULL);
+  fputs(compose_file, fp);
+  TEST(fclose(fp) == 0);
+  TEST(cache_path(path, sizeof(path), file, LOCALE, 1));
+
+  /* nothing cached yet */
+  unlink(path);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  build(file);
+  TEST((t = uim_x_compose_table_load(file, LOCALE)) != NULL);
+  TEST(t->mapped);
+  check_lookups(t);
+  uim_x_compose_table_free(t);
+  /* the image is keyed by the locale too */
+  TEST(uim_x_compose_table_load(file, "C") == NULL);
+
+  test_corrupt(file, path);
+
+  /* a changed Compose file makes the image stale */
+  build(file);
+  TEST((t = uim_x_compose_table_load(file, LOCALE)) != NULL);
+  uim_x_compose_table_free(t);
+  TEST((fp = fopen(file, "a")) != NULL);
+  fputs("<Multi_key> <s> <s> : \"\xc3\x9f\" ssharp\n", fp);
+  TEST(fclose(fp) == 0);
+  TEST(uim_x_compose_table_load(file, LOCALE) == NULL);
+
+  unlink(path);
+  unlink(file);
+  rmdir(dir);
+
+  fprintf(stderr, "tests succeeded.\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,292 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Native child index for trec.scm ruletrees.
+ *
+ * trec.scm keeps its de la Briandais trie as Scheme lists and finds a
+ * child by walking the branch list with a Scheme key=? predicate. For
+ * string-keyed ruletrees this plugin builds a side index from each
+ * branch list to its children sorted by key, so that the routers can
+ * descend with a hash lookup and a binary search instead.
+ *
+ * Only nodes whose branches are all plain nodes with string keys are
+ * indexed. Branch lists containing vnodes or vkeys are left to the
+ * Scheme implementation, so the routing semantics are unchanged. The
+ * index refers to the branch list by identity, therefore a branch list
+ * modified after indexing simply misses the index. Indexed ruletrees
+ * must be kept reachable by the caller until trec-native-unindex!
+ * drops them.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+struct trec_branch {
+  const char *key;
+  uim_lisp tail;         /* branch list from the node: (node . siblings) */
+  size_t pos;
+};
+
+struct trec_index_entry {
+  uim_lisp branches;     /* NULL if the entry is vacant */
+  uim_lisp root;         /* of the ruletree the branches belong to */
+  struct trec_branch *children;
+  size_t nr_children;
+};
+
+static struct trec_index_entry *trec_index;
+static size_t trec_index_size;
+static size_t trec_index_used;
+
+static size_t
+trec_hash(uim_lisp branches)
+{
+  uintptr_t h = (uintptr_t)branches;
+
+  /* cells are aligned */
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return (size_t)h;
+}
+
+static struct trec_index_entry *
+trec_index_find(uim_lisp branches)
+{
+  size_t i;
+
+  if (!trec_index_size)
+    return NULL;
+
+  for (i = trec_hash(branches) & (trec_index_size - 1);
+       trec_index[i].branches;
+       i = (i + 1) & (trec_index_size - 1))
+    if (trec_index[i].branches == branches)
+      return &trec_index[i];
+
+  return NULL;
+}
+
+/* moves the entries into a table of size, dropping those of drop_root */
+static void
+trec_index_rehash(size_t size, uim_lisp drop_root)
+{
+  struct trec_index_entry *old = trec_index;
+  size_t old_size = trec_index_size, i, j;
+
+  trec_index_size = size;
+  trec_index = uim_malloc(sizeof(struct trec_index_entry) * trec_index_size);
+  memset(trec_index, 0, sizeof(struct trec_index_entry) * trec_index_size);
+  trec_index_used = 0;
+  for (j = 0; j < old_size; j++) {
+    if (!old[j].branches)
+      continue;
+    if (old[j].root == drop_root) {
+      free(old[j].children);
+      continue;
+    }
+    for (i = trec_hash(old[j].branches) & (trec_index_size - 1);
+         trec_index[i].branches;
+         i = (i + 1) & (trec_index_size - 1))
+      ;
+    trec_index[i] = old[j];
+    trec_index_used++;
+  }
+  free(old);
+}
+
+static struct trec_index_entry *
+trec_index_insert(uim_lisp branches, uim_lisp root)
+{
+  size_t i;
+
+  if ((trec_index_used + 1) * 2 > trec_index_size)
+    trec_index_rehash(trec_index_size ? trec_index_size * 2 : 256, NULL);
+
+  for (i = trec_hash(branches) & (trec_index_size - 1);
+       trec_index[i].branches;
+       i = (i + 1) & (trec_index_size - 1))
+    ;
+  trec_index[i].branches = branches;
+  trec_index[i].root = root;
+  trec_index_used++;
+
+  return &trec_index[i];
+}
+
+static int
+trec_branch_cmp(const void *a, const void *b)
+{
+  const struct trec_branch *x = a, *y = b;
+  int ret;
+
+  ret = strcmp(x->key, y->key);
+  if (ret)
+    return ret;
+  /* the former branch precedes on duplicate keys */
+  return (x->pos < y->pos) ? -1 : (x->pos > y->pos);
+}
+
+/* node: (key val . branches) */
+static uim_bool
+trec_plain_nodep(uim_lisp node)
+{
+  return CONSP(node) && STRP(CAR(node)) && CONSP(CDR(node));
+}
+
+static void
+trec_index_node(uim_lisp node, uim_lisp root)
+{
+  uim_lisp branches, rest;
+  struct trec_index_entry *ent;
+  struct trec_branch *children;
+  size_t n, i, j;
+  uim_bool plain = UIM_TRUE;
+
+  branches = CDR(CDR(node));
+  if (!CONSP(branches) || trec_index_find(branches))
+    return;
+
+  for (n = 0, rest = branches; CONSP(rest); rest = CDR(rest), n++) {
+    if (trec_plain_nodep(CAR(rest)))
+      trec_index_node(CAR(rest), root);
+    else
+      plain = UIM_FALSE;
+  }
+  if (!plain)
+    return;
+
+  children = uim_malloc(sizeof(struct trec_branch) * n);
+  for (i = 0, rest = branches; CONSP(rest); rest = CDR(rest), i++) {
+    children[i].key = REFER_C_STR(CAR(CAR(rest)));
+    children[i].tail = rest;
+    children[i].pos = i;
+  }
+  qsort(children, n, sizeof(struct trec_branch), trec_branch_cmp);
+  for (i = j = 0; i < n; i++)
+    if (j == 0 || strcmp(children[j - 1].key, children[i].key))
+      children[j++] = children[i];
+
+  ent = trec_index_insert(branches, root);
+  ent->children = children;
+  ent->nr_children = j;
+}
+
+/*
+ * The keys point into the Scheme strings of the ruletree, which the
+ * caller keeps alive with the tree itself.
+ */
+static uim_lisp
+trec_native_index(uim_lisp root_)
+{
+  if (!CONSP(root_) || !CONSP(CDR(root_)))
+    return uim_scm_f();
+
+  trec_index_node(root_, root_);
+  return uim_scm_t();
+}
+
+/*
+ * Drops the index of the ruletree, after which the caller may let it
+ * go. The table is rebuilt without its entries, which is fine for the
+ * rare release of a ruletree.
+ */
+static uim_lisp
+trec_native_unindex(uim_lisp root_)
+{
+  if (trec_index_size)
+    trec_index_rehash(trec_index_size, root_);
+  return uim_scm_t();
+}
+
+/*
+ * .returns The branch list starting from the child matched with key,
+ * '() if cands is indexed but has no such child, or #f if cands is not
+ * indexed
+ */
+static uim_lisp
+trec_native_lookup(uim_lisp cands_, uim_lisp key_)
+{
+  struct trec_index_entry *ent;
+  const char *key;
+  size_t lo, hi;
+
+  if (!CONSP(cands_) || !STRP(key_) || !(ent = trec_index_find(cands_)))
+    return uim_scm_f();
+
+  key = REFER_C_STR(key_);
+  lo = 0;
+  hi = ent->nr_children;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int cmp = strcmp(key, ent->children[mid].key);
+
+    if (cmp == 0)
+      return ent->children[mid].tail;
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return uim_scm_null();
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc1("trec-native-index!", trec_native_index);
+  uim_scm_init_proc2("trec-native-lookup", trec_native_lookup);
+  uim_scm_init_proc1("trec-native-unindex!", trec_native_unindex);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  size_t i;
+
+  for (i = 0; i < trec_index_size; i++)
+    free(trec_index[i].children);
+  free(trec_index);
+  trec_index = NULL;
+  trec_index_size = trec_index_used = 0;
+}
@@ -0,0 +1,1702 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Reverse lookup index of tutcode rules: character -> key sequence.
+ *
+ * The auto-help, the stroke help and the bushu conversion look up the
+ * key sequence (or the bushu pair) producing a character. Building
+ * hash tables for tutcode-rule, tutcode-kigou-rule and tutcode-bushudic
+ * in Scheme takes long enough to stall the first lookup, so the index
+ * is built here instead and saved to ~/.uim.d/tutcode.
+ *
+ * The caller describes where the rule comes from with a source list:
+ * a tag naming the rule, followed by whatever its contents depend on
+ * (the rule file and its mtime, the customization variables). The image
+ * is named after the tag and a hash of the list, so other processes and
+ * later sessions mmap it without walking the rule at all; the rule is
+ * only read when the image has to be built. Writing an image removes the
+ * older ones of the same tag, which belonged to a previous customization.
+ *
+ * The image is in host byte order; it is only meant for the machine
+ * that wrote it.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "uim-posix.h"
+#include "uim-helper.h"
+#include "uim-util.h"
+#include "dynlib.h"
+
+#define INDEX_CACHE_DIR	"tutcode"
+#define INDEX_MAGIC	0x55544932	/* "UTI2" */
+#define INDEX_TAG_MAX	32
+
+struct index_header {
+  uint32_t magic;
+  uint32_t hash;	/* of the source, with a seed other than the filename's */
+  uint32_t n_entries;
+  uint32_t n_buckets;
+  uint32_t buckets;	/* offset of uint32_t[n_buckets], entry index + 1 */
+  uint32_t entries;	/* offset of struct index_entry[n_entries] */
+  uint32_t size;	/* of the whole image */
+};
+
+struct index_entry {
+  uint32_t key;		/* offset of the character */
+  uint32_t seq;		/* offset of n_seq NUL terminated keys */
+  uint32_t n_seq;
+  uint32_t next;	/* entry index + 1 in the same bucket, or 0 */
+};
+
+struct reverse_index {
+  char *image;
+  size_t size;
+  int mapped;
+  const struct index_header *hdr;
+  const uint32_t *buckets;
+  const struct index_entry *entries;
+};
+
+/* an entry of the rule being indexed */
+struct rule_entry {
+  const char *key;
+  uim_lisp seq_;
+};
+
+struct rule {
+  int n, size;
+  struct rule_entry *entries;
+};
+
+/* what the image is keyed by */
+struct source {
+  const char *tag;
+  uint32_t name_hash, hash;
+};
+
+
+static uint32_t
+hash_str(uint32_t h, const char *s)
+{
+  const unsigned char *p;
+
+  /* FNV-1a, including the terminating NUL */
+  for (p = (const unsigned char *)s; ; p++) {
+    h = (h ^ *p) * 16777619U;
+    if (!*p)
+      break;
+  }
+
+  return h;
+}
+
+static uint32_t
+hash_key(const char *s)
+{
+  return hash_str(2166136261U, s);
+}
+
+/* tutcode-euc-jp-string->ichar accepts only a single character */
+static int
+euc_jp_single_char_p(const char *s)
+{
+  const unsigned char *p = (const unsigned char *)s;
+  size_t len = strlen(s);
+
+  if (len == 1)
+    return 1;
+  if (len == 2)
+    return (p[0] >= 0xa1 || p[0] == 0x8e) && p[1] >= 0xa1;
+  if (len == 3)
+    return p[0] == 0x8f && p[1] >= 0xa1 && p[2] >= 0xa1;
+
+  return 0;
+}
+
+/* the lists of a source are short, so plain recursion on the car is fine */
+static uint32_t
+hash_obj(uint32_t h, uim_lisp obj_)
+{
+  char buf[32];
+
+  for (; CONSP(obj_); obj_ = CDR(obj_))
+    h = hash_obj(hash_str(h, "("), CAR(obj_));
+  if (NULLP(obj_))
+    return hash_str(h, ")");
+
+  if (STRP(obj_))
+    return hash_str(hash_str(h, "s"), REFER_C_STR(obj_));
+  if (INTP(obj_)) {
+    snprintf(buf, sizeof(buf), "%ld", C_INT(obj_));
+    return hash_str(hash_str(h, "i"), buf);
+  }
+  if (FALSEP(obj_))
+    return hash_str(h, "f");
+  if (EQ(obj_, uim_scm_t()))
+    return hash_str(h, "t");
+  if (SYMP(obj_)) {
+    char *sym = C_SYM(obj_);
+
+    h = hash_str(hash_str(h, "y"), sym);
+    free(sym);
+    return h;
+  }
+
+  /* procedures and the like; they only occur in non-character entries */
+  return hash_str(h, "?");
+}
+
+/*
+ * The source is ("tag" ...); the tag goes into the filename, so it is
+ * kept to a short run of lowercase letters, digits and '-'.
+ */
+static int
+read_source(struct source *src, uim_lisp source_)
+{
+  const char *p;
+
+  if (!CONSP(source_) || !STRP(CAR(source_)))
+    return 0;
+  src->tag = REFER_C_STR(CAR(source_));
+  if (!*src->tag || strlen(src->tag) > INDEX_TAG_MAX)
+    return 0;
+  for (p = src->tag; *p; p++)
+    if (!(islower((unsigned char)*p) || isdigit((unsigned char)*p)
+	  || *p == '-'))
+      return 0;
+
+  src->name_hash = hash_obj(2166136261U, source_);
+  src->hash = hash_obj(0x811c9dc5U ^ 0x5bd1e995U, source_);
+
+  return 1;
+}
+
+/*
+ * Collect the entries of the form ((("k" "a")) ("c" ...)) whose result
+ * is a single character.
+ */
+static void
+read_rule(struct rule *r, uim_lisp rule_)
+{
+  uim_lisp elem_, seq_, key_, k_;
+  int valid;
+
+  r->n = 0;
+  r->size = 0;
+  r->entries = NULL;
+
+  for (; CONSP(rule_); rule_ = CDR(rule_)) {
+    elem_ = CAR(rule_);
+    if (!CONSP(elem_) || !CONSP(CAR(elem_)) || !CONSP(CDR(elem_))
+	|| !CONSP(CAR(CDR(elem_))))
+      continue;
+    seq_ = CAR(CAR(elem_));
+    key_ = CAR(CAR(CDR(elem_)));
+    if (!STRP(key_) || !euc_jp_single_char_p(REFER_C_STR(key_)))
+      continue;
+
+    valid = 1;
+    for (k_ = seq_; CONSP(k_); k_ = CDR(k_))
+      if (!STRP(CAR(k_)))
+	valid = 0;
+    if (!valid || !NULLP(k_))
+      continue;
+
+    if (r->n == r->size) {
+      r->size = r->size ? r->size * 2 : 256;
+      r->entries = uim_realloc(r->entries,
+			       sizeof(struct rule_entry) * r->size);
+    }
+    r->entries[r->n].key = REFER_C_STR(key_);
+    r->entries[r->n].seq_ = seq_;
+    r->n++;
+  }
+}
+
+static int
+cache_dir(char *dir, size_t len, int need_prepare)
+{
+  char config[MAXPATHLEN];
+
+  if (!uim_get_config_path(config, sizeof(config), !uim_helper_is_setugid()))
+    return 0;
+  if (snprintf(dir, len, "%s/" INDEX_CACHE_DIR, config) >= (int)len)
+    return 0;
+  if (need_prepare && !uim_check_dir(dir))
+    return 0;
+
+  return 1;
+}
+
+static int
+cache_path(char *path, size_t len, const struct source *src, int need_prepare)
+{
+  char dir[MAXPATHLEN];
+
+  if (!cache_dir(dir, sizeof(dir), need_prepare))
+    return 0;
+  if (snprintf(path, len, "%s/%s-%08x", dir, src->tag,
+	       (unsigned int)src->name_hash) >= (int)len)
+    return 0;
+
+  return 1;
+}
+
+static int
+hex8_p(const char *s)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+    if (!isxdigit((unsigned char)s[i]))
+      return 0;
+
+  return s[8] == '\0';
+}
+
+/*
+ * Remove the images of the tag other than the current one, and those
+ * named after the rule contents only, which older versions wrote. A
+ * process still using a removed image keeps its mapping.
+ */
+static void
+remove_old_images(const struct source *src)
+{
+  char dir[MAXPATHLEN], path[MAXPATHLEN], current[16];
+  size_t tag_len = strlen(src->tag);
+  struct dirent *dp;
+  DIR *dirp;
+
+  if (!cache_dir(dir, sizeof(dir), 0) || !(dirp = opendir(dir)))
+    return;
+  snprintf(current, sizeof(current), "%08x", (unsigned int)src->name_hash);
+
+  while ((dp = readdir(dirp)) != NULL) {
+    const char *name = dp->d_name;
+
+    if (!strncmp(name, src->tag, tag_len) && name[tag_len] == '-'
+	&& hex8_p(name + tag_len + 1)) {
+      if (!strcmp(name + tag_len + 1, current))
+	continue;
+    } else if (!hex8_p(name)) {
+      continue;
+    }
+    if (snprintf(path, sizeof(path), "%s/%s", dir, name)
+	< (int)sizeof(path))
+      unlink(path);
+  }
+  closedir(dirp);
+}
+
+static int
+region_ok(const struct reverse_index *idx, uint32_t off, uint32_t n,
+	  size_t elem)
+{
+  return off <= idx->size && n <= (idx->size - off) / elem;
+}
+
+static int
+setup_index(struct reverse_index *idx, const struct source *src)
+{
+  const struct index_header *hdr;
+
+  if (idx->size < sizeof(struct index_header))
+    return 0;
+  hdr = (const struct index_header *)idx->image;
+  if (hdr->magic != INDEX_MAGIC || hdr->size != idx->size
+      || hdr->hash != src->hash || hdr->n_buckets == 0
+      || !region_ok(idx, hdr->buckets, hdr->n_buckets, sizeof(uint32_t))
+      || !region_ok(idx, hdr->entries, hdr->n_entries,
+		    sizeof(struct index_entry))
+      || idx->image[idx->size - 1] != '\0')
+    return 0;
+
+  idx->hdr = hdr;
+  idx->buckets = (const uint32_t *)(idx->image + hdr->buckets);
+  idx->entries = (const struct index_entry *)(idx->image + hdr->entries);
+
+  return 1;
+}
+
+static void
+free_index(struct reverse_index *idx)
+{
+  if (!idx)
+    return;
+
+  if (idx->mapped)
+    munmap(idx->image, idx->size);
+  else
+    free(idx->image);
+  free(idx);
+}
+
+static struct reverse_index *
+map_index(const char *path, const struct source *src)
+{
+  struct reverse_index *idx;
+  struct stat st;
+  void *addr;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+      || st.st_size < (off_t)sizeof(struct index_header)) {
+    close(fd);
+    return NULL;
+  }
+  addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return NULL;
+
+  idx = uim_malloc(sizeof(struct reverse_index));
+  idx->image = addr;
+  idx->size = st.st_size;
+  idx->mapped = 1;
+  if (!setup_index(idx, src)) {
+    free_index(idx);
+    return NULL;
+  }
+
+  return idx;
+}
+
+static const struct index_entry *
+lookup(const struct reverse_index *idx, const char *key)
+{
+  const struct index_entry *e;
+  uint32_t i;
+
+  i = idx->buckets[hash_key(key) % idx->hdr->n_buckets];
+  while (i) {
+    if (i > idx->hdr->n_entries)
+      return NULL;
+    e = &idx->entries[i - 1];
+    if (e->key < idx->size && !strcmp(idx->image + e->key, key))
+      return e;
+    i = e->next;
+  }
+
+  return NULL;
+}
+
+static uint32_t
+pool_add(char **pool, size_t *len, const char *s)
+{
+  size_t off = *len, n = strlen(s) + 1;
+
+  *pool = uim_realloc(*pool, off + n);
+  memcpy(*pool + off, s, n);
+  *len = off + n;
+
+  return (uint32_t)off;
+}
+
+/* the first entry for a character wins, as alist->hash-table does */
+static char *
+build_image(const struct rule *r, const struct source *src, size_t *size_ret)
+{
+  struct index_header hdr;
+  struct index_entry *entries;
+  uint32_t *buckets, b, i, n = 0;
+  char *pool = NULL, *image;
+  size_t pool_len = 0, off;
+  uim_lisp k_;
+  int j;
+
+  hdr.n_buckets = (r->n > 0) ? r->n : 1;
+  buckets = uim_malloc(sizeof(uint32_t) * hdr.n_buckets);
+  memset(buckets, 0, sizeof(uint32_t) * hdr.n_buckets);
+  entries = uim_malloc(sizeof(struct index_entry) * (r->n + 1));
+
+  /* pool offsets are made absolute after the layout is known */
+  for (j = 0; j < r->n; j++) {
+    b = hash_key(r->entries[j].key) % hdr.n_buckets;
+    for (i = buckets[b]; i; i = entries[i - 1].next)
+      if (!strcmp(pool + entries[i - 1].key, r->entries[j].key))
+	break;
+    if (i)
+      continue;
+
+    entries[n].key = pool_add(&pool, &pool_len, r->entries[j].key);
+    entries[n].seq = (uint32_t)pool_len;
+    entries[n].n_seq = 0;
+    for (k_ = r->entries[j].seq_; CONSP(k_); k_ = CDR(k_)) {
+      pool_add(&pool, &pool_len, REFER_C_STR(CAR(k_)));
+      entries[n].n_seq++;
+    }
+    entries[n].next = buckets[b];
+    buckets[b] = ++n;
+  }
+  pool_add(&pool, &pool_len, "");
+
+  hdr.magic = INDEX_MAGIC;
+  hdr.hash = src->hash;
+  hdr.n_entries = n;
+  hdr.buckets = sizeof(struct index_header);
+  hdr.entries = hdr.buckets + sizeof(uint32_t) * hdr.n_buckets;
+  off = hdr.entries + sizeof(struct index_entry) * n;
+  hdr.size = (uint32_t)(off + pool_len);
+
+  for (i = 0; i < n; i++) {
+    entries[i].key += (uint32_t)off;
+    entries[i].seq += (uint32_t)off;
+  }
+
+  image = uim_malloc(hdr.size);
+  memcpy(image, &hdr, sizeof(hdr));
+  memcpy(image + hdr.buckets, buckets, sizeof(uint32_t) * hdr.n_buckets);
+  memcpy(image + hdr.entries, entries, sizeof(struct index_entry) * n);
+  memcpy(image + off, pool, pool_len);
+
+  free(buckets);
+  free(entries);
+  free(pool);
+
+  *size_ret = hdr.size;
+  return image;
+}
+
+/* write to a temporary file and rename, so readers never see a partial one */
+static int
+write_image(const char *path, const char *image, size_t size)
+{
+  char tmp[MAXPATHLEN];
+  size_t done = 0;
+  int fd;
+
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+    return 0;
+  if ((fd = mkstemp(tmp)) < 0)
+    return 0;
+  while (done < size) {
+    ssize_t n = write(fd, image + done, size - done);
+
+    if (n < 0) {
+      close(fd);
+      unlink(tmp);
+      return 0;
+    }
+    done += n;
+  }
+  if (close(fd) < 0 || rename(tmp, path) < 0) {
+    unlink(tmp);
+    return 0;
+  }
+
+  return 1;
+}
+
+static uim_lisp
+reverse_index_open(uim_lisp rule_, uim_lisp source_)
+{
+  struct reverse_index *idx;
+  struct source src;
+  struct rule r;
+  char path[MAXPATHLEN];
+  char *image;
+  size_t size;
+  int has_path;
+
+  if (!read_source(&src, source_))
+    ERROR_OBJ("invalid reverse index source", source_);
+
+  has_path = cache_path(path, sizeof(path), &src, 0);
+  if (has_path && (idx = map_index(path, &src)))
+    return MAKE_PTR(idx);
+
+  read_rule(&r, rule_);
+  image = build_image(&r, &src, &size);
+  free(r.entries);
+  if (has_path && cache_path(path, sizeof(path), &src, 1)
+      && write_image(path, image, size)
+      && (idx = map_index(path, &src))) {
+    remove_old_images(&src);
+    free(image);
+    return MAKE_PTR(idx);
+  }
+
+  /* no cache; keep the image private to this process */
+  idx = uim_malloc(sizeof(struct reverse_index));
+  idx->image = image;
+  idx->size = size;
+  idx->mapped = 0;
+  setup_index(idx, &src);
+
+  return MAKE_PTR(idx);
+}
+
+static uim_lisp
+reverse_index_close(uim_lisp idx_)
+{
+  if (PTRP(idx_)) {
+    free_index(C_PTR(idx_));
+    uim_scm_nullify_c_ptr(idx_);
+  }
+
+  return uim_scm_t();
+}
+
+static uim_lisp
+reverse_index_lookup(uim_lisp idx_, uim_lisp str_)
+{
+  const struct reverse_index *idx;
+  const struct index_entry *e;
+  const char *s, *end;
+  uim_lisp seq_ = uim_scm_null();
+  uint32_t i;
+
+  if (!PTRP(idx_) || !(idx = C_PTR(idx_)) || !STRP(str_))
+    return uim_scm_f();
+
+  e = lookup(idx, REFER_C_STR(str_));
+  if (!e)
+    return uim_scm_f();
+
+  /* collect the keys, then build the list from the last one */
+  s = idx->image + e->seq;
+  end = idx->image + idx->size;
+  for (i = 0; i < e->n_seq && s < end; i++) {
+    seq_ = CONS(MAKE_STR(s), seq_);
+    s += strlen(s) + 1;
+  }
+
+  return uim_scm_callf("reverse!", "o", seq_);
+}
+
+
+/*
+ * Bushu composition for the interactive bushu conversion.
+ *
+ * tutcode-bushu.scm looks up bushu.expand (character -> its bushu) and
+ * bushu.index2 (bushu -> characters containing them) with look(1), and
+ * computes the candidates with list based multiset operations, for each
+ * key press. Load both files once instead, intern the characters to
+ * ids and do the set operations on sorted id arrays.
+ */
+
+struct id_list {
+  uint32_t *ids;
+  uint32_t n, cap;
+};
+
+/* interned strings; ids are indexes of str */
+struct atom_table {
+  char **str;
+  uint32_t n, cap;
+  uint32_t *slots;	/* id + 1, or 0 */
+  uint32_t n_slots;	/* power of 2 */
+};
+
+struct bushu_entry {
+  uint32_t key;		/* atom id */
+  uint32_t start, len;	/* in ids of the map */
+};
+
+struct bushu_map {
+  struct bushu_entry *entries;
+  uint32_t n, cap;
+  uint32_t *slots;	/* entry index + 1, or 0 */
+  uint32_t n_slots;	/* power of 2 */
+  struct id_list ids;
+};
+
+struct bushu_db {
+  struct bushu_map expand;	/* character -> bushu */
+  struct bushu_map index2;	/* bushu -> characters */
+  struct bushu_db *next;	/* in open_dbs */
+};
+
+/* sorted unique ids of a list, with their counts */
+struct id_count {
+  uint32_t *ids, *count;
+  char *done;
+  uint32_t n;
+};
+
+static struct atom_table atoms;
+/* the dbs not closed yet; they refer to the ids of atoms */
+static struct bushu_db *open_dbs;
+
+
+static void
+ids_push(struct id_list *l, uint32_t id)
+{
+  if (l->n == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 16;
+    l->ids = uim_realloc(l->ids, sizeof(uint32_t) * l->cap);
+  }
+  l->ids[l->n++] = id;
+}
+
+static void
+ids_append(struct id_list *l, const uint32_t *ids, uint32_t n)
+{
+  uint32_t i;
+
+  for (i = 0; i < n; i++)
+    ids_push(l, ids[i]);
+}
+
+static void
+ids_free(struct id_list *l)
+{
+  free(l->ids);
+  l->ids = NULL;
+  l->n = l->cap = 0;
+}
+
+/* delete! */
+static void
+ids_delete(struct id_list *l, uint32_t id)
+{
+  uint32_t i, j;
+
+  for (i = j = 0; i < l->n; i++)
+    if (l->ids[i] != id)
+      l->ids[j++] = l->ids[i];
+  l->n = j;
+}
+
+static int
+cmp_id(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+id_count_init(struct id_count *c, const uint32_t *ids, uint32_t n)
+{
+  uint32_t i, j;
+
+  c->ids = uim_malloc(sizeof(uint32_t) * (n + 1));
+  c->count = uim_malloc(sizeof(uint32_t) * (n + 1));
+  c->done = uim_malloc(n + 1);
+  if (n > 0)
+    memcpy(c->ids, ids, sizeof(uint32_t) * n);
+  qsort(c->ids, n, sizeof(uint32_t), cmp_id);
+  for (i = j = 0; i < n; i++) {
+    if (j > 0 && c->ids[j - 1] == c->ids[i]) {
+      c->count[j - 1]++;
+    } else {
+      c->ids[j] = c->ids[i];
+      c->count[j] = 1;
+      c->done[j] = 0;
+      j++;
+    }
+  }
+  c->n = j;
+}
+
+static void
+id_count_free(struct id_count *c)
+{
+  free(c->ids);
+  free(c->count);
+  free(c->done);
+}
+
+/* index of id in c, or -1 */
+static long
+id_count_find(const struct id_count *c, uint32_t id)
+{
+  uint32_t lo = 0, hi = c->n, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (c->ids[mid] < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (lo < c->n && c->ids[lo] == id) ? (long)lo : -1;
+}
+
+static uint32_t
+id_count_of(const struct id_count *c, uint32_t id)
+{
+  long k = id_count_find(c, id);
+
+  return (k < 0) ? 0 : c->count[k];
+}
+
+/* tutcode-bushu-intersection; the order follows l1 */
+static void
+bushu_intersection(struct id_list *out, const struct id_list *l1,
+		   const struct id_list *l2)
+{
+  struct id_count c2;
+  uint32_t i;
+  long k;
+
+  id_count_init(&c2, l2->ids, l2->n);
+  for (i = 0; i < l1->n; i++) {
+    k = id_count_find(&c2, l1->ids[i]);
+    if (k >= 0 && c2.count[k] > 0) {
+      ids_push(out, l1->ids[i]);
+      c2.count[k]--;
+    }
+  }
+  id_count_free(&c2);
+}
+
+/*
+ * tutcode-bushu-subtract-set (l1 - l2) and, if complement,
+ * tutcode-bushu-complement-intersection (symmetric difference). The
+ * Scheme versions walk l1 deleting each element from both lists until
+ * either of them runs out, and the result keeps the order that walk
+ * produces, which the candidate sort depends on for equal priorities.
+ */
+static void
+bushu_difference(struct id_list *out, const struct id_list *l1,
+		 const struct id_list *l2, int complement)
+{
+  struct id_count c1, c2;
+  struct id_list ci = { NULL, 0, 0 };
+  uint32_t i, j, left, n2;
+  long k1, k2;
+
+  if (l2->n == 0) {
+    ids_append(out, l1->ids, l1->n);
+    return;
+  }
+
+  id_count_init(&c1, l1->ids, l1->n);
+  id_count_init(&c2, l2->ids, l2->n);
+  left = c2.n;	/* distinct elements not yet deleted from l2 */
+  for (i = 0; i < l1->n && left > 0; i++) {
+    k1 = id_count_find(&c1, l1->ids[i]);
+    if (c1.done[k1])
+      continue;
+    c1.done[k1] = 1;
+    k2 = id_count_find(&c2, l1->ids[i]);
+    n2 = 0;
+    if (k2 >= 0) {
+      n2 = c2.count[k2];
+      c2.done[k2] = 1;
+      left--;
+    }
+    if (c1.count[k1] > n2)
+      n2 = c1.count[k1] - n2;
+    else if (complement)
+      n2 = n2 - c1.count[k1];
+    else
+      n2 = 0;
+    for (j = 0; j < n2; j++)
+      ids_push(&ci, l1->ids[i]);
+  }
+
+  if (complement)
+    ids_append(out, ci.ids, ci.n);
+  /* what remains of l1 */
+  for (; i < l1->n; i++)
+    if (!c1.done[id_count_find(&c1, l1->ids[i])])
+      ids_push(out, l1->ids[i]);
+  if (complement) {
+    for (j = 0; j < l2->n; j++)
+      if (!c2.done[id_count_find(&c2, l2->ids[j])])
+	ids_push(out, l2->ids[j]);
+  } else {
+    ids_append(out, ci.ids, ci.n);
+  }
+
+  ids_free(&ci);
+  id_count_free(&c1);
+  id_count_free(&c2);
+}
+
+/* tutcode-bushu-included-set? */
+static int
+bushu_included_set_p(const uint32_t *ids1, uint32_t n1,
+		     const uint32_t *ids2, uint32_t n2)
+{
+  struct id_count c1, c2;
+  uint32_t i;
+  int ret = 1;
+
+  id_count_init(&c1, ids1, n1);
+  id_count_init(&c2, ids2, n2);
+  for (i = 0; i < c1.n; i++) {
+    if (c1.count[i] > id_count_of(&c2, c1.ids[i])) {
+      ret = 0;
+      break;
+    }
+  }
+  id_count_free(&c1);
+  id_count_free(&c2);
+
+  return ret;
+}
+
+/* delete-duplicates!, keeping the first one */
+static void
+ids_delete_duplicates(struct id_list *l)
+{
+  struct id_count c;
+  uint32_t i, j;
+  long k;
+
+  id_count_init(&c, l->ids, l->n);
+  for (i = j = 0; i < l->n; i++) {
+    k = id_count_find(&c, l->ids[i]);
+    if (!c.done[k]) {
+      c.done[k] = 1;
+      l->ids[j++] = l->ids[i];
+    }
+  }
+  l->n = j;
+  id_count_free(&c);
+}
+
+
+static uint32_t
+hash_mem(const char *s, size_t len)
+{
+  uint32_t h = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char)s[i]) * 16777619U;
+
+  return h;
+}
+
+static void
+atoms_rehash(void)
+{
+  uint32_t i, j, mask;
+
+  free(atoms.slots);
+  atoms.n_slots = atoms.n_slots ? atoms.n_slots * 2 : 1024;
+  atoms.slots = uim_malloc(sizeof(uint32_t) * atoms.n_slots);
+  memset(atoms.slots, 0, sizeof(uint32_t) * atoms.n_slots);
+  mask = atoms.n_slots - 1;
+  for (i = 0; i < atoms.n; i++) {
+    j = hash_mem(atoms.str[i], strlen(atoms.str[i])) & mask;
+    while (atoms.slots[j])
+      j = (j + 1) & mask;
+    atoms.slots[j] = i + 1;
+  }
+}
+
+/* id of the string, or (uint32_t)-1 if it has none and !create */
+static uint32_t
+atom(const char *s, size_t len, int create)
+{
+  uint32_t j, id, mask;
+
+  if (atoms.n_slots) {
+    mask = atoms.n_slots - 1;
+    for (j = hash_mem(s, len) & mask; atoms.slots[j]; j = (j + 1) & mask) {
+      id = atoms.slots[j] - 1;
+      if (!strncmp(atoms.str[id], s, len) && !atoms.str[id][len])
+	return id;
+    }
+  }
+  if (!create)
+    return (uint32_t)-1;
+
+  if (atoms.n == atoms.cap) {
+    atoms.cap = atoms.cap ? atoms.cap * 2 : 1024;
+    atoms.str = uim_realloc(atoms.str, sizeof(char *) * atoms.cap);
+  }
+  id = atoms.n++;
+  atoms.str[id] = uim_malloc(len + 1);
+  memcpy(atoms.str[id], s, len);
+  atoms.str[id][len] = '\0';
+
+  if (atoms.n * 2 > atoms.n_slots) {
+    atoms_rehash();
+  } else {
+    mask = atoms.n_slots - 1;
+    for (j = hash_mem(s, len) & mask; atoms.slots[j]; j = (j + 1) & mask)
+      ;
+    atoms.slots[j] = id + 1;
+  }
+
+  return id;
+}
+
+static void
+atoms_free(void)
+{
+  uint32_t i;
+
+  for (i = 0; i < atoms.n; i++)
+    free(atoms.str[i]);
+  free(atoms.str);
+  free(atoms.slots);
+  memset(&atoms, 0, sizeof(atoms));
+}
+
+static size_t
+euc_jp_char_len(const char *p, const char *end)
+{
+  size_t len;
+
+  if ((unsigned char)*p == 0x8f)
+    len = 3;
+  else if ((unsigned char)*p >= 0x80)
+    len = 2;
+  else
+    len = 1;
+
+  return ((size_t)(end - p) < len) ? (size_t)(end - p) : len;
+}
+
+/* split into characters, like tutcode-bushu-parse-entry */
+static void
+split_chars(struct id_list *l, const char *s, const char *end)
+{
+  size_t len;
+
+  for (; s < end; s += len) {
+    len = euc_jp_char_len(s, end);
+    ids_push(l, atom(s, len, 1));
+  }
+}
+
+static const struct bushu_entry *
+map_find(const struct bushu_map *m, uint32_t key)
+{
+  uint32_t j, mask;
+
+  if (!m->n_slots)
+    return NULL;
+  mask = m->n_slots - 1;
+  for (j = (key * 2654435761U) & mask; m->slots[j]; j = (j + 1) & mask)
+    if (m->entries[m->slots[j] - 1].key == key)
+      return &m->entries[m->slots[j] - 1];
+
+  return NULL;
+}
+
+static void
+map_rehash(struct bushu_map *m)
+{
+  uint32_t i, j, mask;
+
+  free(m->slots);
+  m->n_slots = m->n_slots ? m->n_slots * 2 : 1024;
+  m->slots = uim_malloc(sizeof(uint32_t) * m->n_slots);
+  memset(m->slots, 0, sizeof(uint32_t) * m->n_slots);
+  mask = m->n_slots - 1;
+  for (i = 0; i < m->n; i++) {
+    for (j = (m->entries[i].key * 2654435761U) & mask; m->slots[j];
+	 j = (j + 1) & mask)
+      ;
+    m->slots[j] = i + 1;
+  }
+}
+
+/*
+ * Add a line. The first one for a key wins, as look(1) returns the
+ * first matching line, and lines with nothing after the key are skipped
+ * as look-lib-look does.
+ */
+static void
+map_add_line(struct bushu_map *m, const char *key, size_t key_len,
+	     const char *val, const char *end)
+{
+  struct bushu_entry *e;
+  uint32_t id;
+
+  if (val >= end)
+    return;
+  id = atom(key, key_len, 1);
+  if (map_find(m, id))
+    return;
+
+  if (m->n == m->cap) {
+    m->cap = m->cap ? m->cap * 2 : 1024;
+    m->entries = uim_realloc(m->entries, sizeof(struct bushu_entry) * m->cap);
+  }
+  e = &m->entries[m->n++];
+  e->key = id;
+  e->start = m->ids.n;
+  split_chars(&m->ids, val, end);
+  e->len = m->ids.n - e->start;
+
+  if (m->n * 2 > m->n_slots) {
+    map_rehash(m);
+  } else {
+    uint32_t j, mask = m->n_slots - 1;
+
+    for (j = (id * 2654435761U) & mask; m->slots[j]; j = (j + 1) & mask)
+      ;
+    m->slots[j] = m->n;
+  }
+}
+
+static void
+map_free(struct bushu_map *m)
+{
+  free(m->entries);
+  free(m->slots);
+  ids_free(&m->ids);
+}
+
+static char *
+read_file(const char *path, size_t *len_ret)
+{
+  struct stat st;
+  char *buf;
+  size_t done = 0;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return NULL;
+  }
+  buf = uim_malloc(st.st_size + 1);
+  while (done < (size_t)st.st_size) {
+    n = read(fd, buf + done, st.st_size - done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  close(fd);
+
+  *len_ret = done;
+  return buf;
+}
+
+/*
+ * bushu.expand lines are a character followed by its bushu, and
+ * bushu.index2 lines are bushu, a space and the characters having them.
+ */
+static int
+load_map(struct bushu_map *m, const char *path, int index2)
+{
+  char *buf, *p, *end, *eol, *sep;
+  size_t len;
+
+  if (!(buf = read_file(path, &len)))
+    return 0;
+
+  end = buf + len;
+  for (p = buf; p < end; p = eol + 1) {
+    if (!(eol = memchr(p, '\n', end - p)))
+      eol = end;
+    if (index2) {
+      if ((sep = memchr(p, ' ', eol - p)))
+	map_add_line(m, p, sep - p, sep + 1, eol);
+    } else if (p < eol) {
+      map_add_line(m, p, euc_jp_char_len(p, eol),
+		   p + euc_jp_char_len(p, eol), eol);
+    }
+  }
+  free(buf);
+
+  return 1;
+}
+
+/* tutcode-bushu-for-char; a character without an entry is its own bushu */
+static void
+bushu_for_char(struct id_list *out, const struct bushu_db *db, uint32_t c)
+{
+  const struct bushu_entry *e = map_find(&db->expand, c);
+
+  if (e)
+    ids_append(out, &db->expand.ids.ids[e->start], e->len);
+  else
+    ids_push(out, c);
+}
+
+static void
+bushu_index2(struct id_list *out, const struct bushu_db *db, uint32_t key)
+{
+  const struct bushu_entry *e = map_find(&db->index2, key);
+
+  if (e)
+    ids_append(out, &db->index2.ids.ids[e->start], e->len);
+}
+
+/* tutcode-bushu-lookup-index2-entry-2; the key is sorted by string<? */
+static void
+bushu_index2_2(struct id_list *out, const struct bushu_db *db,
+	       uint32_t c1, uint32_t c2)
+{
+  const char *s1 = atoms.str[c1], *s2 = atoms.str[c2];
+  size_t len1 = strlen(s1), len2 = strlen(s2);
+  char *key = uim_malloc(len1 + len2 + 1);
+  uint32_t id;
+
+  if (strcmp(s1, s2) > 0) {
+    const char *tmp = s1;
+    size_t tmp_len = len1;
+
+    s1 = s2;
+    len1 = len2;
+    s2 = tmp;
+    len2 = tmp_len;
+  }
+  memcpy(key, s1, len1);
+  memcpy(key + len1, s2, len2 + 1);
+  id = atom(key, len1 + len2, 0);
+  free(key);
+  if (id != (uint32_t)-1)
+    bushu_index2(out, db, id);
+}
+
+/* tutcode-bushu-included-char-list */
+static void
+bushu_included_chars(struct id_list *out, const struct bushu_db *db,
+		     uint32_t c, uint32_t n)
+{
+  const char *s = atoms.str[c];
+  size_t len = strlen(s);
+  char *key;
+  uint32_t i, id;
+
+  if (n == 1) {
+    ids_push(out, c);
+    bushu_index2(out, db, c);
+    return;
+  }
+  key = uim_malloc(len * n + 1);
+  for (i = 0; i < n; i++)
+    memcpy(key + len * i, s, len);
+  key[len * n] = '\0';
+  id = atom(key, len * n, 0);
+  free(key);
+  if (id != (uint32_t)-1)
+    bushu_index2(out, db, id);
+}
+
+static uint32_t
+ids_count(const struct id_list *l, uint32_t id)
+{
+  uint32_t i, n = 0;
+
+  for (i = 0; i < l->n; i++)
+    if (l->ids[i] == id)
+      n++;
+
+  return n;
+}
+
+/* tutcode-bushu-superset */
+static void
+bushu_superset(struct id_list *out, const struct bushu_db *db,
+	       const struct id_list *bushu)
+{
+  struct id_list included = { NULL, 0, 0 }, rest = { NULL, 0, 0 };
+  struct id_list b = { NULL, 0, 0 };
+  uint32_t i, n;
+
+  if (bushu->n == 0)
+    return;
+  if (bushu->n == 1) {
+    bushu_included_chars(out, db, bushu->ids[0], 1);
+    return;
+  }
+  if (bushu->n == 2) {
+    bushu_index2_2(out, db, bushu->ids[0], bushu->ids[1]);
+    return;
+  }
+
+  n = ids_count(bushu, bushu->ids[0]);
+  ids_append(&rest, bushu->ids + 1, bushu->n - 1);
+  if (n > 1) {
+    ids_delete(&rest, bushu->ids[0]);
+    bushu_included_chars(&included, db, bushu->ids[0], n);
+  } else {
+    bushu_index2_2(&included, db, bushu->ids[0], rest.ids[1]);
+  }
+  for (i = 0; i < included.n; i++) {
+    b.n = 0;
+    bushu_for_char(&b, db, included.ids[i]);
+    if (bushu_included_set_p(rest.ids, rest.n, b.ids, b.n))
+      ids_push(out, included.ids[i]);
+  }
+
+  ids_free(&b);
+  ids_free(&rest);
+  ids_free(&included);
+}
+
+/* tutcode-bushu-char-list-for-bushu */
+static void
+bushu_char_list_for_bushu(struct id_list *out, const struct bushu_db *db,
+			  const struct id_list *bushu)
+{
+  struct id_list included = { NULL, 0, 0 }, b = { NULL, 0, 0 };
+  uint32_t i;
+  int match;
+
+  if (bushu->n == 0)
+    return;
+  if (bushu->n == 1)
+    bushu_included_chars(&included, db, bushu->ids[0], 1);
+  else
+    bushu_index2_2(&included, db, bushu->ids[0], bushu->ids[1]);
+
+  for (i = 0; i < included.n; i++) {
+    b.n = 0;
+    bushu_for_char(&b, db, included.ids[i]);
+    if (bushu->n == 1)
+      match = (b.n == 1 && b.ids[0] == bushu->ids[0]);
+    else if (bushu->n == 2)
+      match = (b.n == 2
+	       && ((b.ids[0] == bushu->ids[0] && b.ids[1] == bushu->ids[1])
+		   || (b.ids[0] == bushu->ids[1] && b.ids[1] == bushu->ids[0])));
+    else
+      match = (b.n == bushu->n
+	       && bushu_included_set_p(bushu->ids, bushu->n, b.ids, b.n));
+    if (match)
+      ids_push(out, included.ids[i]);
+  }
+
+  ids_free(&b);
+  ids_free(&included);
+}
+
+/* tutcode-bushu-subset */
+static void
+bushu_subset(struct id_list *out, const struct bushu_db *db,
+	     const struct id_list *bushu)
+{
+  struct id_list uniq = { NULL, 0, 0 }, chars = { NULL, 0, 0 };
+  struct id_list b = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+  uint32_t i;
+
+  ids_append(&uniq, bushu->ids, bushu->n);
+  ids_delete_duplicates(&uniq);
+  for (i = 0; i < uniq.n; i++)
+    bushu_included_chars(&chars, db, uniq.ids[i], 1);
+
+  for (i = 0; i < chars.n; i++) {
+    b.n = d.n = 0;
+    bushu_for_char(&b, db, chars.ids[i]);
+    bushu_difference(&d, &b, bushu, 0);
+    if (d.n == 0)
+      ids_push(out, chars.ids[i]);
+  }
+  ids_delete_duplicates(out);
+
+  ids_free(&d);
+  ids_free(&b);
+  ids_free(&chars);
+  ids_free(&uniq);
+}
+
+/* tutcode-bushu-include-all-chars-bushu? */
+static int
+bushu_include_all_chars_bushu_p(const struct bushu_db *db, uint32_t c,
+				const struct id_list *chars)
+{
+  struct id_list b0 = { NULL, 0, 0 }, nb = { NULL, 0, 0 };
+  struct id_list b = { NULL, 0, 0 }, tmp = { NULL, 0, 0 };
+  struct id_list one = { NULL, 0, 0 }, others = { NULL, 0, 0 };
+  struct id_list d = { NULL, 0, 0 };
+  uint32_t i, j;
+  int ret = 1;
+
+  bushu_for_char(&b0, db, c);
+  ids_append(&nb, b0.ids, b0.n);
+  for (i = 0; i < chars->n; i++) {
+    struct id_list sub = { NULL, 0, 0 };
+
+    tmp.n = 0;
+    bushu_for_char(&tmp, db, chars->ids[i]);
+    bushu_difference(&sub, &nb, &tmp, 0);
+    ids_free(&nb);
+    nb = sub;
+  }
+  bushu_difference(&b, &b0, &nb, 0);
+
+  for (i = 0; i < chars->n && ret; i++) {
+    one.n = others.n = tmp.n = d.n = 0;
+    ids_push(&one, chars->ids[i]);
+    bushu_difference(&others, chars, &one, 0);
+    for (j = 0; j < others.n; j++)
+      bushu_for_char(&tmp, db, others.ids[j]);
+    bushu_difference(&d, &b, &tmp, 0);
+    if (d.n == 0)
+      ret = 0;
+  }
+
+  ids_free(&d);
+  ids_free(&others);
+  ids_free(&one);
+  ids_free(&tmp);
+  ids_free(&b);
+  ids_free(&nb);
+  ids_free(&b0);
+
+  return ret;
+}
+
+/* tutcode-bushu-all-compose-set */
+static void
+bushu_all_compose_set(struct id_list *out, const struct bushu_db *db,
+		      const uint32_t *chars, uint32_t n_chars,
+		      const struct id_list *bushu)
+{
+  struct id_list b = { NULL, 0, 0 }, all = { NULL, 0, 0 };
+  struct id_list bl = { NULL, 0, 0 }, rest = { NULL, 0, 0 };
+  uint32_t i;
+
+  bushu_for_char(&b, db, chars[0]);
+  for (i = 0; i < b.n; i++) {
+    bl.n = 0;
+    ids_push(&bl, b.ids[i]);
+    ids_append(&bl, bushu->ids, bushu->n);
+    if (n_chars > 1)
+      bushu_all_compose_set(&all, db, chars + 1, n_chars - 1, &bl);
+    else
+      bushu_superset(&all, db, &bl);
+  }
+  ids_delete(&all, chars[0]);
+  ids_delete_duplicates(&all);
+
+  ids_append(&rest, chars, n_chars);
+  for (i = 0; i < all.n; i++)
+    if (bushu_include_all_chars_bushu_p(db, all.ids[i], &rest))
+      ids_push(out, all.ids[i]);
+
+  ids_free(&rest);
+  ids_free(&bl);
+  ids_free(&all);
+  ids_free(&b);
+}
+
+
+static void
+list_to_ids(struct id_list *l, uim_lisp list_)
+{
+  const char *s;
+
+  for (; CONSP(list_); list_ = CDR(list_)) {
+    if (!STRP(CAR(list_)))
+      continue;
+    s = REFER_C_STR(CAR(list_));
+    ids_push(l, atom(s, strlen(s), 1));
+  }
+}
+
+static uim_lisp
+ids_to_list(const struct id_list *l)
+{
+  uim_lisp list_ = uim_scm_null();
+  uint32_t i;
+
+  for (i = l->n; i > 0; i--)
+    list_ = CONS(MAKE_STR(atoms.str[l->ids[i - 1]]), list_);
+
+  return list_;
+}
+
+static const struct bushu_db *
+get_db(uim_lisp db_)
+{
+  if (!PTRP(db_))
+    return NULL;
+
+  return C_PTR(db_);
+}
+
+static uim_lisp
+bushu_open(uim_lisp expand_, uim_lisp index2_)
+{
+  struct bushu_db *db;
+
+  if (!STRP(expand_) || !STRP(index2_))
+    return uim_scm_f();
+
+  db = uim_malloc(sizeof(struct bushu_db));
+  memset(db, 0, sizeof(struct bushu_db));
+  if (!load_map(&db->expand, REFER_C_STR(expand_), 0)
+      || !load_map(&db->index2, REFER_C_STR(index2_), 1)) {
+    map_free(&db->expand);
+    map_free(&db->index2);
+    free(db);
+    return uim_scm_f();
+  }
+  db->next = open_dbs;
+  open_dbs = db;
+
+  return MAKE_PTR(db);
+}
+
+static void
+db_free(struct bushu_db *db)
+{
+  struct bushu_db **p;
+
+  for (p = &open_dbs; *p; p = &(*p)->next) {
+    if (*p == db) {
+      *p = db->next;
+      break;
+    }
+  }
+  map_free(&db->expand);
+  map_free(&db->index2);
+  free(db);
+}
+
+static uim_lisp
+bushu_close(uim_lisp db_)
+{
+  struct bushu_db *db;
+
+  if (PTRP(db_) && (db = C_PTR(db_))) {
+    db_free(db);
+    uim_scm_nullify_c_ptr(db_);
+  }
+
+  return uim_scm_t();
+}
+
+static uim_lisp
+bushu_for_char_lisp(uim_lisp db_, uim_lisp char_)
+{
+  const struct bushu_db *db = get_db(db_);
+  struct id_list l = { NULL, 0, 0 };
+  const char *c;
+  uim_lisp ret_;
+
+  if (!db || !STRP(char_))
+    return uim_scm_null();
+
+  c = REFER_C_STR(char_);
+  bushu_for_char(&l, db, atom(c, strlen(c), 1));
+  ret_ = ids_to_list(&l);
+  ids_free(&l);
+
+  return ret_;
+}
+
+static uim_lisp
+bushu_lookup_index2(uim_lisp db_, uim_lisp str_)
+{
+  const struct bushu_db *db = get_db(db_);
+  struct id_list l = { NULL, 0, 0 };
+  uint32_t id;
+  uim_lisp ret_;
+
+  if (!db || !STRP(str_))
+    return uim_scm_null();
+
+  id = atom(REFER_C_STR(str_), strlen(REFER_C_STR(str_)), 0);
+  if (id != (uint32_t)-1)
+    bushu_index2(&l, db, id);
+  ret_ = ids_to_list(&l);
+  ids_free(&l);
+
+  return ret_;
+}
+
+/* the subrs taking a db and a list of characters */
+static uim_lisp
+bushu_db_list_op(uim_lisp db_, uim_lisp list_,
+		 void (*op)(struct id_list *, const struct bushu_db *,
+			    const struct id_list *))
+{
+  const struct bushu_db *db = get_db(db_);
+  struct id_list in = { NULL, 0, 0 }, out = { NULL, 0, 0 };
+  uim_lisp ret_;
+
+  if (!db)
+    return uim_scm_null();
+
+  list_to_ids(&in, list_);
+  op(&out, db, &in);
+  ret_ = ids_to_list(&out);
+  ids_free(&out);
+  ids_free(&in);
+
+  return ret_;
+}
+
+static uim_lisp
+bushu_superset_lisp(uim_lisp db_, uim_lisp bushu_list_)
+{
+  return bushu_db_list_op(db_, bushu_list_, bushu_superset);
+}
+
+static uim_lisp
+bushu_char_list_for_bushu_lisp(uim_lisp db_, uim_lisp bushu_list_)
+{
+  return bushu_db_list_op(db_, bushu_list_, bushu_char_list_for_bushu);
+}
+
+static uim_lisp
+bushu_subset_lisp(uim_lisp db_, uim_lisp bushu_list_)
+{
+  return bushu_db_list_op(db_, bushu_list_, bushu_subset);
+}
+
+static uim_lisp
+bushu_all_compose_set_lisp(uim_lisp db_, uim_lisp char_list_,
+			   uim_lisp bushu_list_)
+{
+  const struct bushu_db *db = get_db(db_);
+  struct id_list chars = { NULL, 0, 0 }, bushu = { NULL, 0, 0 };
+  struct id_list out = { NULL, 0, 0 };
+  uim_lisp ret_;
+
+  list_to_ids(&chars, char_list_);
+  if (!db || chars.n == 0) {
+    ids_free(&chars);
+    return uim_scm_null();
+  }
+
+  list_to_ids(&bushu, bushu_list_);
+  bushu_all_compose_set(&out, db, chars.ids, chars.n, &bushu);
+  ret_ = ids_to_list(&out);
+  ids_free(&out);
+  ids_free(&bushu);
+  ids_free(&chars);
+
+  return ret_;
+}
+
+static uim_lisp
+bushu_set_op(uim_lisp list1_, uim_lisp list2_, int op)
+{
+  struct id_list l1 = { NULL, 0, 0 }, l2 = { NULL, 0, 0 };
+  struct id_list out = { NULL, 0, 0 };
+  uim_lisp ret_;
+
+  list_to_ids(&l1, list1_);
+  list_to_ids(&l2, list2_);
+  if (op == 0)
+    bushu_intersection(&out, &l1, &l2);
+  else
+    bushu_difference(&out, &l1, &l2, op == 2);
+  ret_ = ids_to_list(&out);
+  ids_free(&out);
+  ids_free(&l2);
+  ids_free(&l1);
+
+  return ret_;
+}
+
+static uim_lisp
+bushu_intersection_lisp(uim_lisp list1_, uim_lisp list2_)
+{
+  return bushu_set_op(list1_, list2_, 0);
+}
+
+static uim_lisp
+bushu_subtract_set_lisp(uim_lisp list1_, uim_lisp list2_)
+{
+  return bushu_set_op(list1_, list2_, 1);
+}
+
+static uim_lisp
+bushu_complement_intersection_lisp(uim_lisp list1_, uim_lisp list2_)
+{
+  return bushu_set_op(list1_, list2_, 2);
+}
+
+static uim_lisp
+bushu_included_set_p_lisp(uim_lisp list1_, uim_lisp list2_)
+{
+  struct id_list l1 = { NULL, 0, 0 }, l2 = { NULL, 0, 0 };
+  int ret;
+
+  list_to_ids(&l1, list1_);
+  list_to_ids(&l2, list2_);
+  ret = bushu_included_set_p(l1.ids, l1.n, l2.ids, l2.n);
+  ids_free(&l2);
+  ids_free(&l1);
+
+  return MAKE_BOOL(ret);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc2("tutcode-lib-reverse-index-open", reverse_index_open);
+  uim_scm_init_proc1("tutcode-lib-reverse-index-close", reverse_index_close);
+  uim_scm_init_proc2("tutcode-lib-reverse-index-lookup",
+		     reverse_index_lookup);
+
+  uim_scm_init_proc2("tutcode-lib-bushu-open", bushu_open);
+  uim_scm_init_proc1("tutcode-lib-bushu-close", bushu_close);
+  uim_scm_init_proc2("tutcode-lib-bushu-for-char", bushu_for_char_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-lookup-index2", bushu_lookup_index2);
+  uim_scm_init_proc2("tutcode-lib-bushu-superset", bushu_superset_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-char-list-for-bushu",
+		     bushu_char_list_for_bushu_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-subset", bushu_subset_lisp);
+  uim_scm_init_proc3("tutcode-lib-bushu-all-compose-set",
+		     bushu_all_compose_set_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-intersection",
+		     bushu_intersection_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-subtract-set",
+		     bushu_subtract_set_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-complement-intersection",
+		     bushu_complement_intersection_lisp);
+  uim_scm_init_proc2("tutcode-lib-bushu-included-set?",
+		     bushu_included_set_p_lisp);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  while (open_dbs)
+    db_free(open_dbs);
+  atoms_free();
+}
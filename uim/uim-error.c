@@ -62,10 +62,10 @@ static void print_caught_error(void);
 /* Immediately returns UIM_TRUE if uim is disabled by a fatal error. */
 
 #if UIM_USE_ERROR_GUARD
-JMP_BUF uim_catch_block_env;
+UIM_THREAD_LOCAL JMP_BUF uim_catch_block_env;
 #endif
 static uim_bool fatal_errored;
-static int guarded;
+static UIM_THREAD_LOCAL int guarded;
 static const char *err_msg;
 
 
@@ -124,6 +124,11 @@ uim_catch_error_begin_pre(void)
 {
   assert(guarded >= 0);
 
+#if UIM_USE_THREADS && !UIM_NON_LIBUIM_PROG
+  if (!guarded)
+    uim_thread_enter();
+#endif
+
   return !guarded++;
 }
 
@@ -132,6 +137,9 @@ uim_catch_error_begin_post(void)
 {
   guarded = 0;
   print_caught_error();
+#if UIM_USE_THREADS && !UIM_NON_LIBUIM_PROG
+  uim_thread_leave();
+#endif
 
   return UIM_TRUE;
 }
@@ -142,8 +150,51 @@ uim_catch_error_end(void)
   guarded--;
 
   assert(guarded >= 0);
+
+#if UIM_USE_THREADS && !UIM_NON_LIBUIM_PROG
+  if (!guarded)
+    uim_thread_leave();
+#endif
+}
+
+/* The outer guard of the thread may be on another part of the stack
+ * (see uim-thread.c), so func gets a guard of its own. The caught
+ * error has been printed here and is thrown again by the caller with
+ * uim_throw_error(NULL). */
+uim_bool
+uim_catch_error_call(uim_gc_gate_func_ptr func, void *arg, void **ret)
+{
+  JMP_BUF saved_env;
+  int saved_guarded;
+  uim_bool caught;
+
+  memcpy(saved_env, uim_catch_block_env, sizeof(JMP_BUF));
+  saved_guarded = guarded;
+
+  guarded = 1;
+  if (SETJMP(uim_catch_block_env)) {
+    print_caught_error();
+    err_msg = NULL;
+    caught = UIM_TRUE;
+  } else {
+    *ret = (*func)(arg);
+    caught = UIM_FALSE;
+  }
+
+  guarded = saved_guarded;
+  memcpy(uim_catch_block_env, saved_env, sizeof(JMP_BUF));
+
+  return !caught;
+}
+#else /* not UIM_USE_ERROR_GUARD */
+uim_bool
+uim_catch_error_call(uim_gc_gate_func_ptr func, void *arg, void **ret)
+{
+  *ret = (*func)(arg);
+
+  return UIM_TRUE;
 }
-#endif /* UIM_USE_ERROR_GUARD */
+#endif /* not UIM_USE_ERROR_GUARD */
 
 void
 uim_throw_error(const char *msg)
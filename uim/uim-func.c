@@ -42,10 +42,97 @@
 #include "uim-scm.h"
 #include "uim-scm-abbrev.h"
 #include "uim-im-switcher.h"
+#include "uim-trace.h"
 
 
 #define TEXT_EMPTYP(txt) (!(txt) || !(txt)[0])
 
+/* The bridge callbacks are invoked through uim_thread_call_back() to be
+ * run on the thread which called libuim (see uim-thread.c). */
+enum callback_type {
+  CB_PTR,
+  CB_INT,
+  CB_INT_INT,
+  CB_STR,
+  CB_INT_STR
+};
+
+struct callback_args {
+  enum callback_type type;
+  uim_func_ptr cb;
+  void *ptr;
+  int i0, i1;
+  const char *str;
+};
+
+struct text_args {
+  uim_context uc;
+  enum UTextArea text_id;
+  enum UTextOrigin origin;
+  int former_len, latter_len;
+  char *former, *latter;
+  int err;
+};
+
+static void *run_callback(void *callback_args);
+static void *run_acquire_text_cb(void *text_args);
+static void *run_delete_text_cb(void *text_args);
+
+
+static void *
+run_callback(void *callback_args)
+{
+  struct callback_args *args;
+
+  args = callback_args;
+  switch (args->type) {
+  case CB_PTR:
+    ((void (*)(void *))args->cb)(args->ptr);
+    break;
+  case CB_INT:
+    ((void (*)(void *, int))args->cb)(args->ptr, args->i0);
+    break;
+  case CB_INT_INT:
+    ((void (*)(void *, int, int))args->cb)(args->ptr, args->i0, args->i1);
+    break;
+  case CB_STR:
+    ((void (*)(void *, const char *))args->cb)(args->ptr, args->str);
+    break;
+  case CB_INT_STR:
+    ((void (*)(void *, int, const char *))args->cb)(args->ptr, args->i0,
+                                                    args->str);
+    break;
+  }
+
+  return NULL;
+}
+
+static void
+call_back(enum callback_type type, uim_func_ptr cb, void *ptr,
+          int i0, int i1, const char *str)
+{
+  struct callback_args args;
+
+  args.type = type;
+  args.cb = cb;
+  args.ptr = ptr;
+  args.i0 = i0;
+  args.i1 = i1;
+  args.str = str;
+  uim_thread_call_back(run_callback, &args);
+}
+
+#define CALL_BACK(cb, ptr)                                              \
+  call_back(CB_PTR, (uim_func_ptr)(cb), (ptr), 0, 0, NULL)
+#define CALL_BACK_INT(cb, ptr, i)                                       \
+  call_back(CB_INT, (uim_func_ptr)(cb), (ptr), (i), 0, NULL)
+#define CALL_BACK_INT_INT(cb, ptr, i0, i1)                              \
+  call_back(CB_INT_INT, (uim_func_ptr)(cb), (ptr), (i0), (i1), NULL)
+#define CALL_BACK_STR(cb, ptr, str)                                     \
+  call_back(CB_STR, (uim_func_ptr)(cb), (ptr), 0, 0, (str))
+#define CALL_BACK_INT_STR(cb, ptr, i, str)                              \
+  call_back(CB_INT_STR, (uim_func_ptr)(cb), (ptr), (i), 0, (str))
+
 
 /* this is not a uim API, so did not name as uim_retrieve_context() */
 static uim_context
@@ -92,10 +179,14 @@ static uim_lisp
 im_clear_preedit(uim_lisp uc_)
 {
   uim_context uc;
+  struct uim_trace_span span;
 
   uc = retrieve_uim_context(uc_);
-  if (uc->preedit_clear_cb)
-    uc->preedit_clear_cb(uc->ptr);
+  if (uc->preedit_clear_cb) {
+    UIM_TRACE_BEGIN(&span, "preedit_clear_cb");
+    CALL_BACK(uc->preedit_clear_cb, uc->ptr);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -104,6 +195,7 @@ static uim_lisp
 im_pushback_preedit(uim_lisp uc_, uim_lisp attr_, uim_lisp str_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   const char *str;
   char *converted_str;
   int attr;
@@ -113,8 +205,11 @@ im_pushback_preedit(uim_lisp uc_, uim_lisp attr_, uim_lisp str_)
   str = REFER_C_STR(str_);
 
   converted_str = uc->conv_if->convert(uc->outbound_conv, str);
-  if (uc->preedit_pushback_cb)
-    uc->preedit_pushback_cb(uc->ptr, attr, converted_str);
+  if (uc->preedit_pushback_cb) {
+    UIM_TRACE_BEGIN(&span, "preedit_pushback_cb");
+    CALL_BACK_INT_STR(uc->preedit_pushback_cb, uc->ptr, attr, converted_str);
+    UIM_TRACE_END(&span);
+  }
   free(converted_str);
 
   return uim_scm_f();
@@ -124,10 +219,14 @@ static uim_lisp
 im_update_preedit(uim_lisp uc_)
 {
   uim_context uc;
+  struct uim_trace_span span;
 
   uc = retrieve_uim_context(uc_);
-  if (uc->preedit_update_cb)
-    uc->preedit_update_cb(uc->ptr);
+  if (uc->preedit_update_cb) {
+    UIM_TRACE_BEGIN(&span, "preedit_update_cb");
+    CALL_BACK(uc->preedit_update_cb, uc->ptr);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -136,6 +235,7 @@ static uim_lisp
 im_commit(uim_lisp uc_, uim_lisp str_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   const char *str;
   char *converted_str;
 
@@ -143,8 +243,11 @@ im_commit(uim_lisp uc_, uim_lisp str_)
   str = REFER_C_STR(str_);
 
   converted_str = uc->conv_if->convert(uc->outbound_conv, str);
-  if (uc->commit_cb)
-    uc->commit_cb(uc->ptr, converted_str);
+  if (uc->commit_cb) {
+    UIM_TRACE_BEGIN(&span, "commit_cb");
+    CALL_BACK_STR(uc->commit_cb, uc->ptr, converted_str);
+    UIM_TRACE_END(&span);
+  }
   free(converted_str);
 
   return uim_scm_f();
@@ -231,7 +334,7 @@ im_update_mode_list(uim_lisp uc_)
   uc = retrieve_uim_context(uc_);
 
   if (uc->mode_list_update_cb)
-    uc->mode_list_update_cb(uc->ptr);
+    CALL_BACK(uc->mode_list_update_cb, uc->ptr);
 
   return uim_scm_f();
 }
@@ -247,13 +350,38 @@ im_update_prop_list(uim_lisp uc_, uim_lisp prop_)
   
   free(uc->propstr);
   uc->propstr = uc->conv_if->convert(uc->outbound_conv, prop);
+  uc->prop_list_stale = UIM_FALSE;
 
   if (uc->prop_list_update_cb)
-    uc->prop_list_update_cb(uc->ptr, uc->propstr);
+    CALL_BACK_STR(uc->prop_list_update_cb, uc->ptr, uc->propstr);
 
   return uim_scm_f();
 }
 
+/* Delivers the lightweight state string if the bridge can handle it.
+ * The cached propstr is then out of date, and uim_prop_list_update()
+ * composes it again. Returns #f if the caller has to send the full
+ * property list instead. */
+static uim_lisp
+im_update_prop_state(uim_lisp uc_, uim_lisp state_)
+{
+  uim_context uc;
+  const char *state;
+  char *converted;
+
+  uc = retrieve_uim_context(uc_);
+  if (!uc->prop_state_update_cb)
+    return uim_scm_f();
+
+  state = REFER_C_STR(state_);
+  uc->prop_list_stale = UIM_TRUE;
+  converted = uc->conv_if->convert(uc->outbound_conv, state);
+  CALL_BACK_STR(uc->prop_state_update_cb, uc->ptr, converted);
+  free(converted);
+
+  return uim_scm_t();
+}
+
 static uim_lisp
 im_update_mode(uim_lisp uc_, uim_lisp mode_)
 {
@@ -265,7 +393,7 @@ im_update_mode(uim_lisp uc_, uim_lisp mode_)
 
   uc->mode = mode;
   if (uc->mode_update_cb)
-    uc->mode_update_cb(uc->ptr, mode);
+    CALL_BACK_INT(uc->mode_update_cb, uc->ptr, mode);
 
   return uim_scm_f();
 }
@@ -275,14 +403,19 @@ im_activate_candidate_selector(uim_lisp uc_,
                                uim_lisp nr_, uim_lisp display_limit_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   int nr, display_limit;
 
   uc = retrieve_uim_context(uc_);
   nr = C_INT(nr_);
   display_limit = C_INT(display_limit_);
 
-  if (uc->candidate_selector_activate_cb)
-    uc->candidate_selector_activate_cb(uc->ptr, nr, display_limit);
+  if (uc->candidate_selector_activate_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_activate_cb");
+    CALL_BACK_INT_INT(uc->candidate_selector_activate_cb, uc->ptr,
+                      nr, display_limit);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -291,13 +424,36 @@ static uim_lisp
 im_delay_activate_candidate_selector(uim_lisp uc_, uim_lisp delay_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   int delay;
 
   uc = retrieve_uim_context(uc_);
   delay = C_INT(delay_);
 
-  if (uc->candidate_selector_delay_activate_cb)
-    uc->candidate_selector_delay_activate_cb(uc->ptr, delay);
+  if (uc->candidate_selector_delay_activate_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_delay_activate_cb");
+    CALL_BACK_INT(uc->candidate_selector_delay_activate_cb, uc->ptr, delay);
+    UIM_TRACE_END(&span);
+  }
+
+  return uim_scm_f();
+}
+
+static uim_lisp
+im_delay_activate_candidate_selector_on_fd(uim_lisp uc_, uim_lisp fd_)
+{
+  uim_context uc;
+  struct uim_trace_span span;
+  int fd;
+
+  uc = retrieve_uim_context(uc_);
+  fd = C_INT(fd_);
+
+  if (uc->candidate_selector_delay_activate_fd_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_delay_activate_fd_cb");
+    CALL_BACK_INT(uc->candidate_selector_delay_activate_fd_cb, uc->ptr, fd);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -306,13 +462,17 @@ static uim_lisp
 im_select_candidate(uim_lisp uc_, uim_lisp idx_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   int idx;
 
   uc = retrieve_uim_context(uc_);
   idx = C_INT(idx_);
 
-  if (uc->candidate_selector_select_cb)
-    uc->candidate_selector_select_cb(uc->ptr, idx);
+  if (uc->candidate_selector_select_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_select_cb");
+    CALL_BACK_INT(uc->candidate_selector_select_cb, uc->ptr, idx);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -323,13 +483,17 @@ static uim_lisp
 im_shift_page_candidate(uim_lisp uc_, uim_lisp dir_)
 {
   uim_context uc;
+  struct uim_trace_span span;
   int dir;
 
   uc = retrieve_uim_context(uc_);
   dir = (C_BOOL(dir_)) ? 1 : 0;
     
-  if (uc->candidate_selector_shift_page_cb)
-    uc->candidate_selector_shift_page_cb(uc->ptr, dir);
+  if (uc->candidate_selector_shift_page_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_shift_page_cb");
+    CALL_BACK_INT(uc->candidate_selector_shift_page_cb, uc->ptr, dir);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -338,11 +502,15 @@ static uim_lisp
 im_deactivate_candidate_selector(uim_lisp uc_)
 {
   uim_context uc;
+  struct uim_trace_span span;
 
   uc = retrieve_uim_context(uc_);
 
-  if (uc->candidate_selector_deactivate_cb)
-    uc->candidate_selector_deactivate_cb(uc->ptr);
+  if (uc->candidate_selector_deactivate_cb) {
+    UIM_TRACE_BEGIN(&span, "candidate_selector_deactivate_cb");
+    CALL_BACK(uc->candidate_selector_deactivate_cb, uc->ptr);
+    UIM_TRACE_END(&span);
+  }
 
   return uim_scm_f();
 }
@@ -359,14 +527,53 @@ im_delay_activate_candidate_selector_supportedp(uim_lisp uc_)
   return uim_scm_f();
 }
 
+static uim_lisp
+im_delay_activate_candidate_selector_on_fd_supportedp(uim_lisp uc_)
+{
+  uim_context uc;
+
+  uc = retrieve_uim_context(uc_);
+
+  if (uc->candidate_selector_delay_activate_fd_cb)
+    return uim_scm_t();
+  return uim_scm_f();
+}
+
+static void *
+run_acquire_text_cb(void *text_args)
+{
+  struct text_args *args;
+  uim_context uc;
+
+  args = text_args;
+  uc = args->uc;
+  args->err = uc->acquire_text_cb(uc->ptr, args->text_id, args->origin,
+                                  args->former_len, args->latter_len,
+                                  &args->former, &args->latter);
+
+  return NULL;
+}
+
+static void *
+run_delete_text_cb(void *text_args)
+{
+  struct text_args *args;
+  uim_context uc;
+
+  args = text_args;
+  uc = args->uc;
+  args->err = uc->delete_text_cb(uc->ptr, args->text_id, args->origin,
+                                 args->former_len, args->latter_len);
+
+  return NULL;
+}
+
 static uim_lisp
 im_acquire_text(uim_lisp uc_, uim_lisp text_id_, uim_lisp origin_,
 		uim_lisp former_len_, uim_lisp latter_len_)
 {
   uim_context uc;
-  int err, former_len, latter_len;
-  enum UTextArea text_id;
-  enum UTextOrigin origin;
+  struct text_args args;
   char *former, *latter, *cv_former, *cv_latter;
   uim_lisp former_, latter_;
 
@@ -375,15 +582,17 @@ im_acquire_text(uim_lisp uc_, uim_lisp text_id_, uim_lisp origin_,
   if (!uc->acquire_text_cb)
     return uim_scm_f();
 
-  text_id = C_INT(text_id_);
-  origin = C_INT(origin_);
-  former_len = C_INT(former_len_);
-  latter_len = C_INT(latter_len_);
+  args.uc = uc;
+  args.text_id = C_INT(text_id_);
+  args.origin = C_INT(origin_);
+  args.former_len = C_INT(former_len_);
+  args.latter_len = C_INT(latter_len_);
 
-  err = uc->acquire_text_cb(uc->ptr, text_id, origin,
-                            former_len, latter_len, &former, &latter);
-  if (err)
+  uim_thread_call_back(run_acquire_text_cb, &args);
+  if (args.err)
     return uim_scm_f();
+  former = args.former;
+  latter = args.latter;
 
   /* FIXME: string->list is not applied here for each text part. This
    * interface should be revised when SigScheme has been introduced to
@@ -406,23 +615,22 @@ im_delete_text(uim_lisp uc_, uim_lisp text_id_, uim_lisp origin_,
 	       uim_lisp former_len_, uim_lisp latter_len_)
 {
   uim_context uc;
-  int err, former_len, latter_len;
-  enum UTextArea text_id;
-  enum UTextOrigin origin;
+  struct text_args args;
 
   uc = retrieve_uim_context(uc_);
 
   if (!uc->delete_text_cb)
     return uim_scm_f();
 
-  text_id = C_INT(text_id_);
-  origin = C_INT(origin_);
-  former_len = C_INT(former_len_);
-  latter_len = C_INT(latter_len_);
+  args.uc = uc;
+  args.text_id = C_INT(text_id_);
+  args.origin = C_INT(origin_);
+  args.former_len = C_INT(former_len_);
+  args.latter_len = C_INT(latter_len_);
 
-  err = uc->delete_text_cb(uc->ptr, text_id, origin, former_len, latter_len);
+  uim_thread_call_back(run_delete_text_cb, &args);
 
-  return MAKE_BOOL(!err);
+  return MAKE_BOOL(!args.err);
 }
 
 static uim_lisp
@@ -433,7 +641,7 @@ raise_configuration_change(uim_lisp uc_)
   uc = retrieve_uim_context(uc_);
 
   if (uc->configuration_changed_cb)
-    uc->configuration_changed_cb(uc->ptr);
+    CALL_BACK(uc->configuration_changed_cb, uc->ptr);
 
   return uim_scm_t();
 }
@@ -448,7 +656,7 @@ switch_app_global_im(uim_lisp uc_, uim_lisp name_)
   name = REFER_C_STR(name_);
 
   if (uc->switch_app_global_im_cb)
-    uc->switch_app_global_im_cb(uc->ptr, name);
+    CALL_BACK_STR(uc->switch_app_global_im_cb, uc->ptr, name);
 
   return uim_scm_t();
 }
@@ -463,7 +671,7 @@ switch_system_global_im(uim_lisp uc_, uim_lisp name_)
   name = REFER_C_STR(name_);
 
   if (uc->switch_system_global_im_cb)
-    uc->switch_system_global_im_cb(uc->ptr, name);
+    CALL_BACK_STR(uc->switch_system_global_im_cb, uc->ptr, name);
 
   return uim_scm_t();
 }
@@ -489,8 +697,12 @@ uim_init_im_subrs(void)
 
   uim_scm_init_proc2("im-delay-activate-candidate-selector",
 		     im_delay_activate_candidate_selector);
+  uim_scm_init_proc2("im-delay-activate-candidate-selector-on-fd",
+		     im_delay_activate_candidate_selector_on_fd);
   uim_scm_init_proc1("im-delay-activate-candidate-selector-supported?",
 		     im_delay_activate_candidate_selector_supportedp);
+  uim_scm_init_proc1("im-delay-activate-candidate-selector-on-fd-supported?",
+		     im_delay_activate_candidate_selector_on_fd_supportedp);
 
   uim_scm_init_proc5("im-acquire-text-internal", im_acquire_text);
   uim_scm_init_proc5("im-delete-text-internal", im_delete_text);
@@ -501,6 +713,7 @@ uim_init_im_subrs(void)
   uim_scm_init_proc2("im-update-mode",        im_update_mode);
 
   uim_scm_init_proc2("im-update-prop-list", im_update_prop_list);
+  uim_scm_init_proc2("im-update-prop-state", im_update_prop_state);
 
   uim_scm_init_proc1("im-raise-configuration-change",
 		     raise_configuration_change);
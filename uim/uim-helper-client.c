@@ -54,6 +54,7 @@
 #include "uim-helper.h"
 #include "uim-internal.h"
 #include "uim-util.h"
+#include "uim-trace.h"
 
 
 #define RECV_BUFFER_SIZE 1024
@@ -65,6 +66,8 @@ static char *uim_read_buf;
 
 static int uim_fd = -1;
 static void (*uim_disconnect_cb)(void);
+/* "subscribe" message sent on each connection, or NULL */
+static char *uim_subscription;
 
 
 static char *
@@ -138,6 +141,9 @@ int uim_helper_init_client_fd(void (*disconnect_cb)(void))
   uim_disconnect_cb = disconnect_cb;
   uim_fd = fd;
 
+  if (uim_subscription)
+    uim_helper_send_message(uim_fd, uim_subscription);
+
   return fd;
 
 error:
@@ -156,8 +162,10 @@ error:
 void
 uim_helper_close_client_fd(int fd)
 {
-  if (fd != -1)
+  if (fd != -1) {
+    uim_helper_cancel_batch(fd);
     close(fd);
+  }
 
   if (uim_disconnect_cb)
     uim_disconnect_cb();
@@ -185,24 +193,150 @@ uim_helper_client_get_prop_list(void)
   uim_helper_send_message(uim_fd, "prop_list_get\n");
 }
 
+/*
+ * Receive only the messages whose type starts with one of types, a
+ * NULL terminated array, instead of all of them. The subscription is
+ * sent again whenever the connection is reestablished. The requests
+ * libuim answers by itself are always included.
+ */
+void
+uim_helper_client_subscribe(const char *const *types)
+{
+  size_t len;
+  int i;
+
+  len = strlen("subscribe\nscm_stat_get\ntrace_get\n");
+  for (i = 0; types[i]; i++)
+    len += strlen(types[i]) + 1;
+
+  free(uim_subscription);
+  uim_subscription = uim_malloc(len + 1);
+  strlcpy(uim_subscription, "subscribe\nscm_stat_get\ntrace_get\n", len + 1);
+  for (i = 0; types[i]; i++) {
+    strlcat(uim_subscription, types[i], len + 1);
+    strlcat(uim_subscription, "\n", len + 1);
+  }
+
+  if (uim_fd != -1)
+    uim_helper_send_message(uim_fd, uim_subscription);
+}
+
+void
+uim_helper_client_begin_batch(void)
+{
+  uim_helper_begin_batch(uim_fd);
+}
+
+void
+uim_helper_client_end_batch(void)
+{
+  uim_helper_end_batch(uim_fd);
+}
+
+/*
+ * Called when fd is readable. Read until the socket is drained; with
+ * MSG_DONTWAIT this needs no select(2) before each read.
+ */
 void
 uim_helper_read_proc(int fd)
 {
   int rc;
-
-  while (uim_helper_fd_readable(fd) > 0) {
+  struct uim_trace_span span;
+
+  UIM_TRACE_BEGIN(&span, "uim_helper_read_proc");
+  /* the server is reading again if it has answered */
+  if (uim_helper_flush(fd) < 0) {
+    uim_helper_close_client_fd(fd);
+    UIM_TRACE_END(&span);
+    return;
+  }
+  for (;;) {
+#ifdef MSG_DONTWAIT
+    rc = recv(fd, uim_recv_buf, sizeof(uim_recv_buf), MSG_DONTWAIT);
+#else
+    if (uim_helper_fd_readable(fd) <= 0)
+      break;
     rc = read(fd, uim_recv_buf, sizeof(uim_recv_buf));
-    if (rc == 0 || (rc == -1 && errno != EAGAIN)) {
-      uim_helper_close_client_fd(fd);
-      return;
-    } else if (rc > 0) {
+#endif
+    if (rc > 0) {
       uim_read_buf = uim_helper_buffer_append(uim_read_buf, uim_recv_buf, rc);
+    } else if (rc == -1 && errno == EINTR) {
+      continue;
+    } else if (rc == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      uim_helper_close_client_fd(fd);
+      break;
     }
   }
+  UIM_TRACE_END(&span);
+}
+
+/*
+ * "scm_stat_get" is answered here so that every process running libuim
+ * reports its Scheme heap statistics, regardless of the bridge.
+ */
+static void
+send_scm_stat(void)
+{
+  uim_lisp stat_;
+  char *msg = NULL;
+
+  if (!uim_scm_is_initialized())
+    return;
+
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  stat_ = uim_scm_callf("scm-stat-string", "");
+  uim_asprintf(&msg, "scm_stat\npid\t%d\n%s", (int)getpid(),
+               uim_scm_refer_c_str(stat_));
+
+  UIM_CATCH_ERROR_END();
+
+  uim_helper_send_message(uim_fd, msg);
+  free(msg);
+}
+
+/* "trace_get" is answered only by the processes tracing keystrokes. */
+static void
+send_trace(void)
+{
+  char *spans, *msg = NULL;
+
+  if (!uim_trace_enabled)
+    return;
+
+  spans = uim_trace_get_string();
+  uim_asprintf(&msg, "trace\npid\t%d\n%s", (int)getpid(), spans);
+  free(spans);
+
+  uim_helper_send_message(uim_fd, msg);
+  free(msg);
+}
+
+/* the type of a message is its first line */
+static uim_bool
+is_message_type(const char *msg, const char *type)
+{
+  size_t len = strlen(type);
+
+  return (strncmp(msg, type, len) == 0 && msg[len] == '\n');
 }
 
 char *
 uim_helper_get_message(void)
 {
-  return uim_helper_buffer_get_message(uim_read_buf);
+  char *msg;
+
+  while ((msg = uim_helper_buffer_get_message(uim_read_buf))) {
+    if (is_message_type(msg, "scm_stat_get"))
+      send_scm_stat();
+    else if (is_message_type(msg, "trace_get"))
+      send_trace();
+    else
+      break;
+    free(msg);
+  }
+  return msg;
 }
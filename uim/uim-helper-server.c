@@ -34,7 +34,6 @@
 #include <config.h>
 
 #include <sys/types.h>
-#include <pwd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/param.h>
@@ -61,16 +60,34 @@ struct client {
   int fd;
   char *rbuf;
   char *wbuf;
+  /*
+   * Prefixes of the message types the client has subscribed to with a
+   * "subscribe" message. A client that has not subscribed gets all
+   * messages.
+   */
+  uim_bool subscribed;
+  char **topics;
+  int nr_topics;
+  /* bit i is set once the client has sent queries[i].request */
+  unsigned int queried;
+};
+
+/*
+ * Requests answered by every libuim process. Their replies go only to
+ * the clients which have asked, instead of waking up all of them.
+ */
+static const struct {
+  const char *request;
+  const char *reply;
+} queries[] = {
+  {"scm_stat_get", "scm_stat"},
+  {"trace_get", "trace"},
+  {NULL, NULL}
 };
 
 #define MAX_CLIENT 32
 #define BUFFER_SIZE 1024
 
-#ifndef SUN_LEN
-#define SUN_LEN(su)							\
-  (sizeof(*(su)) - sizeof((su)->sun_path) + strlen((su)->sun_path))
-#endif
-
 static fd_set s_fdset_read;
 static fd_set s_fdset_write;
 static int s_max_fd;
@@ -81,50 +98,11 @@ static char read_buf[BUFFER_SIZE];
 static int
 init_server_fd(char *path)
 {
-  int fd, flag;
-  struct sockaddr_un myhost;
-  struct passwd *pw;
-  char *logname;
-
-  fd = socket(PF_UNIX, SOCK_STREAM, 0);
-  if (fd < 0) {
-    perror("failed in socket()");
-    return -1;
-  }
-  fchmod(fd, S_IRUSR | S_IWUSR);
-
-  memset(&myhost, 0, sizeof(myhost));
-  myhost.sun_family = PF_UNIX;
-  strlcpy(myhost.sun_path, path, sizeof(myhost.sun_path));
-
-  if (bind(fd, (struct sockaddr *)&myhost, SUN_LEN(&myhost)) < 0) {
-    perror("failed in bind()");
-    return -1;
-  }
-
-  logname = getenv("LOGNAME");
-  if (logname) {
-    pw = getpwnam(logname);
-    if (pw) {
-      fchown(fd, pw->pw_uid, -1);
-    }
-  }
-
-  if ((flag = fcntl(fd, F_GETFL)) < 0) {
-    close(fd);
-    return -1;
-  }
-
-  flag |= O_NONBLOCK;
-  if (fcntl(fd, F_SETFL, flag) < 0) {
-    close(fd);
-    return -1;
-  }
+  int fd;
 
-  if (listen(fd, 5) < 0) {
-    perror("failed in listen()");
+  fd = uim_helper_init_server_fd(path);
+  if (fd < 0)
     return -1;
-  }
 
   FD_SET(fd, &s_fdset_read);
   s_max_fd = fd;
@@ -146,14 +124,33 @@ get_unused_client(void)
   clients = uim_realloc(clients, sizeof(struct client) * nr_client_slots);
   clients[nr_client_slots - 1].rbuf = uim_strdup("");
   clients[nr_client_slots - 1].wbuf = uim_strdup("");
+  clients[nr_client_slots - 1].subscribed = UIM_FALSE;
+  clients[nr_client_slots - 1].topics = NULL;
+  clients[nr_client_slots - 1].nr_topics = 0;
+  clients[nr_client_slots - 1].queried = 0;
 
   return &clients[nr_client_slots - 1];
 }
 
+static void
+clear_topics(struct client *cl)
+{
+  int i;
+
+  for (i = 0; i < cl->nr_topics; i++)
+    free(cl->topics[i]);
+  free(cl->topics);
+  cl->topics = NULL;
+  cl->nr_topics = 0;
+  cl->subscribed = UIM_FALSE;
+}
+
 static void
 close_client(struct client *cl)
 {
   close(cl->fd);
+  clear_topics(cl);
+  cl->queried = 0;
   if (cl->rbuf) {
     free(cl->rbuf);
     cl->rbuf = uim_strdup("");
@@ -165,16 +162,83 @@ close_client(struct client *cl)
   cl->fd = -1;
 }
 
+/* "subscribe\n" followed by a type prefix per line replaces the topics */
+static void
+subscribe(struct client *cl, const char *msg)
+{
+  const char *line, *eol;
+
+  clear_topics(cl);
+  cl->subscribed = UIM_TRUE;
+
+  line = strchr(msg, '\n');
+  for (line = line ? line + 1 : ""; *line; line = eol + 1) {
+    if (!(eol = strchr(line, '\n')))
+      break;
+    if (eol == line)
+      continue;
+    cl->topics = uim_realloc(cl->topics, sizeof(char *) * (cl->nr_topics + 1));
+    cl->topics[cl->nr_topics] = uim_malloc(eol - line + 1);
+    memcpy(cl->topics[cl->nr_topics], line, eol - line);
+    cl->topics[cl->nr_topics][eol - line] = '\0';
+    cl->nr_topics++;
+  }
+}
+
+static uim_bool
+is_subscribed(const struct client *cl, const char *type, size_t type_len)
+{
+  int i;
+  size_t len;
+
+  if (!cl->subscribed)
+    return UIM_TRUE;
+
+  for (i = 0; i < cl->nr_topics; i++) {
+    len = strlen(cl->topics[i]);
+    if (len <= type_len && !strncmp(cl->topics[i], type, len))
+      return UIM_TRUE;
+  }
+
+  return UIM_FALSE;
+}
+
+static uim_bool
+type_equals(const char *type, size_t type_len, const char *str)
+{
+  return (type_len == strlen(str) && !strncmp(type, str, type_len));
+}
+
 static void
 distribute_message(char *msg, struct client *cl)
 {
   int i;
-  size_t msg_len;
+  size_t msg_len, type_len;
+  const char *eol;
+  unsigned int reply_to;
 
   msg_len = strlen(msg);
+  /* the type of a message is its first line */
+  eol = strchr(msg, '\n');
+  type_len = eol ? (size_t)(eol - msg) : msg_len;
+
+  if (type_equals(msg, type_len, "subscribe")) {
+    subscribe(cl, msg);
+    return;
+  }
+
+  reply_to = 0;
+  for (i = 0; queries[i].request; i++) {
+    if (type_equals(msg, type_len, queries[i].request))
+      cl->queried |= 1U << i;
+    else if (type_equals(msg, type_len, queries[i].reply))
+      reply_to = 1U << i;
+  }
 
   for (i = 0; i < nr_client_slots; i++) {
-    if (clients[i].fd != -1 && clients[i].fd != cl->fd) {
+    if (clients[i].fd != -1 && clients[i].fd != cl->fd
+	&& (!reply_to || (clients[i].queried & reply_to))
+	&& is_subscribed(&clients[i], msg, type_len)) {
       clients[i].wbuf = uim_helper_buffer_append(clients[i].wbuf, msg, msg_len);
       FD_SET(clients[i].fd, &s_fdset_write);
     }
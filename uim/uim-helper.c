@@ -48,6 +48,15 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#elif defined(HAVE_SYS_POLL_H)
+#include <sys/poll.h>
+#else
+#include "bsd-poll.h"
+#endif
 
 #include "uim-internal.h"
 #include "uim-helper.h"
@@ -65,11 +74,19 @@
 #if USE_UIM_NOTIFY && !UIM_NON_LIBUIM_PROG
 #include "uim-notify.h"
 #endif
+#if !UIM_NON_LIBUIM_PROG
+#include "uim-trace.h"
+#endif
 
 #ifndef HAVE_SIG_T
 typedef void (*sig_t)(int);
 #endif
 
+#ifndef SUN_LEN
+#define SUN_LEN(su)							\
+  (sizeof(*(su)) - sizeof((su)->sun_path) + strlen((su)->sun_path))
+#endif
+
 enum RorW
   {
     READ,
@@ -101,13 +118,242 @@ uim_helper_fd(int fd, enum RorW rw)
     return FD_ISSET(fd, &fds) ? 1 : 0;
 }
 
+/*
+ * Messages sent to batch_fd between uim_helper_begin_batch() and
+ * uim_helper_end_batch() are gathered in batch_buf and written at
+ * once. The buffer is kept for the next batch.
+ */
+static int batch_fd = -1;
+static int batch_depth;
+static char *batch_buf;
+static size_t batch_len, batch_size;
+
+/*
+ * What a non-blocking fd does not take at once is kept in pending_buf
+ * and written before anything else sent to the fd, so that a client is
+ * never blocked by a server slow to read. uim_helper_flush() writes it
+ * out; uim_helper_read_proc() calls it each time the fd is readable.
+ * Only one fd, the connection of the client, is queued for; other fds
+ * are waited for at most WRITE_TIMEOUT.
+ */
+#define WRITE_TIMEOUT 1000  /* msec */
+
+static int pending_fd = -1;
+static char *pending_buf;
+static size_t pending_len, pending_size;
+
+static int
+wait_writable(int fd)
+{
+  struct pollfd pfd;
+  int rc;
+
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  while ((rc = poll(&pfd, 1, WRITE_TIMEOUT)) < 0) {
+    if (errno != EINTR)
+      return 0;
+  }
+  if (rc == 0) {
+    errno = ETIMEDOUT;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * Write iov until it is done or fd would block, advancing *iovp and
+ * *iovcntp past what has been written. SIGPIPE from a vanished peer is
+ * suppressed by MSG_NOSIGNAL where available. Returns 0, or -1 with
+ * errno set on error.
+ */
+static int
+write_iov(int fd, struct iovec **iovp, int *iovcntp)
+{
+  struct iovec *iov = *iovp;
+  int iovcnt = *iovcntp;
+  ssize_t res;
+  int err = 0;
+  int sigpipe_ignored = 0;
+  sig_t old_sigpipe = SIG_DFL;
+#ifdef MSG_NOSIGNAL
+  struct msghdr msg;
+  int is_socket = 1;
+#endif
+
+  while (iovcnt > 0) {
+#ifdef MSG_NOSIGNAL
+    if (is_socket) {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovcnt;
+      res = sendmsg(fd, &msg, MSG_NOSIGNAL);
+      if (res < 0 && errno == ENOTSOCK) {
+	is_socket = 0;
+	continue;
+      }
+    } else
+#endif
+    {
+      if (!sigpipe_ignored) {
+	old_sigpipe = signal(SIGPIPE, SIG_IGN);
+	sigpipe_ignored = 1;
+      }
+      res = writev(fd, iov, iovcnt);
+    }
+
+    if (res < 0) {
+      if (errno == EINTR)
+	continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+	err = errno;
+      break;
+    }
+
+    while (iovcnt > 0 && (size_t)res >= iov->iov_len) {
+      res -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + res;
+      iov->iov_len -= res;
+    }
+  }
+
+  if (sigpipe_ignored)
+    signal(SIGPIPE, old_sigpipe);
+
+  *iovp = iov;
+  *iovcntp = iovcnt;
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+static void
+pending_append(int fd, const struct iovec *iov, int iovcnt)
+{
+  size_t len = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    len += iov[i].iov_len;
+  if (pending_len + len > pending_size) {
+    while (pending_len + len > pending_size)
+      pending_size = pending_size ? pending_size * 2 : 4096;
+    pending_buf = uim_realloc(pending_buf, pending_size);
+  }
+  for (i = 0; i < iovcnt; i++) {
+    memcpy(pending_buf + pending_len, iov[i].iov_base, iov[i].iov_len);
+    pending_len += iov[i].iov_len;
+  }
+  pending_fd = fd;
+}
+
+/*
+ * Write out what is left of the earlier messages to fd without
+ * blocking. Returns 1 if some is still left, 0 if none, and -1 with
+ * errno set on error, in which case the rest is dropped.
+ */
+int
+uim_helper_flush(int fd)
+{
+  struct iovec iov, *iovp = &iov;
+  int iovcnt = 1;
+  size_t written;
+
+  if (fd < 0 || fd != pending_fd)
+    return 0;
+
+  iov.iov_base = pending_buf;
+  iov.iov_len = pending_len;
+  if (write_iov(fd, &iovp, &iovcnt) < 0) {
+    pending_len = 0;
+    pending_fd = -1;
+    return -1;
+  }
+  written = iovcnt ? pending_len - iov.iov_len : pending_len;
+  memmove(pending_buf, pending_buf + written, pending_len - written);
+  pending_len -= written;
+  if (pending_len == 0) {
+    pending_fd = -1;
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Send iov to fd in order after anything pending for it. Returns 0
+ * when it is written or queued, and -1 with errno set on error.
+ */
+static int
+send_iov(int fd, struct iovec *iov, int iovcnt)
+{
+  int rc;
+
+  if (fd == pending_fd) {
+    if ((rc = uim_helper_flush(fd)) < 0)
+      return -1;
+    if (rc > 0) {
+      pending_append(fd, iov, iovcnt);
+      return 0;
+    }
+  }
+
+  if (write_iov(fd, &iov, &iovcnt) < 0)
+    return -1;
+  if (iovcnt == 0)
+    return 0;
+
+  if (pending_fd < 0) {
+    pending_append(fd, iov, iovcnt);
+    return 0;
+  }
+  /* the queue is in use by another fd */
+  while (iovcnt > 0) {
+    if (!wait_writable(fd))
+      return -1;
+    if (write_iov(fd, &iov, &iovcnt) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+int
+uim_helper_write(int fd, const char *buf, size_t len)
+{
+  struct iovec iov;
+
+  iov.iov_base = (char *)buf;
+  iov.iov_len = len;
+
+  return send_iov(fd, &iov, 1);
+}
+
+static void
+batch_append(const char *str, size_t len)
+{
+  if (batch_len + len > batch_size) {
+    while (batch_len + len > batch_size)
+      batch_size = batch_size ? batch_size * 2 : 4096;
+    batch_buf = uim_realloc(batch_buf, batch_size);
+  }
+  memcpy(batch_buf + batch_len, str, len);
+  batch_len += len;
+}
+
 void
 uim_helper_send_message(int fd, const char *message)
 {
-  int res;
-  int out_len;
-  sig_t old_sigpipe;
-  char *buf, *bufp;
+  struct iovec iov[2];
+#if !UIM_NON_LIBUIM_PROG
+  struct uim_trace_span span;
+#endif
 
   if (UIM_CATCH_ERROR_BEGIN())
     return;
@@ -119,35 +365,92 @@ uim_helper_send_message(int fd, const char *message)
     uim_fatal_error("uim_helper_send_message(): NULL message");
 #else
   /* The condition fd < 0 ordinarily occurs. */
-  if (fd < 0 || !message)
+  if (fd < 0 || !message) {
+    UIM_CATCH_ERROR_END();
     return;
+  }
 #endif
 
-  uim_asprintf(&buf, "%s\n", message);
-
-  old_sigpipe = signal(SIGPIPE, SIG_IGN);
-
-  out_len = strlen(buf);
-  bufp = buf;
-  while (out_len > 0) {
-    if ((res = write(fd, bufp, out_len)) < 0) {
-      if (errno == EAGAIN || errno == EINTR)
-	continue;
+#if !UIM_NON_LIBUIM_PROG
+  UIM_TRACE_BEGIN(&span, "uim_helper_send_message");
+#endif
+  if (batch_depth > 0 && fd == batch_fd) {
+    batch_append(message, strlen(message));
+    batch_append("\n", 1);
+  } else {
+    /* the terminating newline is sent along without copying message */
+    iov[0].iov_base = (char *)message;
+    iov[0].iov_len = strlen(message);
+    iov[1].iov_base = (char *)"\n";
+    iov[1].iov_len = 1;
+    if (send_iov(fd, iov, 2) < 0)
       perror("uim_helper_send_message(): unhandled error");
-      break;
-    }
-
-    bufp += res;
-    out_len -= res;
   }
-  free(buf);
-  signal(SIGPIPE, old_sigpipe);
+#if !UIM_NON_LIBUIM_PROG
+  UIM_TRACE_END(&span);
+#endif
 
   UIM_CATCH_ERROR_END();
 
   return;
 }
 
+void
+uim_helper_begin_batch(int fd)
+{
+  if (fd < 0)
+    return;
+
+  if (batch_depth == 0)
+    batch_fd = fd;
+  if (fd == batch_fd)
+    batch_depth++;
+}
+
+void
+uim_helper_end_batch(int fd)
+{
+  struct iovec iov;
+
+  if (batch_depth == 0)
+    return;
+  if (fd != batch_fd) {
+    /* the connection of the batch has gone meanwhile */
+    uim_helper_cancel_batch(batch_fd);
+    return;
+  }
+  if (--batch_depth > 0)
+    return;
+
+  if (batch_len > 0) {
+    iov.iov_base = batch_buf;
+    iov.iov_len = batch_len;
+    if (send_iov(fd, &iov, 1) < 0)
+      perror("uim_helper_end_batch(): unhandled error");
+  }
+  batch_len = 0;
+  batch_fd = -1;
+}
+
+/*
+ * Drop the batch and the pending messages of fd without writing them,
+ * e.g. when fd is closed.
+ */
+void
+uim_helper_cancel_batch(int fd)
+{
+  if (fd == pending_fd) {
+    pending_len = 0;
+    pending_fd = -1;
+  }
+  if (batch_depth == 0 || fd != batch_fd)
+    return;
+
+  batch_depth = 0;
+  batch_len = 0;
+  batch_fd = -1;
+}
+
 static uim_bool
 check_dir(const char *dir)
 {
@@ -161,8 +464,8 @@ check_dir(const char *dir)
   }
 }
 
-uim_bool
-uim_helper_get_pathname(char *helper_path, int len)
+static uim_bool
+get_socket_pathname(char *helper_path, int len, const char *name)
 {
   struct passwd *pw;
   char *runtimedir;
@@ -212,7 +515,8 @@ uim_helper_get_pathname(char *helper_path, int len)
   if (!check_dir(helper_path))
     goto path_error;
 
-  if (strlcat(helper_path, "/uim-helper", len) >= (size_t)len)
+  if (strlcat(helper_path, "/", len) >= (size_t)len
+      || strlcat(helper_path, name, len) >= (size_t)len)
     goto path_error;
 
   UIM_CATCH_ERROR_END();
@@ -221,9 +525,9 @@ uim_helper_get_pathname(char *helper_path, int len)
 
  path_error:
 #if USE_UIM_NOTIFY && !UIM_NON_LIBUIM_PROG
-  uim_notify_fatal("uim_helper_get_pathname() failed");
+  uim_notify_fatal("cannot get the socket path for %s", name);
 #else
-  fprintf(stderr, "uim_helper_get_pathname() failed\n");
+  fprintf(stderr, "cannot get the socket path for %s\n", name);
 #endif
   helper_path[0] = '\0';
 
@@ -231,6 +535,18 @@ uim_helper_get_pathname(char *helper_path, int len)
   return UIM_FALSE;
 }
 
+uim_bool
+uim_helper_get_pathname(char *helper_path, int len)
+{
+  return get_socket_pathname(helper_path, len, "uim-helper");
+}
+
+uim_bool
+uim_server_get_pathname(char *server_path, int len)
+{
+  return get_socket_pathname(server_path, len, "uim-server");
+}
+
 int
 uim_helper_check_connection_fd(int fd)
 {
@@ -255,6 +571,61 @@ uim_helper_check_connection_fd(int fd)
   return 0;
 }
 
+/* Creates the listening socket of uim-helper-server or uim-server at
+ * path. */
+int
+uim_helper_init_server_fd(const char *path)
+{
+  int fd, flag;
+  struct sockaddr_un myhost;
+  struct passwd *pw;
+  char *logname;
+
+  fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("failed in socket()");
+    return -1;
+  }
+  fchmod(fd, S_IRUSR | S_IWUSR);
+
+  memset(&myhost, 0, sizeof(myhost));
+  myhost.sun_family = PF_UNIX;
+  strlcpy(myhost.sun_path, path, sizeof(myhost.sun_path));
+
+  if (bind(fd, (struct sockaddr *)&myhost, SUN_LEN(&myhost)) < 0) {
+    perror("failed in bind()");
+    close(fd);
+    return -1;
+  }
+
+  logname = getenv("LOGNAME");
+  if (logname) {
+    pw = getpwnam(logname);
+    if (pw) {
+      fchown(fd, pw->pw_uid, -1);
+    }
+  }
+
+  if ((flag = fcntl(fd, F_GETFL)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  flag |= O_NONBLOCK;
+  if (fcntl(fd, F_SETFL, flag) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  if (listen(fd, 5) < 0) {
+    perror("failed in listen()");
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
 int uim_helper_fd_readable(int fd)
 {
   return uim_helper_fd(fd, READ);
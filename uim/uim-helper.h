@@ -47,17 +47,29 @@ void uim_helper_client_get_prop_list(void);
 void uim_helper_read_proc(int fd);
 char *uim_helper_get_message(void);
 void uim_helper_send_message(int fd, const char *message);
+/* writes what a non-blocking fd has not taken yet; 1 while some is left */
+int uim_helper_flush(int fd);
+void uim_helper_client_subscribe(const char *const *types);
+/* messages sent in between are coalesced into one write */
+void uim_helper_client_begin_batch(void);
+void uim_helper_client_end_batch(void);
 
 /* functions for libuim server/client's implementation */
 uim_bool uim_helper_get_pathname(char *, int);
+uim_bool uim_server_get_pathname(char *, int);
 int uim_helper_str_terminated(const char *str);
 int uim_helper_check_connection_fd(int fd);
+int uim_helper_init_server_fd(const char *path);
+int uim_helper_write(int fd, const char *buf, size_t len);
 int uim_helper_fd_readable(int fd);
 int uim_helper_fd_writable(int fd);
 char *uim_helper_buffer_append(char *buf,
 			       const char *fragment, size_t fragment_size);
 void uim_helper_buffer_shift(char *buf, int count);
 char *uim_helper_buffer_get_message(char *buf);
+void uim_helper_begin_batch(int fd);
+void uim_helper_end_batch(int fd);
+void uim_helper_cancel_batch(int fd);
 
 uim_bool
 uim_helper_is_setugid(void);
@@ -62,6 +62,12 @@ extern "C" {
 #endif
 #endif /* UIM_USE_ERROR_GUARD */
 
+#if UIM_USE_THREADS
+#define UIM_THREAD_LOCAL __thread
+#else
+#define UIM_THREAD_LOCAL
+#endif
+
 
 struct uim_candidate_ {
   char *str;         /* candidate */
@@ -93,6 +99,17 @@ struct uim_context_ {
   char **modes;
   /* legacy 'property' API */
   char *propstr;
+  /* propstr is out of date since a prop_state_update */
+  uim_bool prop_list_stale;
+
+  /* non-NULL if the context is hosted by uim-server */
+  struct uim_remote_context *remote;
+
+  /* IM name the context was acquired for by uim_acquire_context(),
+     NULL if the context can't be pooled */
+  char *pool_im;
+  /* input mode the IM has started the context in */
+  int pool_mode;
 
   /* commit */
   void (*commit_cb)(void *ptr, const char *str);
@@ -106,6 +123,7 @@ struct uim_context_ {
   void (*candidate_selector_shift_page_cb)(void *ptr, int direction);
   void (*candidate_selector_deactivate_cb)(void *ptr);
   void (*candidate_selector_delay_activate_cb)(void *ptr, int delay);
+  void (*candidate_selector_delay_activate_fd_cb)(void *ptr, int fd);
   /* text acquisition */
   int (*acquire_text_cb)(void *ptr,
                          enum UTextArea text_id, enum UTextOrigin origin,
@@ -120,6 +138,7 @@ struct uim_context_ {
   void (*mode_update_cb)(void *ptr, int);
   /* property */
   void (*prop_list_update_cb)(void *ptr, const char *str);
+  void (*prop_state_update_cb)(void *ptr, const char *str);
 
   /* configuration changed */
   void (*configuration_changed_cb)(void *ptr);
@@ -150,6 +169,8 @@ void     uim_catch_error_end(void);
 #endif /* not UIM_USE_ERROR_GUARD */
 /* throw recoverable error */
 void    uim_throw_error(const char *msg);
+/* run func under an error guard of its own, return UIM_FALSE if caught */
+uim_bool uim_catch_error_call(uim_gc_gate_func_ptr func, void *arg, void **ret);
 
 void uim_init_dynlib(void);
 void uim_quit_dynlib(void);
@@ -170,6 +191,41 @@ uim_bool uim_notify_fatal(const char *msg_fmt, ...);
 #endif
 
 void uim_set_encoding(uim_context uc, const char *enc);
+
+/* uim-remote.c: contexts hosted by uim-server */
+#define UIM_REMOTE_CB_DELAY_ACTIVATE    1
+#define UIM_REMOTE_CB_ACQUIRE_TEXT      2
+#define UIM_REMOTE_CB_DELETE_TEXT       4
+#define UIM_REMOTE_CB_DELAY_ACTIVATE_FD 8
+#define UIM_REMOTE_CB_PROP_STATE        16
+void uim_init_remote(void);
+uim_bool uim_remote_create_context(uim_context uc,
+                                   const char *lang, const char *engine);
+void uim_remote_release_context(uim_context uc);
+void uim_remote_update_callbacks(uim_context uc);
+void uim_remote_switch_im(uim_context uc, const char *engine);
+uim_bool uim_remote_send(uim_context uc, const char *cmd, const char *fmt, ...);
+char **uim_remote_call(uim_context uc, const char *cmd, const char *fmt, ...);
+void uim_remote_free_values(char **values);
+const char *uim_remote_get_current_im_name(uim_context uc);
+/* wire format shared with uim-server */
+char *uim_remote_append_field(char *line, const char *str);
+int uim_remote_split_fields(char *line, char **fields, int max_fields);
+
+/* uim-thread.c: the interpreter thread */
+#if UIM_USE_THREADS
+uim_bool uim_init_thread(void);
+void uim_quit_thread(void);
+void uim_thread_enter(void);
+void uim_thread_leave(void);
+/* run func on the interpreter thread */
+void *uim_thread_call(uim_gc_gate_func_ptr func, void *arg);
+/* run func on the thread which called libuim */
+void *uim_thread_call_back(uim_gc_gate_func_ptr func, void *arg);
+#else
+#define uim_thread_call(func, arg)      ((*(func))(arg))
+#define uim_thread_call_back(func, arg) ((*(func))(arg))
+#endif
 #if HAVE_ISSETUGID
 #define uim_issetugid() issetugid()
 #else
@@ -179,7 +235,7 @@ uim_bool uim_issetugid(void);
 
 #if UIM_USE_ERROR_GUARD
 /* don't touch directly */
-extern JMP_BUF uim_catch_block_env;
+extern UIM_THREAD_LOCAL JMP_BUF uim_catch_block_env;
 #endif
 
 #ifdef __cplusplus
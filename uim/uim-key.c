@@ -35,11 +35,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "uim.h"
 #include "uim-scm.h"
 #include "uim-scm-abbrev.h"
 #include "uim-internal.h"
+#include "uim-trace.h"
 
 
 /* Future version of uim should have uim_filter_key() that returns 'filtered'
@@ -332,12 +335,76 @@ get_sym(int key)
   return NULL;
 }
 
+/*
+ * Time spent in the key handlers. It includes GC pauses occurred on
+ * the keystroke path.
+ */
+static struct {
+  unsigned long nr;
+  unsigned long total_usec;
+  unsigned long max_usec;
+} key_event_stat;
+
+/* a steady clock, so that a step of the wall clock is not counted */
+static double
+key_event_now_usec(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+  {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+  }
+}
+
+static void
+key_event_stat_add(double start)
+{
+  double elapsed;
+  unsigned long usec;
+
+  elapsed = key_event_now_usec() - start;
+  /* the fallback clock may still go back */
+  usec = (elapsed > 0) ? (unsigned long)elapsed : 0;
+  key_event_stat.nr++;
+  key_event_stat.total_usec += usec;
+  if (usec > key_event_stat.max_usec)
+    key_event_stat.max_usec = usec;
+}
+
+static uim_lisp
+c_key_event_stat(void)
+{
+  return uim_scm_callf("list", "ooo",
+                       CONS(MAKE_SYM("key-events"),
+                            MAKE_INT(key_event_stat.nr)),
+                       CONS(MAKE_SYM("key-event-usec-total"),
+                            MAKE_INT(key_event_stat.total_usec)),
+                       CONS(MAKE_SYM("key-event-usec-max"),
+                            MAKE_INT(key_event_stat.max_usec)));
+}
+
+static uim_lisp
+c_key_event_stat_reset(void)
+{
+  memset(&key_event_stat, 0, sizeof(key_event_stat));
+  return uim_scm_t();
+}
+
 /* FIXME: Replace 'protected' variable with stack protection */
 static uim_bool
 filter_key(uim_context uc, int key, int state, uim_bool is_press)
 {
   uim_lisp key_, filtered;
   const char *sym, *handler;
+  double start;
+  struct uim_trace_span span;
 
   if (!uc)
     return UIM_FALSE;
@@ -352,6 +419,17 @@ filter_key(uim_context uc, int key, int state, uim_bool is_press)
   if (!uc->is_enabled)
     return UIM_FALSE;
 
+  if (uc->remote) {
+    char **values;
+    uim_bool ret;
+
+    values = uim_remote_call(uc, (is_press) ? "press_key" : "release_key",
+			     "ii", key, state);
+    ret = (values && values[0] && atoi(values[0]));
+    uim_remote_free_values(values);
+    return ret;
+  }
+
   if (ISASCII(key)) {
     protected = key_ = MAKE_INT(key);
   }
@@ -365,7 +443,11 @@ filter_key(uim_context uc, int key, int state, uim_bool is_press)
     return UIM_FALSE;
 
   handler = (is_press) ? "key-press-handler" : "key-release-handler";
+  start = key_event_now_usec();
+  UIM_TRACE_BEGIN(&span, handler);
   filtered = uim_scm_callf(handler, "poi", uc, key_, state);
+  UIM_TRACE_END(&span);
+  key_event_stat_add(start);
   return C_BOOL(filtered);
 }
 
@@ -383,6 +465,7 @@ int
 uim_press_key(uim_context uc, int key, int state)
 {
   uim_bool filtered;
+  struct uim_trace_span span;
 
   if (UIM_CATCH_ERROR_BEGIN())
     return PASSTHROUGH;
@@ -392,7 +475,9 @@ uim_press_key(uim_context uc, int key, int state)
   assert(key >= 0);
   assert(state >= 0);
 
+  UIM_TRACE_BEGIN(&span, "uim_press_key");
   filtered = filter_key(uc, key, state, UIM_TRUE);
+  UIM_TRACE_END(&span);
 
   UIM_CATCH_ERROR_END();
 
@@ -403,6 +488,7 @@ int
 uim_release_key(uim_context uc, int key, int state)
 {
   uim_bool filtered;
+  struct uim_trace_span span;
 
   if (UIM_CATCH_ERROR_BEGIN())
     return PASSTHROUGH;
@@ -412,7 +498,9 @@ uim_release_key(uim_context uc, int key, int state)
   assert(key >= 0);
   assert(state >= 0);
 
+  UIM_TRACE_BEGIN(&span, "uim_release_key");
   filtered = filter_key(uc, key, state, UIM_FALSE);
+  UIM_TRACE_END(&span);
 
   UIM_CATCH_ERROR_END();
 
@@ -426,4 +514,7 @@ uim_init_key_subrs(void)
   uim_scm_gc_protect(&protected);
 
   define_valid_key_symbols();
+
+  uim_scm_init_proc0("key-event-stat", c_key_event_stat);
+  uim_scm_init_proc0("key-event-stat-reset!", c_key_event_stat_reset);
 }
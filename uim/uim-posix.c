@@ -38,6 +38,7 @@
 #include <string.h>
 #include <math.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -412,6 +413,24 @@ c_difftime(uim_lisp time1_, uim_lisp time0_)
   return time_t_to_uim_lisp(difftime(time1, time0));
 }
 
+/* (sec . usec) of a clock not stepped by the wall clock, for intervals */
+static uim_lisp
+c_clock_monotonic(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return CONS(MAKE_INT(ts.tv_sec), MAKE_INT(ts.tv_nsec / 1000));
+#endif
+  {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return CONS(MAKE_INT(tv.tv_sec), MAKE_INT(tv.tv_usec));
+  }
+}
+
 
 static uim_lisp
 c_sleep(uim_lisp seconds_)
@@ -458,6 +477,7 @@ uim_init_posix_subrs(void)
 
   uim_scm_init_proc0("time", c_time);
   uim_scm_init_proc2("difftime", c_difftime);
+  uim_scm_init_proc0("clock-monotonic", c_clock_monotonic);
 
   uim_scm_init_proc1("sleep", c_sleep);
 
@@ -0,0 +1,859 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Client side of uim-server.
+ *
+ * If LIBUIM_USE_SERVER is set, uim_create_context() asks uim-server to
+ * host the context instead of creating it in the local interpreter, so
+ * that input methods and their dictionaries are loaded only once per
+ * session. All frontends get this through the usual libuim API: the
+ * functions in uim.c and uim-key.c forward their requests here when
+ * uc->remote is set, and the callbacks of the hosted context are
+ * replayed on the local one.
+ *
+ * The connection is a UNIX domain socket next to the uim-helper-server
+ * one. Each request and each reply is a helper-style message terminated
+ * by an empty line. A message consists of tab separated lines whose
+ * fields are escaped by uim_remote_append_field(). A reply carries the
+ * callbacks fired while processing the request followed by a 'done'
+ * line, so a keystroke costs one round trip. See uim-server.c for the
+ * list of requests and events.
+ *
+ * Events may also arrive outside of a request, e.g. for a context whose
+ * candidate window waits for a descriptor. Bridges watch the connection
+ * given to the callback of uim_set_server_watch_cb() and call
+ * uim_server_read_proc() when it gets readable.
+ *
+ * If uim-server dies or does not answer within REMOTE_TIMEOUT, the
+ * connection is dropped. The next request reconnects, starting a new
+ * server if needed, and recreates every context there with its last
+ * known IM and mode.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/param.h>
+#include <sys/un.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-helper.h"
+#include "uim-util.h"
+#include "uim-trace.h"
+
+
+#define REMOTE_TIMEOUT (10 * 1000)  /* msec */
+#define RECONNECT_INTERVAL 5  /* sec */
+#define RECV_BUFFER_SIZE 1024
+
+struct uim_remote_context {
+  int id;
+  uim_context uc;
+  char *lang;
+  char *im_name;  /* the IM to recreate the context with */
+  struct uim_remote_context *next;
+};
+
+static uim_bool use_server;
+static int server_fd = -1;
+static char *read_buf;
+static struct uim_remote_context *contexts;
+static int last_id;
+static void (*server_watch_cb)(int fd);
+static uim_bool reconnecting;
+static time_t last_reconnect;
+
+static uim_bool connect_server(void);
+static void disconnect_server(void);
+static uim_bool reconnect_server(void);
+static uim_bool send_create(struct uim_remote_context *rc);
+static uim_bool write_message(const char *msg);
+static char *read_message(void);
+static char **wait_done(void);
+static char **process_message(char *msg);
+static void dispatch_event(char **fields, int n);
+static struct uim_remote_context *lookup_context(int id);
+
+
+void
+uim_init_remote(void)
+{
+  const char *env;
+
+  env = (uim_issetugid()) ? NULL : getenv("LIBUIM_USE_SERVER");
+  use_server = (env && env[0] && strcmp(env, "0") != 0);
+}
+
+/*
+ * Wire format
+ */
+char *
+uim_remote_append_field(char *line, const char *str)
+{
+  const char *p;
+  char *q;
+  size_t len, n;
+
+  len = strlen(line);
+  for (n = 0, p = str; *p; p++)
+    n += (*p == '\\' || *p == '\t' || *p == '\n') ? 2 : 1;
+
+  line = uim_realloc(line, len + 1 + n + 1);
+  q = &line[len];
+  *q++ = '\t';
+  for (p = str; *p; p++) {
+    switch (*p) {
+    case '\\':
+      *q++ = '\\';
+      *q++ = '\\';
+      break;
+    case '\t':
+      *q++ = '\\';
+      *q++ = 't';
+      break;
+    case '\n':
+      *q++ = '\\';
+      *q++ = 'n';
+      break;
+    default:
+      *q++ = *p;
+    }
+  }
+  *q = '\0';
+
+  return line;
+}
+
+/* Splits a line in place and unescapes the fields. Returns the number
+ * of fields stored into @fields. */
+int
+uim_remote_split_fields(char *line, char **fields, int max_fields)
+{
+  char *p, *q;
+  int n;
+
+  p = line;
+  for (n = 0; n < max_fields; n++) {
+    fields[n] = q = p;
+    for (; *p && *p != '\t'; p++) {
+      if (*p == '\\' && p[1]) {
+	p++;
+	*q++ = (*p == 'n') ? '\n' : (*p == 't') ? '\t' : *p;
+      } else {
+	*q++ = *p;
+      }
+    }
+    if (*p != '\t') {
+      *q = '\0';
+      return n + 1;
+    }
+    *q = '\0';
+    p++;
+  }
+
+  return n;
+}
+
+/*
+ * Connection
+ */
+static char *
+get_server_command(void)
+{
+  return UIM_LIBEXECDIR "/uim-server";
+}
+
+static int
+try_connect(const char *path)
+{
+  struct sockaddr_un server;
+  int fd;
+
+  memset(&server, 0, sizeof(server));
+  server.sun_family = PF_UNIX;
+  strlcpy(server.sun_path, path, sizeof(server.sun_path));
+
+  fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("fail to create socket");
+    return -1;
+  }
+  fcntl(fd, F_SETFD, fcntl(fd, F_GETFD, 0) | FD_CLOEXEC);
+
+#ifdef LOCAL_CREDS /* for NetBSD */
+  {
+    int on = 1;
+    setsockopt(fd, 0, LOCAL_CREDS, &on, sizeof(on));
+  }
+#endif
+
+  if (connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static uim_bool
+connect_server(void)
+{
+  char path[MAXPATHLEN];
+  FILE *serv_r = NULL, *serv_w = NULL;
+  int fd;
+
+  if (!uim_server_get_pathname(path, sizeof(path)))
+    return UIM_FALSE;
+
+  fd = try_connect(path);
+  if (fd < 0) {
+    pid_t serv_pid;
+    char buf[128];
+
+    /* uim-server prints an empty line once it has loaded init.scm */
+    serv_pid = uim_ipc_open_command(0, &serv_r, &serv_w, get_server_command());
+    if (serv_pid == 0)
+      return UIM_FALSE;
+
+    while (fgets(buf, sizeof(buf), serv_r) != NULL) {
+      if (strcmp(buf, "\n") == 0)
+	break;
+    }
+    fclose(serv_r);
+    fclose(serv_w);
+
+    fd = try_connect(path);
+    if (fd < 0)
+      return UIM_FALSE;
+  }
+
+  if (uim_helper_check_connection_fd(fd)) {
+    close(fd);
+    return UIM_FALSE;
+  }
+
+#ifdef LOCAL_CREDS /* for NetBSD */
+  {
+    /* skip the credential byte sent by the server */
+    char c;
+    read(fd, &c, 1);
+  }
+#endif
+
+  free(read_buf);
+  read_buf = uim_strdup("");
+  server_fd = fd;
+  if (server_watch_cb)
+    server_watch_cb(server_fd);
+
+  return UIM_TRUE;
+}
+
+/* The contexts become inert until reconnect_server() succeeds. */
+static void
+disconnect_server(void)
+{
+  if (server_fd == -1)
+    return;
+
+  fprintf(stderr, "libuim: lost the connection to uim-server\n");
+  close(server_fd);
+  server_fd = -1;
+  if (server_watch_cb)
+    server_watch_cb(-1);
+}
+
+/* Connects again and recreates the contexts. A server which keeps
+ * failing is not retried more often than every RECONNECT_INTERVAL. */
+static uim_bool
+reconnect_server(void)
+{
+  struct uim_remote_context *rc;
+  time_t now;
+
+  if (server_fd >= 0)
+    return UIM_TRUE;
+  if (reconnecting || !contexts)
+    return UIM_FALSE;
+
+  now = time(NULL);
+  if (last_reconnect && now >= last_reconnect
+      && now - last_reconnect < RECONNECT_INTERVAL)
+    return UIM_FALSE;
+  last_reconnect = now;
+
+  if (!connect_server())
+    return UIM_FALSE;
+
+  reconnecting = UIM_TRUE;
+  for (rc = contexts; rc && server_fd >= 0; rc = rc->next)
+    send_create(rc);
+  reconnecting = UIM_FALSE;
+
+  if (server_fd < 0)
+    return UIM_FALSE;
+  fprintf(stderr, "libuim: reconnected to uim-server\n");
+
+  return UIM_TRUE;
+}
+
+static uim_bool
+write_message(const char *msg)
+{
+  return (uim_helper_write(server_fd, msg, strlen(msg)) == 0);
+}
+
+static char *
+read_message(void)
+{
+  char buf[RECV_BUFFER_SIZE];
+  struct pollfd pfd;
+  ssize_t rc;
+  char *msg;
+  int ready;
+
+  while (!(msg = uim_helper_buffer_get_message(read_buf))) {
+    pfd.fd = server_fd;
+    pfd.events = POLLIN;
+    ready = poll(&pfd, 1, REMOTE_TIMEOUT);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return NULL;
+
+    rc = read(server_fd, buf, sizeof(buf));
+    if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+    if (rc <= 0)
+      return NULL;
+    read_buf = uim_helper_buffer_append(read_buf, buf, rc);
+  }
+
+  return msg;
+}
+
+/*
+ * Requests
+ */
+static char **
+vcall(uim_context uc, const char *cmd, const char *fmt, va_list args)
+{
+  char *line, num[32], **values;
+  const char *p;
+  uim_bool written;
+  struct uim_trace_span span;
+
+  if (server_fd < 0 && !reconnect_server())
+    return NULL;
+
+  UIM_TRACE_BEGIN(&span, cmd);
+
+  line = uim_strdup(cmd);
+  snprintf(num, sizeof(num), "%d", (uc) ? uc->remote->id : 0);
+  line = uim_remote_append_field(line, num);
+  for (p = fmt; *p; p++) {
+    switch (*p) {
+    case 'i':
+      snprintf(num, sizeof(num), "%d", va_arg(args, int));
+      line = uim_remote_append_field(line, num);
+      break;
+    case 's':
+      line = uim_remote_append_field(line, va_arg(args, const char *));
+      break;
+    }
+  }
+  line = uim_helper_buffer_append(line, "\n\n", 2);
+
+  written = write_message(line);
+  if (!written) {
+    /* uim-server has gone since the last request. The request has not
+     * reached it, so it is worth sending again to a new one. */
+    disconnect_server();
+    if (reconnect_server())
+      written = write_message(line);
+  }
+  free(line);
+  if (written) {
+    values = wait_done();
+  } else {
+    disconnect_server();
+    values = NULL;
+  }
+  UIM_TRACE_END(&span);
+
+  return values;
+}
+
+/* Returns the NULL-terminated values of the reply, or NULL if the
+ * server is unavailable. */
+char **
+uim_remote_call(uim_context uc, const char *cmd, const char *fmt, ...)
+{
+  va_list args;
+  char **values;
+
+  va_start(args, fmt);
+  values = vcall(uc, cmd, fmt, args);
+  va_end(args);
+
+  return values;
+}
+
+uim_bool
+uim_remote_send(uim_context uc, const char *cmd, const char *fmt, ...)
+{
+  va_list args;
+  char **values;
+
+  va_start(args, fmt);
+  values = vcall(uc, cmd, fmt, args);
+  va_end(args);
+
+  uim_remote_free_values(values);
+
+  return (values != NULL);
+}
+
+void
+uim_remote_free_values(char **values)
+{
+  char **p;
+
+  if (!values)
+    return;
+
+  for (p = values; *p; p++)
+    free(*p);
+  free(values);
+}
+
+/* Events are dispatched as soon as their message has been taken off the
+ * read buffer, so that callbacks may issue nested requests just like
+ * they do on a local context. */
+static char **
+wait_done(void)
+{
+  char *msg, **values;
+
+  for (;;) {
+    msg = read_message();
+    if (!msg) {
+      disconnect_server();
+      return NULL;
+    }
+    values = process_message(msg);
+    free(msg);
+    if (values)
+      return values;
+    if (server_fd < 0)
+      return NULL;
+  }
+}
+
+static char **
+process_message(char *msg)
+{
+  char *line, *next, *p, **fields, **values;
+  int i, n;
+
+  values = NULL;
+  for (line = msg; *line; line = next) {
+    next = strchr(line, '\n');
+    if (!next)
+      break;
+    *next++ = '\0';
+    if (!*line)
+      continue;
+
+    for (n = 1, p = line; *p; p++)
+      n += (*p == '\t');
+    fields = uim_malloc(sizeof(char *) * n);
+    n = uim_remote_split_fields(line, fields, n);
+
+    if (strcmp(fields[0], "done") == 0) {
+      uim_remote_free_values(values);
+      values = uim_malloc(sizeof(char *) * (n > 2 ? n - 1 : 1));
+      for (i = 2; i < n; i++)
+	values[i - 2] = uim_strdup(fields[i]);
+      values[(n > 2) ? n - 2 : 0] = NULL;
+    } else if (n >= 2) {
+      dispatch_event(fields, n);
+    }
+    free(fields);
+  }
+
+  return values;
+}
+
+static struct uim_remote_context *
+lookup_context(int id)
+{
+  struct uim_remote_context *rc;
+
+  for (rc = contexts; rc; rc = rc->next) {
+    if (rc->id == id)
+      return rc;
+  }
+
+  return NULL;
+}
+
+static void
+reply_acquire(struct uim_remote_context *rc, char **fields, int n)
+{
+  uim_context uc;
+  char *former, *latter, *line, num[32];
+  int err;
+
+  uc = rc->uc;
+  former = latter = NULL;
+  err = -1;
+  if (n >= 6 && uc->acquire_text_cb)
+    err = uc->acquire_text_cb(uc->ptr, atoi(fields[2]), atoi(fields[3]),
+			      atoi(fields[4]), atoi(fields[5]),
+			      &former, &latter);
+
+  line = uim_strdup("acquired");
+  snprintf(num, sizeof(num), "%d", rc->id);
+  line = uim_remote_append_field(line, num);
+  snprintf(num, sizeof(num), "%d", err);
+  line = uim_remote_append_field(line, num);
+  line = uim_remote_append_field(line, (!err && former) ? former : "");
+  line = uim_remote_append_field(line, (!err && latter) ? latter : "");
+  line = uim_helper_buffer_append(line, "\n\n", 2);
+  if (!err) {
+    free(former);
+    free(latter);
+  }
+
+  if (!write_message(line))
+    disconnect_server();
+  free(line);
+}
+
+static void
+reply_delete(struct uim_remote_context *rc, char **fields, int n)
+{
+  uim_context uc;
+  char *line, num[32];
+  int err;
+
+  uc = rc->uc;
+  err = -1;
+  if (n >= 6 && uc->delete_text_cb)
+    err = uc->delete_text_cb(uc->ptr, atoi(fields[2]), atoi(fields[3]),
+			     atoi(fields[4]), atoi(fields[5]));
+
+  line = uim_strdup("deleted");
+  snprintf(num, sizeof(num), "%d", rc->id);
+  line = uim_remote_append_field(line, num);
+  snprintf(num, sizeof(num), "%d", err);
+  line = uim_remote_append_field(line, num);
+  line = uim_helper_buffer_append(line, "\n\n", 2);
+
+  if (!write_message(line))
+    disconnect_server();
+  free(line);
+}
+
+static void
+update_mode_list(uim_context uc, char **names, int nr)
+{
+  int i;
+
+  for (i = 0; i < uc->nr_modes; i++)
+    free(uc->modes[i]);
+  free(uc->modes);
+
+  uc->nr_modes = nr;
+  uc->modes = uim_malloc(sizeof(char *) * (nr > 0 ? nr : 1));
+  for (i = 0; i < nr; i++)
+    uc->modes[i] = uim_strdup(names[i]);
+}
+
+static void
+dispatch_event(char **fields, int n)
+{
+  struct uim_remote_context *rc;
+  uim_context uc;
+  const char *ev, *str;
+  int arg;
+
+  rc = lookup_context(atoi(fields[1]));
+  if (!rc)
+    return;
+  uc = rc->uc;
+  ev = fields[0];
+  str = (n > 2) ? fields[2] : "";
+  arg = atoi(str);
+
+  if (strcmp(ev, "commit") == 0) {
+    if (uc->commit_cb)
+      uc->commit_cb(uc->ptr, str);
+  } else if (strcmp(ev, "preedit_clear") == 0) {
+    if (uc->preedit_clear_cb)
+      uc->preedit_clear_cb(uc->ptr);
+  } else if (strcmp(ev, "preedit_pushback") == 0) {
+    if (uc->preedit_pushback_cb && n >= 4)
+      uc->preedit_pushback_cb(uc->ptr, arg, fields[3]);
+  } else if (strcmp(ev, "preedit_update") == 0) {
+    if (uc->preedit_update_cb)
+      uc->preedit_update_cb(uc->ptr);
+  } else if (strcmp(ev, "cand_activate") == 0) {
+    if (uc->candidate_selector_activate_cb && n >= 4)
+      uc->candidate_selector_activate_cb(uc->ptr, arg, atoi(fields[3]));
+  } else if (strcmp(ev, "cand_select") == 0) {
+    if (uc->candidate_selector_select_cb)
+      uc->candidate_selector_select_cb(uc->ptr, arg);
+  } else if (strcmp(ev, "cand_shift_page") == 0) {
+    if (uc->candidate_selector_shift_page_cb)
+      uc->candidate_selector_shift_page_cb(uc->ptr, arg);
+  } else if (strcmp(ev, "cand_deactivate") == 0) {
+    if (uc->candidate_selector_deactivate_cb)
+      uc->candidate_selector_deactivate_cb(uc->ptr);
+  } else if (strcmp(ev, "cand_delay_activate") == 0) {
+    if (uc->candidate_selector_delay_activate_cb)
+      uc->candidate_selector_delay_activate_cb(uc->ptr, arg);
+  } else if (strcmp(ev, "acquire") == 0) {
+    reply_acquire(rc, fields, n);
+  } else if (strcmp(ev, "delete") == 0) {
+    reply_delete(rc, fields, n);
+  } else if (strcmp(ev, "mode_list") == 0) {
+    update_mode_list(uc, &fields[2], n - 2);
+    if (uc->mode_list_update_cb)
+      uc->mode_list_update_cb(uc->ptr);
+  } else if (strcmp(ev, "mode") == 0) {
+    uc->mode = arg;
+    if (uc->mode_update_cb)
+      uc->mode_update_cb(uc->ptr, arg);
+  } else if (strcmp(ev, "prop_list") == 0) {
+    free(uc->propstr);
+    uc->propstr = uim_strdup(str);
+    uc->prop_list_stale = UIM_FALSE;
+    if (uc->prop_list_update_cb)
+      uc->prop_list_update_cb(uc->ptr, str);
+  } else if (strcmp(ev, "prop_state") == 0) {
+    uc->prop_list_stale = UIM_TRUE;
+    if (uc->prop_state_update_cb)
+      uc->prop_state_update_cb(uc->ptr, str);
+  } else if (strcmp(ev, "configuration_changed") == 0) {
+    if (uc->configuration_changed_cb)
+      uc->configuration_changed_cb(uc->ptr);
+  } else if (strcmp(ev, "switch_app_global_im") == 0) {
+    if (uc->switch_app_global_im_cb)
+      uc->switch_app_global_im_cb(uc->ptr, str);
+  } else if (strcmp(ev, "switch_system_global_im") == 0) {
+    if (uc->switch_system_global_im_cb)
+      uc->switch_system_global_im_cb(uc->ptr, str);
+  }
+}
+
+/*
+ * Reading outside of requests
+ */
+void
+uim_set_server_watch_cb(void (*watch_cb)(int fd))
+{
+  server_watch_cb = watch_cb;
+  if (server_watch_cb && server_fd >= 0)
+    server_watch_cb(server_fd);
+}
+
+void
+uim_server_read_proc(void)
+{
+  char buf[RECV_BUFFER_SIZE], *msg;
+  ssize_t rc;
+
+  if (server_fd < 0)
+    return;
+
+  rc = read(server_fd, buf, sizeof(buf));
+  if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+    return;
+  if (rc <= 0) {
+    disconnect_server();
+    /* the contexts of the bridge should not wait for the next key to
+     * get their properties back */
+    reconnect_server();
+    return;
+  }
+  read_buf = uim_helper_buffer_append(read_buf, buf, rc);
+
+  /* read_buf may be consumed by the nested requests of the callbacks */
+  while (server_fd >= 0 && (msg = uim_helper_buffer_get_message(read_buf))) {
+    uim_remote_free_values(process_message(msg));
+    free(msg);
+  }
+}
+
+/*
+ * Contexts
+ */
+static uim_bool
+send_create(struct uim_remote_context *rc)
+{
+  uim_context uc;
+
+  uc = rc->uc;
+  if (!uim_remote_send(uc, "create", "sss", uc->client_encoding,
+		       (rc->lang) ? rc->lang : "",
+		       (rc->im_name) ? rc->im_name : ""))
+    return UIM_FALSE;
+  if (!reconnecting)
+    return UIM_TRUE;
+
+  /* restore what the context had on the former server */
+  uim_remote_update_callbacks(uc);
+  if (uc->mode)
+    uim_remote_send(uc, "set_mode", "i", uc->mode);
+
+  return (server_fd >= 0);
+}
+
+uim_bool
+uim_remote_create_context(uim_context uc, const char *lang, const char *engine)
+{
+  struct uim_remote_context *rc;
+
+  if (!use_server)
+    return UIM_FALSE;
+
+  if (server_fd < 0
+      && !((contexts) ? reconnect_server() : connect_server())) {
+    /* don't retry on every context; fall back to local contexts */
+    fprintf(stderr, "libuim: uim-server is not available\n");
+    use_server = UIM_FALSE;
+    return UIM_FALSE;
+  }
+
+  rc = uim_malloc(sizeof(*rc));
+  rc->id = ++last_id;
+  rc->uc = uc;
+  rc->lang = (lang) ? uim_strdup(lang) : NULL;
+  rc->im_name = (engine) ? uim_strdup(engine) : NULL;
+  rc->next = contexts;
+  contexts = rc;
+  uc->remote = rc;
+
+  if (!send_create(rc)) {
+    uim_remote_release_context(uc);
+    return UIM_FALSE;
+  }
+
+  return UIM_TRUE;
+}
+
+void
+uim_remote_release_context(uim_context uc)
+{
+  struct uim_remote_context *rc, **p;
+
+  rc = uc->remote;
+  if (server_fd >= 0)
+    uim_remote_send(uc, "release", "");
+
+  for (p = &contexts; *p; p = &(*p)->next) {
+    if (*p == rc) {
+      *p = rc->next;
+      break;
+    }
+  }
+  free(rc->lang);
+  free(rc->im_name);
+  free(rc);
+  uc->remote = NULL;
+}
+
+void
+uim_remote_switch_im(uim_context uc, const char *engine)
+{
+  struct uim_remote_context *rc;
+
+  rc = uc->remote;
+  free(rc->im_name);
+  rc->im_name = uim_strdup(engine);
+  uim_remote_send(uc, "switch_im", "s", engine);
+}
+
+/* uim-server must know which optional callbacks are available since the
+ * IMs change their behavior according to them. */
+void
+uim_remote_update_callbacks(uim_context uc)
+{
+  int mask;
+
+  mask = 0;
+  if (uc->candidate_selector_delay_activate_cb)
+    mask |= UIM_REMOTE_CB_DELAY_ACTIVATE;
+  if (uc->candidate_selector_delay_activate_fd_cb)
+    mask |= UIM_REMOTE_CB_DELAY_ACTIVATE_FD;
+  if (uc->acquire_text_cb)
+    mask |= UIM_REMOTE_CB_ACQUIRE_TEXT;
+  if (uc->delete_text_cb)
+    mask |= UIM_REMOTE_CB_DELETE_TEXT;
+  if (uc->prop_state_update_cb)
+    mask |= UIM_REMOTE_CB_PROP_STATE;
+
+  uim_remote_send(uc, "callbacks", "i", mask);
+}
+
+const char *
+uim_remote_get_current_im_name(uim_context uc)
+{
+  struct uim_remote_context *rc;
+  char **values;
+
+  rc = uc->remote;
+  values = uim_remote_call(uc, "current_im", "");
+  if (values && values[0]) {
+    free(rc->im_name);
+    rc->im_name = uim_strdup(values[0]);
+  }
+  uim_remote_free_values(values);
+
+  return (rc->im_name) ? rc->im_name : "direct";
+}
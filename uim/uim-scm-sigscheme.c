@@ -51,6 +51,7 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <unistd.h>
 
 #include "uim-scm.h"
 /* To avoid macro name conflict with SigScheme, uim-scm-abbrev.h should not
@@ -59,6 +60,11 @@
 
 static uim_lisp protected;
 static uim_bool initialized;
+static uim_gc_gate_hook_ptr gc_gate_hook;
+static ScmStorageConf storage_conf;
+
+static void *call_with_gc_ready_stack_obj(uim_gc_gate_func_ptr func,
+                                          void *arg);
 
 static void *uim_scm_error_internal(const char *msg);
 struct uim_scm_error_obj_args {
@@ -122,6 +128,7 @@ struct vector2array_args {
 };
 static void *uim_scm_vector2array_internal(struct vector2array_args *args);
 static void *uim_scm_eval_internal(void *uim_lisp_obj);
+static void *uim_scm_eval_c_string_internal(const char *str);
 static void *uim_scm_quote_internal(void *obj);
 struct cons_args {
   uim_lisp car;
@@ -136,6 +143,12 @@ uim_scm_set_fatal_error_hook(void (*hook)(void))
   scm_set_fatal_error_callback(hook);
 }
 
+void
+uim_scm_set_gc_gate_hook(uim_gc_gate_hook_ptr hook)
+{
+  gc_gate_hook = hook;
+}
+
 void
 uim_scm_error(const char *msg)
 {
@@ -220,7 +233,7 @@ uim_scm_make_int(long integer)
 {
   assert(uim_scm_gc_any_contextp());
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack(uim_scm_make_int_internal,
+  return (uim_lisp)call_with_gc_ready_stack_obj(uim_scm_make_int_internal,
                                                     (void *)(intptr_t)integer);
 }
 
@@ -259,7 +272,7 @@ uim_scm_make_char(long ch)
 {
   assert(uim_scm_gc_any_contextp());
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_make_char_internal, (void *)(intptr_t)ch);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_make_char_internal, (void *)(intptr_t)ch);
 }
 
 static void *
@@ -317,7 +330,7 @@ uim_scm_make_str(const char *str)
   assert(uim_scm_gc_any_contextp());
   assert(str);
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_make_str_internal, (void *)str);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_make_str_internal, (void *)str);
 }
 
 static void *
@@ -332,7 +345,7 @@ uim_scm_make_str_directly(char *str)
   assert(uim_scm_gc_any_contextp());
   assert(str);
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_make_str_directly_internal, (void *)str);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_make_str_directly_internal, (void *)str);
 }
 
 static void *
@@ -356,7 +369,7 @@ uim_scm_make_symbol(const char *name)
   assert(uim_scm_gc_any_contextp());
   assert(name);
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_make_symbol_internal, (void *)name);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_make_symbol_internal, (void *)name);
 }
 
 static void *
@@ -395,7 +408,7 @@ uim_scm_make_ptr(void *ptr)
 {
   assert(uim_scm_gc_any_contextp());
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack(uim_scm_make_ptr_internal,
+  return (uim_lisp)call_with_gc_ready_stack_obj(uim_scm_make_ptr_internal,
                                                     ptr);
 }
 
@@ -422,7 +435,7 @@ uim_scm_make_func_ptr(uim_func_ptr func_ptr)
 {
   assert(uim_scm_gc_any_contextp());
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_make_func_ptr_internal, (void *)(uintptr_t)func_ptr);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_make_func_ptr_internal, (void *)(uintptr_t)func_ptr);
 }
 
 static void *
@@ -452,9 +465,30 @@ uim_scm_gc_unprotect(uim_lisp *location)
 void *
 uim_scm_call_with_gc_ready_stack(uim_gc_gate_func_ptr func, void *arg)
 {
+  void *ret;
+
   assert(uim_scm_gc_any_contextp());
   assert(func);
 
+  if (gc_gate_hook && (*gc_gate_hook)(func, arg, &ret, UIM_FALSE))
+    return ret;
+
+  return scm_call_with_gc_ready_stack(func, arg);
+}
+
+/* for func returning a Scheme object, which the gate hook keeps alive
+ * for the thread it is handed to (see uim-thread.c) */
+static void *
+call_with_gc_ready_stack_obj(uim_gc_gate_func_ptr func, void *arg)
+{
+  void *ret;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(func);
+
+  if (gc_gate_hook && (*gc_gate_hook)(func, arg, &ret, UIM_TRUE))
+    return ret;
+
   return scm_call_with_gc_ready_stack(func, arg);
 }
 
@@ -493,7 +527,7 @@ uim_scm_symbol_value(const char *symbol_str)
   assert(uim_scm_gc_any_contextp());
   assert(symbol_str);
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_symbol_value_internal, (void *)symbol_str);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_symbol_value_internal, (void *)symbol_str);
 }
 
 static void *
@@ -616,7 +650,7 @@ uim_scm_quote(uim_lisp obj)
   assert(uim_scm_gc_any_contextp());
   assert(uim_scm_gc_protectedp(obj));
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack(uim_scm_quote_internal,
+  return (uim_lisp)call_with_gc_ready_stack_obj(uim_scm_quote_internal,
                                                     (void *)obj);
 }
 
@@ -696,7 +730,7 @@ uim_scm_array2list(void **ary, size_t len, uim_lisp (*conv)(void *))
   args.len = len;
   args.conv = conv;
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_array2list_internal, &args);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_array2list_internal, &args);
 }
 
 static void *
@@ -745,7 +779,7 @@ uim_scm_array2vector(void **ary, size_t len, uim_lisp (*conv)(void *))
   args.len = len;
   args.conv = conv;
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_array2vector_internal, &args);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_array2vector_internal, &args);
 }
 
 static void *
@@ -914,7 +948,7 @@ uim_scm_eval(uim_lisp obj)
   assert(uim_scm_gc_any_contextp());
   assert(uim_scm_gc_protectedp(obj));
 
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack(uim_scm_eval_internal,
+  return (uim_lisp)call_with_gc_ready_stack_obj(uim_scm_eval_internal,
 						    (void *)obj);
 }
 
@@ -933,7 +967,13 @@ uim_scm_eval_c_string(const char *str)
 {
   assert(uim_scm_gc_any_contextp());
 
-  return (uim_lisp)scm_eval_c_string(str);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_eval_c_string_internal, (void *)str);
+}
+
+static void *
+uim_scm_eval_c_string_internal(const char *str)
+{
+  return (void *)scm_eval_c_string(str);
 }
 
 uim_lisp
@@ -947,7 +987,7 @@ uim_scm_call(uim_lisp proc, uim_lisp args)
 
   _args.proc = proc;
   _args.args = args;
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_call_internal, &_args);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_call_internal, &_args);
 }
 
 static void *
@@ -972,7 +1012,7 @@ uim_scm_call_with_guard(uim_lisp failed, uim_lisp proc, uim_lisp args)
   _args.failed = failed;
   _args.proc = proc;
   _args.args = args;
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_call_with_guard_internal, &_args);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_call_with_guard_internal, &_args);
 }
 
 static void *
@@ -1007,7 +1047,7 @@ uim_scm_callf(const char *proc, const char *args_fmt, ...)
   args.proc = proc;
   args.args_fmt = args_fmt;
   args.with_guard = UIM_FALSE;
-  ret = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
+  ret = (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
 
   va_end(args.args);
 
@@ -1104,7 +1144,7 @@ uim_scm_callf_with_guard(uim_lisp failed,
   args.args_fmt = args_fmt;
   args.with_guard = UIM_TRUE;
   args.failed = failed;
-  ret = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
+  ret = (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
 
   va_end(args.args);
 
@@ -1154,7 +1194,7 @@ uim_scm_cons(uim_lisp car, uim_lisp cdr)
 
   args.car = car;
   args.cdr = cdr;
-  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_cons_internal, &args);
+  return (uim_lisp)call_with_gc_ready_stack_obj((uim_gc_gate_func_ptr)uim_scm_cons_internal, &args);
 }
 
 static void *
@@ -1282,10 +1322,48 @@ uim_scm_init_proc5(const char *name,
   scm_register_func(name, (scm_procedure_fixed_5)func, SCM_PROCEDURE_FIXED_5);
 }
 
+/*
+ * Heap parameters can be tuned by environment variables for large
+ * IMs, to reduce GC frequency during typing. Invalid values are
+ * ignored.
+ */
+static size_t
+heap_param(const char *env, size_t default_val, size_t min, size_t max)
+{
+  const char *str;
+  char *end;
+  unsigned long val;
+
+  /* libuim-scm cannot use uim_issetugid() of libuim */
+  if (getuid() != geteuid() || getgid() != getegid())
+    return default_val;
+  if (!(str = getenv(env)) || !*str)
+    return default_val;
+
+  val = strtoul(str, &end, 10);
+  if (*end || val < min || val > max)
+    return default_val;
+
+  return (size_t)val;
+}
+
+static uim_lisp
+heap_conf(void)
+{
+  return uim_scm_callf("list", "oooo",
+                       uim_scm_cons(uim_scm_make_symbol("heap-size"),
+                                    uim_scm_make_int(storage_conf.heap_size)),
+                       uim_scm_cons(uim_scm_make_symbol("heap-alloc-threshold"),
+                                    uim_scm_make_int(storage_conf.heap_alloc_threshold)),
+                       uim_scm_cons(uim_scm_make_symbol("n-heaps-init"),
+                                    uim_scm_make_int(storage_conf.n_heaps_init)),
+                       uim_scm_cons(uim_scm_make_symbol("n-heaps-max"),
+                                    uim_scm_make_int(storage_conf.n_heaps_max)));
+}
+
 void
 uim_scm_init(const char *system_load_path)
 {
-  ScmStorageConf storage_conf;
   char **argp, *argv[8];
 
   if (initialized)
@@ -1313,10 +1391,14 @@ uim_scm_init(const char *system_load_path)
   /* 128KB/heap, max 0.99GB on 32-bit systems. Since maximum length of list can
    * be represented by a Scheme integer, SCM_INT_MAX limits the number of cons
    * cells. */
-  storage_conf.heap_size            = 16384;
-  storage_conf.heap_alloc_threshold = 16384;
+  storage_conf.heap_size = heap_param("LIBUIM_SCM_HEAP_SIZE",
+                                      16384, 1024, 1024 * 1024);
+  storage_conf.heap_alloc_threshold = heap_param("LIBUIM_SCM_HEAP_ALLOC_THRESHOLD",
+                                                 storage_conf.heap_size,
+                                                 1, 1024 * 1024);
   storage_conf.n_heaps_max          = SCM_INT_MAX / storage_conf.heap_size;
-  storage_conf.n_heaps_init         = 1;
+  storage_conf.n_heaps_init = heap_param("LIBUIM_SCM_N_HEAPS_INIT",
+                                         1, 1, storage_conf.n_heaps_max);
   storage_conf.symbol_hash_size     = 1024;
   scm_initialize(&storage_conf, (const char *const *)&argv);
   initialized = UIM_TRUE;  /* init here for uim_scm_gc_protect() */
@@ -1324,6 +1406,8 @@ uim_scm_init(const char *system_load_path)
   protected = (uim_lisp)SCM_FALSE;
   uim_scm_gc_protect(&protected);
 
+  uim_scm_init_proc0("%%heap-conf", heap_conf);
+
 #ifdef DEBUG_SCM
   /* required by test-im.scm */
   uim_scm_callf("provide", "s", "debug");
@@ -89,15 +89,21 @@ typedef int uim_bool;
 typedef struct uim_opaque * uim_lisp;
 typedef void (*uim_func_ptr)(void);
 typedef void *(*uim_gc_gate_func_ptr)(void *);
+typedef uim_bool (*uim_gc_gate_hook_ptr)(uim_gc_gate_func_ptr func, void *arg,
+                                         void **ret, uim_bool obj);
 
 
 /* subsystem interfaces */
-/* uim_scm_init(), uim_scm_quit() and uim_scm_set_fatal_error_hook() are
- * called from libuim internal. Ordinary user must not call it directly. */
+/* uim_scm_init(), uim_scm_quit(), uim_scm_set_fatal_error_hook() and
+ * uim_scm_set_gc_gate_hook() are called from libuim internal. Ordinary
+ * user must not call it directly. */
 void uim_scm_init(const char *system_load_path);
 void uim_scm_quit(void);
 uim_bool uim_scm_is_initialized(void);
 void uim_scm_set_fatal_error_hook(void (*hook)(void));
+/* hook returns UIM_TRUE if it has run func elsewhere; obj tells that
+ * func returns a Scheme object */
+void uim_scm_set_gc_gate_hook(uim_gc_gate_hook_ptr hook);
 void uim_scm_set_lib_path(const char *path);
 
 /* GC protections */
@@ -0,0 +1,976 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * uim-server hosts input contexts on behalf of the libuim clients
+ * started with LIBUIM_USE_SERVER, so that the IMs of a session are
+ * loaded into a single interpreter. See uim-remote.c for the client
+ * side and the wire format.
+ *
+ * Requests (client -> server). ID is chosen by the client.
+ *
+ *   create ID encoding lang engine        lang and engine may be empty
+ *   release ID
+ *   callbacks ID mask                     UIM_REMOTE_CB_*
+ *   reset ID, focus_in ID, focus_out ID, place ID, displace ID
+ *   press_key ID key state                -> filtered
+ *   release_key ID key state              -> filtered
+ *   input_string ID str                   -> consumed
+ *   candidate ID index hint               -> str heading annotation
+ *   set_candidate_index ID index
+ *   delay_activating ID nr limit index    -> nr limit index
+ *   switch_im ID name
+ *   current_im ID                         -> name
+ *   set_mode ID mode
+ *   prop_activate ID str
+ *   prop_list_update ID                   prop_list event if out of date
+ *   prop_update_custom ID custom value
+ *   encoding ID encoding
+ *   reload_configs 0
+ *
+ * Every request is answered by the events fired while processing it,
+ * followed by 'done ID values...'. The events are named after the
+ * callbacks: commit, preedit_clear, preedit_pushback, preedit_update,
+ * cand_activate, cand_select, cand_shift_page, cand_deactivate,
+ * cand_delay_activate, mode_list, mode, prop_list, prop_state,
+ * configuration_changed, switch_app_global_im and
+ * switch_system_global_im.
+ *
+ * A descriptor to watch for the delayed activation (see
+ * uim_set_delay_candidate_selector_fd_cb()) is only valid in the
+ * server. The server watches it by itself and sends
+ * 'cand_delay_activate ID 0' once it gets readable.
+ *
+ * Text acquisition needs an answer from the client in the middle of a
+ * request: 'acquire ID text_id origin former_len latter_len' and
+ * 'delete ID text_id origin former_len latter_len' terminate a message,
+ * and the server waits for 'acquired ID err former latter' or
+ * 'deleted ID err' while still serving nested requests of the client.
+ * A nested request for the waiting context is deferred until the outer
+ * request has returned, unless it is a query (candidate, current_im and
+ * delay_activating); a deferred key is answered as filtered, and the
+ * events of the deferred requests are sent without 'done' line.
+ *
+ * Events of a context owned by another client than the requesting one
+ * are sent as a message without 'done' line. The client reads them
+ * in uim_server_read_proc() once its bridge sees the connection
+ * readable.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/param.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
+
+#include "uim.h"
+#include "uim-im-switcher.h"
+#include "uim-internal.h"
+#include "uim-helper.h"
+#include "uim-util.h"
+
+
+struct client {
+  int fd;
+  char *rbuf;
+  char *wbuf;
+  char *deferred;  /* requests to serve after the current one */
+  uim_bool dead;  /* closed after the current request */
+};
+
+struct hosted_context {
+  int client;
+  int id;
+  uim_context uc;
+  int busy;  /* nesting depth of the requests in progress */
+  int watch_fd;  /* for the delayed activation, -1 if none */
+  struct hosted_context *next;
+};
+
+#define BUFFER_SIZE 1024
+#define CLIENT_TIMEOUT (3 * 1000)  /* msec */
+
+static int nr_client_slots;
+static struct client *clients;
+static struct hosted_context *hosted_contexts;
+static char read_buf[BUFFER_SIZE];
+
+static void process_request(int ci, char *msg, uim_bool deferred);
+
+/*
+ * Clients
+ */
+static int
+get_unused_client(void)
+{
+  int i;
+
+  for (i = 0; i < nr_client_slots; i++) {
+    if (clients[i].fd == -1)
+      return i;
+  }
+
+  nr_client_slots++;
+  clients = uim_realloc(clients, sizeof(struct client) * nr_client_slots);
+  clients[nr_client_slots - 1].rbuf = uim_strdup("");
+  clients[nr_client_slots - 1].wbuf = uim_strdup("");
+  clients[nr_client_slots - 1].deferred = uim_strdup("");
+  clients[nr_client_slots - 1].dead = UIM_FALSE;
+
+  return nr_client_slots - 1;
+}
+
+static void
+close_client(int ci)
+{
+  struct client *cl;
+  struct hosted_context *hc, **p;
+
+  for (p = &hosted_contexts; *p; ) {
+    hc = *p;
+    if (hc->client == ci) {
+      *p = hc->next;
+      uim_release_context(hc->uc);
+      free(hc);
+    } else {
+      p = &hc->next;
+    }
+  }
+
+  cl = &clients[ci];
+  close(cl->fd);
+  free(cl->rbuf);
+  cl->rbuf = uim_strdup("");
+  free(cl->wbuf);
+  cl->wbuf = uim_strdup("");
+  free(cl->deferred);
+  cl->deferred = uim_strdup("");
+  cl->dead = UIM_FALSE;
+  cl->fd = -1;
+}
+
+static uim_bool
+check_session_alive(void)
+{
+  /* If there's no connection, we can assume user logged out. */
+  int i;
+
+  for (i = 0; i < nr_client_slots; i++) {
+    if (clients[i].fd != -1)
+      return UIM_TRUE;
+  }
+
+  return UIM_FALSE; /* User already logged out */
+}
+
+static uim_bool
+accept_new_connection(int server_fd)
+{
+  struct sockaddr_un clientsoc;
+  socklen_t len;
+  int new_fd, flag, ci;
+
+  len = sizeof(clientsoc);
+  new_fd = accept(server_fd, (struct sockaddr *)&clientsoc, &len);
+
+  if (new_fd < 0) {
+    perror("accept failed");
+    return UIM_FALSE;
+  }
+
+  if (uim_helper_check_connection_fd(new_fd)) {
+    close(new_fd);
+    return UIM_FALSE;
+  }
+
+  if ((flag = fcntl(new_fd, F_GETFL)) < 0) {
+    close(new_fd);
+    return UIM_FALSE;
+  }
+
+  flag |= O_NONBLOCK;
+  if (fcntl(new_fd, F_SETFL, flag) < 0) {
+    close(new_fd);
+    return UIM_FALSE;
+  }
+
+  ci = get_unused_client();
+  clients[ci].fd = new_fd;
+#ifdef LOCAL_CREDS	/* for NetBSD */
+  {
+    char buf[1] = { '\0' };
+    write(new_fd, buf, 1);
+  }
+#endif
+
+  return UIM_TRUE;
+}
+
+/* The clients wait for the reply in a blocking manner, so the reply is
+ * written synchronously. */
+static void
+flush_client(struct client *cl)
+{
+  struct pollfd pfd;
+  ssize_t ret;
+  size_t out_len;
+  char *out;
+
+  out = cl->wbuf;
+  out_len = strlen(cl->wbuf);
+  while (out_len > 0 && !cl->dead) {
+    if ((ret = write(cl->fd, out, out_len)) < 0) {
+      if (errno == EINTR)
+	continue;
+      if (errno != EAGAIN) {
+	cl->dead = UIM_TRUE;
+	break;
+      }
+      pfd.fd = cl->fd;
+      pfd.events = POLLOUT;
+      if (poll(&pfd, 1, CLIENT_TIMEOUT) <= 0)
+	cl->dead = UIM_TRUE;
+    } else {
+      out += ret;
+      out_len -= ret;
+    }
+  }
+
+  free(cl->wbuf);
+  cl->wbuf = uim_strdup("");
+}
+
+/* Events without 'done' line are handled by the client on its next
+ * request. */
+static void
+flush_events(struct client *cl)
+{
+  if (cl->fd != -1 && cl->wbuf[0]) {
+    cl->wbuf = uim_helper_buffer_append(cl->wbuf, "\n", 1);
+    flush_client(cl);
+  }
+}
+
+static uim_bool
+read_client(struct client *cl)
+{
+  ssize_t rc;
+
+  rc = read(cl->fd, read_buf, sizeof(read_buf));
+  if (rc == -1) {
+    if (errno == EAGAIN || errno == EINTR)
+      return UIM_TRUE;
+    return UIM_FALSE;
+  } else if (rc == 0) {
+    return UIM_FALSE;
+  }
+
+  cl->rbuf = uim_helper_buffer_append(cl->rbuf, read_buf, rc);
+
+  return UIM_TRUE;
+}
+
+/* Waits for the answer to a text acquisition request. Other requests
+ * of the client, issued from its callbacks, are served meanwhile. */
+static char *
+wait_reply(int ci, const char *expected)
+{
+  struct pollfd pfd;
+  size_t len;
+  char *msg;
+  int ready;
+
+  len = strlen(expected);
+  while (!clients[ci].dead) {
+    msg = uim_helper_buffer_get_message(clients[ci].rbuf);
+    if (msg) {
+      if (strncmp(msg, expected, len) == 0 && msg[len] == '\t')
+	return msg;
+      process_request(ci, msg, UIM_FALSE);
+      free(msg);
+      continue;
+    }
+
+    pfd.fd = clients[ci].fd;
+    pfd.events = POLLIN;
+    ready = poll(&pfd, 1, CLIENT_TIMEOUT);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0 || !read_client(&clients[ci]))
+      clients[ci].dead = UIM_TRUE;
+  }
+
+  return NULL;
+}
+
+static char *
+first_line(char *msg)
+{
+  char *eol;
+
+  eol = strchr(msg, '\n');
+  if (eol)
+    *eol = '\0';
+
+  return msg;
+}
+
+/*
+ * Callbacks of the hosted contexts
+ */
+static void
+emit(struct hosted_context *hc, const char *ev, const char *fmt, ...)
+{
+  struct client *cl;
+  va_list args;
+  char *line, num[32];
+  const char *p;
+
+  cl = &clients[hc->client];
+  if (cl->dead)
+    return;
+
+  line = uim_strdup(ev);
+  snprintf(num, sizeof(num), "%d", hc->id);
+  line = uim_remote_append_field(line, num);
+  va_start(args, fmt);
+  for (p = fmt; *p; p++) {
+    switch (*p) {
+    case 'i':
+      snprintf(num, sizeof(num), "%d", va_arg(args, int));
+      line = uim_remote_append_field(line, num);
+      break;
+    case 's':
+      line = uim_remote_append_field(line, va_arg(args, const char *));
+      break;
+    }
+  }
+  va_end(args);
+
+  cl->wbuf = uim_helper_buffer_append(cl->wbuf, line, strlen(line));
+  cl->wbuf = uim_helper_buffer_append(cl->wbuf, "\n", 1);
+  free(line);
+}
+
+static void
+commit_cb(void *ptr, const char *str)
+{
+  emit(ptr, "commit", "s", str);
+}
+
+static void
+preedit_clear_cb(void *ptr)
+{
+  emit(ptr, "preedit_clear", "");
+}
+
+static void
+preedit_pushback_cb(void *ptr, int attr, const char *str)
+{
+  emit(ptr, "preedit_pushback", "is", attr, str);
+}
+
+static void
+preedit_update_cb(void *ptr)
+{
+  emit(ptr, "preedit_update", "");
+}
+
+static void
+cand_activate_cb(void *ptr, int nr, int display_limit)
+{
+  emit(ptr, "cand_activate", "ii", nr, display_limit);
+}
+
+static void
+cand_select_cb(void *ptr, int index)
+{
+  emit(ptr, "cand_select", "i", index);
+}
+
+static void
+cand_shift_page_cb(void *ptr, int direction)
+{
+  emit(ptr, "cand_shift_page", "i", direction);
+}
+
+static void
+cand_deactivate_cb(void *ptr)
+{
+  emit(ptr, "cand_deactivate", "");
+}
+
+static void
+cand_delay_activate_cb(void *ptr, int delay)
+{
+  emit(ptr, "cand_delay_activate", "i", delay);
+}
+
+static void
+cand_delay_activate_fd_cb(void *ptr, int fd)
+{
+  struct hosted_context *hc = ptr;
+
+  hc->watch_fd = fd;
+}
+
+static void
+mode_list_update_cb(void *ptr)
+{
+  struct hosted_context *hc = ptr;
+  struct client *cl;
+  char *line, num[32];
+  int i, nr;
+
+  cl = &clients[hc->client];
+  if (cl->dead)
+    return;
+
+  line = uim_strdup("mode_list");
+  snprintf(num, sizeof(num), "%d", hc->id);
+  line = uim_remote_append_field(line, num);
+  nr = uim_get_nr_modes(hc->uc);
+  for (i = 0; i < nr; i++)
+    line = uim_remote_append_field(line, uim_get_mode_name(hc->uc, i));
+
+  cl->wbuf = uim_helper_buffer_append(cl->wbuf, line, strlen(line));
+  cl->wbuf = uim_helper_buffer_append(cl->wbuf, "\n", 1);
+  free(line);
+}
+
+static void
+mode_update_cb(void *ptr, int mode)
+{
+  emit(ptr, "mode", "i", mode);
+}
+
+static void
+prop_list_update_cb(void *ptr, const char *str)
+{
+  emit(ptr, "prop_list", "s", str);
+}
+
+static void
+prop_state_update_cb(void *ptr, const char *str)
+{
+  emit(ptr, "prop_state", "s", str);
+}
+
+static void
+configuration_changed_cb(void *ptr)
+{
+  emit(ptr, "configuration_changed", "");
+}
+
+static void
+switch_app_global_im_cb(void *ptr, const char *name)
+{
+  emit(ptr, "switch_app_global_im", "s", name);
+}
+
+static void
+switch_system_global_im_cb(void *ptr, const char *name)
+{
+  emit(ptr, "switch_system_global_im", "s", name);
+}
+
+/* Sends the pending events and the request, and returns the fields of
+ * the answer. */
+static char *
+ask_client(struct hosted_context *hc, const char *req, const char *expected,
+	   int text_id, int origin, int former_len, int latter_len)
+{
+  struct client *cl;
+
+  emit(hc, req, "iiii", text_id, origin, former_len, latter_len);
+  cl = &clients[hc->client];
+  cl->wbuf = uim_helper_buffer_append(cl->wbuf, "\n", 1);
+  flush_client(cl);
+
+  return wait_reply(hc->client, expected);
+}
+
+static int
+acquire_text_cb(void *ptr, enum UTextArea text_id, enum UTextOrigin origin,
+		int former_len, int latter_len, char **former, char **latter)
+{
+  char *msg, *line, *fields[5];
+  int err;
+
+  msg = ask_client(ptr, "acquire", "acquired",
+		   text_id, origin, former_len, latter_len);
+  if (!msg)
+    return -1;
+
+  line = first_line(msg);
+  err = -1;
+  if (uim_remote_split_fields(line, fields, 5) == 5) {
+    err = atoi(fields[2]);
+    if (!err) {
+      *former = uim_strdup(fields[3]);
+      *latter = uim_strdup(fields[4]);
+    }
+  }
+  free(msg);
+
+  return err;
+}
+
+static int
+delete_text_cb(void *ptr, enum UTextArea text_id, enum UTextOrigin origin,
+	       int former_len, int latter_len)
+{
+  char *msg, *line, *fields[3];
+  int err;
+
+  msg = ask_client(ptr, "delete", "deleted",
+		   text_id, origin, former_len, latter_len);
+  if (!msg)
+    return -1;
+
+  line = first_line(msg);
+  err = -1;
+  if (uim_remote_split_fields(line, fields, 3) == 3)
+    err = atoi(fields[2]);
+  free(msg);
+
+  return err;
+}
+
+/*
+ * Requests
+ */
+static struct hosted_context *
+create_context(int ci, int id, const char *enc,
+	       const char *lang, const char *engine)
+{
+  struct hosted_context *hc;
+  uim_context uc;
+
+  hc = uim_malloc(sizeof(*hc));
+  hc->client = ci;
+  hc->id = id;
+  hc->busy = 0;
+  hc->watch_fd = -1;
+
+  uc = uim_create_context(hc, enc, (*lang) ? lang : NULL,
+			  (*engine) ? engine : NULL, NULL, commit_cb);
+  if (!uc) {
+    free(hc);
+    return NULL;
+  }
+  hc->uc = uc;
+
+  uim_set_preedit_cb(uc, preedit_clear_cb, preedit_pushback_cb,
+		     preedit_update_cb);
+  uim_set_candidate_selector_cb(uc, cand_activate_cb, cand_select_cb,
+				cand_shift_page_cb, cand_deactivate_cb);
+  uim_set_mode_list_update_cb(uc, mode_list_update_cb);
+  uim_set_mode_cb(uc, mode_update_cb);
+  uim_set_prop_list_update_cb(uc, prop_list_update_cb);
+  uim_set_configuration_changed_cb(uc, configuration_changed_cb);
+  uim_set_im_switch_request_cb(uc, switch_app_global_im_cb,
+			       switch_system_global_im_cb);
+
+  hc->next = hosted_contexts;
+  hosted_contexts = hc;
+
+  return hc;
+}
+
+static void
+release_context(struct hosted_context *hc)
+{
+  struct hosted_context **p;
+
+  for (p = &hosted_contexts; *p; p = &(*p)->next) {
+    if (*p == hc) {
+      *p = hc->next;
+      break;
+    }
+  }
+  uim_release_context(hc->uc);
+  free(hc);
+}
+
+static struct hosted_context *
+lookup_context(int ci, int id)
+{
+  struct hosted_context *hc;
+
+  for (hc = hosted_contexts; hc; hc = hc->next) {
+    if (hc->client == ci && hc->id == id)
+      return hc;
+  }
+
+  return NULL;
+}
+
+static char *
+append_int(char *line, int n)
+{
+  char num[32];
+
+  snprintf(num, sizeof(num), "%d", n);
+  return uim_remote_append_field(line, num);
+}
+
+/* requests answered with values, which the client waits for */
+static uim_bool
+is_query(const char *cmd)
+{
+  return (strcmp(cmd, "candidate") == 0
+	  || strcmp(cmd, "current_im") == 0
+	  || strcmp(cmd, "delay_activating") == 0);
+}
+
+static void
+defer_request(struct client *cl, char **fields, int n)
+{
+  char *line;
+  int i;
+
+  line = uim_strdup(fields[0]);
+  for (i = 1; i < n; i++)
+    line = uim_remote_append_field(line, fields[i]);
+  cl->deferred = uim_helper_buffer_append(cl->deferred, line, strlen(line));
+  cl->deferred = uim_helper_buffer_append(cl->deferred, "\n\n", 2);
+  free(line);
+}
+
+static char *
+serve(int ci, char **fields, int n, char *done)
+{
+  struct hosted_context *hc;
+  uim_context uc;
+  const char *cmd;
+  int id;
+
+  cmd = fields[0];
+  id = atoi(fields[1]);
+
+  if (strcmp(cmd, "create") == 0) {
+    if (n >= 5)
+      create_context(ci, id, fields[2], fields[3], fields[4]);
+    return done;
+  } else if (strcmp(cmd, "reload_configs") == 0) {
+    uim_prop_reload_configs();
+    return done;
+  }
+
+  hc = lookup_context(ci, id);
+  if (!hc)
+    return done;
+  uc = hc->uc;
+
+  /* Issued from a callback while the context waits for the client: it
+   * must neither release the context nor re-enter its handlers. */
+  if (hc->busy && !is_query(cmd)) {
+    defer_request(&clients[ci], fields, n);
+    if (strcmp(cmd, "press_key") == 0 || strcmp(cmd, "release_key") == 0
+	|| strcmp(cmd, "input_string") == 0)
+      done = append_int(done, 1);
+    return done;
+  }
+
+  if (strcmp(cmd, "release") == 0) {
+    release_context(hc);
+    return done;
+  }
+
+  hc->busy++;
+  if (strcmp(cmd, "callbacks") == 0 && n >= 3) {
+    int mask = atoi(fields[2]);
+
+    uim_set_delay_candidate_selector_cb(uc,
+      (mask & UIM_REMOTE_CB_DELAY_ACTIVATE) ? cand_delay_activate_cb : NULL);
+    uim_set_delay_candidate_selector_fd_cb(uc,
+      (mask & UIM_REMOTE_CB_DELAY_ACTIVATE_FD)
+      ? cand_delay_activate_fd_cb : NULL);
+    if (!(mask & UIM_REMOTE_CB_DELAY_ACTIVATE_FD))
+      hc->watch_fd = -1;
+    uim_set_text_acquisition_cb(uc,
+      (mask & UIM_REMOTE_CB_ACQUIRE_TEXT) ? acquire_text_cb : NULL,
+      (mask & UIM_REMOTE_CB_DELETE_TEXT) ? delete_text_cb : NULL);
+    uim_set_prop_state_update_cb(uc,
+      (mask & UIM_REMOTE_CB_PROP_STATE) ? prop_state_update_cb : NULL);
+  } else if (strcmp(cmd, "reset") == 0) {
+    uim_reset_context(uc);
+  } else if (strcmp(cmd, "focus_in") == 0) {
+    uim_focus_in_context(uc);
+  } else if (strcmp(cmd, "focus_out") == 0) {
+    uim_focus_out_context(uc);
+  } else if (strcmp(cmd, "place") == 0) {
+    uim_place_context(uc);
+  } else if (strcmp(cmd, "displace") == 0) {
+    uim_displace_context(uc);
+  } else if (strcmp(cmd, "press_key") == 0 && n >= 4) {
+    done = append_int(done,
+		      uim_press_key(uc, atoi(fields[2]), atoi(fields[3])) == 0);
+  } else if (strcmp(cmd, "release_key") == 0 && n >= 4) {
+    done = append_int(done,
+		      uim_release_key(uc, atoi(fields[2]), atoi(fields[3])) == 0);
+  } else if (strcmp(cmd, "input_string") == 0 && n >= 3) {
+    done = append_int(done, uim_input_string(uc, fields[2]));
+  } else if (strcmp(cmd, "candidate") == 0 && n >= 4) {
+    uim_candidate cand;
+
+    cand = uim_get_candidate(uc, atoi(fields[2]), atoi(fields[3]));
+    if (cand) {
+      done = uim_remote_append_field(done, uim_candidate_get_cand_str(cand));
+      done = uim_remote_append_field(done,
+				     uim_candidate_get_heading_label(cand));
+      done = uim_remote_append_field(done,
+				     uim_candidate_get_annotation_str(cand));
+      uim_candidate_free(cand);
+    }
+  } else if (strcmp(cmd, "set_candidate_index") == 0 && n >= 3) {
+    uim_set_candidate_index(uc, atoi(fields[2]));
+  } else if (strcmp(cmd, "delay_activating") == 0 && n >= 5) {
+    int nr, display_limit, selected_index;
+
+    nr = atoi(fields[2]);
+    display_limit = atoi(fields[3]);
+    selected_index = atoi(fields[4]);
+    uim_delay_activating(uc, &nr, &display_limit, &selected_index);
+    done = append_int(done, nr);
+    done = append_int(done, display_limit);
+    done = append_int(done, selected_index);
+  } else if (strcmp(cmd, "switch_im") == 0 && n >= 3) {
+    uim_switch_im(uc, fields[2]);
+  } else if (strcmp(cmd, "current_im") == 0) {
+    done = uim_remote_append_field(done, uim_get_current_im_name(uc));
+  } else if (strcmp(cmd, "set_mode") == 0 && n >= 3) {
+    uim_set_mode(uc, atoi(fields[2]));
+  } else if (strcmp(cmd, "prop_activate") == 0 && n >= 3) {
+    uim_prop_activate(uc, fields[2]);
+  } else if (strcmp(cmd, "prop_list_update") == 0) {
+    uim_prop_list_update(uc);
+  } else if (strcmp(cmd, "prop_update_custom") == 0 && n >= 4) {
+    uim_prop_update_custom(uc, fields[2], fields[3]);
+  } else if (strcmp(cmd, "encoding") == 0 && n >= 3) {
+    uim_set_client_encoding(uc, fields[2]);
+  }
+  hc->busy--;
+
+  return done;
+}
+
+static void
+process_request(int ci, char *msg, uim_bool deferred)
+{
+  char *line, *p, *done, **fields;
+  int i, n;
+
+  line = first_line(msg);
+
+  for (n = 1, p = line; *p; p++)
+    n += (*p == '\t');
+  fields = uim_malloc(sizeof(char *) * n);
+  n = uim_remote_split_fields(line, fields, n);
+  if (n < 2) {
+    free(fields);
+    return;
+  }
+
+  done = uim_strdup("done");
+  done = uim_remote_append_field(done, fields[1]);
+  done = serve(ci, fields, n, done);
+  free(fields);
+
+  /* nobody waits for the answer to a deferred request */
+  if (deferred) {
+    flush_events(&clients[ci]);
+  } else if (clients[ci].fd != -1) {
+    clients[ci].wbuf = uim_helper_buffer_append(clients[ci].wbuf,
+						done, strlen(done));
+    clients[ci].wbuf = uim_helper_buffer_append(clients[ci].wbuf, "\n\n", 2);
+    flush_client(&clients[ci]);
+  }
+  free(done);
+
+  /* events of the contexts owned by the other clients */
+  for (i = 0; i < nr_client_slots; i++) {
+    if (i != ci)
+      flush_events(&clients[i]);
+  }
+}
+
+/* Serves the requests read from the client. The deferred ones were
+ * issued earlier, so they come first. */
+static void
+serve_client(int ci)
+{
+  uim_bool deferred;
+  char *msg;
+
+  if (!read_client(&clients[ci]))
+    clients[ci].dead = UIM_TRUE;
+  while (!clients[ci].dead) {
+    msg = uim_helper_buffer_get_message(clients[ci].deferred);
+    deferred = (msg != NULL);
+    if (!msg)
+      msg = uim_helper_buffer_get_message(clients[ci].rbuf);
+    if (!msg)
+      break;
+    process_request(ci, msg, deferred);
+    free(msg);
+  }
+}
+
+/* Fires the delayed activations whose descriptors have got readable.
+ * The client is told to activate right away. */
+static void
+activate_watched(fd_set *readfds)
+{
+  struct hosted_context *hc;
+
+  for (hc = hosted_contexts; hc; hc = hc->next) {
+    if (hc->watch_fd != -1 && FD_ISSET(hc->watch_fd, readfds)) {
+      hc->watch_fd = -1;
+      emit(hc, "cand_delay_activate", "i", 0);
+      flush_events(&clients[hc->client]);
+    }
+  }
+}
+
+static void
+uim_server_process_connection(int server_fd)
+{
+  int i, max_fd;
+  fd_set readfds;
+  struct hosted_context *hc;
+
+  while (1) {
+    FD_ZERO(&readfds);
+    FD_SET(server_fd, &readfds);
+    max_fd = server_fd;
+    for (i = 0; i < nr_client_slots; i++) {
+      if (clients[i].fd != -1) {
+	FD_SET(clients[i].fd, &readfds);
+	if (clients[i].fd > max_fd)
+	  max_fd = clients[i].fd;
+      }
+    }
+    for (hc = hosted_contexts; hc; hc = hc->next) {
+      if (hc->watch_fd != -1) {
+	FD_SET(hc->watch_fd, &readfds);
+	if (hc->watch_fd > max_fd)
+	  max_fd = hc->watch_fd;
+      }
+    }
+
+    if (select(max_fd + 1, &readfds, NULL, NULL, NULL) <= 0) {
+      if (errno != EINTR) {
+	perror("uim-server select(2) failed");
+	sleep(3);
+      }
+      continue;
+    }
+
+    if (FD_ISSET(server_fd, &readfds)) {
+      accept_new_connection(server_fd);
+      continue;
+    }
+
+    activate_watched(&readfds);
+
+    for (i = 0; i < nr_client_slots; i++) {
+      if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &readfds))
+	serve_client(i);
+    }
+
+    /* the contexts may be in use until the request has been processed */
+    for (i = 0; i < nr_client_slots; i++) {
+      if (clients[i].fd != -1 && clients[i].dead)
+	close_client(i);
+    }
+
+    if (!check_session_alive())
+      return;
+  }
+}
+
+
+int
+main(int argc, char **argv)
+{
+  char path[MAXPATHLEN];
+  int server_fd;
+
+  /* the server itself hosts contexts locally */
+  unsetenv("LIBUIM_USE_SERVER");
+
+  if (uim_init() < 0)
+    return 0;
+
+  if (!uim_server_get_pathname(path, sizeof(path)))
+    return 0;
+
+  unlink(path);
+
+  clients = NULL;
+  nr_client_slots = 0;
+  server_fd = uim_helper_init_server_fd(path);
+
+  printf("waiting\n\n");
+  fflush(stdout);
+
+  fclose(stdin);
+  fclose(stdout);
+
+  if (server_fd < 0)
+    return 0;
+
+  signal(SIGPIPE, SIG_IGN);
+  uim_server_process_connection(server_fd);
+
+  uim_quit();
+
+  return 0;
+}
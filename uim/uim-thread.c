@@ -0,0 +1,412 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * The interpreter thread.
+ *
+ * SigScheme scans the stack of the thread that entered it, and the
+ * error guard of libuim longjmp()s to the outermost API call, so the
+ * interpreter can only be used from one thread. If LIBUIM_USE_THREAD
+ * is set, uim_init() starts a dedicated thread for it and every entry
+ * to the interpreter, which always passes through
+ * uim_scm_call_with_gc_ready_stack(), is run there instead. The
+ * calling thread waits meanwhile, and runs the bridge callbacks the
+ * interpreter fires (see uim-func.c), so that toolkits get them on the
+ * thread that called libuim. Both threads serve nested requests while
+ * waiting, so a callback may call libuim again. This makes libuim
+ * usable from several threads; it does not make a call return before
+ * the input method has handled it.
+ *
+ * The calls of different threads are serialized by api_lock. It is
+ * held from the outermost UIM_CATCH_ERROR_BEGIN() to the matching
+ * UIM_CATCH_ERROR_END(), and by the gate hook for the uim_scm_*
+ * functions a bridge calls directly. Thus at most one request is
+ * outstanding in each direction, and a slot for each is enough.
+ *
+ * The collector only scans the stack of the interpreter thread, so the
+ * Scheme objects handed to another thread are kept in the held list,
+ * tagged with the thread. They stay alive until the thread calls the
+ * libuim API again, or has got HELD_MAX newer ones.
+ */
+
+#include <config.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-scm.h"
+
+#define HELD_MAX 64
+
+struct uim_thread_job {
+  uim_gc_gate_func_ptr func;
+  void *arg;
+  void *ret;
+  uim_bool done;
+  uim_bool failed;
+};
+
+struct gate_args {
+  uim_gc_gate_func_ptr func;
+  void *arg;
+  uim_bool obj;
+  long token;
+};
+
+static void *interp_main(void *dummy);
+static void *interp_stop(void *dummy);
+static void *call_gate(struct gate_args *args);
+static void *run_gate(struct gate_args *args);
+static void *release_held(void *token_ptr);
+static void *release_held_internal(void *token_ptr);
+static void update_held(long owner, uim_lisp obj);
+static uim_bool gc_gate_hook(uim_gc_gate_func_ptr func, void *arg, void **ret,
+                             uim_bool obj);
+static void *post_and_wait(struct uim_thread_job **slot,
+                           struct uim_thread_job **inbox,
+                           uim_gc_gate_func_ptr func, void *arg,
+                           uim_bool *failed);
+static void run_job(struct uim_thread_job *job);
+
+static uim_bool threaded, running;
+static pthread_t interp_thread;
+static pthread_mutex_t api_lock;
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_cond = PTHREAD_COND_INITIALIZER;
+static struct uim_thread_job *to_interp, *to_caller;
+static long nr_tokens;
+/* ((token . obj) ...), newest first; touched on the interpreter thread */
+static uim_lisp held;
+static uim_bool held_protected;
+static UIM_THREAD_LOCAL long token;
+static UIM_THREAD_LOCAL int api_depth, nr_held;
+
+
+uim_bool
+uim_init_thread(void)
+{
+  pthread_mutexattr_t attr;
+  const char *env;
+
+  if (threaded)
+    return UIM_TRUE;
+
+  env = (uim_issetugid()) ? NULL : getenv("LIBUIM_USE_THREAD");
+  if (!env || !strcmp(env, "0"))
+    return UIM_FALSE;
+
+  /* the gate hook locks it again within an API call */
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&api_lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  running = UIM_TRUE;
+  if (pthread_create(&interp_thread, NULL, interp_main, NULL)) {
+    pthread_mutex_destroy(&api_lock);
+    return UIM_FALSE;
+  }
+
+  threaded = UIM_TRUE;
+  uim_scm_set_gc_gate_hook(gc_gate_hook);
+
+  return UIM_TRUE;
+}
+
+void
+uim_quit_thread(void)
+{
+  if (!threaded)
+    return;
+
+  uim_thread_call(interp_stop, NULL);
+  pthread_join(interp_thread, NULL);
+  uim_scm_set_gc_gate_hook(NULL);
+  pthread_mutex_destroy(&api_lock);
+  /* gone with the interpreter */
+  held = NULL;
+  held_protected = UIM_FALSE;
+  threaded = UIM_FALSE;
+}
+
+static uim_bool
+on_interp_thread(void)
+{
+  return (threaded && pthread_equal(pthread_self(), interp_thread));
+}
+
+static void
+lock_api(void)
+{
+  pthread_mutex_lock(&api_lock);
+  api_depth++;
+}
+
+static void
+unlock_api(void)
+{
+  api_depth--;
+  pthread_mutex_unlock(&api_lock);
+}
+
+void
+uim_thread_enter(void)
+{
+  uim_bool failed;
+
+  if (!threaded || on_interp_thread())
+    return;
+
+  lock_api();
+  /* a new API call; the objects got before are no longer in use */
+  if (api_depth == 1 && nr_held) {
+    post_and_wait(&to_interp, &to_caller, release_held, &token, &failed);
+    nr_held = 0;
+  }
+}
+
+void
+uim_thread_leave(void)
+{
+  if (threaded && !on_interp_thread())
+    unlock_api();
+}
+
+void *
+uim_thread_call(uim_gc_gate_func_ptr func, void *arg)
+{
+  uim_bool failed;
+  void *ret;
+
+  if (!threaded || on_interp_thread())
+    return (*func)(arg);
+
+  ret = post_and_wait(&to_interp, &to_caller, func, arg, &failed);
+  /* the error has been reported by the other thread */
+  if (failed)
+    uim_throw_error(NULL);
+
+  return ret;
+}
+
+void *
+uim_thread_call_back(uim_gc_gate_func_ptr func, void *arg)
+{
+  uim_bool failed;
+  void *ret;
+
+  if (!on_interp_thread())
+    return (*func)(arg);
+
+  ret = post_and_wait(&to_caller, &to_interp, func, arg, &failed);
+  if (failed)
+    uim_throw_error(NULL);
+
+  return ret;
+}
+
+static uim_bool
+gc_gate_hook(uim_gc_gate_func_ptr func, void *arg, void **ret, uim_bool obj)
+{
+  struct gate_args args;
+  uim_bool failed;
+
+  if (on_interp_thread())
+    return UIM_FALSE;
+
+  if (!token) {
+    pthread_mutex_lock(&slot_lock);
+    token = ++nr_tokens;
+    pthread_mutex_unlock(&slot_lock);
+  }
+
+  args.func = func;
+  args.arg = arg;
+  args.obj = obj;
+  args.token = token;
+
+  lock_api();
+  *ret = post_and_wait(&to_interp, &to_caller,
+                       (uim_gc_gate_func_ptr)call_gate, &args, &failed);
+  if (obj && *ret && !failed && nr_held < HELD_MAX)
+    nr_held++;
+  unlock_api();
+
+  if (failed)
+    uim_throw_error(NULL);
+
+  return UIM_TRUE;
+}
+
+static void *
+call_gate(struct gate_args *args)
+{
+  return uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)run_gate,
+                                          args);
+}
+
+static void *
+run_gate(struct gate_args *args)
+{
+  void *ret;
+
+  ret = (*args->func)(args->arg);
+  if (args->obj && ret)
+    update_held(args->token, (uim_lisp)ret);
+
+  return ret;
+}
+
+static void *
+release_held(void *token_ptr)
+{
+  return uim_scm_call_with_gc_ready_stack(release_held_internal, token_ptr);
+}
+
+static void *
+release_held_internal(void *token_ptr)
+{
+  if (held_protected)
+    update_held(*(long *)token_ptr, NULL);
+
+  return NULL;
+}
+
+/* Add obj to the objects held for the thread of owner, dropping the
+ * oldest ones beyond HELD_MAX, or drop all of them if obj is NULL. */
+static void
+update_held(long owner, uim_lisp obj)
+{
+  uim_lisp rest, kept, entry;
+  int n;
+
+  if (!held_protected) {
+    held = uim_scm_null();
+    uim_scm_gc_protect(&held);
+    held_protected = UIM_TRUE;
+  }
+
+  kept = uim_scm_null();
+  n = 0;
+  if (obj) {
+    kept = uim_scm_cons(uim_scm_cons(uim_scm_make_int(owner), obj), kept);
+    n++;
+  }
+  for (rest = held; !uim_scm_nullp(rest); rest = uim_scm_cdr(rest)) {
+    entry = uim_scm_car(rest);
+    if (uim_scm_c_int(uim_scm_car(entry)) == owner) {
+      if (!obj || n == HELD_MAX)
+        continue;
+      n++;
+    }
+    kept = uim_scm_cons(entry, kept);
+  }
+  held = uim_scm_callf("reverse!", "o", kept);
+}
+
+static void *
+post_and_wait(struct uim_thread_job **slot, struct uim_thread_job **inbox,
+              uim_gc_gate_func_ptr func, void *arg, uim_bool *failed)
+{
+  struct uim_thread_job job, *nested;
+
+  job.func = func;
+  job.arg = arg;
+  job.ret = NULL;
+  job.done = job.failed = UIM_FALSE;
+
+  pthread_mutex_lock(&slot_lock);
+  assert(!*slot);
+  *slot = &job;
+  pthread_cond_broadcast(&slot_cond);
+
+  /* serve the requests the other thread makes to finish ours */
+  while (!job.done) {
+    if ((nested = *inbox)) {
+      *inbox = NULL;
+      pthread_mutex_unlock(&slot_lock);
+      run_job(nested);
+      pthread_mutex_lock(&slot_lock);
+      nested->done = UIM_TRUE;
+      pthread_cond_broadcast(&slot_cond);
+    } else {
+      pthread_cond_wait(&slot_cond, &slot_lock);
+    }
+  }
+  pthread_mutex_unlock(&slot_lock);
+
+  *failed = job.failed;
+
+  return job.ret;
+}
+static void
+run_job(struct uim_thread_job *job)
+{
+  job->failed = !uim_catch_error_call(job->func, job->arg, &job->ret);
+}
+
+static void *
+interp_main(void *dummy)
+{
+  struct uim_thread_job *job;
+
+  pthread_mutex_lock(&slot_lock);
+  while (running) {
+    if ((job = to_interp)) {
+      to_interp = NULL;
+      pthread_mutex_unlock(&slot_lock);
+      run_job(job);
+      pthread_mutex_lock(&slot_lock);
+      job->done = UIM_TRUE;
+      pthread_cond_broadcast(&slot_cond);
+    } else {
+      pthread_cond_wait(&slot_cond, &slot_lock);
+    }
+  }
+  pthread_mutex_unlock(&slot_lock);
+
+  return NULL;
+}
+
+static void *
+interp_stop(void *dummy)
+{
+  running = UIM_FALSE;
+
+  return NULL;
+}
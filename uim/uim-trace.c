@@ -0,0 +1,233 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+#include <config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-util.h"
+#include "uim-trace.h"
+
+
+#define DEFAULT_NR_SPANS 4096
+
+struct trace_event {
+  const char *name;
+  double start;  /* usec */
+  double dur;    /* usec */
+};
+
+int uim_trace_enabled;
+
+static struct trace_event *events;
+static int nr_slots;
+static uint64_t nr_recorded;  /* total, may exceed nr_slots */
+static char *dump_prefix;
+static uim_bool exit_hook_registered;
+
+static void dump_to_file(void);
+
+
+static double
+now_usec(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#endif
+  {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+  }
+}
+
+void
+uim_init_trace(void)
+{
+  const char *env;
+  int n;
+
+  if (uim_trace_enabled || uim_issetugid())
+    return;
+
+  env = getenv("LIBUIM_TRACE");
+  if (!env || !env[0] || strcmp(env, "0") == 0)
+    return;
+
+  n = atoi(env);
+  nr_slots = (n > 1) ? n : DEFAULT_NR_SPANS;
+  events = uim_malloc(sizeof(struct trace_event) * nr_slots);
+  nr_recorded = 0;
+
+  env = getenv("LIBUIM_TRACE_FILE");
+  if (env && env[0]) {
+    dump_prefix = uim_strdup(env);
+    if (!exit_hook_registered) {
+      /* for the bridges that never call uim_quit() */
+      atexit(dump_to_file);
+      exit_hook_registered = UIM_TRUE;
+    }
+  }
+
+  uim_trace_enabled = 1;
+}
+
+/* Dumps before the plugins holding the span names are unloaded. */
+void
+uim_quit_trace(void)
+{
+  if (!uim_trace_enabled)
+    return;
+
+  dump_to_file();
+  uim_trace_enabled = 0;
+  free(events);
+  events = NULL;
+  free(dump_prefix);
+  dump_prefix = NULL;
+}
+
+void
+uim_trace_span_begin(struct uim_trace_span *span, const char *name)
+{
+  span->name = name;
+  span->start = now_usec();
+}
+
+void
+uim_trace_span_end(struct uim_trace_span *span)
+{
+  struct trace_event *ev;
+
+  if (!uim_trace_enabled)
+    return;
+
+  ev = &events[nr_recorded % nr_slots];
+  ev->name = span->name;
+  ev->start = span->start;
+  ev->dur = now_usec() - span->start;
+  nr_recorded++;
+}
+
+static uint64_t
+first_event(void)
+{
+  return (nr_recorded > nr_slots) ? nr_recorded - nr_slots : 0;
+}
+
+char *
+uim_trace_get_string(void)
+{
+  struct trace_event *ev;
+  char *buf, line[256];
+  size_t len, size, n;
+  uint64_t i;
+
+  len = 0;
+  size = 1024;
+  buf = uim_malloc(size);
+  buf[0] = '\0';
+  for (i = first_event(); uim_trace_enabled && i < nr_recorded; i++) {
+    ev = &events[i % nr_slots];
+    n = snprintf(line, sizeof(line), "%s\t%.0f\t%.1f\n",
+		 ev->name, ev->start, ev->dur);
+    if (n >= sizeof(line))
+      continue;
+    if (len + n + 1 > size) {
+      size = (len + n + 1) * 2;
+      buf = uim_realloc(buf, size);
+    }
+    memcpy(&buf[len], line, n + 1);
+    len += n;
+  }
+
+  return buf;
+}
+
+/* Chrome's trace event format, readable by chrome://tracing and
+ * Perfetto. Nesting is derived from the time ranges. */
+void
+uim_trace_dump(FILE *fp)
+{
+  struct trace_event *ev;
+  uint64_t i;
+  int pid;
+
+  pid = (int)getpid();
+  fputs("{\"traceEvents\":[", fp);
+  for (i = first_event(); uim_trace_enabled && i < nr_recorded; i++) {
+    ev = &events[i % nr_slots];
+    fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.1f,"
+	    "\"pid\":%d,\"tid\":%d}",
+	    (i == first_event()) ? "" : ",", ev->name, ev->start, ev->dur,
+	    pid, pid);
+  }
+  fputs("\n]}\n", fp);
+}
+
+static void
+dump_to_file(void)
+{
+  char *path;
+  FILE *fp;
+
+  if (!uim_trace_enabled || !dump_prefix)
+    return;
+
+  uim_asprintf(&path, "%s.%d", dump_prefix, (int)getpid());
+  fp = fopen(path, "w");
+  if (fp) {
+    uim_trace_dump(fp);
+    fclose(fp);
+  } else {
+    perror(path);
+  }
+  free(path);
+
+  /* dumped once per process */
+  free(dump_prefix);
+  dump_prefix = NULL;
+}
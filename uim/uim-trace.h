@@ -0,0 +1,85 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Per-keystroke tracing. If LIBUIM_TRACE is set, the spans below are
+ * recorded into a ring buffer which can be queried by the trace_get
+ * helper message, or dumped as trace events into LIBUIM_TRACE_FILE.PID
+ * when the process quits. Otherwise a span costs a single test.
+ *
+ *   struct uim_trace_span span;
+ *
+ *   UIM_TRACE_BEGIN(&span, "skk-lib-get-entry");
+ *   ...
+ *   UIM_TRACE_END(&span);
+ *
+ * The name must be a string literal, or otherwise live as long as the
+ * library that records it.
+ */
+
+#ifndef UIM_TRACE_H
+#define UIM_TRACE_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uim_trace_span {
+  const char *name;  /* NULL if tracing is disabled */
+  double start;      /* usec */
+};
+
+extern int uim_trace_enabled;
+
+void uim_trace_span_begin(struct uim_trace_span *span, const char *name);
+void uim_trace_span_end(struct uim_trace_span *span);
+
+#define UIM_TRACE_BEGIN(sp, nm)						\
+  ((uim_trace_enabled)							\
+   ? uim_trace_span_begin((sp), (nm)) : (void)((sp)->name = NULL))
+#define UIM_TRACE_END(sp)						\
+  (((sp)->name) ? uim_trace_span_end(sp) : (void)0)
+
+void uim_init_trace(void);
+void uim_quit_trace(void);
+/* "name\tstart\tduration\n" lines of the recorded spans, oldest first */
+char *uim_trace_get_string(void);
+void uim_trace_dump(FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
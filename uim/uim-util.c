@@ -51,6 +51,12 @@ uim_version()
   return MAKE_STR(PACKAGE_VERSION);
 }
 
+static uim_lisp
+sys_bindir()
+{
+  return MAKE_STR(BINDIR);
+}
+
 static uim_lisp
 sys_libdir()
 {
@@ -194,6 +200,7 @@ uim_init_util_subrs(void)
 
   uim_scm_init_proc0("uim-version", uim_version);
 
+  uim_scm_init_proc0("sys-bindir", sys_bindir);
   uim_scm_init_proc0("sys-libdir", sys_libdir);
   uim_scm_init_proc0("sys-pkglibdir", sys_pkglibdir);
   uim_scm_init_proc0("sys-datadir", sys_datadir);
@@ -0,0 +1,695 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Compiled Compose tables shared by uim-xim and the GTK+ immodules.
+ *
+ * The frontends parse the Compose file as before but feed the key
+ * sequences to a builder.  The builder flattens the sequence tree into
+ * arrays of states and transitions with all references stored as
+ * offsets, and writes the image to ~/.uim.d/compose.  Other processes
+ * using the same file and locale then just mmap the image, so neither
+ * the parse nor the memory of the tree is paid per process.
+ *
+ * The image is in host byte order; it is only meant for the machine
+ * that wrote it.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+
+#include "uim.h"
+#include "uim-posix.h"
+#include "uim-helper.h"
+#include "uim-util.h"
+#include "uim-x-util.h"
+
+#define COMPOSE_CACHE_DIR	"compose"
+#define COMPOSE_CACHE_MAGIC	0x55584331	/* "UXC1" */
+
+struct cache_header {
+  uint32_t magic;
+  uint32_t size;		/* of the whole image */
+  uint32_t n_states;
+  uint32_t n_entries;
+  uint32_t n_sources;
+  uint32_t locale;		/* offset into the string pool */
+  uint32_t states;		/* offsets from the top of the image */
+  uint32_t entries;
+  uint32_t sources;
+  uint32_t strings;
+};
+
+struct cache_state {
+  uint32_t first;
+  uint32_t count;
+};
+
+struct cache_source {
+  int64_t mtime;
+  int64_t size;
+  uint32_t path;
+  uint32_t pad;
+};
+
+struct uim_x_compose_table {
+  char *image;
+  size_t size;
+  int mapped;
+  const struct cache_header *hdr;
+  const struct cache_state *states;
+  const uim_x_compose_entry *entries;
+  const struct cache_source *sources;
+  const char *strings;
+};
+
+/* the same tree the frontends used to build */
+struct node {
+  struct node *next;
+  struct node *succession;
+  uim_x_compose_key key;
+  char *utf8;
+  uint32_t order;
+};
+
+struct source {
+  char *path;
+  int64_t mtime;
+  int64_t size;
+};
+
+struct uim_x_compose_builder {
+  struct node *top;
+  uint32_t n_nodes;
+  struct source *sources;
+  uint32_t n_sources;
+  int cacheable;
+};
+
+/* string pool of the image being compiled */
+struct pool {
+  char *data;
+  size_t len;
+  size_t size;
+};
+
+
+static uint32_t
+hash_name(const char *file, const char *locale)
+{
+  /* FNV-1a */
+  uint32_t h = 2166136261U;
+  const unsigned char *p;
+
+  for (p = (const unsigned char *)file; *p; p++)
+    h = (h ^ *p) * 16777619U;
+  h = (h ^ '\n') * 16777619U;
+  for (p = (const unsigned char *)locale; *p; p++)
+    h = (h ^ *p) * 16777619U;
+
+  return h;
+}
+
+static int
+cache_path(char *path, size_t len, const char *file, const char *locale,
+	   int need_prepare)
+{
+  char config[MAXPATHLEN], dir[MAXPATHLEN];
+
+  if (!uim_get_config_path(config, sizeof(config), !uim_helper_is_setugid()))
+    return 0;
+  if (snprintf(dir, sizeof(dir), "%s/" COMPOSE_CACHE_DIR, config)
+      >= (int)sizeof(dir))
+    return 0;
+  if (need_prepare && !uim_check_dir(dir))
+    return 0;
+  if (snprintf(path, len, "%s/%08x", dir,
+	       (unsigned int)hash_name(file, locale)) >= (int)len)
+    return 0;
+
+  return 1;
+}
+
+static int
+region_ok(const struct cache_header *hdr, uint32_t off, uint32_t n,
+	  size_t elem)
+{
+  return off <= hdr->size && (hdr->size - off) / elem >= n;
+}
+
+static int
+string_ok(const uim_x_compose_table *t, uint32_t off)
+{
+  return off < t->hdr->size - t->hdr->strings;
+}
+
+static int
+setup_table(uim_x_compose_table *t)
+{
+  const struct cache_header *hdr;
+  uint32_t i;
+
+  if (t->size < sizeof(struct cache_header))
+    return 0;
+  hdr = (const struct cache_header *)t->image;
+  if (hdr->magic != COMPOSE_CACHE_MAGIC || hdr->size != t->size
+      || hdr->n_states == 0
+      || !region_ok(hdr, hdr->states, hdr->n_states,
+		    sizeof(struct cache_state))
+      || !region_ok(hdr, hdr->entries, hdr->n_entries,
+		    sizeof(uim_x_compose_entry))
+      || !region_ok(hdr, hdr->sources, hdr->n_sources,
+		    sizeof(struct cache_source))
+      || hdr->strings >= hdr->size
+      || t->image[hdr->size - 1] != '\0')
+    return 0;
+
+  t->hdr = hdr;
+  t->states = (const struct cache_state *)(t->image + hdr->states);
+  t->entries = (const uim_x_compose_entry *)(t->image + hdr->entries);
+  t->sources = (const struct cache_source *)(t->image + hdr->sources);
+  t->strings = t->image + hdr->strings;
+
+  if (!string_ok(t, hdr->locale))
+    return 0;
+  for (i = 0; i < hdr->n_states; i++)
+    if (t->states[i].first > hdr->n_entries
+	|| hdr->n_entries - t->states[i].first < t->states[i].count)
+      return 0;
+  for (i = 0; i < hdr->n_entries; i++)
+    if (t->entries[i].next_state >= hdr->n_states
+	|| !string_ok(t, t->entries[i].utf8))
+      return 0;
+  for (i = 0; i < hdr->n_sources; i++)
+    if (!string_ok(t, t->sources[i].path))
+      return 0;
+
+  return 1;
+}
+
+static int
+sources_unchanged(const uim_x_compose_table *t, const char *file,
+		  const char *locale)
+{
+  struct stat st;
+  uint32_t i;
+
+  if (strcmp(t->strings + t->hdr->locale, locale) != 0
+      || t->hdr->n_sources == 0
+      || strcmp(t->strings + t->sources[0].path, file) != 0)
+    return 0;
+
+  for (i = 0; i < t->hdr->n_sources; i++) {
+    const struct cache_source *src = &t->sources[i];
+
+    if (stat(t->strings + src->path, &st) < 0
+	|| (int64_t)st.st_mtime != src->mtime
+	|| (int64_t)st.st_size != src->size)
+      return 0;
+  }
+
+  return 1;
+}
+
+static uim_x_compose_table *
+map_image(const char *path)
+{
+  uim_x_compose_table *t;
+  struct stat st;
+  void *addr;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+      || st.st_size < (off_t)sizeof(struct cache_header)) {
+    close(fd);
+    return NULL;
+  }
+  addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return NULL;
+
+  t = malloc(sizeof(uim_x_compose_table));
+  if (!t) {
+    munmap(addr, st.st_size);
+    return NULL;
+  }
+  t->image = addr;
+  t->size = st.st_size;
+  t->mapped = 1;
+  if (!setup_table(t)) {
+    uim_x_compose_table_free(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+uim_x_compose_table *
+uim_x_compose_table_load(const char *file, const char *locale)
+{
+  uim_x_compose_table *t;
+  char path[MAXPATHLEN];
+
+  if (!cache_path(path, sizeof(path), file, locale, 0))
+    return NULL;
+  t = map_image(path);
+  if (t && !sources_unchanged(t, file, locale)) {
+    uim_x_compose_table_free(t);
+    return NULL;
+  }
+
+  return t;
+}
+
+void
+uim_x_compose_table_free(uim_x_compose_table *t)
+{
+  if (!t)
+    return;
+
+  if (t->mapped)
+    munmap(t->image, t->size);
+  else
+    free(t->image);
+  free(t);
+}
+
+const uim_x_compose_entry *
+uim_x_compose_table_lookup(const uim_x_compose_table *t, unsigned int state,
+			   KeySym keysym, unsigned int modstate)
+{
+  const uim_x_compose_entry *e, *end;
+  size_t lo, hi;
+
+  if (!t || state >= t->hdr->n_states)
+    return NULL;
+
+  e = t->entries + t->states[state].first;
+  lo = 0;
+  hi = t->states[state].count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (e[mid].keysym < keysym)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  /* entries of a keysym keep the order of the original tree */
+  end = e + t->states[state].count;
+  for (e += lo; e < end && e->keysym == keysym; e++)
+    if ((modstate & e->modifier_mask) == e->modifier)
+      return e;
+
+  return NULL;
+}
+
+const char *
+uim_x_compose_table_utf8(const uim_x_compose_table *t,
+			 const uim_x_compose_entry *e)
+{
+  return t->strings + e->utf8;
+}
+
+uim_x_compose_builder *
+uim_x_compose_builder_new(void)
+{
+  uim_x_compose_builder *b;
+
+  b = malloc(sizeof(uim_x_compose_builder));
+  if (!b)
+    return NULL;
+  b->top = NULL;
+  b->n_nodes = 0;
+  b->sources = NULL;
+  b->n_sources = 0;
+  b->cacheable = 1;
+
+  return b;
+}
+
+void
+uim_x_compose_builder_add_source(uim_x_compose_builder *b, const char *file)
+{
+  struct source *sources;
+  struct stat st;
+  char *path;
+
+  if (!b || !b->cacheable)
+    return;
+
+  if (stat(file, &st) < 0) {
+    b->cacheable = 0;
+    return;
+  }
+  path = strdup(file);
+  sources = realloc(b->sources, sizeof(struct source) * (b->n_sources + 1));
+  if (!path || !sources) {
+    free(path);
+    if (sources)
+      b->sources = sources;
+    b->cacheable = 0;
+    return;
+  }
+  b->sources = sources;
+  b->sources[b->n_sources].path = path;
+  b->sources[b->n_sources].mtime = st.st_mtime;
+  b->sources[b->n_sources].size = st.st_size;
+  b->n_sources++;
+}
+
+int
+uim_x_compose_builder_add(uim_x_compose_builder *b,
+			  const uim_x_compose_key *seq, int len,
+			  const char *utf8)
+{
+  struct node **top, *p = NULL;
+  char *str;
+  int i;
+
+  if (!b || len <= 0)
+    return 0;
+  if ((str = strdup(utf8)) == NULL)
+    return 0;
+
+  top = &b->top;
+  for (i = 0; i < len; i++) {
+    for (p = *top; p; p = p->next) {
+      if (seq[i].keysym == p->key.keysym
+	  && seq[i].modifier == p->key.modifier
+	  && seq[i].modifier_mask == p->key.modifier_mask)
+	break;
+    }
+    if (!p) {
+      if ((p = malloc(sizeof(struct node))) == NULL) {
+	free(str);
+	return 0;
+      }
+      p->key = seq[i];
+      p->succession = NULL;
+      p->utf8 = NULL;
+      p->order = b->n_nodes++;
+      p->next = *top;
+      *top = p;
+    }
+    top = &p->succession;
+  }
+
+  free(p->utf8);
+  p->utf8 = str;
+
+  return len;
+}
+
+static void
+free_nodes(struct node *p)
+{
+  while (p) {
+    struct node *next = p->next;
+
+    free_nodes(p->succession);
+    free(p->utf8);
+    free(p);
+    p = next;
+  }
+}
+
+static void
+builder_free(uim_x_compose_builder *b)
+{
+  uint32_t i;
+
+  free_nodes(b->top);
+  for (i = 0; i < b->n_sources; i++)
+    free(b->sources[i].path);
+  free(b->sources);
+  free(b);
+}
+
+static uint32_t
+pool_add(struct pool *pool, const char *str)
+{
+  size_t len = strlen(str) + 1;
+  uint32_t off;
+
+  if (pool->len + len > pool->size) {
+    size_t size = pool->size ? pool->size : 4096;
+    char *data;
+
+    while (pool->len + len > size)
+      size *= 2;
+    if ((data = realloc(pool->data, size)) == NULL)
+      return UINT32_MAX;
+    pool->data = data;
+    pool->size = size;
+  }
+  off = pool->len;
+  memcpy(pool->data + pool->len, str, len);
+  pool->len += len;
+
+  return off;
+}
+
+/* by keysym, newer definitions first as in the sibling lists */
+static int
+node_cmp(const void *a, const void *b)
+{
+  const struct node *x = *(struct node * const *)a;
+  const struct node *y = *(struct node * const *)b;
+
+  if (x->key.keysym != y->key.keysym)
+    return x->key.keysym < y->key.keysym ? -1 : 1;
+  return x->order > y->order ? -1 : x->order < y->order;
+}
+
+static size_t
+align8(size_t n)
+{
+  return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Lay the tree out breadth-first: the sibling list of each state is
+ * sorted into a run of entries, and the lists below them are queued as
+ * the next states.
+ */
+static char *
+compile(uim_x_compose_builder *b, const char *locale, size_t *size_ret)
+{
+  struct node **queue, **run = NULL;
+  struct cache_state *states;
+  uim_x_compose_entry *entries;
+  struct cache_source *sources;
+  struct cache_header hdr;
+  struct pool pool = { NULL, 0, 0 };
+  uint32_t n_states = 1, head, i, n = 0, empty;
+  char *image = NULL;
+  size_t off;
+
+  /* one state for the top and one for each node with successors */
+  queue = malloc(sizeof(struct node *) * (b->n_nodes + 1));
+  states = malloc(sizeof(struct cache_state) * (b->n_nodes + 1));
+  entries = malloc(sizeof(uim_x_compose_entry) * (b->n_nodes + 1));
+  sources = malloc(sizeof(struct cache_source) * (b->n_sources + 1));
+  if (b->n_nodes)
+    run = malloc(sizeof(struct node *) * b->n_nodes);
+  if (!queue || !states || !entries || !sources || (b->n_nodes && !run))
+    goto out;
+
+  empty = pool_add(&pool, "");
+  hdr.locale = pool_add(&pool, locale);
+  for (i = 0; i < b->n_sources; i++) {
+    sources[i].path = pool_add(&pool, b->sources[i].path);
+    sources[i].mtime = b->sources[i].mtime;
+    sources[i].size = b->sources[i].size;
+    sources[i].pad = 0;
+  }
+  if (!pool.data)
+    goto out;
+
+  queue[0] = b->top;
+  for (head = 0; head < n_states; head++) {
+    struct node *p;
+    uint32_t count = 0;
+
+    for (p = queue[head]; p; p = p->next)
+      run[count++] = p;
+    qsort(run, count, sizeof(struct node *), node_cmp);
+
+    states[head].first = n;
+    states[head].count = count;
+    for (i = 0; i < count; i++, n++) {
+      p = run[i];
+      entries[n].keysym = p->key.keysym;
+      entries[n].modifier_mask = p->key.modifier_mask;
+      entries[n].modifier = p->key.modifier;
+      if (p->succession) {
+	queue[n_states] = p->succession;
+	entries[n].next_state = n_states++;
+      } else {
+	entries[n].next_state = 0;
+      }
+      entries[n].utf8 = p->utf8 ? pool_add(&pool, p->utf8) : empty;
+      if (entries[n].utf8 == UINT32_MAX)
+	goto out;
+    }
+  }
+
+  hdr.magic = COMPOSE_CACHE_MAGIC;
+  hdr.n_states = n_states;
+  hdr.n_entries = n;
+  hdr.n_sources = b->n_sources;
+  off = align8(sizeof(hdr));
+  hdr.states = off;
+  off = align8(off + sizeof(struct cache_state) * n_states);
+  hdr.entries = off;
+  off = align8(off + sizeof(uim_x_compose_entry) * n);
+  hdr.sources = off;
+  off = align8(off + sizeof(struct cache_source) * hdr.n_sources);
+  hdr.strings = off;
+  off += pool.len;
+  if (off > UINT32_MAX)
+    goto out;
+  hdr.size = off;
+
+  if ((image = calloc(1, off)) == NULL)
+    goto out;
+  memcpy(image, &hdr, sizeof(hdr));
+  memcpy(image + hdr.states, states, sizeof(struct cache_state) * n_states);
+  memcpy(image + hdr.entries, entries, sizeof(uim_x_compose_entry) * n);
+  memcpy(image + hdr.sources, sources,
+	 sizeof(struct cache_source) * hdr.n_sources);
+  memcpy(image + hdr.strings, pool.data, pool.len);
+  *size_ret = off;
+
+out:
+  free(queue);
+  free(run);
+  free(states);
+  free(entries);
+  free(sources);
+  free(pool.data);
+
+  return image;
+}
+
+/* write to a temporary file and rename, so readers never see a partial one */
+static int
+write_image(const char *path, const char *image, size_t size)
+{
+  char tmp[MAXPATHLEN];
+  size_t done = 0;
+  int fd;
+
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+    return 0;
+  if ((fd = mkstemp(tmp)) < 0)
+    return 0;
+  while (done < size) {
+    ssize_t n = write(fd, image + done, size - done);
+
+    if (n < 0) {
+      close(fd);
+      unlink(tmp);
+      return 0;
+    }
+    done += n;
+  }
+  if (close(fd) < 0 || rename(tmp, path) < 0) {
+    unlink(tmp);
+    return 0;
+  }
+
+  return 1;
+}
+
+uim_x_compose_table *
+uim_x_compose_builder_finish(uim_x_compose_builder *b, const char *file,
+			     const char *locale)
+{
+  uim_x_compose_table *t = NULL;
+  char path[MAXPATHLEN];
+  char *image;
+  size_t size;
+
+  if (!b)
+    return NULL;
+
+  image = compile(b, locale, &size);
+  if (!image)
+    goto out;
+
+  /* the first source must be the file the cache is looked up by */
+  if (b->cacheable && b->n_sources > 0
+      && strcmp(b->sources[0].path, file) == 0
+      && cache_path(path, sizeof(path), file, locale, 1)
+      && write_image(path, image, size)) {
+    t = map_image(path);
+    if (t) {
+      free(image);
+      goto out;
+    }
+  }
+
+  /* no cache; keep the image private to this process */
+  if ((t = malloc(sizeof(uim_x_compose_table))) == NULL) {
+    free(image);
+    goto out;
+  }
+  t->image = image;
+  t->size = size;
+  t->mapped = 0;
+  setup_table(t);
+
+out:
+  builder_free(b);
+
+  return t;
+}
@@ -34,6 +34,7 @@
 #ifndef UIM_X_UTIL_H
 #define UIM_X_UTIL_H
 
+#include <stdint.h>
 #include <X11/Xlib.h>
 
 #include "uim.h"
@@ -48,6 +49,54 @@ int uim_x_kana_input_hack_translate_key(int ukey, KeyCode hardware_keycode);
 int uim_x_kana_input_hack_filter_event(uim_context uc, XEvent *event);
 void uim_x_kana_input_hack_init(Display *display);
 
+/*
+ * Compiled Compose tables (uim-x-compose.c).  A table is built from
+ * the parsed Compose file once and cached under ~/.uim.d/compose,
+ * then mmap'ed read-only by every process using the same file and
+ * locale.  States are numbered from 0 (the initial state); each holds
+ * its transitions sorted by keysym.
+ */
+typedef struct uim_x_compose_table uim_x_compose_table;
+typedef struct uim_x_compose_builder uim_x_compose_builder;
+
+typedef struct uim_x_compose_key {
+  unsigned int keysym;
+  unsigned int modifier_mask;
+  unsigned int modifier;
+} uim_x_compose_key;
+
+typedef struct uim_x_compose_entry {
+  uint32_t keysym;
+  uint32_t modifier_mask;
+  uint32_t modifier;
+  uint32_t next_state;	/* 0 on a leaf */
+  uint32_t utf8;	/* offset into the string pool */
+} uim_x_compose_entry;
+
+/* returns NULL unless an up-to-date cache exists for the file */
+uim_x_compose_table *uim_x_compose_table_load(const char *file,
+					      const char *locale);
+void uim_x_compose_table_free(uim_x_compose_table *table);
+const uim_x_compose_entry *
+uim_x_compose_table_lookup(const uim_x_compose_table *table,
+			   unsigned int state, KeySym keysym,
+			   unsigned int modstate);
+const char *uim_x_compose_table_utf8(const uim_x_compose_table *table,
+				     const uim_x_compose_entry *entry);
+
+uim_x_compose_builder *uim_x_compose_builder_new(void);
+/* every file read while parsing, the top file first; the cache is
+   rebuilt when any of them changes */
+void uim_x_compose_builder_add_source(uim_x_compose_builder *builder,
+				      const char *file);
+int uim_x_compose_builder_add(uim_x_compose_builder *builder,
+			      const uim_x_compose_key *seq, int len,
+			      const char *utf8);
+/* compiles, writes the cache and frees the builder */
+uim_x_compose_table *
+uim_x_compose_builder_finish(uim_x_compose_builder *builder,
+			     const char *file, const char *locale);
+
 #ifdef __cplusplus
 }
 #endif
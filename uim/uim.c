@@ -48,6 +48,7 @@
 #include "uim-im-switcher.h"
 #include "uim-scm.h"
 #include "uim-scm-abbrev.h"
+#include "uim-trace.h"
 #if UIM_USE_NOTIFY_PLUGINS
 #include "uim-notify.h"
 #else
@@ -62,13 +63,17 @@ enum uim_result {
 
 static void fatal_error_hook(void);
 
+static void *uim_init_scm(void *dummy);
 static void *uim_init_internal(void *dummy);
+static void *uim_quit_scm(void *dummy);
 struct uim_get_candidate_args {
   uim_context uc;
   int index;
   int enum_hint;
 };
 static void *uim_get_candidate_internal(struct uim_get_candidate_args *args);
+static uim_candidate get_remote_candidate(uim_context uc,
+                                          int index, int enum_hint);
 struct uim_delay_activating_args {
   uim_context uc;
   int nr;
@@ -77,6 +82,7 @@ struct uim_delay_activating_args {
 };
 static void *uim_delay_activating_internal(struct uim_delay_activating_args *);
 static uim_lisp get_nth_im(uim_context uc, int nth);
+static void release_pooled_contexts(void);
 #ifdef ENABLE_ANTHY_STATIC
 void uim_anthy_plugin_instance_init(void);
 void uim_anthy_plugin_instance_quit(void);
@@ -89,6 +95,11 @@ void uim_anthy_utf8_plugin_instance_quit(void);
 static uim_bool uim_initialized;
 static uim_lisp protected0, protected1;
 
+/* contexts released with uim_recycle_context(), newest last */
+#define CONTEXT_POOL_SIZE 8
+static uim_context context_pool[CONTEXT_POOL_SIZE];
+static int nr_pooled_contexts;
+
 unsigned int uim_init_count;
 
 /****************************************************************
@@ -105,27 +116,39 @@ int
 uim_init(void)
 {
   int ret;
-  char *sys_load_path;
 
   if (uim_initialized)
     return OK;
 
   uim_init_error();
+  uim_init_trace();
+#if UIM_USE_THREADS
+  uim_init_thread();
+#endif
 
   if (UIM_CATCH_ERROR_BEGIN())
     return FAILED;
 
-  sys_load_path = (uim_issetugid()) ? NULL : getenv("LIBUIM_SYSTEM_SCM_FILES");
-  uim_scm_init(sys_load_path);
-  uim_scm_set_fatal_error_hook(fatal_error_hook);
-
-  ret = (int)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_init_internal, NULL);
+  /* the interpreter is initialized on the thread it will run on */
+  ret = (int)uim_thread_call(uim_init_scm, NULL);
 
   UIM_CATCH_ERROR_END();
 
   return ret;
 }
 
+static void *
+uim_init_scm(void *dummy)
+{
+  char *sys_load_path;
+
+  sys_load_path = (uim_issetugid()) ? NULL : getenv("LIBUIM_SYSTEM_SCM_FILES");
+  uim_scm_init(sys_load_path);
+  uim_scm_set_fatal_error_hook(fatal_error_hook);
+
+  return uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_init_internal, NULL);
+}
+
 static void *
 uim_init_internal(void *dummy)
 {
@@ -152,6 +175,7 @@ uim_init_internal(void *dummy)
   uim_init_key_subrs();
   uim_init_rk_subrs();
   uim_init_dynlib();
+  uim_init_remote();
 #ifdef ENABLE_ANTHY_STATIC
   uim_anthy_plugin_instance_init();
 #endif
@@ -185,6 +209,19 @@ uim_quit(void)
     return;
   }
 
+  uim_thread_call(uim_quit_scm, NULL);
+  uim_initialized = UIM_FALSE;
+
+  UIM_CATCH_ERROR_END();
+#if UIM_USE_THREADS
+  uim_quit_thread();
+#endif
+}
+
+static void *
+uim_quit_scm(void *dummy)
+{
+  release_pooled_contexts();
 #ifdef ENABLE_ANTHY_STATIC
   uim_anthy_plugin_instance_quit();
 #endif
@@ -194,11 +231,13 @@ uim_quit(void)
 #if UIM_USE_NOTIFY_PLUGINS
   uim_notify_quit();
 #endif
+  uim_quit_trace();
   uim_scm_callf("annotation-unload", "");
   uim_scm_callf("dynlib-unload-all", "");
   uim_quit_dynlib();
   uim_scm_quit();
-  uim_initialized = UIM_FALSE;
+
+  return NULL;
 }
 
 uim_context
@@ -235,6 +274,11 @@ uim_create_context(void *ptr,
   /* foreign context objects */
   uc->ptr = ptr;
 
+  if (uim_remote_create_context(uc, lang, engine)) {
+    UIM_CATCH_ERROR_END();
+    return uc;
+  }
+
   protected0 = lang_ = (lang) ? MAKE_SYM(lang) : uim_scm_f();
   protected1 = engine_ = (engine) ? MAKE_SYM(engine) : uim_scm_f();
   uc->sc = uim_scm_f(); /* failsafe */
@@ -258,8 +302,12 @@ uim_release_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("release-context", "p", uc);
-  uim_scm_gc_unprotect(&uc->sc);
+  if (uc->remote) {
+    uim_remote_release_context(uc);
+  } else {
+    uim_scm_callf("release-context", "p", uc);
+    uim_scm_gc_unprotect(&uc->sc);
+  }
   if (uc->outbound_conv)
     uc->conv_if->release(uc->outbound_conv);
   if (uc->inbound_conv)
@@ -271,6 +319,7 @@ uim_release_context(uim_context uc)
   free(uc->propstr);
   free(uc->modes);
   free(uc->client_encoding);
+  free(uc->pool_im);
 #ifdef DEBUG
   /* prevents operating on invalidated uim_context */
   memset(uc, 0, sizeof(*uc));
@@ -280,6 +329,134 @@ uim_release_context(uim_context uc)
   UIM_CATCH_ERROR_END();
 }
 
+/* name of the IM which create-context picks for lang and engine */
+static const char *
+pool_im_name(const char *lang, const char *engine)
+{
+  uim_lisp im, name;
+
+  protected0 = (lang) ? MAKE_SYM(lang) : uim_scm_f();
+  protected1 = (engine) ? MAKE_SYM(engine) : uim_scm_f();
+  protected0 = im = uim_scm_callf("find-im", "oo", protected1, protected0);
+  if (FALSEP(im))
+    return NULL;
+  protected1 = name = uim_scm_callf("im-name", "o", im);
+
+  return REFER_C_STR(name);
+}
+
+uim_context
+uim_acquire_context(void *ptr,
+		    const char *enc,
+		    const char *lang,
+		    const char *engine,
+		    struct uim_code_converter *conv,
+		    void (*commit_cb)(void *ptr, const char *str))
+{
+  uim_context uc;
+  const char *name;
+  char *im;
+  int i;
+
+  if (UIM_CATCH_ERROR_BEGIN())
+    return NULL;
+
+  assert(uim_scm_gc_any_contextp());
+
+  if (!enc)
+    enc = "UTF-8";
+  if (!conv)
+    conv = uim_iconv;
+
+  name = pool_im_name(lang, engine);
+  im = (name) ? uim_strdup(name) : NULL;
+  for (i = nr_pooled_contexts - 1; im && i >= 0; i--) {
+    uc = context_pool[i];
+    if (uc->conv_if == conv
+	&& strcmp(uc->client_encoding, enc) == 0
+	&& strcmp(uc->pool_im, im) == 0) {
+      context_pool[i] = context_pool[--nr_pooled_contexts];
+      context_pool[nr_pooled_contexts] = NULL;
+      uc->ptr = ptr;
+      uc->commit_cb = commit_cb;
+      free(im);
+      UIM_CATCH_ERROR_END();
+      return uc;
+    }
+  }
+
+  uc = uim_create_context(ptr, enc, lang, engine, conv, commit_cb);
+  if (uc && !uc->remote && im
+      && strcmp(uim_get_current_im_name(uc), im) == 0) {
+    uc->pool_im = im;
+    uc->pool_mode = uc->mode;
+    im = NULL;
+  }
+  free(im);
+
+  UIM_CATCH_ERROR_END();
+
+  return uc;
+}
+
+void
+uim_recycle_context(uim_context uc)
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+
+  /* a context switched to another IM no longer matches its key */
+  if (!uc->pool_im || nr_pooled_contexts == CONTEXT_POOL_SIZE
+      || strcmp(uim_get_current_im_name(uc), uc->pool_im) != 0) {
+    uim_release_context(uc);
+    UIM_CATCH_ERROR_END();
+    return;
+  }
+
+  /* the owner is gone: nothing may be called back during the reset */
+  uc->ptr = NULL;
+  uc->commit_cb = NULL;
+  uc->preedit_clear_cb = NULL;
+  uc->preedit_pushback_cb = NULL;
+  uc->preedit_update_cb = NULL;
+  uc->candidate_selector_activate_cb = NULL;
+  uc->candidate_selector_select_cb = NULL;
+  uc->candidate_selector_shift_page_cb = NULL;
+  uc->candidate_selector_deactivate_cb = NULL;
+  uc->candidate_selector_delay_activate_cb = NULL;
+  uc->candidate_selector_delay_activate_fd_cb = NULL;
+  uc->acquire_text_cb = NULL;
+  uc->delete_text_cb = NULL;
+  uc->mode_list_update_cb = NULL;
+  uc->mode_update_cb = NULL;
+  uc->prop_list_update_cb = NULL;
+  uc->prop_state_update_cb = NULL;
+  uc->configuration_changed_cb = NULL;
+  uc->switch_app_global_im_cb = NULL;
+  uc->switch_system_global_im_cb = NULL;
+
+  uim_reset_context(uc);
+  /* the next owner expects the mode of a new context */
+  if (uc->mode != uc->pool_mode)
+    uim_set_mode(uc, uc->pool_mode);
+  uc->is_enabled = UIM_TRUE;
+  context_pool[nr_pooled_contexts++] = uc;
+
+  UIM_CATCH_ERROR_END();
+}
+
+static void
+release_pooled_contexts(void)
+{
+  while (nr_pooled_contexts > 0) {
+    uim_release_context(context_pool[--nr_pooled_contexts]);
+    context_pool[nr_pooled_contexts] = NULL;
+  }
+}
+
 void
 uim_reset_context(uim_context uc)
 {
@@ -289,7 +466,10 @@ uim_reset_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("reset-handler", "p", uc);
+  if (uc->remote)
+    uim_remote_send(uc, "reset", "");
+  else
+    uim_scm_callf("reset-handler", "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -303,7 +483,10 @@ uim_focus_in_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("focus-in-handler", "p", uc);
+  if (uc->remote)
+    uim_remote_send(uc, "focus_in", "");
+  else
+    uim_scm_callf("focus-in-handler", "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -317,7 +500,10 @@ uim_focus_out_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("focus-out-handler", "p", uc);
+  if (uc->remote)
+    uim_remote_send(uc, "focus_out", "");
+  else
+    uim_scm_callf("focus-out-handler", "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -331,7 +517,10 @@ uim_place_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("place-handler", "p", uc);
+  if (uc->remote)
+    uim_remote_send(uc, "place", "");
+  else
+    uim_scm_callf("place-handler", "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -345,7 +534,10 @@ uim_displace_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("displace-handler", "p", uc);
+  if (uc->remote)
+    uim_remote_send(uc, "displace", "");
+  else
+    uim_scm_callf("displace-handler", "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -405,6 +597,12 @@ uim_get_candidate(uim_context uc, int index, int accel_enumeration_hint)
   assert(index >= 0);
   assert(accel_enumeration_hint >= 0);
 
+  if (uc->remote) {
+    cand = get_remote_candidate(uc, index, accel_enumeration_hint);
+    UIM_CATCH_ERROR_END();
+    return cand;
+  }
+
   args.uc = uc;
   args.index = index;
   args.enum_hint = accel_enumeration_hint;
@@ -442,6 +640,26 @@ uim_get_candidate_internal(struct uim_get_candidate_args *args)
   return (void *)cand;
 }
 
+static uim_candidate
+get_remote_candidate(uim_context uc, int index, int enum_hint)
+{
+  uim_candidate cand;
+  char **values;
+  int i;
+
+  values = uim_remote_call(uc, "candidate", "ii", index, enum_hint);
+  for (i = 0; values && values[i] && i < 3; i++)
+    ;
+
+  cand = uim_malloc(sizeof(*cand));
+  cand->str           = uim_strdup((i == 3) ? values[0] : "");
+  cand->heading_label = uim_strdup((i == 3) ? values[1] : "");
+  cand->annotation    = uim_strdup((i == 3) ? values[2] : "");
+  uim_remote_free_values(values);
+
+  return cand;
+}
+
 /* Accepts NULL candidates that produced by an error on uim_get_candidate(). */
 const char *
 uim_candidate_get_cand_str(uim_candidate cand)
@@ -530,7 +748,10 @@ uim_set_candidate_index(uim_context uc, int nth)
   assert(uc);
   assert(nth >= 0);
 
-  uim_scm_callf("set-candidate-index", "pi", uc, nth);
+  if (uc->remote)
+    uim_remote_send(uc, "set_candidate_index", "i", nth);
+  else
+    uim_scm_callf("set-candidate-index", "pi", uc, nth);
 
   UIM_CATCH_ERROR_END();
 }
@@ -554,6 +775,8 @@ uim_set_text_acquisition_cb(uim_context uc,
 
   uc->acquire_text_cb = acquire_cb;
   uc->delete_text_cb = delete_cb;
+  if (uc->remote)
+    uim_remote_update_callbacks(uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -572,6 +795,17 @@ uim_input_string(uim_context uc, const char *str)
   assert(uc);
   assert(str);
 
+  if (uc->remote) {
+    char **values;
+
+    /* uim-server converts the string to the encoding of the IM */
+    values = uim_remote_call(uc, "input_string", "s", str);
+    ret = (values && values[0] && atoi(values[0]));
+    uim_remote_free_values(values);
+    UIM_CATCH_ERROR_END();
+    return ret;
+  }
+
   conv = uc->conv_if->convert(uc->inbound_conv, str);
   if (conv) {
     protected0 =
@@ -606,6 +840,12 @@ uim_set_client_encoding(uim_context uc, const char *encoding)
   free(uc->client_encoding);
   uc->client_encoding = uim_strdup(encoding);
 
+  if (uc->remote) {
+    uim_remote_send(uc, "encoding", "s", encoding);
+    UIM_CATCH_ERROR_END();
+    return;
+  }
+
   protected0 = im_enc = uim_scm_callf("uim-context-encoding", "p", uc);
   uim_set_encoding(uc, REFER_C_STR(im_enc));
 
@@ -665,7 +905,10 @@ uim_switch_im(uim_context uc, const char *engine)
   assert(uc);
   assert(engine);
 
-  uim_scm_callf("uim-switch-im", "py", uc, engine);
+  if (uc->remote)
+    uim_remote_switch_im(uc, engine);
+  else
+    uim_scm_callf("uim-switch-im", "py", uc, engine);
 
   UIM_CATCH_ERROR_END();
 }
@@ -682,6 +925,12 @@ uim_get_current_im_name(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
+  if (uc->remote) {
+    name = uim_remote_get_current_im_name(uc);
+    UIM_CATCH_ERROR_END();
+    return name;
+  }
+
   protected0 = im = uim_scm_callf("uim-context-im", "p", uc);
   protected1 = ret = uim_scm_callf("im-name", "o", im);
   name = REFER_C_STR(ret);
@@ -806,6 +1055,26 @@ uim_set_delay_candidate_selector_cb(uim_context uc,
   assert(uc);
 
   uc->candidate_selector_delay_activate_cb = delay_activate_cb;
+  if (uc->remote)
+    uim_remote_update_callbacks(uc);
+
+  UIM_CATCH_ERROR_END();
+}
+
+void
+uim_set_delay_candidate_selector_fd_cb(uim_context uc,
+                                       void (*delay_activate_fd_cb)(void *ptr,
+                                                                    int fd))
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+
+  uc->candidate_selector_delay_activate_fd_cb = delay_activate_fd_cb;
+  if (uc->remote)
+    uim_remote_update_callbacks(uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -821,6 +1090,24 @@ uim_delay_activating(uim_context uc, int *nr, int *display_limit, int *selected_
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
+  if (uc->remote) {
+    char **values;
+    int i;
+
+    values = uim_remote_call(uc, "delay_activating", "iii",
+			     *nr, *display_limit, *selected_index);
+    for (i = 0; values && values[i] && i < 3; i++)
+      ;
+    if (i == 3) {
+      *nr = atoi(values[0]);
+      *display_limit = atoi(values[1]);
+      *selected_index = atoi(values[2]);
+    }
+    uim_remote_free_values(values);
+    UIM_CATCH_ERROR_END();
+    return;
+  }
+
   args.uc = uc;
   args.nr = *nr;
   args.display_limit = *display_limit;
@@ -908,7 +1195,10 @@ uim_set_mode(uim_context uc, int mode)
   assert(mode >= 0);
 
   uc->mode = mode;
-  uim_scm_callf("mode-handler", "pi", uc, mode);
+  if (uc->remote)
+    uim_remote_send(uc, "set_mode", "i", mode);
+  else
+    uim_scm_callf("mode-handler", "pi", uc, mode);
 
   UIM_CATCH_ERROR_END();
 }
@@ -959,6 +1249,23 @@ uim_set_prop_list_update_cb(uim_context uc,
   UIM_CATCH_ERROR_END();
 }
 
+void
+uim_set_prop_state_update_cb(uim_context uc,
+			     void (*update_cb)(void *ptr, const char *str))
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+
+  uc->prop_state_update_cb = update_cb;
+  if (uc->remote)
+    uim_remote_update_callbacks(uc);
+
+  UIM_CATCH_ERROR_END();
+}
+
 /* Obsolete */
 void
 uim_set_prop_label_update_cb(uim_context uc,
@@ -982,8 +1289,15 @@ uim_prop_list_update(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  if (uc->propstr && uc->prop_list_update_cb)
+  if (uc->prop_list_stale) {
+    /* the new list is passed to prop_list_update_cb */
+    if (uc->remote)
+      uim_remote_send(uc, "prop_list_update", "");
+    else
+      uim_scm_callf("context-propagate-prop-list-update", "o", uc->sc);
+  } else if (uc->propstr && uc->prop_list_update_cb) {
     uc->prop_list_update_cb(uc->ptr, uc->propstr);
+  }
 
   UIM_CATCH_ERROR_END();
 }
@@ -1011,7 +1325,10 @@ uim_prop_activate(uim_context uc, const char *str)
   assert(uc);
   assert(str);
       
-  uim_scm_callf("prop-activate-handler", "ps", uc, str);
+  if (uc->remote)
+    uim_remote_send(uc, "prop_activate", "s", str);
+  else
+    uim_scm_callf("prop-activate-handler", "ps", uc, str);
 
   UIM_CATCH_ERROR_END();
 }
@@ -1043,7 +1360,10 @@ uim_prop_update_custom(uim_context uc, const char *custom, const char *val)
   assert(custom);
   assert(val);
 
-  uim_scm_callf("custom-set-handler", "pys", uc, custom, val);
+  if (uc->remote)
+    uim_remote_send(uc, "prop_update_custom", "ss", custom, val);
+  else
+    uim_scm_callf("custom-set-handler", "pys", uc, custom, val);
 
   UIM_CATCH_ERROR_END();
 }
@@ -1058,6 +1378,8 @@ uim_prop_reload_configs(void)
 
   /* FIXME: handle return value properly. */
   uim_scm_callf("custom-reload-user-configs", "");
+  /* no-op unless some contexts are hosted by uim-server */
+  uim_remote_send(NULL, "reload_configs", "");
 
   UIM_CATCH_ERROR_END();
 
@@ -571,6 +571,45 @@ uim_create_context(void *ptr,
 void
 uim_release_context(uim_context uc);
 
+/**
+ * Get an input context, reusing one put back by uim_recycle_context if
+ * it matches enc, conv and the input method selected by lang and
+ * engine. Otherwise same as uim_create_context.
+ *
+ * A reused context has been reset and put back to the input mode its
+ * input method starts in. Its callbacks other than commit_cb are
+ * cleared, so set them again as for a new context.
+ *
+ * @param ptr cookie value which is passed as an argument of uim's callback functions.
+ * @param enc iconv-acceptable name of client encoding.
+ * @param lang name language you want to input
+ * @param engine name of conversion engine you want to use
+ * @param conv character code converter.
+ * @param commit_cb callback function which is called when there comes somestring to commit.
+ *
+ * @return uim_context which is reused or newly created.
+ * @see uim_create_context
+ */
+uim_context
+uim_acquire_context(void *ptr,
+		    const char *enc,
+		    const char *lang,
+		    const char *engine,
+		    struct uim_code_converter *conv,
+		    void (*commit_cb)(void *ptr, const char *str));
+
+/**
+ * Put back input context which is no longer used so that later
+ * uim_acquire_context can reuse it. The context is reset, detached
+ * from its callbacks and put back to its initial input mode. It is
+ * released instead if it can't be pooled.
+ *
+ * @param uc input context to be put back.
+ * @see uim_acquire_context
+ */
+void
+uim_recycle_context(uim_context uc);
+
 /**
  * Reset input context to neutral state.
  *
@@ -800,6 +839,24 @@ void uim_set_delay_candidate_selector_cb(uim_context uc,
                                          void (*delay_activate_cb)(void *ptr,
                                                                    int delay));
 
+/**
+ * Set callback function to activate candidate-selection when data
+ * arrives on a file descriptor. IMs waiting for an asynchronous result
+ * use it instead of a timer. The bridge watches fd for input in its
+ * event loop and then calls uim_delay_activating() as on the timeout
+ * of the delay_activate_cb of uim_set_delay_candidate_selector_cb().
+ * The watch is removed once it has fired. Only one watch is kept per
+ * context and a new one replaces the previous; fd < 0 just removes it.
+ *
+ * @param uc input context
+ * @param delay_activate_fd_cb called when candidate window should be activated on input from fd.
+ *
+ * @see uim_set_delay_candidate_selector_cb
+ */
+void uim_set_delay_candidate_selector_fd_cb(uim_context uc,
+                                            void (*delay_activate_fd_cb)(void *ptr,
+                                                                         int fd));
+
 /**
  * Notify that the candidate selector is being activated after delay.
  *
@@ -895,6 +952,22 @@ const char *uim_candidate_get_annotation_str(uim_candidate cand);
 void
 uim_set_prop_list_update_cb(uim_context uc,
 			    void (*update_cb)(void *ptr, const char *str));
+/**
+ * Set callback function to be called when only the states of the
+ * properties are changed. The string passed contains a "branch" line
+ * for each widget followed by an "active" line holding the action ID
+ * of the current state. If no callback is set, the whole property
+ * list is delivered via the callback set by
+ * uim_set_prop_list_update_cb() instead.
+ *
+ * @param uc input context
+ * @param update_cb called when property states are updated.
+ *        1st argument "ptr" corresponds to the 1st argument of uim_create_context.
+ *        2nd argument is the message to be sent to the helper server with "prop_state_update" command and charset info.
+ */
+void
+uim_set_prop_state_update_cb(uim_context uc,
+			     void (*update_cb)(void *ptr, const char *str));
 /**
  * Force to input context to update property list.
  *
@@ -1044,6 +1117,26 @@ void
 uim_set_configuration_changed_cb(uim_context uc,
 				 void (*changed_cb)(void *ptr));
 
+/*
+ * Set callback function to be told the connection to uim-server.
+ * Contexts hosted by uim-server (see LIBUIM_USE_SERVER) may receive
+ * events outside of any request of the bridge. The bridge watches fd
+ * for input in its event loop and calls uim_server_read_proc() on it.
+ * The callback is called again with a new fd after a reconnection, and
+ * with -1 when there is nothing to watch. It is called at once if the
+ * connection already exists.
+ *
+ * @param watch_cb called when the connection to watch changes.
+ */
+void
+uim_set_server_watch_cb(void (*watch_cb)(int fd));
+
+/*
+ * Read and dispatch the pending events from uim-server.
+ */
+void
+uim_server_read_proc(void);
+
 
 /* For plugins implementation. Bridges should not use these functions. */
 void uim_fatal_error(const char *msg);  /* Disables uim */
@@ -0,0 +1,307 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "uim.h"
+#include "wire.h"
+
+
+#define WIRE_READ_BUFSIZ 4096
+
+void
+uim_wire_buf_init(uim_wire_buf *wb)
+{
+  wb->data = NULL;
+  wb->head = wb->tail = wb->size = 0;
+}
+
+void
+uim_wire_buf_free(uim_wire_buf *wb)
+{
+  free(wb->data);
+  uim_wire_buf_init(wb);
+}
+
+unsigned char *
+uim_wire_reserve(uim_wire_buf *wb, size_t n)
+{
+  size_t len = UIM_WIRE_BUF_LEN(wb);
+
+  if (wb->size - wb->tail >= n)
+    return wb->data + wb->tail;
+
+  if (wb->head > 0) {
+    memmove(wb->data, UIM_WIRE_BUF_HEAD(wb), len);
+    wb->head = 0;
+    wb->tail = len;
+  }
+  if (wb->size - wb->tail < n) {
+    size_t size = wb->size ? wb->size : 256;
+
+    while (size - len < n)
+      size *= 2;
+    wb->data = uim_realloc(wb->data, size);
+    wb->size = size;
+  }
+  return wb->data + wb->tail;
+}
+
+void
+uim_wire_consume(uim_wire_buf *wb, size_t n)
+{
+  if (n >= UIM_WIRE_BUF_LEN(wb))
+    wb->head = wb->tail = 0;
+  else
+    wb->head += n;
+}
+
+static unsigned char *
+wire_put(uim_wire_buf *wb, size_t len)
+{
+  unsigned char *p = uim_wire_reserve(wb, len);
+
+  wb->tail += len;
+  return p;
+}
+
+void
+uim_wire_put_u8(uim_wire_buf *wb, unsigned int val)
+{
+  *wire_put(wb, 1) = val & 0xff;
+}
+
+void
+uim_wire_put_u16(uim_wire_buf *wb, unsigned int val)
+{
+  unsigned char *p = wire_put(wb, 2);
+
+  p[0] = (val >> 8) & 0xff;
+  p[1] = val & 0xff;
+}
+
+void
+uim_wire_put_u32(uim_wire_buf *wb, uint32_t val)
+{
+  unsigned char *p = wire_put(wb, 4);
+
+  p[0] = (val >> 24) & 0xff;
+  p[1] = (val >> 16) & 0xff;
+  p[2] = (val >> 8) & 0xff;
+  p[3] = val & 0xff;
+}
+
+void
+uim_wire_put_bytes(uim_wire_buf *wb, const void *p, size_t len)
+{
+  if (len)
+    memcpy(wire_put(wb, len), p, len);
+}
+
+void
+uim_wire_put_s8(uim_wire_buf *wb, const char *str)
+{
+  uim_wire_put_bytes(wb, str, strlen(str) + 1);
+}
+
+void
+uim_wire_put_s16(uim_wire_buf *wb, const char *str)
+{
+  uim_wire_put_s8(wb, str);
+  uim_wire_put_u8(wb, 0);
+}
+
+void
+uim_wire_set_u16(uim_wire_buf *wb, size_t off, unsigned int val)
+{
+  unsigned char *p = UIM_WIRE_BUF_HEAD(wb) + off;
+
+  p[0] = (val >> 8) & 0xff;
+  p[1] = val & 0xff;
+}
+
+const unsigned char *
+uim_wire_find(const uim_wire_buf *wb, size_t start,
+	      const void *delim, size_t delim_len)
+{
+  const unsigned char *p, *end, *d = delim;
+  size_t len = UIM_WIRE_BUF_LEN(wb);
+
+  if (delim_len == 0 || start > len || len - start < delim_len)
+    return NULL;
+  for (p = UIM_WIRE_BUF_HEAD(wb) + start,
+	 end = UIM_WIRE_BUF_HEAD(wb) + len - delim_len + 1;
+       (p = memchr(p, d[0], end - p));
+       p++) {
+    if (memcmp(p, d, delim_len) == 0)
+      return p;
+  }
+  return NULL;
+}
+
+ssize_t
+uim_wire_fill(uim_wire_buf *wb, int fd, size_t n)
+{
+  ssize_t nr;
+
+  do {
+    nr = read(fd, uim_wire_reserve(wb, n), n);
+  } while (nr < 0 && errno == EINTR);
+  if (nr > 0)
+    wb->tail += nr;
+  return nr;
+}
+
+int
+uim_wire_write(int fd, uim_wire_buf *wb)
+{
+  while (UIM_WIRE_BUF_LEN(wb) > 0) {
+    ssize_t n = write(fd, UIM_WIRE_BUF_HEAD(wb), UIM_WIRE_BUF_LEN(wb));
+
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    uim_wire_consume(wb, n);
+  }
+  return 0;
+}
+
+void
+uim_wire_reader_init(uim_wire_reader *rd, int fd, uim_wire_buf *buf)
+{
+  rd->fd = fd;
+  rd->buf = buf;
+  uim_wire_clear(buf);
+}
+
+static int
+wire_fill(uim_wire_reader *rd)
+{
+  return (uim_wire_fill(rd->buf, rd->fd, WIRE_READ_BUFSIZ) > 0) ? 0 : -1;
+}
+
+int
+uim_wire_read(uim_wire_reader *rd, void *dst, size_t len)
+{
+  unsigned char *p = dst;
+
+  while (len) {
+    size_t n;
+
+    if (UIM_WIRE_BUF_LEN(rd->buf) == 0 && wire_fill(rd) < 0)
+      return -1;
+    n = UIM_WIRE_BUF_LEN(rd->buf);
+    if (n > len)
+      n = len;
+    if (p) {
+      memcpy(p, UIM_WIRE_BUF_HEAD(rd->buf), n);
+      p += n;
+    }
+    uim_wire_consume(rd->buf, n);
+    len -= n;
+  }
+  return 0;
+}
+
+int
+uim_wire_read_u8(uim_wire_reader *rd, unsigned int *val)
+{
+  unsigned char c;
+
+  if (uim_wire_read(rd, &c, 1) < 0)
+    return -1;
+  *val = c;
+  return 0;
+}
+
+int
+uim_wire_read_u16(uim_wire_reader *rd, unsigned int *val)
+{
+  unsigned char p[2];
+
+  if (uim_wire_read(rd, p, 2) < 0)
+    return -1;
+  *val = uim_wire_get_u16(p);
+  return 0;
+}
+
+int
+uim_wire_read_u32(uim_wire_reader *rd, uint32_t *val)
+{
+  unsigned char p[4];
+
+  if (uim_wire_read(rd, p, 4) < 0)
+    return -1;
+  *val = uim_wire_get_u32(p);
+  return 0;
+}
+
+int
+uim_wire_read_s8(uim_wire_reader *rd, uim_wire_buf *wb)
+{
+  for (;;) {
+    const unsigned char *nul;
+    size_t n;
+
+    if (UIM_WIRE_BUF_LEN(rd->buf) == 0 && wire_fill(rd) < 0)
+      return -1;
+    nul = uim_wire_find(rd->buf, 0, "", 1);
+    n = nul ? (size_t)(nul - UIM_WIRE_BUF_HEAD(rd->buf)) + 1
+	    : UIM_WIRE_BUF_LEN(rd->buf);
+    uim_wire_put_bytes(wb, UIM_WIRE_BUF_HEAD(rd->buf), n);
+    uim_wire_consume(rd->buf, n);
+    if (nul)
+      return 0;
+  }
+}
+
+unsigned int
+uim_wire_get_u16(const unsigned char *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+uint32_t
+uim_wire_get_u32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+    | ((uint32_t)p[2] << 8) | p[3];
+}
@@ -0,0 +1,107 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Byte buffers for binary protocols, shared by the byte-buffer of
+ * fileio and by the plugins that talk to conversion servers (sj3serv,
+ * cannaserver). Bytes are put at the tail and consumed from the head.
+ * Integers are big-endian on the wire.
+ */
+
+#ifndef UIM_WIRE_H
+#define UIM_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct uim_wire_buf {
+  unsigned char *data;
+  size_t head;  /* offset of the first unconsumed byte */
+  size_t tail;  /* offset just after the last byte */
+  size_t size;
+} uim_wire_buf;
+
+#define UIM_WIRE_BUF_LEN(wb) ((wb)->tail - (wb)->head)
+#define UIM_WIRE_BUF_HEAD(wb) ((wb)->data + (wb)->head)
+
+/* buffered reader for the replies of one exchange. The buffer is owned
+   by the caller and kept across exchanges, so that nothing is leaked
+   when a truncated reply raises an error. */
+typedef struct uim_wire_reader {
+  int fd;
+  uim_wire_buf *buf;
+} uim_wire_reader;
+
+void uim_wire_buf_init(uim_wire_buf *wb);
+void uim_wire_buf_free(uim_wire_buf *wb);
+/* room for n bytes at the tail, which the caller fills and then
+   commits by advancing tail */
+unsigned char *uim_wire_reserve(uim_wire_buf *wb, size_t n);
+void uim_wire_consume(uim_wire_buf *wb, size_t n);
+#define uim_wire_clear(wb) uim_wire_consume((wb), (size_t)-1)
+void uim_wire_put_u8(uim_wire_buf *wb, unsigned int val);
+void uim_wire_put_u16(uim_wire_buf *wb, unsigned int val);
+void uim_wire_put_u32(uim_wire_buf *wb, uint32_t val);
+void uim_wire_put_bytes(uim_wire_buf *wb, const void *p, size_t len);
+/* the string and one NUL */
+void uim_wire_put_s8(uim_wire_buf *wb, const char *str);
+/* the string and two NULs */
+void uim_wire_put_s16(uim_wire_buf *wb, const char *str);
+/* patch a u16 already put at offset off from the head */
+void uim_wire_set_u16(uim_wire_buf *wb, size_t off, unsigned int val);
+/* the first delim at or after offset start from the head, or NULL */
+const unsigned char *uim_wire_find(const uim_wire_buf *wb, size_t start,
+				   const void *delim, size_t delim_len);
+/* reads at most n bytes from fd to the tail. Returns the number of
+   bytes read, 0 at the end of stream or -1 on error. */
+ssize_t uim_wire_fill(uim_wire_buf *wb, int fd, size_t n);
+/* writes out and consumes the whole content. Returns 0 on success,
+   or -1 with what has been written consumed. */
+int uim_wire_write(int fd, uim_wire_buf *wb);
+
+/* drops what is left in buf from the previous exchange */
+void uim_wire_reader_init(uim_wire_reader *rd, int fd, uim_wire_buf *buf);
+/* these return 0 on success and -1 on error or end of stream */
+int uim_wire_read(uim_wire_reader *rd, void *dst, size_t len);
+int uim_wire_read_u8(uim_wire_reader *rd, unsigned int *val);
+int uim_wire_read_u16(uim_wire_reader *rd, unsigned int *val);
+int uim_wire_read_u32(uim_wire_reader *rd, uint32_t *val);
+/* read up to and including a NUL; the string is appended to wb with
+   its terminator */
+int uim_wire_read_s8(uim_wire_reader *rd, uim_wire_buf *wb);
+
+unsigned int uim_wire_get_u16(const unsigned char *p);
+uint32_t uim_wire_get_u32(const unsigned char *p);
+
+#endif /* UIM_WIRE_H */
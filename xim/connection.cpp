@@ -166,27 +166,30 @@ void XConnection::readProc(XClientMessageEvent *ev)
 
     checkByteorder();
 
+    // OnRecv() consumes every queued packet, so they can refer to mBuf
+    // directly and the buffer is shifted only once they are gone.
     bool pushed = true;
+    int consumed = 0;
     do {
+	unsigned char *head = (unsigned char *)&mBuf.buf[consumed];
 	int len = -1;
-	if (mBuf.len >= 4)
-	    len = RxPacket::getPacketLength((unsigned char *)mBuf.buf,
-					    mByteorder);
-
-	if ((len > 4 && len <= mBuf.len) ||
-	    (len == 4 && mBuf.buf[0] == XIM_DISCONNECT)) {
-	    RxPacket *p = 
-		createRxPacket((unsigned char *)mBuf.buf, mByteorder);
-	    shiftBuffer(len);
+	if (mBuf.len - consumed >= 4)
+	    len = RxPacket::getPacketLength(head, mByteorder);
+
+	if ((len > 4 && len <= mBuf.len - consumed) ||
+	    (len == 4 && head[0] == XIM_DISCONNECT)) {
+	    RxPacket *p = createRxPacketView(head, mByteorder);
+	    consumed += len;
 	    mRxQ.push_back(p);
 	} else if (len == 4) {
 	    // do nothing
-	    shiftBuffer(4);
+	    consumed += 4;
 	} else {
 	    pushed = false;
 	}
     } while (pushed);
     OnRecv();
+    shiftBuffer(consumed);
 
     writeProc();
 }
@@ -272,11 +275,14 @@ void XConnection::writePendingPacket()
 
 	i = mPendingTxQ.begin();
 	major = (*i)->get_major();
+	if ((major == XIM_COMMIT || major == XIM_FORWARD_EVENT) &&
+			hasPendingSyncReply())
+	    break;
 
 	switch (major) {
 	case XIM_COMMIT:
 	case XIM_FORWARD_EVENT:
-	    setSyncFlag();
+	    waitSyncReply();
 	    break;
 	case XIM_PREEDIT_START:
 	    setPreeditStartSyncFlag();
@@ -328,18 +334,19 @@ void XConnection::writePassivePacket()
 	    break;
 
 	i = mPTxQ.begin();
+	major = (*i)->get_major();
 
 	if (hasSyncFlag() || hasPreeditStartSyncFlag() ||
-			hasPreeditCaretSyncFlag()) {
+			hasPreeditCaretSyncFlag() ||
+			(major == XIM_COMMIT && hasPendingSyncReply())) {
 	    mPendingTxQ.push_back(*i);
 	    mPTxQ.pop_front();
 	    break;
 	}
 
-	major = (*i)->get_major();
 	switch (major) {
 	case XIM_COMMIT:
-	    setSyncFlag();
+	    waitSyncReply();
 	    break;
 	case XIM_PREEDIT_START:
 	    setPreeditStartSyncFlag();
@@ -390,13 +397,13 @@ void XConnection::writeNormalPacket()
 	i = mTxQ.begin();
 	major = (*i)->get_major();
 	if (major == XIM_FORWARD_EVENT) {
-	    if (hasSyncFlag()) {
+	    if (hasSyncFlag() || hasPendingSyncReply()) {
 		// move this packet to pending queue
 		mPendingTxQ.push_back(*i);
 		mTxQ.pop_front();
 		continue;
 	    }
-	    setSyncFlag();
+	    waitSyncReply();
 	}
 	doSend(*i, false);
 	delete *i;
@@ -404,6 +411,20 @@ void XConnection::writeNormalPacket()
     }
 }
 
+// Xlib puts the key events made from XIM_COMMIT and XIM_FORWARD_EVENT
+// back at the head of the client's event queue, so two of them handled
+// at once are seen in reverse order.  They are sent synchronously, and
+// the next one waits for the XIM_SYNC_REPLY of the client, which
+// tells that the key event has been taken off the queue.  Without
+// OPT_ASYNC_FORWARD every other packet waits for it too.
+void XConnection::waitSyncReply()
+{
+    if (g_option_mask & OPT_ASYNC_FORWARD)
+	addPendingSyncReply();
+    else
+	setSyncFlag();
+}
+
 void XConnection::writeProc()
 {
     OnSend(); // add XIM_COMMIT packet to passive queue
@@ -434,6 +455,10 @@ void XConnection::doSend(TxPacket *t, bool passive)
 	    printf("->: %s.\n", xim_packet_name[t->get_major()]);
     }
 
+    // the reply would be taken for the one of a key event
+    if (t->get_major() == XIM_SYNC && (g_option_mask & OPT_ASYNC_FORWARD))
+	addPendingSyncReply();
+
     XClientMessageEvent r;
     int buflen;
     char *buf;
@@ -55,6 +55,7 @@ private:
     bool readToBuf(XClientMessageEvent *);
     bool checkByteorder();
     void shiftBuffer(int);
+    void waitSyncReply();
     void doSend(TxPacket *t, bool is_passive);
 
     Window mClientWin, mCommWin;
@@ -44,9 +44,11 @@
 #endif
 #include <clocale>
 #include <cstdlib>
+#include <map>
 #include "xim.h"
 #include "ximserver.h"
 #include "convdisp.h"
+#include "ospreedit.h"
 #include "canddisp.h"
 #include "xdispatch.h"
 #include "util.h"
@@ -114,8 +116,10 @@ update_default_xftfont() {
 			XFT_PIXEL_SIZE, XftTypeDouble, (double)DEFAULT_FONT_SIZE,
 			NULL);
 	if (xftfont) {
-	    if (gXftFont)
+	    if (gXftFont) {
+		forget_glyph_extents(gXftFont);
 		XftFontClose(XimServer::gDpy, gXftFont);
+	    }
 	    free(gXftFontName);
 	    free(gXftFontLocale);
 	    gXftFont = xftfont;
@@ -164,6 +168,21 @@ choose_default_fontset(const char *im_lang, const char *locale) {
     return create_default_fontset(im_lang, locale);
 }
 
+// Extents of the characters drawn in the preedit windows, cached per
+// font.  The entries of a font are dropped with forget_glyph_extents()
+// before the font is released.
+struct glyph_extent {
+    int width; // -1 if the character can't be drawn with the font
+    int height;
+};
+typedef std::map<uchar, glyph_extent> GlyphExtents;
+static std::map<const void *, GlyphExtents> glyph_cache;
+
+void forget_glyph_extents(const void *font)
+{
+    glyph_cache.erase(font);
+}
+
 struct char_ent {
     uchar c;
     int stat;
@@ -183,7 +202,9 @@ public:
     virtual void destroy(Window w);
     virtual void expose(Window w);
 
-    void draw_char(int x, int y, uchar ch, int stat);
+    bool get_char_extent(uchar ch, int *width, int *height);
+    void draw_string(int x, int y, const uchar *str, int len, int width,
+		     int stat);
     void set_back(unsigned long p);
     void set_fore(unsigned long p);
 #if HAVE_XFT_UTF8_STRING
@@ -255,7 +276,7 @@ public:
     virtual void set_size(int w, int h);
     virtual ~PeOvWin();
 private:
-    void draw_a_ce(char_ent *ce);
+    void draw_ce_run(char_ent *ce, int len);
     void draw_cursor(char_ent *ce);
     Pixmap m_mask_pix;
     GC m_mask_pix_gc;
@@ -306,23 +327,23 @@ private:
     PeLineWin *mPeWin;
 };
 
-class ConvdispOs : public Convdisp {
+class ConvdispOs : public Convdisp, private OsPreedit {
 public:
     ConvdispOs(InputContext *, icxatr *, Connection *);
     virtual ~ConvdispOs();
     virtual void update_preedit();
     virtual void clear_preedit();
+    virtual void flush_preedit();
     virtual void update_icxatr();
     virtual void move_candwin();
     virtual bool use_xft();
 
+protected:
+    virtual char *to_ctext(uString *);
+
 private:
-    void compose_preedit_array(TxPacket *);
-    void compose_feedback_array(TxPacket *);
-  
     Connection *mConn;
-    C16 mImid, mIcid;
-    int mPrevLen;
+    bool mIsDirty;
 };
 
 Convdisp *create_convdisp(int style, InputContext *k,
@@ -428,8 +449,10 @@ PeWin::~PeWin()
 #if HAVE_XFT_UTF8_STRING 
     if (mConvdisp->use_xft() == true) {
 	XftDrawDestroy(mXftDraw);
-	if (mXftFont != gXftFont)
+	if (mXftFont != gXftFont) {
+	    forget_glyph_extents(mXftFont);
 	    XftFontClose(XimServer::gDpy, mXftFont);
+	}
     }
 #endif
 
@@ -457,44 +480,134 @@ void PeWin::expose(Window w)
     XFlush(XimServer::gDpy);
 }
 
-void PeWin::draw_char(int x, int y, uchar ch, int stat)
+bool PeWin::get_char_extent(uchar ch, int *width, int *height)
+{
+    const void *font = mFontset;
+#if HAVE_XFT_UTF8_STRING
+    if (mConvdisp->use_xft() == true)
+	font = mXftFont;
+#endif
+    GlyphExtents &extents = glyph_cache[font];
+    GlyphExtents::iterator it = extents.find(ch);
+    if (it != extents.end()) {
+	*width = (*it).second.width < 0 ? 0 : (*it).second.width;
+	*height = (*it).second.height;
+	return (*it).second.width >= 0;
+    }
+
+    glyph_extent e;
+    char utf8[7];
+    int len = utf8_wctomb((unsigned char *)utf8, ch);
+    utf8[len] = '\0';
+
+    e.width = 0;
+    e.height = 0;
+    if (mConvdisp->use_xft() == true) {
+#if HAVE_XFT_UTF8_STRING
+	XGlyphInfo ginfo;
+	XftTextExtentsUtf8(XimServer::gDpy, mXftFont, (unsigned char *)utf8,
+			len, &ginfo);
+	e.width = ginfo.xOff;
+	e.height = mXftFontSize;
+#endif
+    } else {
+	XRectangle ink, logical;
+
+	if (!strcmp(mEncoding, "UTF-8")) {
+	    XwcTextExtents(mFontset, &ch, 1, &ink, &logical);
+	    e.width = logical.width;
+	    e.height = logical.height;
+	} else {
+	    char *native_str;
+	    XimIM *im = get_im_by_id(mConvdisp->get_context()->get_ic()->get_imid());
+
+	    native_str = im->utf8_to_native_str(utf8);
+	    if (native_str) {
+		len = static_cast<int>(strlen(native_str));
+		XmbTextExtents(mFontset, native_str, len, &ink, &logical);
+		free(native_str);
+		e.width = logical.width;
+		e.height = logical.height;
+	    } else
+		e.width = -1;
+	}
+    }
+    extents[ch] = e;
+
+    *width = e.width < 0 ? 0 : e.width;
+    *height = e.height;
+    return e.width >= 0;
+}
+
+// Draw a run of characters sharing the same attribute with one request.
+// The width is the sum of their advances.
+void PeWin::draw_string(int x, int y, const uchar *str, int len, int width,
+			int stat)
 {
     GC gc = mGC;
     if (stat & PE_REVERSE)
 	gc = mClearGC;
 
-    char utf8[6];
-    int len = utf8_wctomb((unsigned char *)utf8, ch);
-    utf8[len] = '\0';
+    if (len <= 0)
+	return;
+
+    int i, n = 0;
+    char *utf8 = NULL;
+    if (mConvdisp->use_xft() == true || strcmp(mEncoding, "UTF-8")) {
+	utf8 = (char *)malloc(len * 6 + 1);
+	for (i = 0; i < len; i++)
+	    n += utf8_wctomb((unsigned char *)&utf8[n], str[i]);
+	utf8[n] = '\0';
+    }
 
     if (mConvdisp->use_xft() == true) {
 #ifdef HAVE_XFT_UTF8_STRING
-	XGlyphInfo ginfo;
-	XftTextExtentsUtf8(XimServer::gDpy, mXftFont, (unsigned char *)utf8, len, &ginfo);
 	if (stat & PE_REVERSE) {
-	    XftDrawRect(mXftDraw, &mXftColorFg, x, y - (mXftFontSize - 2), ginfo.xOff, mXftFontSize);
-	    XftDrawStringUtf8(mXftDraw, &mXftColorFgRev, mXftFont, x, y, (unsigned char *)utf8, len);
+	    XftDrawRect(mXftDraw, &mXftColorFg, x, y - (mXftFontSize - 2), width, mXftFontSize);
+	    XftDrawStringUtf8(mXftDraw, &mXftColorFgRev, mXftFont, x, y, (unsigned char *)utf8, n);
 	} else {
-	    XftDrawStringUtf8(mXftDraw, &mXftColorFg, mXftFont, x, y, (unsigned char *)utf8, len);
+	    XftDrawStringUtf8(mXftDraw, &mXftColorFg, mXftFont, x, y, (unsigned char *)utf8, n);
 	}
 #endif
     } else {
 	if (!strcmp(mEncoding, "UTF-8")) {
-    	    XwcDrawImageString(XimServer::gDpy, mPixmap, mFontset,
-			gc, x, y, &ch, 1);
+	    XwcDrawImageString(XimServer::gDpy, mPixmap, mFontset,
+			gc, x, y, (wchar_t *)str, len);
 	} else {
 	    char *native_str;
 	    XimIM *im = get_im_by_id(mConvdisp->get_context()->get_ic()->get_imid());
-	
+
 	    native_str = im->utf8_to_native_str(utf8);
-	    if (!native_str)
-		return;
-	    len = static_cast<int>(strlen(native_str));
-	    XmbDrawImageString(XimServer::gDpy, mPixmap, mFontset,
-			   gc, x, y, native_str, len);
-	    free(native_str);
+	    if (native_str) {
+		n = static_cast<int>(strlen(native_str));
+		XmbDrawImageString(XimServer::gDpy, mPixmap, mFontset,
+			       gc, x, y, native_str, n);
+		free(native_str);
+	    } else {
+		// Some character of the run has no native representation.
+		// Draw the others one by one and skip it, as its extent is
+		// cached as 0.
+		for (i = 0; i < len; i++) {
+		    char c[7];
+		    int w, h;
+
+		    if (!get_char_extent(str[i], &w, &h))
+			continue;
+		    n = utf8_wctomb((unsigned char *)c, str[i]);
+		    c[n] = '\0';
+		    native_str = im->utf8_to_native_str(c);
+		    if (native_str) {
+			XmbDrawImageString(XimServer::gDpy, mPixmap, mFontset,
+				       gc, x, y, native_str,
+				       static_cast<int>(strlen(native_str)));
+			free(native_str);
+		    }
+		    x += w;
+		}
+	    }
 	}
     }
+    free(utf8);
 }
 
 void PeWin::set_back(unsigned long p)
@@ -550,8 +663,10 @@ void PeWin::set_xftfont(const char *xfld)
 	if (!gXftFont)
 	    init_default_xftfont();
 	if (size != -1 && (mXftFontSize != size || strcmp(locale, gXftFontLocale))) {
-	    if (mXftFont != gXftFont)
+	    if (mXftFont != gXftFont) {
+		forget_glyph_extents(mXftFont);
 		XftFontClose(XimServer::gDpy, mXftFont);
+	    }
 
 	    mXftFont = XftFontOpen(XimServer::gDpy,
 			    DefaultScreen(XimServer::gDpy),
@@ -694,38 +809,8 @@ void PeLineWin::draw_cursor()
 
 int PeLineWin::get_char_width(uchar ch)
 {
-    int width = 0;
-    char utf8[6];
-
-    int len = utf8_wctomb((unsigned char *)utf8, ch);
-    utf8[len] = '\0';
-
-    if (mConvdisp->use_xft() == true) {
-#ifdef HAVE_XFT_UTF8_STRING
-	XGlyphInfo ginfo;
-	XftTextExtentsUtf8(XimServer::gDpy, mXftFont, (unsigned char *)utf8,
-			len, &ginfo);
-	width = ginfo.xOff;
-#endif
-    } else {
-	XRectangle ink, logical;
-
-	if (!strcmp(mEncoding, "UTF-8")) {
-	    XwcTextExtents(mFontset, &ch, 1, &ink, &logical);
-	} else {
-	    char *native_str;
-	    XimIM *im = get_im_by_id(mConvdisp->get_context()->get_ic()->get_imid());
-
-	    native_str = im->utf8_to_native_str(utf8);
-	    if (!native_str)
-		return 0;
-	    len = static_cast<int>(strlen(native_str));
-	    XmbTextExtents(mFontset, native_str, len, &ink, &logical);
-	    free(native_str);
-	}
-	width = logical.width;
-    }
-
+    int width, height;
+    get_char_extent(ch, &width, &height);
     return width;
 }
 
@@ -733,21 +818,24 @@ void PeLineWin::draw_segment(pe_ustring *s)
 {
     uString::iterator i;
     int caret_pos = mConvdisp->get_caret_pos();
+    std::vector<uchar> str(s->s.begin(), s->s.end());
+    int x = m_x;
 
     for (i = s->s.begin(); i != s->s.end(); ++i) {
-	uchar ch = *i;
-	int width = get_char_width(ch);
-	draw_char(m_x, PE_LINE_WIN_FONT_POS_Y, ch, s->stat);
+	m_x += get_char_width(*i);
 	mCharPos++;
+	if (mCharPos == caret_pos)
+	    mCursorX= m_x;
+    }
 
+    if (!str.empty()) {
+	draw_string(x, PE_LINE_WIN_FONT_POS_Y, &str[0],
+		    static_cast<int>(str.size()), m_x - x, s->stat);
 	if (s->stat & PE_UNDERLINE) {
 	    XDrawLine(XimServer::gDpy, mPixmap, mGC,
-			    m_x, PE_LINE_WIN_FONT_POS_Y + UNDERLINE_HEIGHT,
-			    m_x + width, PE_LINE_WIN_FONT_POS_Y + UNDERLINE_HEIGHT);
+			    x, PE_LINE_WIN_FONT_POS_Y + UNDERLINE_HEIGHT,
+			    m_x, PE_LINE_WIN_FONT_POS_Y + UNDERLINE_HEIGHT);
 	}
-	m_x += width;
-	if (mCharPos == caret_pos)
-	    mCursorX= m_x;
     }
 
     switch (XimServer::gCandWinPosType) {
@@ -838,9 +926,15 @@ void PeOvWin::draw_ce(char_ent *ce, int len)
     XSetForeground(XimServer::gDpy, m_mask_pix_gc,
 		   WhitePixel(XimServer::gDpy,
 			      DefaultScreen(XimServer::gDpy)));
-    int i;
-    for (i = 0; i < len; i++) {
-	draw_a_ce(&ce[i]);
+    int i, start;
+    for (i = 1, start = 0; i <= len; i++) {
+	// a run ends at an attribute change or a line break
+	if (i == len || ce[i].stat != ce[start].stat ||
+	    ce[i].y != ce[start].y ||
+	    ce[i].x != ce[i - 1].x + ce[i - 1].width) {
+	    draw_ce_run(&ce[start], i - start);
+	    start = i;
+	}
     }
     draw_cursor(ce);
     XShapeCombineMask(XimServer::gDpy, mWin, ShapeBounding,
@@ -849,17 +943,25 @@ void PeOvWin::draw_ce(char_ent *ce, int len)
 }
 
 #define CURSOR_WIDTH	1
-void PeOvWin::draw_a_ce(char_ent *ce)
+void PeOvWin::draw_ce_run(char_ent *ce, int len)
 {
-    draw_char(ce->x, ce->y, ce->c, ce->stat);
+    std::vector<uchar> str(len);
+    int i, width = 0, height = 0;
+    for (i = 0; i < len; i++) {
+	str[i] = ce[i].c;
+	width += ce[i].width;
+	if (ce[i].height > height)
+	    height = ce[i].height;
+    }
+    draw_string(ce->x, ce->y, &str[0], len, width, ce->stat);
 
     XFillRectangle(XimServer::gDpy, m_mask_pix, m_mask_pix_gc,
-		   ce->x, ce->y - ce->height + 2,
-		   ce->width + CURSOR_WIDTH, ce->height + UNDERLINE_HEIGHT - 1);
+		   ce->x, ce->y - height + 2,
+		   width + CURSOR_WIDTH, height + UNDERLINE_HEIGHT - 1);
     if (ce->stat & PE_UNDERLINE) {
 	XDrawLine(XimServer::gDpy, mPixmap, mGC,
 		  ce->x, ce->y + UNDERLINE_HEIGHT,
-		  ce->x + ce->width, ce->y + UNDERLINE_HEIGHT);
+		  ce->x + width, ce->y + UNDERLINE_HEIGHT);
     }
 }
 
@@ -898,6 +1000,10 @@ Convdisp::~Convdisp()
 {
 }
 
+void Convdisp::flush_preedit()
+{
+}
+
 void Convdisp::set_im_lang(const char *im_lang)
 {
     mIMLang = im_lang;
@@ -1437,42 +1543,8 @@ void ConvdispOv::layoutCharEnt()
     for (i = 0; i < m_ce_len; i++) {
 	uchar ch = m_ce[i].c;
 
-	char utf8[6];
-	int len;
-	if (use_xft() == true) {
-#if HAVE_XFT_UTF8_STRING
-	    len = utf8_wctomb((unsigned char *)utf8, ch);
-	    utf8[len] = '\0';
-
-	    XGlyphInfo ginfo;
-	    XftTextExtentsUtf8(XimServer::gDpy, m_ov_win->mXftFont, (unsigned char *)utf8, len, &ginfo);
-	    m_ce[i].width = ginfo.xOff;
-	    m_ce[i].height = m_ov_win->mXftFontSize;
-#endif
-	} else {
-	    XRectangle ink, logical;
-
-	    if (!strcmp(mEncoding, "UTF-8")) {
-		XwcTextExtents(m_atr->font_set, &ch, 1, &ink, &logical);
-		m_ce[i].width = logical.width;
-		m_ce[i].height = logical.height;
-	    } else {
-		len = utf8_wctomb((unsigned char *)utf8, ch);
-		utf8[len] = '\0';
-		XimIM *im = get_im_by_id(mKkContext->get_ic()->get_imid());
-		char *str = im->utf8_to_native_str(utf8);
-		if (!str) {
-		    logical.width = 0;
-		    logical.height = (unsigned short)((i > 0) ? m_ce[i - 1].height : 0);
-		} else {
-		    len = static_cast<int>(strlen(str));
-		    XmbTextExtents(m_atr->font_set, str, len, &ink, &logical);
-		    free(str);
-		}
-		m_ce[i].width = logical.width;
-		m_ce[i].height = logical.height;
-	    }
-	}
+	if (!m_ov_win->get_char_extent(ch, &m_ce[i].width, &m_ce[i].height))
+	    m_ce[i].height = (i > 0) ? m_ce[i - 1].height : 0;
 
 	if (m_ce[i].width + x > right_limit) {
 	    // goto next line
@@ -1528,74 +1600,65 @@ bool ConvdispOv::use_xft()
 
 // On the spot style
 ConvdispOs::ConvdispOs(InputContext *k, icxatr *a, Connection *c)
-    : Convdisp(k, a)
+    : Convdisp(k, a),
+      OsPreedit(k->get_ic()->get_imid(), k->get_ic()->get_icid())
 {
-    XimIC *ic = k->get_ic();
     mConn = c;
-    mImid = ic->get_imid();
-    mIcid = ic->get_icid();
-    mPrevLen = 0;
+    mIsDirty = false;
 }
 
 ConvdispOs::~ConvdispOs()
 {
 }
 
+// The preedit is only marked here and sent by flush_preedit() when the
+// pending packets of the connection are written, so that the several
+// updates caused by a single key event end up in one XIM_PREEDIT_DRAW.
 void ConvdispOs::update_preedit()
 {
     move_candwin();
-    if (!m_pe)
-	return;
+    if (m_pe)
+	mIsDirty = true;
+}
 
-    TxPacket *t;
+static C32 pe_feedback(int stat)
+{
+    C32 xstat = FB_None;
+    if (stat & PE_REVERSE)
+	xstat |= FB_Reverse;
 
-    int len, caret_pos;
-    len = m_pe->get_char_count();
-    caret_pos = m_pe->caret_pos;
+    if (stat & PE_UNDERLINE)
+	xstat |= FB_Underline;
 
-    if (mPrevLen == 0 && len == 0)
-	return;
+    if (stat & PE_HILIGHT)
+	xstat |= FB_Highlight;
 
-    if (mPrevLen == 0 && len) {
-	t = createTxPacket(XIM_PREEDIT_START, 0);
-	t->pushC16(mImid);
-	t->pushC16(mIcid);
-	mConn->push_passive_packet(t);
-    }
+    return xstat;
+}
 
-    t = createTxPacket(XIM_PREEDIT_DRAW, 0);
-    t->pushC16(mImid);
-    t->pushC16(mIcid);
-    t->pushC32(caret_pos);// caret
-    t->pushC32(0); // chg_first
-    t->pushC32(mPrevLen); // chg_length
+void ConvdispOs::flush_preedit()
+{
+    if (!mIsDirty || !m_pe)
+	return;
+    mIsDirty = false;
 
-    if (!m_pe->ustrings.empty())
-	t->pushC32(0);
-    else
-	t->pushC32(3);
-  
-    compose_preedit_array(t);
-    compose_feedback_array(t);
-    mConn->push_passive_packet(t);
-
-    if (mPrevLen && len == 0) {
-	t = createTxPacket(XIM_PREEDIT_DONE, 0);
-	t->pushC16(mImid);
-	t->pushC16(mIcid);
-	mConn->push_passive_packet(t);
-    }
-    mPrevLen = len;
-
-    if (len) {
-	t = createTxPacket(XIM_PREEDIT_CARET, 0);
-	t->pushC16(mImid);
-	t->pushC16(mIcid);
-	t->pushC32(caret_pos);
-	t->pushC32(XIMAbsolutePosition);
-	t->pushC32(XIMIsPrimary);
-	mConn->push_passive_packet(t);
+    std::vector<uchar> text;
+    std::vector<C32> feedback;
+    std::list<pe_ustring>::iterator it;
+    uString::iterator ui;
+    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
+	C32 xstat = pe_feedback((*it).stat);
+	for (ui = (*it).s.begin(); ui != (*it).s.end(); ++ui) {
+	    text.push_back(*ui);
+	    feedback.push_back(xstat);
+	}
     }
+
+    std::list<TxPacket *> q;
+    draw(text, feedback, m_pe->caret_pos, q);
+    std::list<TxPacket *>::iterator i;
+    for (i = q.begin(); i != q.end(); ++i)
+	mConn->push_passive_packet(*i);
 }
 
 void ConvdispOs::move_candwin()
@@ -1638,61 +1701,17 @@ void ConvdispOs::move_candwin()
 
 void ConvdispOs::clear_preedit()
 {
-    mPrevLen = 0;
+    clear();
 }
 
 void ConvdispOs::update_icxatr()
 {
 }
 
-void ConvdispOs::compose_preedit_array(TxPacket *t)
+char *ConvdispOs::to_ctext(uString *s)
 {
-    uString s;
-    std::list<pe_ustring>::iterator it;
-    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
-	append_ustring(&s, &(*it).s);
-    }
-
     XimIM *im = get_im_by_id(mKkContext->get_ic()->get_imid());
-    char *c = im->uStringToCtext(&s);
-    int i, len = 0;
-    if (c)
-	len = static_cast<int>(strlen(c));
-    t->pushC16((C16)len); // LENGTH
-    for (i = 0; i < len; i++) {
-	t->pushC8(c[i]); // CTEXT
-    }
-    len = pad4(len + 2);
-    for (i = 0; i < len; i++) {
-	t->pushC8(0); // PADDING
-    }
-    free(c);
-}
-
-void ConvdispOs::compose_feedback_array(TxPacket *t)
-{
-    int i, len, stat, xstat;
-    len = m_pe->get_char_count();
-    t->pushC16((C16)(len * 4));
-    t->pushC16(0);
-    std::list<pe_ustring>::iterator it;
-    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
-	len = static_cast<int>((*it).s.size());
-	stat = (*it).stat;
-	xstat = FB_None;
-	if (stat & PE_REVERSE)
-	    xstat |= FB_Reverse;
-
-	if (stat & PE_UNDERLINE)
-	    xstat |= FB_Underline;
-
-	if (stat & PE_HILIGHT)
-	    xstat |= FB_Highlight;
-
-	for (i = 0; i < len; i++) {
-	    t->pushC32(xstat);
-	}
-    }
+    return im->uStringToCtext(s);
 }
 
 bool ConvdispOs::use_xft()
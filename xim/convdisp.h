@@ -52,6 +52,7 @@ public:
     void update_caret_state();
     virtual void update_preedit() = 0;
     virtual void clear_preedit() = 0;
+    virtual void flush_preedit();
     virtual void update_icxatr() = 0;
     virtual void move_candwin() = 0;
     virtual void set_im_lang(const char *im_lang);
@@ -73,6 +74,7 @@ protected:
 
 Convdisp *create_convdisp(int style, InputContext *, icxatr *, Connection *);
 XFontSet get_font_set(const char *name, const char *locale);
+void forget_glyph_extents(const void *font);
 
 #endif
 /*
@@ -52,6 +52,12 @@
 #include "uim/uim-im-switcher.h"
 
 int lib_uim_fd = -1;
+// the helper messages handled in helper_str_parse()
+static const char *const helper_subscription[] = {
+    "im_change_", "prop_update_custom", "custom_reload_notify",
+    "prop_list_get", "prop_label_get", "prop_activate", "im_list_get",
+    "commit_string", "focus_in", NULL
+};
 
 static void
 parse_helper_str_im_change(const char *level, const char *engine) {
@@ -283,12 +289,39 @@ void
 check_helper_connection(void)
 {
     if (lib_uim_fd < 0) {
+	uim_helper_client_subscribe(helper_subscription);
 	lib_uim_fd = uim_helper_init_client_fd(helper_disconnect_cb);
 	if (lib_uim_fd >= 0)
 	    add_fd_watch(lib_uim_fd, READ_OK, helper_read_cb);
     }
 }
 
+// uim-server connection
+
+static int server_fd = -1;
+
+static void
+server_read_cb(int /* fd */, int /* ev */)
+{
+    uim_server_read_proc();
+}
+
+static void
+server_watch_cb(int fd)
+{
+    if (server_fd >= 0)
+	remove_current_fd_watch(server_fd);
+    server_fd = fd;
+    if (server_fd >= 0)
+	add_fd_watch(server_fd, READ_OK, server_read_cb);
+}
+
+void
+watch_server_connection(void)
+{
+    uim_set_server_watch_cb(server_watch_cb);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
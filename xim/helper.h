@@ -37,6 +37,7 @@
 void check_helper_connection();
 void helper_disconnect_cb();
 void send_im_list();
+void watch_server_connection();
 
 #endif
 /*
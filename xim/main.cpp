@@ -43,6 +43,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <sys/select.h>
+#include <sys/time.h>
 #include <time.h>
 
 #include "xim.h"
@@ -73,6 +74,8 @@ const char *usage=
 "--engine=ENGINE    :Use ENGINE as a backend conversion engine at startup\n"
 "--async            :Use on-demand-synchronous method of XIM event flow\n"
 "                    (using this option is not safe for Tcl/Tk GUI toolkit)\n"
+"--async-forward    :Same as --async, and also send the other packets while\n"
+"                    commits and unfiltered keys wait for XIM_SYNC_REPLY\n"
 "--trace            :trace-connection\n"
 "--trace-xim        :trace-xim-message\n";
 const char *default_engine;
@@ -95,9 +98,11 @@ static void check_pending_xevent(void);
 
 #if UIM_XIM_USE_DELAY
 static void timer_check(void);
+static double now_msec(void);
 static void *timer_ptr;
 static void (*timer_cb)(void *ptr);
-static time_t timer_time;
+static double timer_time;  /* msec, 0 if not set */
+static int timer_fd = -1;  /* fires on input instead */
 #endif
 
 bool
@@ -153,10 +158,18 @@ static void main_loop()
 	FD_ZERO(&wfds);
 #if UIM_XIM_USE_DELAY
 	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	if (timer_time > 0) {
+	    double rest = timer_time - now_msec();
+	    if (rest < 1000) {
+		tv.tv_sec = 0;
+		tv.tv_usec = (rest > 0) ? (long)(rest * 1000) : 0;
+	    }
+	}
 #else
 	tv.tv_sec = 2;
-#endif
 	tv.tv_usec = 0;
+#endif
 
 	std::map<int, fd_watch_struct>::iterator it;
 	int  fd_max = 0;
@@ -357,27 +370,58 @@ xEventRead(int /* fd */, int /* ev */)
 }
 
 #if UIM_XIM_USE_DELAY
+static double
+now_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
 static void
 timer_check(void)
 {
-    if (timer_time > 0 && time(NULL) >= timer_time) {
+    if (timer_time > 0 && now_msec() >= timer_time) {
 	timer_time = 0;
 	timer_cb(timer_ptr);
     }
 }
 
+static void
+timer_fd_read(int /* fd */, int /* ev */)
+{
+    timer_cancel();
+    timer_cb(timer_ptr);
+}
+
 void
-timer_set(int seconds, void (*timeout_cb)(void *ptr), void *ptr)
+timer_set(int msec, void (*timeout_cb)(void *ptr), void *ptr)
 {
-    timer_time = time(NULL) + seconds;
+    timer_cancel();
+    timer_time = now_msec() + msec;
     timer_cb = timeout_cb;
     timer_ptr = ptr;
 }
 
+void
+timer_set_fd(int fd, void (*ready_cb)(void *ptr), void *ptr)
+{
+    timer_cancel();
+    timer_fd = fd;
+    timer_cb = ready_cb;
+    timer_ptr = ptr;
+    add_fd_watch(fd, READ_OK, timer_fd_read);
+}
+
 void
 timer_cancel()
 {
     timer_time = 0;
+    if (timer_fd != -1) {
+	remove_current_fd_watch(timer_fd);
+	timer_fd = -1;
+    }
 }
 #endif
 
@@ -527,6 +571,8 @@ parse_args(int argc, char **argv)
 		default_engine = strdup(&argv[i][9]);
 	    } else if (!strcmp(opt, "async")) {
 		g_option_mask |= OPT_ON_DEMAND_SYNC;
+	    } else if (!strcmp(opt, "async-forward")) {
+		g_option_mask |= (OPT_ON_DEMAND_SYNC | OPT_ASYNC_FORWARD);
 	    }
 	}
     }
@@ -625,7 +671,9 @@ main(int argc, char **argv)
 
     parse_args(argc, argv);
 
-    if (g_option_mask & OPT_ON_DEMAND_SYNC)
+    if (g_option_mask & OPT_ASYNC_FORWARD)
+	printf("Using asynchronous XIM event flow (not safe for Tcl/TK)\n");
+    else if (g_option_mask & OPT_ON_DEMAND_SYNC)
 	printf("Using on-demand-synchronous XIM event flow (not safe for Tcl/TK)\n");
     else
 	printf("Using full-synchronous XIM event flow\n");
@@ -634,6 +682,7 @@ main(int argc, char **argv)
     signal(SIGUSR1, reload_uim);
 
     check_helper_connection();
+    watch_server_connection();
 
     XimServer::gDpy = XOpenDisplay(NULL);
     if (!XimServer::gDpy) {
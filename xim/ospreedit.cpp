@@ -0,0 +1,172 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+*/
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+#include "xim.h"
+#include "ospreedit.h"
+#include "util.h"
+
+OsPreedit::OsPreedit(C16 imid, C16 icid)
+{
+    mImid = imid;
+    mIcid = icid;
+    mPrevCaret = 0;
+}
+
+OsPreedit::~OsPreedit()
+{
+}
+
+void OsPreedit::draw(std::vector<uchar> &text, std::vector<C32> &feedback,
+		     int caret_pos, std::list<TxPacket *> &q)
+{
+    TxPacket *t;
+
+    int len, prev_len;
+    len = static_cast<int>(text.size());
+    prev_len = static_cast<int>(mPrevText.size());
+
+    if (prev_len == 0 && len == 0)
+	return;
+
+    // Only the characters between the common head and tail are redrawn.
+    int head, tail;
+    for (head = 0; head < len && head < prev_len; head++) {
+	if (text[head] != mPrevText[head] ||
+	    feedback[head] != mPrevFeedback[head])
+	    break;
+    }
+    for (tail = 0; tail < len - head && tail < prev_len - head; tail++) {
+	if (text[len - 1 - tail] != mPrevText[prev_len - 1 - tail] ||
+	    feedback[len - 1 - tail] != mPrevFeedback[prev_len - 1 - tail])
+	    break;
+    }
+    bool changed = (head != len || head != prev_len);
+
+    if (!changed && caret_pos == mPrevCaret)
+	return;
+
+    if (prev_len == 0 && len) {
+	t = createTxPacket(XIM_PREEDIT_START, 0);
+	t->pushC16(mImid);
+	t->pushC16(mIcid);
+	q.push_back(t);
+    }
+
+    if (changed) {
+	t = createTxPacket(XIM_PREEDIT_DRAW, 0);
+	t->pushC16(mImid);
+	t->pushC16(mIcid);
+	t->pushC32(caret_pos);// caret
+	t->pushC32(head); // chg_first
+	t->pushC32(prev_len - head - tail); // chg_length
+
+	if (len - tail > head)
+	    t->pushC32(0);
+	else
+	    t->pushC32(3);
+
+	compose_preedit_array(t, text, head, len - tail);
+	compose_feedback_array(t, feedback, head, len - tail);
+	q.push_back(t);
+    }
+
+    if (prev_len && len == 0) {
+	t = createTxPacket(XIM_PREEDIT_DONE, 0);
+	t->pushC16(mImid);
+	t->pushC16(mIcid);
+	q.push_back(t);
+    }
+    mPrevText.swap(text);
+    mPrevFeedback.swap(feedback);
+    mPrevCaret = caret_pos;
+
+    if (len) {
+	t = createTxPacket(XIM_PREEDIT_CARET, 0);
+	t->pushC16(mImid);
+	t->pushC16(mIcid);
+	t->pushC32(caret_pos);
+	t->pushC32(XIMAbsolutePosition);
+	t->pushC32(XIMIsPrimary);
+	q.push_back(t);
+    }
+}
+
+void OsPreedit::clear()
+{
+    mPrevText.clear();
+    mPrevFeedback.clear();
+    mPrevCaret = 0;
+}
+
+void OsPreedit::compose_preedit_array(TxPacket *t,
+				      std::vector<uchar> &text,
+				      int first, int last)
+{
+    static const char padding[4] = {0, 0, 0, 0};
+    uString s(text.begin() + first, text.begin() + last);
+
+    char *c = to_ctext(&s);
+    int len = 0;
+    if (c)
+	len = static_cast<int>(strlen(c));
+    t->pushC16((C16)len); // LENGTH
+    if (len)
+	t->pushBytes(c, len); // CTEXT
+    t->pushBytes(padding, pad4(len + 2)); // PADDING
+    free(c);
+}
+
+void OsPreedit::compose_feedback_array(TxPacket *t,
+				       std::vector<C32> &feedback,
+				       int first, int last)
+{
+    int i;
+    t->pushC16((C16)((last - first) * 4));
+    t->pushC16(0);
+    for (i = first; i < last; i++) {
+	t->pushC32(feedback[i]);
+    }
+}
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ */
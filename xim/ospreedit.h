@@ -0,0 +1,75 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+*/
+
+
+// -*- C++ -*-
+#ifndef UIM_XIM_OSPREEDIT_H
+#define UIM_XIM_OSPREEDIT_H
+
+#include <list>
+#include <vector>
+#include "xim.h"
+
+// The preedit of an on-the-spot client as it was last drawn.  draw()
+// composes the packets which bring the client up to date, and only the
+// characters between the common head and tail are sent again.
+class OsPreedit {
+public:
+    OsPreedit(C16 imid, C16 icid);
+    virtual ~OsPreedit();
+    // appends the packets to q; text and feedback are taken over
+    void draw(std::vector<uchar> &text, std::vector<C32> &feedback,
+	      int caret_pos, std::list<TxPacket *> &q);
+    // forgets what was drawn, as the client has dropped it
+    void clear();
+
+protected:
+    // returns the malloc()ed compound text of s
+    virtual char *to_ctext(uString *s) = 0;
+
+private:
+    void compose_preedit_array(TxPacket *, std::vector<uchar> &, int, int);
+    void compose_feedback_array(TxPacket *, std::vector<C32> &, int, int);
+
+    C16 mImid, mIcid;
+    std::vector<uchar> mPrevText;
+    std::vector<C32> mPrevFeedback;
+    int mPrevCaret;
+};
+
+#endif
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ */
@@ -0,0 +1,236 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+*/
+
+// A fake XIM client for test-xim-order.sh.  It sends a fast stream of
+// key events to its own window, lets uim-xim filter them, and checks
+// that the keys forwarded back arrive in the order they were typed.
+// Then it sends keys one at a time and reports how long each one takes
+// to come back.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#define TIMEOUT 10000 // msec
+#define EXIT_SKIP 77
+#define NR_LATENCY_KEYS 200
+
+static const char text[] =
+    "the quick brown fox jumps over the lazy dog "
+    "pack my box with five dozen liquor jugs";
+
+static bool next_event(Display *dpy, XEvent *ev, int timeout)
+{
+    while (!XPending(dpy)) {
+	struct pollfd pfd;
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, timeout) <= 0)
+	    return false;
+    }
+    XNextEvent(dpy, ev);
+    return true;
+}
+
+// uim-xim may still be starting
+static XIM open_im(Display *dpy)
+{
+    XIM im;
+    int i;
+
+    for (i = 0; i < TIMEOUT / 100; i++) {
+	if ((im = XOpenIM(dpy, NULL, NULL, NULL)))
+	    return im;
+	usleep(100 * 1000);
+    }
+    return NULL;
+}
+
+static void send_key(Display *dpy, Window win, KeySym sym)
+{
+    XEvent ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.xkey.type = KeyPress;
+    ev.xkey.display = dpy;
+    ev.xkey.window = win;
+    ev.xkey.root = DefaultRootWindow(dpy);
+    ev.xkey.subwindow = None;
+    ev.xkey.time = CurrentTime;
+    ev.xkey.same_screen = True;
+    ev.xkey.keycode = XKeysymToKeycode(dpy, sym);
+    XSendEvent(dpy, win, False, KeyPressMask, &ev);
+}
+
+// the text of the next key that uim-xim has forwarded back
+static bool receive_key(Display *dpy, XIC ic, std::string *received)
+{
+    XEvent ev;
+    char buf[64];
+    KeySym sym;
+    Status status;
+    int len;
+
+    for (;;) {
+	if (!next_event(dpy, &ev, TIMEOUT))
+	    return false;
+	if (XFilterEvent(&ev, None) || ev.type != KeyPress)
+	    continue;
+	len = Xutf8LookupString(ic, &ev.xkey, buf, sizeof(buf) - 1, &sym,
+				&status);
+	if (status == XLookupChars || status == XLookupBoth) {
+	    received->append(buf, len);
+	    return true;
+	}
+    }
+}
+
+static double now_msec()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// from XSendEvent() to the forwarded key, waiting for each one
+static bool measure_latency(Display *dpy, Window win, XIC ic)
+{
+    std::string received;
+    double start, elapsed, total = 0, max = 0;
+    int i;
+
+    for (i = 0; i < NR_LATENCY_KEYS; i++) {
+	start = now_msec();
+	send_key(dpy, win, XK_a + i % 26);
+	XFlush(dpy);
+	if (!receive_key(dpy, ic, &received))
+	    return false;
+	elapsed = now_msec() - start;
+	total += elapsed;
+	if (elapsed > max)
+	    max = elapsed;
+    }
+    fprintf(stderr, "keystroke latency: %.3f msec on average, %.3f msec at most"
+	    " (%d keys)\n", total / NR_LATENCY_KEYS, max, NR_LATENCY_KEYS);
+
+    return true;
+}
+
+int main()
+{
+    Display *dpy;
+    Window win;
+    XIM im;
+    XIC ic;
+    XEvent ev;
+    unsigned long filter_mask = 0;
+    std::string received;
+    const char *p;
+    bool measured;
+
+    if (!setlocale(LC_ALL, "en_US.UTF-8") || !XSupportsLocale()) {
+	fprintf(stderr, "en_US.UTF-8 is not supported; skipped\n");
+	return EXIT_SKIP;
+    }
+    XSetLocaleModifiers("@im=uim");
+
+    if (!(dpy = XOpenDisplay(NULL))) {
+	fprintf(stderr, "cannot open display\n");
+	return EXIT_FAILURE;
+    }
+    if (!(im = open_im(dpy))) {
+	fprintf(stderr, "cannot open uim-xim\n");
+	return EXIT_FAILURE;
+    }
+
+    win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 100, 100,
+			      0, 0, 0);
+    ic = XCreateIC(im, XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
+		   XNClientWindow, win, XNFocusWindow, win, NULL);
+    if (!ic) {
+	fprintf(stderr, "cannot create an input context\n");
+	return EXIT_FAILURE;
+    }
+    XGetICValues(ic, XNFilterEvents, &filter_mask, NULL);
+    XSelectInput(dpy, win, KeyPressMask | StructureNotifyMask | filter_mask);
+    XMapWindow(dpy, win);
+    do {
+	if (!next_event(dpy, &ev, TIMEOUT)) {
+	    fprintf(stderr, "window not mapped\n");
+	    return EXIT_FAILURE;
+	}
+    } while (ev.type != MapNotify);
+    XSetICFocus(ic);
+
+    // the whole stream at once, without waiting for uim-xim
+    for (p = text; *p; p++)
+	send_key(dpy, win, *p == ' ' ? XK_space : XK_a + (*p - 'a'));
+    XFlush(dpy);
+
+    while (received.size() < strlen(text)) {
+	if (!receive_key(dpy, ic, &received))
+	    break;
+    }
+
+    measured = measure_latency(dpy, win, ic);
+
+    XDestroyIC(ic);
+    XCloseIM(im);
+    XCloseDisplay(dpy);
+
+    if (received != text) {
+	fprintf(stderr, "sent:     \"%s\"\nreceived: \"%s\"\n", text,
+		received.c_str());
+	return EXIT_FAILURE;
+    }
+    if (!measured) {
+	fprintf(stderr, "a key was lost while measuring the latency\n");
+	return EXIT_FAILURE;
+    }
+    fprintf(stderr, "tests succeeded.\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Replays a fast key stream through uim-xim on an Xvfb server with
+# test-xim-order, and checks that the keys come back to the client in
+# order.  The full-synchronous flow is run first as the reference for
+# the keystroke latency of --async-forward.  Skipped when Xvfb is not
+# installed.
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found; skipped"
+    exit 77
+fi
+
+n=90
+while test -e /tmp/.X$n-lock; do
+    n=`expr $n + 1`
+done
+DISPLAY=:$n
+export DISPLAY
+
+Xvfb $DISPLAY -nolisten tcp >/dev/null 2>&1 &
+xvfb_pid=$!
+xim_pid=
+trap 'kill $xim_pid $xvfb_pid 2>/dev/null' 0
+
+# wait for the server
+i=0
+while test ! -e /tmp/.X11-unix/X$n; do
+    i=`expr $i + 1`
+    if test $i -gt 10; then
+	echo "Xvfb did not start"
+	exit 1
+    fi
+    sleep 1
+done
+
+for opt in "" --async-forward; do
+    echo "uim-xim --engine=direct $opt"
+    ./uim-xim --engine=direct $opt >/dev/null &
+    xim_pid=$!
+    ./test-xim-order
+    status=$?
+    kill $xim_pid
+    wait $xim_pid 2>/dev/null
+    xim_pid=
+    test $status -eq 0 || exit $status
+done
@@ -0,0 +1,307 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project https://github.com/uim/uim
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+*/
+
+// Checks the bytes of TxPackets written in both byte orders, and the
+// packets which redraw the preedit of an on-the-spot client.
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "xim.h"
+#include "ospreedit.h"
+
+#define TEST(cond)							\
+    do {								\
+	if (!(cond)) {							\
+	    fprintf(stderr, "%s:%d: test failed: %s\n",			\
+		    __FILE__, __LINE__, #cond);				\
+	    exit(EXIT_FAILURE);						\
+	}								\
+    } while (0)
+
+// ximpacket.cpp refers to it; it is defined in main.cpp
+int g_option_mask;
+
+static void expect_bytes(TxPacket *t, int byte_order,
+			 const unsigned char *expected, int len)
+{
+    unsigned char buf[64];
+
+    memset(buf, 0, sizeof(buf));
+    TEST(t->write_to_buf(buf, sizeof(buf), byte_order) == len);
+    TEST(memcmp(buf, expected, len) == 0);
+}
+
+static void test_fields()
+{
+    static const unsigned char lsb[] = {
+	XIM_COMMIT, 0, 4, 0,
+	0x02, 0x01, 0x04, 0x03,
+	0x0b, 0x0a,
+	0x08, 0x07, 0x06, 0x05,
+	2, 0, 'a', 'b',
+	9, 0
+    };
+    static const unsigned char msb[] = {
+	XIM_COMMIT, 0, 0, 4,
+	0x01, 0x02, 0x03, 0x04,
+	0x0a, 0x0b,
+	0x05, 0x06, 0x07, 0x08,
+	0, 2, 'a', 'b',
+	9, 0
+    };
+    TxPacket *t;
+    int pos;
+
+    t = createTxPacket(XIM_COMMIT, 0);
+    t->pushC16(0x0102);
+    t->pushC16(0x0304);
+    pos = t->reserveC16();
+    TEST(pos == 4);
+    t->pushC32(0x05060708);
+    t->pushSTRING((char *)"ab");
+    t->pushC8(9);
+    t->pushC16(0xffff);
+    TEST(t->pop_back() == 2);
+    t->patchC16(pos, 0x0a0b);
+    TEST(t->get_length() == 19);
+
+    expect_bytes(t, LSB_FIRST, lsb, sizeof(lsb));
+    expect_bytes(t, MSB_FIRST, msb, sizeof(msb));
+    // writing does not change the packet
+    expect_bytes(t, LSB_FIRST, lsb, sizeof(lsb));
+    delete t;
+}
+
+static void test_pop_back()
+{
+    static const unsigned char lsb[] = {
+	XIM_COMMIT, 0, 2, 0,
+	3, 0, 'a', 'b', 'c', 0, 0, 0
+    };
+    static const unsigned char msb[] = {
+	XIM_COMMIT, 0, 0, 2,
+	0, 3, 'a', 'b', 'c', 0, 0, 0
+    };
+    static const unsigned char empty[] = {
+	XIM_COMMIT, 0, 0, 0
+    };
+    TxPacket *t;
+
+    t = createTxPacket(XIM_COMMIT, 0);
+    t->pushSTRING((char *)"abc");
+    t->pushBytes("xy", 2);
+    TEST(t->pop_back() == 2);
+    expect_bytes(t, LSB_FIRST, lsb, sizeof(lsb));
+    expect_bytes(t, MSB_FIRST, msb, sizeof(msb));
+
+    // the padding goes with the STRING
+    TEST(t->pop_back() == 8);
+    TEST(t->get_length() == 4);
+    expect_bytes(t, LSB_FIRST, empty, sizeof(empty));
+    expect_bytes(t, MSB_FIRST, empty, sizeof(empty));
+    delete t;
+}
+
+class TestPreedit : public OsPreedit {
+public:
+    TestPreedit() : OsPreedit(1, 2) {}
+    void draw_str(const char *str, const C32 *fb, int caret_pos,
+		  std::list<TxPacket *> &q) {
+	std::vector<uchar> text;
+	std::vector<C32> feedback;
+	for (int i = 0; str[i]; i++) {
+	    text.push_back(str[i]);
+	    feedback.push_back(fb[i]);
+	}
+	draw(text, feedback, caret_pos, q);
+    }
+
+protected:
+    virtual char *to_ctext(uString *s) {
+	char *c = (char *)malloc(s->size() + 1);
+	char *p = c;
+	uString::iterator i;
+	for (i = s->begin(); i != s->end(); ++i)
+	    *p++ = (char)*i;
+	*p = '\0';
+	return c;
+    }
+};
+
+#define EXPECT_PACKET(q, expected)					\
+    do {								\
+	TEST(!(q).empty());						\
+	expect_bytes((q).front(), LSB_FIRST, expected, sizeof(expected)); \
+	delete (q).front();						\
+	(q).pop_front();						\
+    } while (0)
+
+static const unsigned char preedit_start[] = {
+    XIM_PREEDIT_START, 0, 1, 0, 1, 0, 2, 0
+};
+static const unsigned char preedit_done[] = {
+    XIM_PREEDIT_DONE, 0, 1, 0, 1, 0, 2, 0
+};
+
+#define PREEDIT_CARET(pos) {						\
+	XIM_PREEDIT_CARET, 0, 4, 0, 1, 0, 2, 0,				\
+	pos, 0, 0, 0,							\
+	XIMAbsolutePosition, 0, 0, 0,					\
+	XIMIsPrimary, 0, 0, 0						\
+    }
+
+static void test_preedit_draw()
+{
+    static const C32 ul[] = {
+	FB_Underline, FB_Underline, FB_Underline
+    };
+    static const C32 rev_ul[] = {
+	FB_Reverse, FB_Underline
+    };
+    // caret, chg_first, chg_length, status, "ab", feedback
+    static const unsigned char insert_ab[] = {
+	XIM_PREEDIT_DRAW, 0, 9, 0, 1, 0, 2, 0,
+	2, 0, 0, 0,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0, 0, 0,
+	2, 0, 'a', 'b',
+	8, 0, 0, 0,  FB_Underline, 0, 0, 0,  FB_Underline, 0, 0, 0
+    };
+    static const unsigned char caret_2[] = PREEDIT_CARET(2);
+    // "ab" -> "acb"
+    static const unsigned char insert_c[] = {
+	XIM_PREEDIT_DRAW, 0, 8, 0, 1, 0, 2, 0,
+	2, 0, 0, 0,  1, 0, 0, 0,  0, 0, 0, 0,  0, 0, 0, 0,
+	1, 0, 'c', 0,
+	4, 0, 0, 0,  FB_Underline, 0, 0, 0
+    };
+    // "acb" -> "ab"; no string nor feedback
+    static const unsigned char delete_c[] = {
+	XIM_PREEDIT_DRAW, 0, 7, 0, 1, 0, 2, 0,
+	1, 0, 0, 0,  1, 0, 0, 0,  1, 0, 0, 0,  3, 0, 0, 0,
+	0, 0, 0, 0,
+	0, 0, 0, 0
+    };
+    static const unsigned char caret_1[] = PREEDIT_CARET(1);
+    // "ab" -> "xb"
+    static const unsigned char replace_a[] = {
+	XIM_PREEDIT_DRAW, 0, 8, 0, 1, 0, 2, 0,
+	1, 0, 0, 0,  0, 0, 0, 0,  1, 0, 0, 0,  0, 0, 0, 0,
+	1, 0, 'x', 0,
+	4, 0, 0, 0,  FB_Underline, 0, 0, 0
+    };
+    // the same text with another feedback
+    static const unsigned char reverse_x[] = {
+	XIM_PREEDIT_DRAW, 0, 8, 0, 1, 0, 2, 0,
+	1, 0, 0, 0,  0, 0, 0, 0,  1, 0, 0, 0,  0, 0, 0, 0,
+	1, 0, 'x', 0,
+	4, 0, 0, 0,  FB_Reverse, 0, 0, 0
+    };
+    static const unsigned char caret_0[] = PREEDIT_CARET(0);
+    // "xb" -> ""
+    static const unsigned char erase_all[] = {
+	XIM_PREEDIT_DRAW, 0, 7, 0, 1, 0, 2, 0,
+	0, 0, 0, 0,  0, 0, 0, 0,  2, 0, 0, 0,  3, 0, 0, 0,
+	0, 0, 0, 0,
+	0, 0, 0, 0
+    };
+    TestPreedit pe;
+    std::list<TxPacket *> q;
+
+    pe.draw_str("ab", ul, 2, q);
+    EXPECT_PACKET(q, preedit_start);
+    EXPECT_PACKET(q, insert_ab);
+    EXPECT_PACKET(q, caret_2);
+    TEST(q.empty());
+
+    pe.draw_str("acb", ul, 2, q);
+    EXPECT_PACKET(q, insert_c);
+    EXPECT_PACKET(q, caret_2);
+    TEST(q.empty());
+
+    pe.draw_str("ab", ul, 1, q);
+    EXPECT_PACKET(q, delete_c);
+    EXPECT_PACKET(q, caret_1);
+    TEST(q.empty());
+
+    pe.draw_str("xb", ul, 1, q);
+    EXPECT_PACKET(q, replace_a);
+    EXPECT_PACKET(q, caret_1);
+    TEST(q.empty());
+
+    pe.draw_str("xb", rev_ul, 1, q);
+    EXPECT_PACKET(q, reverse_x);
+    EXPECT_PACKET(q, caret_1);
+    TEST(q.empty());
+
+    // only the caret moves
+    pe.draw_str("xb", rev_ul, 0, q);
+    EXPECT_PACKET(q, caret_0);
+    TEST(q.empty());
+
+    // nothing to redraw
+    pe.draw_str("xb", rev_ul, 0, q);
+    TEST(q.empty());
+
+    pe.draw_str("", ul, 0, q);
+    EXPECT_PACKET(q, erase_all);
+    EXPECT_PACKET(q, preedit_done);
+    TEST(q.empty());
+
+    // cleared by the client; drawing starts over
+    pe.draw_str("ab", ul, 2, q);
+    pe.clear();
+    while (!q.empty()) {
+	delete q.front();
+	q.pop_front();
+    }
+    pe.draw_str("ab", ul, 2, q);
+    EXPECT_PACKET(q, preedit_start);
+    EXPECT_PACKET(q, insert_ab);
+    EXPECT_PACKET(q, caret_2);
+    TEST(q.empty());
+}
+
+int main()
+{
+    test_fields();
+    test_pop_back();
+    test_preedit_draw();
+
+    fprintf(stderr, "tests succeeded.\n");
+
+    return EXIT_SUCCESS;
+}
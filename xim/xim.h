@@ -73,6 +73,9 @@ public:
     virtual int pushSTRING(char *) = 0;
     virtual int pushBytes(const char *, int) = 0;
 
+    virtual int reserveC16() = 0;
+    virtual void patchC16(int pos, C16) = 0;
+
     virtual int pop_back() = 0;
 };
 
@@ -100,6 +103,7 @@ public:
 
 TxPacket *createTxPacket(C8 major, C8 minor);
 RxPacket *createRxPacket(unsigned char *buf, int byte_order);
+RxPacket *createRxPacketView(unsigned char *buf, int byte_order);
 RxPacket *copyRxPacket(RxPacket *packet);
 
 class Connection {
@@ -128,6 +132,8 @@ protected:
     virtual void setPreeditCaretSyncFlag();
     virtual void unsetPreeditCaretSyncFlag();
     virtual bool hasPreeditCaretSyncFlag();
+    virtual void addPendingSyncReply();
+    virtual bool hasPendingSyncReply();
 
     std::list<RxPacket *> mRxQ;
     std::list<TxPacket *> mTxQ;
@@ -168,6 +174,8 @@ private:
     bool mSyncFlag;
     bool mPreeditStartSyncFlag;
     bool mPreeditCaretSyncFlag;
+    // XIM_SYNC_REPLY awaited for packets which did not set mSyncFlag
+    int mNrPendingSyncReplies;
     struct timeval mSyncStartTime;
 };
 
@@ -198,7 +206,7 @@ public:
     struct input_style *getInputStyles();
     // for Compose
     void create_compose_tree();
-    DefTree *get_compose_tree();
+    uim_x_compose_table *get_compose_tree();
 
 protected:
     Connection *mConn;
@@ -211,10 +219,10 @@ protected:
     int get_compose_filename(char *filename, size_t len);
     int TransFileName(char *transname, const char *name, size_t len);
     void ParseComposeStringFile(FILE *fp);
-    void FreeComposeTree(DefTree *top);
     int parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen);
     int get_mb_string(char *buf, KeySym ks);
-    DefTree *mTreeTop;
+    uim_x_compose_builder *mComposeBuilder;
+    uim_x_compose_table *mComposeTable;
 };
 
 C16 unused_im_id();
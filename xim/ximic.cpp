@@ -107,6 +107,7 @@ release_font_set(const char *name, const char *locale)
 	if (!strcmp(it->name, name) && !strcmp(it->locale, locale)) {
 	    it->refc--;
 	    if (!it->refc) {
+		forget_glyph_extents(it->fs);
 		XFreeFontSet(XimServer::gDpy, it->fs);
 		free(it->name);
 		free(it->locale);
@@ -623,6 +624,9 @@ Convdisp *XimIC::get_convdisp()
 
 void XimIC::onSendPacket()
 {
+    if (mConvdisp)
+	mConvdisp->flush_preedit();
+
     if (mPending.empty())
 	return;
 
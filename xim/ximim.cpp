@@ -393,7 +393,8 @@ XimIM::XimIM(Connection *c, C16 id)
     mID = id;
     mEncoding = NULL;
     mLangRegion = NULL;
-    mTreeTop = NULL;
+    mComposeBuilder = NULL;
+    mComposeTable = NULL;
     mLocale = NULL;
 }
 
@@ -401,24 +402,10 @@ XimIM::~XimIM()
 {
     free(mEncoding);
     free(mLangRegion);
-    FreeComposeTree(mTreeTop);
+    uim_x_compose_table_free(mComposeTable);
     delete mLocale;
 }
 
-void XimIM::FreeComposeTree(DefTree *top)
-{
-   if (!top)
-	return;
-
-   if (top->succession)
-	FreeComposeTree(top->succession);
-   if (top->next)
-	FreeComposeTree(top->next);
-   free(top->mb);
-   free(top->utf8);
-   free(top);
-}
-
 void XimIM::set_encoding(const char *encoding)
 {
     free(mEncoding);
@@ -37,7 +37,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <list>
+#include <vector>
 
 #include "xim.h"
 #include "util.h"
@@ -115,111 +115,12 @@ C32 readC32(unsigned char *buf, int byte_order)
 // TxPacket
 //
 
-class TxElement{
-public:
-    virtual ~TxElement() {};
-    virtual int get_size() = 0;
-    virtual int write_to_buf(unsigned char *buf, int byte_order) = 0;
-};
-
-class TxC8 : public TxElement {
-public:
-    TxC8(C8 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 1;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC8(val, bo, buf);
-	return 1;
-    }
-private:
-    C8 val;
-};
-
-class TxC16 : public TxElement {
-public:
-    TxC16(C16 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 2;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC16(val, bo, buf);
-	return 2;
-    }
-private:
-    C16 val;
-};
-
-class TxC32 : public TxElement {
-public:
-    TxC32(C32 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 4;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC32(val, bo, buf);
-	return 4;
-    }
-private:
-    C32 val;
-};
-
-class TxString : public TxElement {
-public:
-    TxString(char *s) {
-	init(s, static_cast<int>(strlen(s)));
-    }
-    TxString(char *s, int len) {
-	init(s, static_cast<int>(len));
-    }
-    virtual ~TxString() {
-	free(m_str);
-    }
-    virtual int get_size() {
-	return 2 + m_len + pad4(2 + m_len);
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC16((C16)m_len, bo, buf);
-	memcpy(&buf[2], m_str, m_len);
-	return get_size();
-    }
-private:
-    void init(char *s, int len) {
-	m_len = len;
-	m_str = (char *)malloc(len + 1);
-	strlcpy(m_str, s, len + 1);
-    }
-    int m_len;
-    char *m_str;
-};
-
-class TxBytes : public TxElement {
-public:
-    TxBytes(const char *s, int len) {
-	m_str = (char *)malloc(len);
-	m_len = len;
-	memcpy(m_str, s, len);
-    };
-    virtual ~TxBytes() {
-	free(m_str);
-    }
-    virtual int get_size() {
-	return m_len;
-    }
-    virtual int write_to_buf(unsigned char *buf, int /* bo */) {
-	memcpy(buf, m_str, m_len);
-	return get_size();
-    }
-private:
-    int m_len;
-    char *m_str;
-};
+// The body of a TxPacket is kept in a single growable buffer, encoded in
+// LSB_FIRST order since the byte order of the peer is only known when the
+// packet is written out.  Each pushed field is recorded with its offset so
+// that pop_back() can drop it and write_to_buf() can swap the multi-byte
+// fields in place for MSB_FIRST peers.
+#define TX_INIT_BUF_SIZE 32
 
 class TxPacket_impl : public TxPacket {
 public:
@@ -238,50 +139,96 @@ public:
     virtual int pushSTRING(char *);
     virtual int pushBytes(const char *, int);
 
+    virtual int reserveC16();
+    virtual void patchC16(int pos, C16);
+
     virtual int pop_back();
 private:
+    enum field_type {
+	FIELD_C8,
+	FIELD_C16,
+	FIELD_C32,
+	FIELD_STRING,	// C16 length followed by the bytes and padding
+	FIELD_BYTES
+    };
+    struct field {
+	int offset;
+	field_type type;
+    };
+    unsigned char *append(field_type type, int len);
     void write_header(unsigned char *buf, int l, int byte_order);
     C8 m_major, m_minor;
-    std::list <TxElement *> m_elms;
+    unsigned char *m_buf;
+    int m_len, m_size;
+    std::vector<field> m_fields;
 };
 
 TxPacket_impl::TxPacket_impl(C8 major, C8 minor)
 {
     m_major = major;
     m_minor = minor;
+    m_buf = NULL;
+    m_len = 0;
+    m_size = 0;
 }
 
 TxPacket_impl::~TxPacket_impl()
 {
-    std::list<TxElement *>::iterator i;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	delete *i;
+    free(m_buf);
+}
+
+unsigned char *TxPacket_impl::append(field_type type, int len)
+{
+    if (m_len + len > m_size) {
+	int size = m_size ? m_size : TX_INIT_BUF_SIZE;
+	while (m_len + len > size)
+	    size *= 2;
+	m_buf = (unsigned char *)realloc(m_buf, size);
+	m_size = size;
     }
+
+    field f;
+    f.offset = m_len;
+    f.type = type;
+    m_fields.push_back(f);
+
+    unsigned char *p = &m_buf[m_len];
+    m_len += len;
+    return p;
 }
 
 int TxPacket_impl::get_length()
 {
-    std::list<TxElement *>::iterator i;
-    int l;
-    l = 4;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	l +=  (*i)->get_size();
-    }  
-    return l;
+    return 4 + m_len;
 }
 
 int TxPacket_impl::write_to_buf(unsigned char *buf, int buflen, int byte_order)
 {
-    std::list<TxElement *>::iterator i;
-    int l, m;
-    l = 4;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	m = (*i)->get_size();
-	if (l + m > buflen)
-	    return 0;
+    int l;
+    l = 4 + m_len;
+    if (l > buflen)
+	return 0;
 
-	m = (*i)->write_to_buf(&buf[l], byte_order);
-	l += m;
+    if (m_len)
+	memcpy(&buf[4], m_buf, m_len);
+    if (byte_order != LSB_FIRST) {
+	std::vector<field>::iterator i;
+	unsigned char *p, c;
+	for (i = m_fields.begin(); i != m_fields.end(); ++i) {
+	    p = &buf[4 + (*i).offset];
+	    switch ((*i).type) {
+	    case FIELD_C16:
+	    case FIELD_STRING:
+		c = p[0]; p[0] = p[1]; p[1] = c;
+		break;
+	    case FIELD_C32:
+		c = p[0]; p[0] = p[3]; p[3] = c;
+		c = p[1]; p[1] = p[2]; p[2] = c;
+		break;
+	    default:
+		break;
+	    }
+	}
     }
     l = rup4(l);
     write_header(buf, l, byte_order);
@@ -290,52 +237,63 @@ int TxPacket_impl::write_to_buf(unsigned char *buf, int buflen, int byte_order)
 
 int TxPacket_impl::pushC8(C8 v)
 {
-    TxElement *e;
-    e = new TxC8(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC8(v, LSB_FIRST, append(FIELD_C8, 1));
+    return 1;
 }
 
 int TxPacket_impl::pushC16(C16 v)
 {
-    TxElement *e;
-    e = new TxC16(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC16(v, LSB_FIRST, append(FIELD_C16, 2));
+    return 2;
 }
 
 int TxPacket_impl::pushC32(C32 v)
 {
-    TxElement *e;
-    e = new TxC32(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC32(v, LSB_FIRST, append(FIELD_C32, 4));
+    return 4;
 }
 
 int TxPacket_impl::pushSTRING(char *s)
 {
-    TxElement *e;
-    e = new TxString(s);
-    m_elms.push_back(e);
-    return e->get_size();
+    int len, size;
+    unsigned char *p;
+    len = static_cast<int>(strlen(s));
+    size = 2 + len + pad4(2 + len);
+    p = append(FIELD_STRING, size);
+    writeC16((C16)len, LSB_FIRST, p);
+    memcpy(&p[2], s, len);
+    memset(&p[2 + len], 0, size - 2 - len);
+    return size;
 }
 
 int TxPacket_impl::pushBytes(const char *b, int len)
 {
-    TxElement *e;
-    e = new TxBytes(b, len);
-    m_elms.push_back(e);
-    return e->get_size();
+    unsigned char *p = append(FIELD_BYTES, len);
+    if (len)
+	memcpy(p, b, len);
+    return len;
+}
+
+// Push a C16 whose value is not known yet, such as the length of the
+// list that follows it, and return its position for patchC16().
+int TxPacket_impl::reserveC16()
+{
+    int pos = m_len;
+    pushC16(0);
+    return pos;
+}
+
+void TxPacket_impl::patchC16(int pos, C16 v)
+{
+    writeC16(v, LSB_FIRST, &m_buf[pos]);
 }
 
 int TxPacket_impl::pop_back()
 {
     int len;
-    TxElement *e;
-    e = m_elms.back();
-    len = e->get_size();
-    delete e;
-    m_elms.pop_back();
+    len = m_len - m_fields.back().offset;
+    m_len = m_fields.back().offset;
+    m_fields.pop_back();
     return len;
 }
 
@@ -372,7 +330,7 @@ TxPacket *createTxPacket(C8 major, C8 minor)
 //
 class RxPacket_impl : public RxPacket {
 public:
-    RxPacket_impl(unsigned char *buf, int byte_order);
+    RxPacket_impl(unsigned char *buf, int byte_order, bool copy);
     RxPacket_impl(const RxPacket_impl& rhs);
     virtual ~RxPacket_impl();
 
@@ -400,13 +358,18 @@ private:
     int mIndex;
     int mByteOrder;
     bool mIsOverRun;
+    bool mOwnBuf;
 };
 
-RxPacket_impl::RxPacket_impl(unsigned char *b, int byte_order)
+RxPacket_impl::RxPacket_impl(unsigned char *b, int byte_order, bool copy)
 {
     mLen = getPacketLength(b, byte_order);
-    mBuf = (unsigned char *)malloc(mLen);
-    memcpy(mBuf, b, mLen);
+    if (copy) {
+	mBuf = (unsigned char *)malloc(mLen);
+	memcpy(mBuf, b, mLen);
+    } else
+	mBuf = b;
+    mOwnBuf = copy;
     mByteOrder = byte_order;
     rewind();
 }
@@ -419,11 +382,13 @@ RxPacket_impl::RxPacket_impl(const RxPacket_impl& rhs) : RxPacket(rhs)
     mIndex = rhs.mIndex;
     mByteOrder = rhs.mByteOrder;
     mIsOverRun = rhs.mIsOverRun;
+    mOwnBuf = true;
 }
 
 RxPacket_impl::~RxPacket_impl()
 {
-    free(mBuf);
+    if (mOwnBuf)
+	free(mBuf);
 }
 
 void RxPacket_impl::rewind()
@@ -539,7 +504,14 @@ int RxPacket::getPacketLength(unsigned char *buf, int byte_order)
 
 RxPacket *createRxPacket(unsigned char *buf, int byte_order)
 {
-    return new RxPacket_impl(buf, byte_order);
+    return new RxPacket_impl(buf, byte_order, true);
+}
+
+// The packet reads directly from buf, which must be left untouched until
+// the packet is deleted.
+RxPacket *createRxPacketView(unsigned char *buf, int byte_order)
+{
+    return new RxPacket_impl(buf, byte_order, false);
 }
 
 RxPacket *copyRxPacket(RxPacket *p)
@@ -431,6 +431,8 @@ InputContext::createUimContext(const char *engine)
 			InputContext::candidate_deactivate_cb);
 	uim_set_prop_list_update_cb(uc,
 			InputContext::update_prop_list_cb);
+	uim_set_prop_state_update_cb(uc,
+			InputContext::update_prop_state_cb);
 #if 0
 	uim_set_prop_label_update_cb(uc,
 			InputContext::update_prop_label_cb);
@@ -443,6 +445,8 @@ InputContext::createUimContext(const char *engine)
 #if UIM_XIM_USE_DELAY
 	uim_set_delay_candidate_selector_cb(uc,
 			InputContext::candidate_activate_with_delay_cb);
+	uim_set_delay_candidate_selector_fd_cb(uc,
+			InputContext::candidate_activate_on_fd_cb);
 #endif
 
 	if (mFocusedContext == this)
@@ -569,6 +573,7 @@ InputContext::focusIn()
     setlocale(LC_CTYPE, mLocaleName);
 
     check_helper_connection();
+    uim_helper_client_begin_batch();
     uim_helper_client_focus_in(mUc);
     mFocusedContext = this;
     if (mConvdisp) {
@@ -581,6 +586,7 @@ InputContext::focusIn()
     if (hasActiveCandwin())
 	candidate_update();
     uim_focus_in_context(mUc);
+    uim_helper_client_end_batch();
 }
 
 void
@@ -648,7 +654,13 @@ void InputContext::candidate_activate_cb(void *ptr, int nr, int display_limit)
 void InputContext::candidate_activate_with_delay_cb(void *ptr, int delay)
 {
     InputContext *ic = (InputContext *)ptr;
-    ic->candidate_activate_with_delay(delay);
+    ic->candidate_activate_with_delay(delay * 1000);
+}
+
+void InputContext::candidate_activate_on_fd_cb(void *ptr, int fd)
+{
+    InputContext *ic = (InputContext *)ptr;
+    ic->candidate_activate_on_fd(fd);
 }
 
 void InputContext::candidate_activate_timeout_cb(void *ptr)
@@ -685,6 +697,14 @@ void InputContext::update_prop_list_cb(void *ptr, const char *str)
       ic->update_prop_list(str);
 }
 
+void InputContext::update_prop_state_cb(void *ptr, const char *str)
+{
+    InputContext *ic = (InputContext *)ptr;
+    InputContext *focusedContext = InputContext::focusedContext();
+    if (ic == focusedContext)
+      ic->update_prop_state(str);
+}
+
 void InputContext::update_prop_label_cb(void *ptr, const char *str)
 {
     InputContext *ic = (InputContext *)ptr;
@@ -912,16 +932,23 @@ void InputContext::candidate_activate(int nr, int display_limit)
 }
 
 #if UIM_XIM_USE_DELAY
-void InputContext::candidate_activate_with_delay(int delay)
+void InputContext::candidate_activate_with_delay(int msec)
 {
     timer_cancel();
-    if (delay > 0) {
-	timer_set(delay, InputContext::candidate_activate_timeout_cb, this);
+    if (msec > 0) {
+	timer_set(msec, InputContext::candidate_activate_timeout_cb, this);
     } else {
 	candidate_activate_timeout();
     }
 }
 
+void InputContext::candidate_activate_on_fd(int fd)
+{
+    timer_cancel();
+    if (fd >= 0)
+	timer_set_fd(fd, InputContext::candidate_activate_timeout_cb, this);
+}
+
 void InputContext::candidate_activate_timeout()
 {
     int nr = -1, display_limit = -1, selected_index = -1;
@@ -1142,10 +1169,22 @@ char *InputContext::get_caret_state_label_from_prop_list(const char *str)
 }
 
 void InputContext::update_prop_list(const char *str)
+{
+    send_prop_message("prop_list_update", str);
+}
+
+// The state string carries the same branch lines as prop_list, so the
+// caret state label can be extracted from either of them.
+void InputContext::update_prop_state(const char *str)
+{
+    send_prop_message("prop_state_update", str);
+}
+
+void InputContext::send_prop_message(const char *command, const char *str)
 {
     char *buf;
 
-    if (asprintf(&buf, "prop_list_update\ncharset=UTF-8\n%s", str) == -1) {
+    if (asprintf(&buf, "%s\ncharset=UTF-8\n%s", command, str) == -1) {
         free(buf);
         return;
     }
@@ -1225,7 +1264,7 @@ bool InputContext::isCaretStateShown()
 keyState::keyState(XimIC *ic)
 {
     XimIM *im;
-    DefTree *top;
+    uim_x_compose_table *top;
 
     mModState = 0;
     mIc = ic;
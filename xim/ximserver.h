@@ -104,7 +104,8 @@ void reload_uim(int x);
 void check_candwin_style();
 void check_candwin_pos_type();
 #if UIM_XIM_USE_DELAY
-void timer_set(int seconds, void (*timeout_cb)(void *ptr), void *ptr);
+void timer_set(int msec, void (*timeout_cb)(void *ptr), void *ptr);
+void timer_set_fd(int fd, void (*ready_cb)(void *ptr), void *ptr);
 void timer_cancel();
 #endif
 
@@ -116,6 +117,8 @@ void timer_cancel();
 #define OPT_TRACE_XIM 2
 // use on-demand-synchronous XIM event flow (not safe for Tcl/Tk 8.{3,4})
 #define OPT_ON_DEMAND_SYNC 4
+// let only the next XIM_COMMIT or XIM_FORWARD_EVENT wait for XIM_SYNC_REPLY
+#define OPT_ASYNC_FORWARD 8
 
 
 // byte order
@@ -182,7 +185,8 @@ public:
     void update_preedit();
     void candidate_activate(int nr, int display_limit);
 #if UIM_XIM_USE_DELAY
-    void candidate_activate_with_delay(int delay);
+    void candidate_activate_with_delay(int msec);
+    void candidate_activate_on_fd(int fd);
     void candidate_activate_timeout();
 #endif
     void candidate_select(int index);
@@ -194,6 +198,7 @@ public:
     int prepare_page_candidates_by_index(int index);
 #endif
     void update_prop_list(const char *str);
+    void update_prop_state(const char *str);
     void update_prop_label(const char *str);
     bool hasActiveCandwin();
     bool isCaretStateShown();
@@ -214,12 +219,14 @@ public:
     static void candidate_activate_cb(void *ptr, int nr, int index);
 #if UIM_XIM_USE_DELAY
     static void candidate_activate_with_delay_cb(void *ptr, int delay);
+    static void candidate_activate_on_fd_cb(void *ptr, int fd);
     static void candidate_activate_timeout_cb(void *ptr);
 #endif
     static void candidate_select_cb(void *ptr, int index);
     static void candidate_shift_page_cb(void *ptr, int direction);
     static void candidate_deactivate_cb(void *ptr);
     static void update_prop_list_cb(void *ptr, const char *str);
+    static void update_prop_state_cb(void *ptr, const char *str);
     static void update_prop_label_cb(void *ptr, const char *str);
     static void configuration_changed_cb(void *ptr);
     static void switch_app_global_im_cb(void *ptr, const char *name);
@@ -231,6 +238,7 @@ private:
     void clear_pe_stat();
     void review_im(const char *engine);
     char *get_caret_state_label_from_prop_list(const char *str);
+    void send_prop_message(const char *command, const char *str);
 
     XimIC *mXic;
     XimServer *mServer;
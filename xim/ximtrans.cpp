@@ -108,18 +108,13 @@ XIMATTRIBUTE::XIMATTRIBUTE(const char *n, C16 t)
 
 void XIMATTRIBUTE::write_imattr_to_packet(TxPacket *p)
 {
-    int i, l;
+    int i, pos, start;
     char tmp[4];
     for (i = 0; i < 4; i++) {
 	tmp[i] = 0;
     }
-    for (i = 0, l = 0; i < (int)(sizeof(xim_attributes) / sizeof(XIMATTRIBUTE));
-	 i++) {
-	l += 6;
-	l += static_cast<int>(strlen(xim_attributes[i].name));
-	l += pad4(static_cast<int>(strlen(xim_attributes[i].name)) + 2);
-    }
-    p->pushC16((C16)l);
+    pos = p->reserveC16();
+    start = p->get_length();
     for (i = 0; i < (int)(sizeof(xim_attributes) / sizeof(XIMATTRIBUTE)); i++) {
 	p->pushC16((C16)i);
 	p->pushC16(xim_attributes[i].type);
@@ -129,6 +124,7 @@ void XIMATTRIBUTE::write_imattr_to_packet(TxPacket *p)
 	p->pushBytes(tmp, pad4(static_cast<int>(
 					strlen(xim_attributes[i].name))) + 2);
     }
+    p->patchC16(pos, (C16)(p->get_length() - start));
 }
 
 static struct XICATTRIBUTE {
@@ -168,18 +164,14 @@ XICATTRIBUTE::XICATTRIBUTE(const char *n, C16 t)
 
 void XICATTRIBUTE::write_icattr_to_packet(TxPacket *p)
 {
-    int i, l;
+    int i, pos, start;
     char tmp[4];
     for (i = 0; i < 4; i++) {
 	tmp[i] = 0;
     }
-    for (i = 0, l = 0; i < (int)(sizeof(xic_attributes) / sizeof(XICATTRIBUTE)); i++) {
-	l += 6;
-	l += static_cast<int>(strlen(xic_attributes[i].name));
-	l += pad4(static_cast<int>(strlen(xic_attributes[i].name)) + 2);
-    }
-    p->pushC16((C16)l);
+    pos = p->reserveC16();
     p->pushC16(0);
+    start = p->get_length();
     for (i = 0; i < (int)(sizeof(xic_attributes) / sizeof(XICATTRIBUTE)); i++) {
 	p->pushC16((C16)i);
 	p->pushC16(xic_attributes[i].type);
@@ -189,6 +181,7 @@ void XICATTRIBUTE::write_icattr_to_packet(TxPacket *p)
 	p->pushBytes(tmp, pad4(static_cast<int>(
 					strlen(xic_attributes[i].name)) + 2));
     }
+    p->patchC16(pos, (C16)(p->get_length() - start));
 }
 
 Connection::Connection(XimServer *svr)
@@ -199,6 +192,7 @@ Connection::Connection(XimServer *svr)
     mSyncFlag = false;
     mPreeditStartSyncFlag = false;
     mPreeditCaretSyncFlag = false;
+    mNrPendingSyncReplies = 0;
 }
 
 Connection::~Connection()
@@ -447,6 +441,17 @@ bool Connection::hasPreeditCaretSyncFlag()
     return mPreeditCaretSyncFlag;
 }
 
+void Connection::addPendingSyncReply()
+{
+    if (mNrPendingSyncReplies++ == 0)
+	X_GETTIMEOFDAY(&mSyncStartTime);
+}
+
+bool Connection::hasPendingSyncReply()
+{
+    return mNrPendingSyncReplies > 0;
+}
+
 //
 // Packet handlers
 //
@@ -707,12 +712,13 @@ void Connection::xim_forward_event(RxPacket *p)
     icid = p->getC16();
     p->rewind();
     im = get_im_by_id(imid);
-    if (hasSyncFlag()) {
+    if (hasSyncFlag() || hasPendingSyncReply()) {
 	if (is_xim_sync_reply_timeout()) {
 	    // XIM protocol error?
 	    push_error_packet(imid, icid, ERR_BadProtocol, "Bad Protocol");
 	    clear_pending_queue();
 	    unsetSyncFlag();
+	    mNrPendingSyncReplies = 0;
 	}
     }
     im->forward_event(p);
@@ -720,7 +726,11 @@ void Connection::xim_forward_event(RxPacket *p)
 
 void Connection::xim_sync_reply()
 {
-    unsetSyncFlag();
+    // the replies come in the order of the packets
+    if (mNrPendingSyncReplies > 0)
+	mNrPendingSyncReplies--;
+    else
+	unsetSyncFlag();
 }
 
 void Connection::xim_reset_ic(RxPacket *p)